@@ -0,0 +1,158 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef CC1101_TRANSCEIVER_H
+#define CC1101_TRANSCEIVER_H
+
+#include <cmath>
+#include <cstring>
+
+#include <Arduino.h>
+
+#include <iohcCrc.h>
+#include <iohcTransceiver.h>
+
+#if __has_include(<CC1101Helpers.h>)
+#include <CC1101Helpers.h>
+#else
+#error "CC1101 backend needs CC1101Helpers.h (Radio:: SPI helpers, frame encoder/decoder), not part of this tree"
+#endif
+
+/*
+    CC1101 backend of the transceiver concept. The CC1101 has no IoHome packet engine: frames are
+    encoded/decoded by software (start/stop bits) and the whole frame is read on GDO preamble detection.
+    The GDO line is reported as payload, so iohcRadio reads the frame at once.
+*/
+namespace Radio {
+    class CC1101Transceiver : public Transceiver<CC1101Transceiver> {
+    public:
+        static void init() {
+            initHardware();
+        }
+
+        static void attachInterrupts(void (*isr)()) {
+            attachInterrupt(RADIO_PREAMBLE_DETECTED, isr, RISING);
+        }
+
+        static Irq IRAM_ATTR readPins() {
+            return {false, static_cast<bool>(digitalRead(RADIO_PREAMBLE_DETECTED)), false};
+        }
+
+        // No Tx done line is wired, GDO only signals reception
+        static constexpr bool txDone = false;
+        static Status IRAM_ATTR status() { return {false, true}; }
+
+        static void IRAM_ATTR setRx() { Radio::setRx(); }
+        static void IRAM_ATTR setTx() { Radio::setTx(); }
+        static void IRAM_ATTR setStandby() { Radio::setStandby(); }
+        static void IRAM_ATTR setFrequency(uint32_t frequency) { setCarrier(Carrier::Frequency, frequency); }
+        static void IRAM_ATTR clearFlags() { Radio::clearFlags(); }
+        static void IRAM_ATTR clearFifo() { SPIsendCommand(CMD_FLUSH_TX); }
+        static void IRAM_ATTR readFifo(uint8_t *buffer, uint8_t length) { SPIreadRegisterBurst(REG_FIFO, length, buffer); }
+        static void IRAM_ATTR writeFifo(uint8_t *buffer, uint8_t length) { sendFrame(buffer, length); }
+        static bool IRAM_ATTR fifoNotEmpty() { return SPIgetRegValue(REG_RXBYTES, 6, 0) != 0; }
+
+        // Not supervised: no receiver state is read back, the watchdog only sees silence
+        static Health health() { return {true, true, false, true}; }
+
+        static void clearIrq() { clearFlags(); }
+        static void restartRx() {
+            SPIsendCommand(CMD_IDLE);
+            SPIsendCommand(CMD_FLUSH_RX | CMD_READ);
+            SPIsendCommand(CMD_RX);
+        }
+        static void saveConfig() {}
+        static void restoreConfig() { init(); }
+        static void reset() { init(); }
+
+        static void IRAM_ATTR readSignal(IOHC::iohcPacket *packet) {
+            uint8_t tmprssi = SPIgetRegValue(REG_RSSI);
+            if (tmprssi >= 128)
+                packet->setRssi((float)((tmprssi - 256) / 2) - 74);
+            else
+                packet->setRssi((float)(tmprssi / 2) - 74);
+        }
+
+        // Prepare (encode, add crc, and so no) the packet for CC1101 then send it
+        static void transmit(uint8_t *buffer, uint8_t length) {
+            sendFrame(buffer, length);
+            setTx();
+        }
+
+/**
+ * The function `receiveFrame` reads the encoded frame as it comes, sizing it from its first byte,
+ * then decodes it and checks the CRC. The receiver is flushed and restarted afterwards.
+ */
+        static void receiveFrame(IOHC::iohcPacket *packet, bool stats) {
+            readSignal(packet);
+
+            uint8_t bytesInFIFO = SPIgetRegValue(REG_RXBYTES, 6, 0);
+            size_t readBytes = 0;
+            uint32_t lastPop = millis();
+            uint8_t lenghtFrame = 0;
+            uint8_t lenghtFrameCoded = 0xFF;
+            uint8_t tmpBuffer[64] = {0x00};
+            while (readBytes < lenghtFrameCoded) {
+                if ((readBytes >= 1) && (lenghtFrameCoded == 0xFF)) { // Obtain frame lenght
+                    lenghtFrame = (reverseByte(((uint8_t)(tmpBuffer[0] << 4) | (uint8_t)(tmpBuffer[1] >> 4)))) & 0b00011111;
+                    lenghtFrameCoded = ((lenghtFrame + 2 + 1) * 8) + ((lenghtFrame + 2 + 1) * 2); // Calculate Num of bits of encoded frame (add 2 bit per byte)
+                    lenghtFrameCoded = ceil((float)lenghtFrameCoded / 8);                         // divide by 8 bits per byte and round to up
+                    setPktLenght(lenghtFrameCoded);
+                }
+
+                if (bytesInFIFO == 0) {
+                    if (millis() - lastPop > 5) {
+                        // readData was required to read a packet longer than the one received.
+                        break;
+                    } else {
+                        delay(1);
+                        bytesInFIFO = SPIgetRegValue(REG_RXBYTES, 6, 0);
+                        continue;
+                    }
+                }
+
+                // read the minimum between "remaining length" and bytesInFifo
+                uint8_t bytesToRead = (((uint8_t)(lenghtFrameCoded - readBytes)) < (bytesInFIFO) ? ((uint8_t)(lenghtFrameCoded - readBytes)) : (bytesInFIFO));
+                SPIreadRegisterBurst(REG_FIFO, bytesToRead, &(tmpBuffer[readBytes]));
+                readBytes += bytesToRead;
+                lastPop = millis();
+
+                // Get how many bytes are left in FIFO.
+                bytesInFIFO = SPIgetRegValue(REG_RXBYTES, 6, 0);
+            }
+
+            if (lenghtFrameCoded < 255) {
+                int8_t lenFuncDecodeFrame = decodeFrame(tmpBuffer, lenghtFrameCoded);
+                if (lenFuncDecodeFrame > 0 && lenFuncDecodeFrame <= MAX_FRAME_LEN) {
+                    if (IOHC::crc16(tmpBuffer, lenFuncDecodeFrame) == 0) {
+                        packet->buffer_length = lenFuncDecodeFrame;
+                        memcpy(packet->payload.buffer, tmpBuffer, lenFuncDecodeFrame);
+                    }
+                }
+            }
+
+            // Flush then standby according to RXOFF_MODE (default: RADIOLIB_CC1101_RXOFF_IDLE)
+            if (SPIgetRegValue(REG_MCSM1, 3, 2) == RF_RXOFF_IDLE) {
+                SPIsendCommand(CMD_IDLE);                    // set mode to standby
+                SPIsendCommand(CMD_FLUSH_RX | CMD_READ);     // flush Rx FIFO
+            }
+
+            SPIsendCommand(CMD_RX);
+        }
+    };
+}
+
+#endif // CC1101_TRANSCEIVER_H
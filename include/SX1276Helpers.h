@@ -17,6 +17,9 @@
 #ifndef SX1276HELPERS_H
 #define SX1276HELPERS_H
 
+#include <cstddef>
+#include <cstdint>
+
 #include <sx1276Regs-Fsk.h>
 
 #if defined(ESP8266)
@@ -42,6 +45,11 @@
 
 #define RF_PACKETCONFIG2_IOHOME_POWERFRAME  0x10    // Missing from SX1276 FSK modem registers and bits definitions
 
+#define RADIO_REGS_SIZE         0x80    // Register snapshot, RegFifo (0x00) is left to 0
+#define RADIO_REGS_BASELINE     "/regs.bin"
+
+#define RADIO_FIFO_THRESHOLD    7   // FifoLevel rises above this count, RX is drained by chunks of RADIO_FIFO_THRESHOLD + 1 bytes
+
 /*
     Helper functions to setup and manage SX1276 registry configuration, query status and SPI interaction
 */
@@ -93,9 +101,18 @@ namespace Radio {
     bool setParams();
     bool setCarrier(Carrier param, uint32_t value);
     regBandWidth bwRegs(uint8_t bandwidth);
-    void dump();
+    void dump(bool decode = false);
     void dumpReal();
     int dump_fsk_registers(const uint8_t *regs);
+    void snapshot(uint8_t *regs);
+    void printSnapshot(const uint8_t *regs);
+    uint8_t diff(const uint8_t *baseline, const uint8_t *regs);
+    void saveRegisters();
+    void restoreRegisters();
+    bool registersIntact();
+    void clearIrqFlags();
+    void restartRx();
+    void resetHardware();
 
     uint16_t readWord(uint8_t regAddr);
     void writeWord(uint8_t regAddr, uint16_t value);
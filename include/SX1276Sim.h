@@ -0,0 +1,149 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef SX1276SIM_H
+#define SX1276SIM_H
+
+#include <cstdint>
+#include <cstddef>
+
+#include <Delegate.h>
+#include <sx1276Regs-Fsk.h>
+
+#define SIM_FIFO_SIZE           64
+#define SIM_MAX_AIR_FRAME       64
+#define SIM_SPI_BYTE_NS         2000    // 4MHz SPI clock, 8 bits per byte
+#define SIM_SPI_OVERHEAD_NS     1000    // NSS assert/release around each transaction
+
+/*
+    Software model of the SX1276 FSK modem, used in place of the SPI transport when RADIO_SIM is defined.
+    It keeps a register file with the semantics of sx1276Regs-Fsk.h, a 64 bytes FIFO, the IRQ flags,
+    the opmode transitions and a virtual air interface to inject frames into the receiver and capture
+    the transmitted ones. Time is virtual: it only moves with SPI traffic, air activity and advance(),
+    so runs are deterministic.
+*/
+namespace Radio::Sim {
+    using AirDelegate = Delegate<void(const uint8_t *frame, uint8_t len, uint32_t frequency)>;
+    using IrqDelegate = Delegate<void()>;
+
+    // Faults injected to exercise the recovery of the driver
+    enum class Fault : uint8_t {
+        None,
+        StuckPreamble,  // PreambleDetect stays up and nothing is received, until Rx restart or mode change
+        PllUnlock,      // PllLock falls, until Rx restart or mode change
+        ConfigLost,     // Registers back to power on values, as after a glitch on NRESET
+        Dead,           // SPI reads 0 and writes are ignored, until reset
+    };
+
+    struct Counters {
+        uint32_t spiTransactions;
+        uint32_t spiBytes;
+        uint32_t framesInjected;
+        uint32_t framesReceived;   // PayloadReady raised
+        uint32_t framesDropped;    // Injected while not listening on that frequency, or FIFO overrun
+        uint32_t framesSent;
+        uint32_t fifoOverruns;
+        uint32_t fifoUnderruns;
+        // Latencies of the last frame and worst seen, in ns
+        uint32_t rxLatency;        // End of frame on air to FIFO emptied by the driver
+        uint32_t rxLatencyMax;
+        uint32_t txLatency;        // Standby before Tx to first bit of preamble on air
+        uint32_t txLatencyMax;
+    };
+
+    class Chip {
+    public:
+        Chip();
+
+        void reset();
+
+        // SPI side, as seen by Radio::readBytes / Radio::writeBytes
+        void readBytes(uint8_t regAddr, uint8_t *out, uint8_t len);
+        void writeBytes(uint8_t regAddr, const uint8_t *in, uint8_t len);
+
+        void fault(Fault f);
+        Fault fault() const { return faultMode; }
+
+        // Air side
+        bool inject(const uint8_t *frame, uint8_t len, uint32_t frequency, int16_t rssi = -60);
+        void onTransmit(AirDelegate cb) { txCB = std::move(cb); }
+
+        // Virtual clock in ns
+        void advance(uint64_t ns);
+        uint64_t now() const { return clockNs; }
+        uint64_t byteTimeNs() const;
+
+        // DIO pins, following REG_DIOMAPPING1/2 for the packet mode
+        bool dio(uint8_t pin);
+        // Called on a rising edge of DIO0, DIO1 or DIO4, as the interrupt lines wired on the boards
+        void onIrq(IrqDelegate cb) { irqCB = std::move(cb); }
+
+        uint32_t frequency() const;
+        const Counters &counters() const { return stats; }
+        void clearCounters() { stats = {}; }
+
+    private:
+        enum class Air : uint8_t { Idle, Preamble, Sync, Payload, Crc };
+
+        void spiCost(uint8_t len);
+        void sync();
+        void edges();
+        bool dioLevel(uint8_t pin) const;
+        void setMode(uint8_t mode);
+        void startTx();
+        void fifoPush(uint8_t byte);
+        uint8_t fifoPop();
+        void fifoClear();
+        uint8_t irqFlags1() const;
+        uint8_t irqFlags2() const;
+        uint8_t fifoThreshold() const { return regs[REG_FIFOTHRESH] & ~RF_FIFOTHRESH_FIFOTHRESHOLD_MASK; }
+        uint16_t preambleBytes() const { return (regs[REG_PREAMBLEMSB] << 8) | regs[REG_PREAMBLELSB]; }
+        uint8_t syncBytes() const { return (regs[REG_SYNCCONFIG] & ~RF_SYNCCONFIG_SYNCSIZE_MASK) + 1; }
+
+        uint8_t regs[0x80]{};
+        uint8_t fifo[SIM_FIFO_SIZE]{};
+        uint8_t fifoHead = 0;
+        uint8_t fifoCount = 0;
+
+        // Sticky flags, cleared by writing 1 or by mode changes
+        uint8_t flags1 = 0;
+        uint8_t flags2 = 0;
+
+        uint64_t clockNs = 0;
+        uint64_t rxEndNs = 0;       // PayloadReady raised, not read out yet
+        uint64_t standbyNs = 0;     // Last switch to Standby
+
+        // Frame currently on air, either received or transmitted
+        Air air = Air::Idle;
+        bool airTx = false;
+        uint8_t airFrame[SIM_MAX_AIR_FRAME]{};
+        uint8_t airLen = 0;
+        uint8_t airPos = 0;
+        uint64_t airNextNs = 0;
+        uint16_t airCount = 0;
+
+        Fault faultMode = Fault::None;
+        AirDelegate txCB = nullptr;
+        IrqDelegate irqCB = nullptr;
+        uint8_t dioLevels = 0;
+        bool inIrq = false;
+        Counters stats{};
+    };
+
+    Chip &chip();
+}
+
+#endif // SX1276SIM_H
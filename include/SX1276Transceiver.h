@@ -0,0 +1,139 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef SX1276_TRANSCEIVER_H
+#define SX1276_TRANSCEIVER_H
+
+#include <iohcTransceiver.h>
+#include <SX1276Helpers.h>
+
+#if defined(RADIO_SIM)
+#include <SX1276Sim.h>
+#else
+#include <Arduino.h>
+#endif
+
+#ifndef IRAM_ATTR
+#define IRAM_ATTR
+#endif
+
+/*
+    SX1276 backends of the transceiver concept. Register access is shared through the Radio:: helpers,
+    only the interrupt lines differ: GPIO on the boards, the model DIO on the simulator.
+*/
+namespace Radio {
+    template <typename Impl>
+    class SX1276Base : public Transceiver<Impl> {
+    public:
+        static constexpr uint8_t fifoChunk = RADIO_FIFO_THRESHOLD + 1;
+
+        static void init() {
+            initHardware();
+            calibrate();
+
+            initRegisters(MAX_FRAME_LEN);
+            setCarrier(Carrier::Deviation, 19200);
+            setCarrier(Carrier::Bitrate, 38400);
+            setCarrier(Carrier::Bandwidth, 250);
+            setCarrier(Carrier::Modulation, Modulation::FSK);
+        }
+
+        static Status IRAM_ATTR status() {
+            uint8_t flags[2];
+            readBytes(REG_IRQFLAGS1, flags, sizeof(flags));
+            return {(flags[0] & RF_IRQFLAGS1_TXREADY) != 0, (flags[0] & RF_IRQFLAGS1_RXREADY) != 0};
+        }
+
+        static void IRAM_ATTR setRx() { Radio::setRx(); }
+        static void IRAM_ATTR setTx() { Radio::setTx(); }
+        static void IRAM_ATTR setStandby() { Radio::setStandby(); }
+        static void IRAM_ATTR setFrequency(uint32_t frequency) { setCarrier(Carrier::Frequency, frequency); }
+        static void IRAM_ATTR clearFlags() { Radio::clearFlags(); }
+        static void IRAM_ATTR clearFifo() { clearBuffer(); }
+        static void IRAM_ATTR readFifo(uint8_t *buffer, uint8_t length) { readBytes(REG_FIFO, buffer, length); }
+        static void IRAM_ATTR writeFifo(uint8_t *buffer, uint8_t length) { writeBytes(REG_FIFO, buffer, length); }
+        static bool IRAM_ATTR fifoNotEmpty() { return dataAvail(); }
+
+        static Health health() {
+            uint8_t opMode = readByte(REG_OPMODE);
+            uint8_t flags = readByte(REG_IRQFLAGS1);
+            return {
+                (opMode & ~RF_OPMODE_MASK) == RF_OPMODE_RECEIVER,
+                (flags & RF_IRQFLAGS1_PLLLOCK) != 0,
+                (flags & RF_IRQFLAGS1_PREAMBLEDETECT) != 0,
+                registersIntact()
+            };
+        }
+
+        // Off, frames failing their CRC are delivered with it. The watchdog keeps the new configuration
+        static void setHardwareCrc(bool on) {
+            writeByte(REG_PACKETCONFIG1, (readByte(REG_PACKETCONFIG1) & RF_PACKETCONFIG1_CRC_MASK) |
+                                         (on ? RF_PACKETCONFIG1_CRC_ON : RF_PACKETCONFIG1_CRC_OFF));
+            saveRegisters();
+        }
+
+        static void clearIrq() { clearIrqFlags(); }
+        static void restartRx() { Radio::restartRx(); }
+        static void saveConfig() { saveRegisters(); }
+        static void restoreConfig() { restoreRegisters(); }
+        static void reset() { resetHardware(); }
+
+        static void IRAM_ATTR readSignal(IOHC::iohcPacket *packet) {
+            float rssi = static_cast<float>(readByte(REG_RSSIVALUE)) / -2.0f;
+            packet->setRssi(rssi);
+            int16_t thres = readByte(REG_RSSITHRESH);
+            packet->rx.snr = rssi > thres ? 0 : (thres - rssi);
+            //            packet->lna = RF96lnaMap[ (readByte(REG_LNA) >> 5) & 0x7 ];
+            int16_t f = (uint16_t) readByte(REG_AFCMSB);
+            f = (f << 8) | (uint16_t) readByte(REG_AFCLSB);
+            //            packet->afc = f * (32000000.0 / 524288.0); // static_cast<float>(1 << 19));
+            packet->rx.afc = f * 61;
+        }
+
+    protected:
+        SX1276Base() = default;
+    };
+
+#if defined(RADIO_SIM)
+    class SimTransceiver : public SX1276Base<SimTransceiver> {
+    public:
+        static void attachInterrupts(void (*isr)()) { Sim::chip().onIrq(isr); }
+
+        static Irq readPins() {
+            return {Sim::chip().dio(4), Sim::chip().dio(0), Sim::chip().dio(1)};
+        }
+    };
+#else
+    class SX1276Transceiver : public SX1276Base<SX1276Transceiver> {
+    public:
+        static void attachInterrupts(void (*isr)()) {
+            attachInterrupt(RADIO_DIO0_PIN, isr, RISING); //CHANGE); //
+            attachInterrupt(RADIO_DIO1_PIN, isr, RISING); // CHANGE); //
+            attachInterrupt(RADIO_DIO2_PIN, isr, RISING); //CHANGE); //
+        }
+
+        static Irq IRAM_ATTR readPins() {
+            return {
+                static_cast<bool>(digitalRead(RADIO_PREAMBLE_DETECTED)),
+                static_cast<bool>(digitalRead(RADIO_PACKET_AVAIL)),
+                static_cast<bool>(digitalRead(RADIO_DATA_AVAIL))
+            };
+        }
+    };
+#endif
+}
+
+#endif // SX1276_TRANSCEIVER_H
@@ -84,6 +84,8 @@ namespace TimersUS {
 
     void detach();
     bool active();
+    // Stops the delayed task before it runs, false if it has run or is running
+    bool stopDelay();
 
     private:
         uint32_t _iterationCount = 0;
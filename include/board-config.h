@@ -20,6 +20,7 @@
 #define RADIO_SX127X
 #define Regulatory_Domain_EU_868
 //#define RADIO_SX126X
+//#define RADIO_SIM             // SX1276 software model in place of the SPI transport, see SX1276Sim.h
 #define BOARD_MODEL BOARD_HELTEC32_V3
 /*
  * Board pins definitions
@@ -45,7 +46,7 @@
 // https://github.com/LilyGO/ESP32-Paxcounter/blob/master/src/hal/ttgov2.h 
 
 
-#if defined(ESP32)
+#if defined(ESP32) || defined(RADIO_SIM)
 #define RADIO_MOSI             RADIO_MOSI_PIN //                 23  // Default VSPI
 #define RADIO_MISO             RADIO_MISO_PIN //                 19  // Default VSPI
 #define RADIO_SCLK             RADIO_SCLK_PIN //                 18  // Default VSPI
@@ -59,13 +60,13 @@
 //#define RADIO_DIO_2                             2   // NodeMCU D4 // Not used - No wire
 //#define RADIO_DIO_4                             2   // NodeMCU D4
 #define RADIO_DIO_0                             RADIO_DIO0_PIN //                 35
-//#define RADIO_DIO_1                             34      // Not used - No wire
+#define RADIO_DIO_1                             RADIO_DIO1_PIN //                 33/35
 //#define RADIO_DIO_2                             34      // Not used - No wire
 #define RADIO_DIO_4                             RADIO_DIO2_PIN //                 34
 #endif
 #if defined(RADIO_SX127X)
 #define RADIO_PACKET_AVAIL                      RADIO_DIO_0     // Packet Received / CRC ok from Radio
-#define RADIO_DATA_AVAIL                        RADIO_DIO_1     // FIFO empty from Radio
+#define RADIO_DATA_AVAIL                        RADIO_DIO_1     // FIFO level above threshold from Radio
 #define RADIO_RXTIMEOUT                         RADIO_DIO_2     // Radio Rx Sequencer timeout (used to switch the receiver frequency)
 #define RADIO_PREAMBLE_DETECTED                 RADIO_DIO_4     // Preamble detected from Radio (used instead of FIFO empty)
 #endif
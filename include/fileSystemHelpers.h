@@ -29,4 +29,6 @@
 void listFS();
 void cat(const char *fname);
 void rm(const char *fname);
+bool writeBlob(const char *fname, const uint8_t *data, size_t size);
+size_t readBlob(const char *fname, uint8_t *data, size_t size);
 #endif // FILESYSTEMHELPERS_H
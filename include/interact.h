@@ -18,14 +18,18 @@
 #define INTERACT_H
 /*
   MQTT & Command Line interaction
+  On the host (RADIO_SIM builds of test/) only the command table and the flags the devices read are
+  built, there is no WiFi, MQTT nor serial console.
 */
 #include <board-config.h>
 #include <user_config.h>
 
 #include <vector> 
 #include <sstream> 
+#include <cstdlib>
 #include <cstring>
 
+#if defined(ESP32)
 extern "C" {
 	#include "freertos/FreeRTOS.h"
 	#include "freertos/timers.h"
@@ -37,16 +41,14 @@ extern "C" {
   #include <AsyncMqttClient.h>
   #include <ArduinoJson.h>
 #endif
+#endif
 
 #include <utils.h>
 
 #if defined(ESP32)
   #include <TickerUsESP32.h>
-  #define MAXCMDS 50
 #endif
-
-inline TimerHandle_t wifiReconnectTimer;
-inline WiFiClient wifiClient;                 // Create an ESP32 WiFiClient class to connect to the MQTT server
+#define MAXCMDS 64
 
 using Tokens = std::vector<std::string>;
 
@@ -67,6 +69,10 @@ using Tokens = std::vector<std::string>;
 
   inline uint8_t lastEntry = 0;
 
+#if defined(ESP32)
+inline TimerHandle_t wifiReconnectTimer;
+inline WiFiClient wifiClient;                 // Create an ESP32 WiFiClient class to connect to the MQTT server
+
 #if defined(MQTT)
 inline AsyncMqttClient mqttClient;
 inline TimerHandle_t mqttReconnectTimer;
@@ -226,6 +232,7 @@ inline void WiFiEvent(WiFiEvent_t event) {
     default: {}
     }
 }
+#endif
 
 #if defined(DEBUG)
   #ifndef DEBUG_PORT
@@ -253,9 +260,9 @@ namespace Cmd {
 
 #if defined(ESP32)
       inline TimersUS::TickerUsESP32 kbd_tick;
-#endif
 
     inline TimerHandle_t consoleTimer;
+#endif
 
   inline bool addHandler(char *cmd, char *description, void (*handler)(Tokens*)) {
     for (uint8_t idx=0; idx<MAXCMDS; ++idx) {
@@ -268,7 +275,7 @@ namespace Cmd {
         _cmdHandler[idx] = static_cast<_cmdEntry *>(alloc);
         memset(alloc, 0, sizeof(struct _cmdEntry));
         strncpy(_cmdHandler[idx]->cmd, cmd, strlen(cmd)<sizeof(_cmdHandler[idx]->cmd)?strlen(cmd):sizeof(_cmdHandler[idx]->cmd) - 1);
-        strncpy(_cmdHandler[idx]->description, description, strlen(cmd)<sizeof(_cmdHandler[idx]->description)?strlen(description):sizeof(_cmdHandler[idx]->description) - 1);
+        strncpy(_cmdHandler[idx]->description, description, strlen(description)<sizeof(_cmdHandler[idx]->description)?strlen(description):sizeof(_cmdHandler[idx]->description) - 1);
         _cmdHandler[idx]->handler = handler;
 
         if (idx > lastEntry)
@@ -279,6 +286,7 @@ namespace Cmd {
     return false;
   }
 
+#if defined(ESP32)
   inline char *cmdReceived(bool echo = false) {
       _avail = Serial.available();
       if (_avail)  {
@@ -347,5 +355,6 @@ namespace Cmd {
     kbd_tick.attach_ms(500, cmdFuncHandler);
 
   }  
+#endif
 }
 #endif
\ No newline at end of file
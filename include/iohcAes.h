@@ -0,0 +1,96 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef IOHC_AES_H
+#define IOHC_AES_H
+
+#include <cstdint>
+
+#if defined(ESP32)
+    #include "mbedtls/aes.h"        // AES peripheral through the ESP-IDF mbedtls port
+#endif
+
+#define IOHC_AES_HARDWARE       1       // ESP32 AES peripheral
+#define IOHC_AES_TTABLE         2       // 32 bit T-table, fastest in software
+#define IOHC_AES_PORTABLE       3       // No table indexed by data, constant time
+
+// Set with -DIOHC_AES_BACKEND=IOHC_AES_PORTABLE to force one
+#if !defined(IOHC_AES_BACKEND)
+    #if defined(ESP32)
+        #define IOHC_AES_BACKEND IOHC_AES_HARDWARE
+    #else
+        #define IOHC_AES_BACKEND IOHC_AES_TTABLE
+    #endif
+#endif
+
+#if IOHC_AES_BACKEND == IOHC_AES_HARDWARE && !defined(ESP32)
+    #error "IOHC_AES_HARDWARE needs the ESP32 AES peripheral"
+#endif
+
+/*
+    AES-128 block encryption, the only cipher operation of io-homecontrol (HMAC, challenge answers and key
+    transfers all encrypt one block). Each backend has the same shape: a Schedule type holding the expanded
+    key, expand(), encrypt() and release(); in and out may be the same block. A schedule starts zeroed, is
+    expanded again in place, and is released when dropped: the hardware one is an mbedtls context. AesBackend is the one selected for the
+    build, the others are still compiled on the host so that they can be checked and timed side by side.
+*/
+namespace iohcCrypto {
+    // Round keys as big endian words, shared by the software backends
+    struct AesRoundKeys {
+        uint32_t rk[44];
+    };
+
+    struct AesTTable {
+        using Schedule = AesRoundKeys;
+        static constexpr const char *name = "T-table";
+        static void expand(Schedule &schedule, const uint8_t *key);
+        static void encrypt(const Schedule &schedule, const uint8_t *in, uint8_t *out);
+        static void release(Schedule &) {}
+    };
+
+    struct AesPortable {
+        using Schedule = AesRoundKeys;
+        static constexpr const char *name = "portable";
+        static void expand(Schedule &schedule, const uint8_t *key);
+        static void encrypt(const Schedule &schedule, const uint8_t *in, uint8_t *out);
+        static void release(Schedule &) {}
+    };
+
+#if defined(ESP32)
+    struct AesHardware {
+        using Schedule = mbedtls_aes_context;
+        static constexpr const char *name = "hardware";
+        static void expand(Schedule &schedule, const uint8_t *key);
+        static void encrypt(const Schedule &schedule, const uint8_t *in, uint8_t *out);
+        static void release(Schedule &schedule);
+    };
+#endif
+
+#if IOHC_AES_BACKEND == IOHC_AES_HARDWARE
+    using AesBackend = AesHardware;
+#elif IOHC_AES_BACKEND == IOHC_AES_PORTABLE
+    using AesBackend = AesPortable;
+#else
+    using AesBackend = AesTTable;
+#endif
+
+    // Every backend compiled against the known answer vectors, prints the failures. true if all pass
+    bool aesSelfTest();
+    // Time per block and per key expansion of every backend compiled
+    void aesBench(uint32_t blocks);
+}
+
+#endif // IOHC_AES_H
@@ -0,0 +1,116 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef IOHC_AUTH_1W_H
+#define IOHC_AUTH_1W_H
+
+#include <cstdint>
+
+#include <iohcCryptoHelpers.h>
+#include <iohcPacket.h>
+
+#if defined(ESP32)
+    #include <freertos/FreeRTOS.h>
+    #include <freertos/queue.h>
+    #include <freertos/semphr.h>
+#endif
+
+#define IOHC_AUTH_KEYS                  16      // 1W remotes whose key is known
+#define IOHC_AUTH_QUEUE_LEN             32      // Frames waiting for the verifier, about 100 ms at the worst frame rate
+#define IOHC_AUTH_RECENT                8       // Last verdicts kept for the console
+
+/*
+    Authentication of the 1W frames received. The frames carrying a sequence and a MAC (0x00, 0x01, 0x20,
+    0x2E, 0x39) are checked against the key of their source, from 1W.json or captured from a 0x30: the MAC
+    is computed again with the cached key schedule and the sequence classified by the window of that remote
+    (iohcSequences), fed with the frames of the right MAC and those of the remotes without key. The radio task only queues a copy of the frame, a verifier task does the rest. On the
+    host the queue is skipped and frames are verified as they are submitted.
+*/
+namespace IOHC {
+    enum class AuthVerdict : uint8_t {
+        Authentic,
+        Replay,             // MAC right, sequence seen already or older than the window
+        Forged,             // MAC wrong
+        UnknownKey,         // No key for the source
+        Count
+    };
+
+    const char *authVerdictName(AuthVerdict verdict);
+
+    struct AuthResult {
+        address source;
+        uint8_t cmd;
+        AuthVerdict verdict;
+        uint16_t sequence;
+    };
+
+    struct AuthStats {
+        uint32_t verdicts[static_cast<uint8_t>(AuthVerdict::Count)];
+        uint32_t queued;
+        uint32_t dropped;           // Queue full, the radio task never waits
+        uint32_t maxQueued;         // Queue high water mark
+    };
+
+    class iohcAuth1W {
+    public:
+        static iohcAuth1W *getInstance();
+        virtual ~iohcAuth1W() = default;
+
+        bool begin();
+        // A key replaced is used from the next frame on
+        bool setKey(const address node, const uint8_t *key, iohcCrypto::KeyKind kind);
+        void forget(const address node);
+
+        // Called from the radio task, never blocks. Frames without MAC are left out
+        void submit(const iohcPacket &packet);
+        // Verifier side, public for the host benchmark. false if the frame has no MAC
+        bool verify(const uint8_t *frame, uint8_t length, AuthResult *result);
+
+        const AuthStats &getStats() const { return stats; }
+        void print();
+
+    private:
+        struct KnownKey {
+            bool used;
+            iohcCrypto::KeyKind kind;
+            address node;
+            uint8_t key[16];
+        };
+
+        iohcAuth1W() = default;
+        KnownKey *find(const address node);
+        void lock();
+        void unlock();
+    #if defined(ESP32)
+        struct QueuedFrame {
+            uint8_t length;
+            uint8_t frame[MAX_FRAME_LEN];
+        };
+        static void verifierTask(void *pvParameters);
+        QueueHandle_t queue = nullptr;
+        SemaphoreHandle_t mutex = nullptr;
+    #endif
+
+        static iohcAuth1W *_iohcAuth1W;
+        bool ready = false;
+        KnownKey keys[IOHC_AUTH_KEYS]{};
+        AuthResult recent[IOHC_AUTH_RECENT]{};
+        uint32_t results = 0;
+        AuthStats stats{};
+    };
+}
+
+#endif // IOHC_AUTH_1W_H
@@ -0,0 +1,153 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef IOHC_CAPTURE_H
+#define IOHC_CAPTURE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+
+#include <iohcPacket.h>
+
+#if defined(ESP32)
+    #include <LittleFS.h>
+    #include <freertos/FreeRTOS.h>
+    #include <freertos/queue.h>
+    #include <freertos/semphr.h>
+#endif
+
+#define CAPTURE_FILE                    "/capture.bin"
+#define CAPTURE_MAGIC                   "IOHCCAP"
+#define CAPTURE_VERSION                 1
+#define CAPTURE_RECORDS                 1024    // Ring capacity, 64 KiB on flash
+#define CAPTURE_PAGE_SIZE               4096    // Records are written by flash page
+#define CAPTURE_DATA_OFFSET             CAPTURE_PAGE_SIZE   // Header alone in the first page, records page aligned
+#define CAPTURE_QUEUE_LEN               64      // Frames waiting for the writer, about 200 ms at the worst frame rate
+#define CAPTURE_FLUSH_MS                1000    // Partial page written after that long without frames
+#define CAPTURE_WORST_FPS               300     // Shortest frame (3 bytes preamble, sync, 11 bytes) back to back at 38400 bps
+
+/*
+    Binary capture of every frame received or sent, appended to a ring file pre-sized on LittleFS.
+    The file starts with a CaptureHeader page, then CAPTURE_RECORDS fixed size records; the oldest record
+    is overwritten once the ring is full. Records carry a sequence number (0 for a free slot), the write
+    position is found back from it at start so the header is never rewritten. The radio task only queues
+    the record, a writer task batches them by flash page. On the host the queue is skipped and the ring
+    is written to a plain file.
+*/
+namespace IOHC {
+    enum class Direction : uint8_t {
+        Rx,
+        Tx
+    };
+
+    struct CaptureHeader {
+        char magic[8];
+        uint16_t version;
+        uint16_t recordSize;
+        uint32_t capacity;          // Records in the ring
+        uint8_t reserved[48];
+    };
+    static_assert(sizeof(CaptureHeader) == 64, "Capture header is one record long");
+
+    struct CaptureRecord {
+        uint32_t sequence;          // From 1, ordering across ring wraps
+        uint32_t frequency;         // Hz
+        uint64_t timestampUs;
+        int32_t afc;                // Hz, 0 for a frame sent
+        int16_t rssi;               // dBm x 10, 0 for a frame sent
+        Direction direction;
+        uint8_t length;
+        uint8_t frame[MAX_FRAME_LEN];
+        uint8_t reserved[8];
+    };
+    static_assert(sizeof(CaptureRecord) == 64, "Records must tile a flash page");
+    static_assert(CAPTURE_PAGE_SIZE % sizeof(CaptureRecord) == 0, "Records must tile a flash page");
+
+    struct CaptureStats {
+        uint32_t queued;
+        uint32_t dropped;           // Queue full, the radio task never waits
+        uint32_t written;
+        uint32_t pages;             // Batched writes
+        uint32_t maxQueued;         // Queue high water mark
+    };
+
+    // Random access file, LittleFS on the boards and stdio on the host
+    class CaptureFile {
+    public:
+        bool open(const char *path, size_t size);
+        bool read(uint32_t offset, void *data, size_t size);
+        bool write(uint32_t offset, const void *data, size_t size);
+        void flush();
+        void close();
+
+    private:
+    #if defined(ESP32)
+        File file;
+    #else
+        FILE *file = nullptr;
+    #endif
+    };
+
+    class iohcCapture {
+    public:
+        static iohcCapture *getInstance();
+        virtual ~iohcCapture() = default;
+
+        bool begin(const char *path = CAPTURE_FILE, uint32_t capacity = CAPTURE_RECORDS);
+        void setEnabled(bool on) { enabled = on; }
+        bool isEnabled() const { return enabled; }
+
+        // Called from the radio task, never blocks
+        void record(const iohcPacket &packet, Direction direction);
+        void flush();
+        void clear();
+        // Records as text lines, oldest first: sequence;us;Hz;dBm;afc;dir;hex
+        void dump(uint32_t last = 0);
+        // Records oldest first, the last ones only if last is not 0
+        void forEach(uint32_t last, const std::function<void(const CaptureRecord &rec)> &visit);
+        const CaptureStats &getStats() const { return stats; }
+
+        // Writer side, public for the host benchmark
+        void append(const CaptureRecord &rec);
+
+    private:
+        iohcCapture() = default;
+        void writePage();
+        void recover();
+        void lock();
+        void unlock();
+    #if defined(ESP32)
+        static void writerTask(void *pvParameters);
+        QueueHandle_t queue = nullptr;
+        SemaphoreHandle_t mutex = nullptr;
+    #endif
+
+        static iohcCapture *_iohcCapture;
+        CaptureFile file;
+        CaptureHeader header{};
+        CaptureRecord page[CAPTURE_PAGE_SIZE / sizeof(CaptureRecord)]{};
+        uint16_t pending = 0;       // Records in page, not written yet
+        uint32_t next = 0;          // Slot of the next record
+        uint32_t sequence = 1;
+        CaptureStats stats{};
+        bool ready = false;
+        volatile bool enabled = true;
+    };
+}
+
+#endif // IOHC_CAPTURE_H
@@ -0,0 +1,102 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef IOHC_CHALLENGE_H
+#define IOHC_CHALLENGE_H
+
+#include <cstdint>
+
+#include <iohcFrame.h>
+#include <iohcPacket.h>
+#include <iohcTransaction.h>
+
+#if defined(ESP32)
+    #include <freertos/FreeRTOS.h>
+    #include <freertos/semphr.h>
+#endif
+
+#define IOHC_CHALLENGE_PEERS            IOHC_MAX_SESSIONS   // Peers challenging us at once, one context each
+
+/*
+    Answers to the 2W challenges (0x3C), one context per peer. A command sent to several devices at once
+    (setMode to every heater) is challenged by each of them in turn, one frame after the other. The
+    challenge is kept with a copy of the IV prefix of the request of the peer's session, computed when the
+    request was sent, so that the peers never share state. A challenge is answered as soon as it is
+    received, with the others already pending when the answers are computed: the IVs, prefix then
+    challenge, then every block with the transfer key, looked up once. They are handed to the radio as one
+    batch of answers, sent back to back and ahead of the frames of a batch still being sent, so that the
+    answers to the next challenges go out right behind them. A challenge repeated by a peer that missed our
+    answer gets the same answer again, without computing it.
+*/
+namespace IOHC {
+    struct ChallengeContext {
+        uint32_t peer;              // sessionKey, 0 for a free context
+        address gateway;            // Our address that was challenged, the answer comes from it
+        uint8_t challenge[6];
+        uint8_t request;            // Request challenged
+        uint8_t ivPrefix[IV_PREFIX_LEN];    // From the session, the IV is this then the challenge
+        bool pending;               // Answer not handed to the radio yet
+        bool answered;              // answer holds the answer to challenge
+        bool keyTransfer;           // Challenge on 0x31, answered by the key (0x32) instead of 0x3D
+        uint8_t answer[16];
+        uint32_t receivedUs;
+    };
+
+    struct ChallengeStats {
+        uint32_t challenged;
+        uint32_t answered;
+        uint32_t repeated;          // Same challenge again, the answer computed before sent
+        uint32_t noRequest;         // No request in flight with the peer
+        uint32_t evicted;           // Context of another peer reused, all were taken
+        uint32_t batches;
+        uint32_t largestBatch;
+        uint32_t maxLatencyUs;      // Challenge received to answer handed to the radio
+    };
+
+    // Microseconds, wrapping, for the latencies
+    uint32_t challengeTime();
+
+    class iohcChallenges {
+    public:
+        static iohcChallenges *getInstance();
+        virtual ~iohcChallenges() = default;
+
+        // 0x3C to one of our addresses, from the radio task, answered at once. false without request in flight with the peer
+        bool challenged(const iohcPacket &packet, uint32_t nowUs = challengeTime());
+        // Answers every pending challenge at once, returns how many
+        uint8_t flush(uint32_t nowUs = challengeTime());
+        // Answers of count contexts, public for the host benchmark
+        static void computeAnswers(ChallengeContext *const *contexts, uint8_t count);
+
+        const ChallengeStats &getStats() const { return stats; }
+        void print();
+
+    private:
+        iohcChallenges();
+        ChallengeContext *lookup(uint32_t peer);
+        void lock();
+        void unlock();
+    #if defined(ESP32)
+        SemaphoreHandle_t mutex = nullptr;
+    #endif
+
+        static iohcChallenges *_iohcChallenges;
+        ChallengeContext contexts[IOHC_CHALLENGE_PEERS]{};
+        ChallengeStats stats{};
+    };
+}
+
+#endif // IOHC_CHALLENGE_H
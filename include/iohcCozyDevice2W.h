@@ -21,6 +21,8 @@
 #include <string>
 #include <iohcRadio.h>
 #include <iohcDevice.h>
+#include <iohcDispatch.h>
+#include <iohcFrameBuilder.h>
 #include <map>
 #include <vector>
 
@@ -45,8 +47,6 @@ namespace IOHC {
         static iohcCozyDevice2W *getInstance();
         ~iohcCozyDevice2W() override = default;
 
-        Memorize memorizeSend; //2W only
-
         // Put that in json
         address gateway/*[3]*/ = {0xba, 0x11, 0xad};
         address master_from/*[3]*/ = {0x47, 0x77, 0x06}; // It's the new heater kitchen Address From
@@ -67,9 +67,9 @@ namespace IOHC {
 
         bool isFake(address nodeSrc, address nodeDst) override;
         void cmd(DeviceButton cmd, Tokens *data);
+        void registerHandlers(iohcDispatcher *dispatcher);
         bool load() override;
         bool save() override;
-        static void forgePacket(iohcPacket *packet, const std::vector<uint8_t> &vector);
 
     private:
         iohcCozyDevice2W();
@@ -84,6 +84,7 @@ namespace IOHC {
         };
 
         std::vector<device> devices;
+        void answer(iohcPacket *packet);
         std::vector<iohcPacket *> packets2send{};
     };
 }
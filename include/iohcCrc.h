@@ -0,0 +1,44 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef IOHC_CRC_H
+#define IOHC_CRC_H
+
+#include <cstddef>
+#include <cstdint>
+
+#define CRC_POLYNOMIAL_CCITT    0x8408  // x^16 + x^12 + x^5 + 1, reflected
+// #define IOHC_CRC_SLICE_BY_4             // 4 bytes per step from 2 KiB of tables instead of 512 bytes
+
+/*
+    Frame CRC, CRC-16/KERMIT: reflected CCITT polynomial, 0 as initial value, no final xor. The two CRC bytes
+    follow the frame low byte first, so that the CRC of a frame with its CRC is 0. A byte is one lookup in a
+    256 entry table; slice-by-4 takes 4 bytes per step, worth it for the longer blocks of the sniffer.
+    crc16Bitwise is the reference the tables are checked against.
+*/
+namespace IOHC {
+    uint16_t crc16(const uint8_t *data, size_t len, uint16_t crc = 0);
+    uint16_t crc16Bitwise(const uint8_t *data, size_t len, uint16_t crc = 0);
+    uint16_t crc16Table(const uint8_t *data, size_t len, uint16_t crc = 0);
+    uint16_t crc16Slice4(const uint8_t *data, size_t len, uint16_t crc = 0);
+
+    // Frame followed by its 2 CRC bytes
+    inline bool crc16Valid(const uint8_t *frame, size_t lenWithCrc) {
+        return lenWithCrc > 2 && crc16(frame, lenWithCrc) == 0;
+    }
+}
+
+#endif // IOHC_CRC_H
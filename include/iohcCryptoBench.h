@@ -0,0 +1,46 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef IOHC_CRYPTO_BENCH_H
+#define IOHC_CRYPTO_BENCH_H
+
+#include <cstdint>
+
+/*
+    Timing of every crypto primitive (key expansion, block encryption, cached or not, IV builders) and of
+    every protocol operation made of them (1W MAC, 1W key transfer, 1W frame verification, 2W challenge
+    answer, from the request or from its IV prefix, and key transfer), the same code on the ESP32 from the
+    console and on the host from test/bench/crypto.cpp. One line per operation, semicolon separated so
+    that runs can be compared by a script:
+
+        crypto;<op>;<rounds>;<ns/op>;<ops/s>;<allocs/op>
+
+    Allocations are the heap blocks allocated per operation: counted by operator new on the host, the change
+    of the blocks allocated in the default heap on the ESP32, which misses the blocks freed within the loop.
+*/
+namespace iohcCrypto {
+    // Results of the operations against the backend alone, prints the failures. true if all match
+    bool cryptoSelfTest();
+    // Runs and prints every operation, rounds times each
+    void cryptoBench(uint32_t rounds);
+
+#if !defined(ESP32)
+    // Counted by the operator new of the host bench, 0 in the other host builds
+    extern uint32_t hostAllocations;
+#endif
+}
+
+#endif // IOHC_CRYPTO_BENCH_H
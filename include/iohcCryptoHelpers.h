@@ -22,24 +22,66 @@
 #include <vector>
 #include <tuple>
 
-#if defined(ESP8266)
-    #include <Crypto.h>
-    #include <AES.h>
-    #include <CTR.h>
-#elif defined(ESP32)
-    #include "mbedtls/aes.h"        // AES functions
-#endif
+#include <iohcAes.h>
 
-#define CRC_POLYNOMIAL_CCITT    0x8408
+#define IOHC_KEY_CACHE_SIZE     8       // Expanded AES keys kept: system, transfer and a few remotes
+#define IV_PREFIX_LEN           10      // IV bytes before the 1W sequence or the 2W challenge
 
 uint8_t hexStringToBytes(std::string hexString, uint8_t *byteString);
 std::string bytesToHexString(const uint8_t *byteString, uint8_t len);
 
 namespace iohcCrypto {
-    uint16_t computeCrc(uint8_t data, uint16_t crc);
-    uint16_t radioPacketComputeCrc(uint8_t *buffer, uint8_t bufferLength);
-    uint16_t radioPacketComputeCrc(std::vector<uint8_t>& buffer);
+    // Whose key it is. Node is the address of the remote (Remote, Learnt), zeros otherwise
+    enum class KeyKind : uint8_t { System, Transfer, Remote, Learnt };
+
+    struct KeyId {
+        KeyKind kind;
+        uint8_t node[3];
+
+        static KeyId of(KeyKind kind, const uint8_t *node = nullptr) {
+            KeyId id{kind, {}};
+            if (node) for (uint8_t i = 0; i < 3; i++) id.node[i] = node[i];
+            return id;
+        }
+    };
+
+    struct KeyCacheStats {
+        uint32_t hits;
+        uint32_t expansions;        // Key schedule computed: first use, key changed or evicted before
+        uint32_t evictions;
+    };
+
+    /*
+        AES-128 block encryption with a cached key schedule. The schedule of a key is computed on its first use
+        and kept under its identity; it is computed again only if the key bytes given differ from the ones cached
+        (a key changed is thus never used stale) or after it was evicted by IOHC_KEY_CACHE_SIZE newer keys.
+        in and out may be the same block.
+    */
+    void encryptBlock(const KeyId &id, const uint8_t *key, const uint8_t *in, uint8_t *out);
+    // count blocks with one key, looked up and locked once for all
+    using Block = uint8_t[16];
+    void encryptBlocks(const KeyId &id, const uint8_t *key, const Block *in, Block *out, size_t count);
+    void invalidateKey(const KeyId &id);
+    void invalidateKeys();
+    const KeyCacheStats &keyCacheStats();
+    // HMAC and challenge answer latency, with the key schedule cached against computed for each frame
+    void benchKeyCache(uint32_t rounds);
+
+    /*
+        Initial value (IV) of the io-homecontrol MAC, written into a 16 byte block: the first 8 bytes of the frame
+        from its command padded with 0x55, a 2 byte checksum of the whole frame, then the 1W sequence number padded
+        with 0x55 or the 6 bytes of a 2W challenge. The 2W request is given as its command and its data, as kept
+        by the sessions, so that nothing is copied to put them together.
+    */
+    uint16_t ivChecksum(const uint8_t *data, size_t len, uint16_t checksum = 0);
+    void hmacInitialValue(uint8_t *iv, const uint8_t *frame, size_t len, const uint8_t *sequence);
+    void challengeInitialValue(uint8_t *iv, uint8_t cmd, const uint8_t *data, size_t len, const uint8_t *challenge);
+    // The IV_PREFIX_LEN bytes of a challenge IV before the challenge, known as soon as the request is sent
+    void challengePrefix(uint8_t *prefix, uint8_t cmd, const uint8_t *data, size_t len);
+
     void encrypt_1W_key(const uint8_t *node_address, uint8_t *key);
-    void create_1W_hmac(uint8_t *hmac, const uint8_t *seq_number, uint8_t *controller_key, const std::vector<uint8_t>& frame_data);
+    // node is the remote owning controller_key, the identity of the key in the cache
+    void create_1W_hmac(uint8_t *hmac, const uint8_t *seq_number, const uint8_t *controller_key,
+                        const uint8_t *frame, size_t len, const uint8_t *node);
 }
 #endif
\ No newline at end of file
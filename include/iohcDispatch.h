@@ -0,0 +1,70 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef IOHC_DISPATCH_H
+#define IOHC_DISPATCH_H
+
+#include <cstdint>
+#include <initializer_list>
+
+#include <iohcPacket.h>
+
+/*
+    Received frames, by command. Each device registers at startup the handlers of the commands it answers
+    or learns from; the radio callback indexes a 256 entry table with the command byte, so that a frame
+    costs one load and one call whatever the number of commands known. Each entry counts its frames and
+    the time spent in its handler. A command without a handler is counted as unknown.
+*/
+namespace IOHC {
+    using CommandHandler = void (*)(iohcPacket *packet);
+
+    struct CommandStats {
+        uint32_t hits;
+        uint32_t totalUs;
+        uint32_t maxUs;
+    };
+
+    class iohcDispatcher {
+    public:
+        static iohcDispatcher *getInstance();
+        virtual ~iohcDispatcher() = default;
+
+        // The last handler registered for a command replaces the previous one
+        void on(uint8_t cmd, CommandHandler handler);
+        void on(std::initializer_list<uint8_t> cmds, CommandHandler handler);
+        // Known command, nothing to do
+        void ignore(std::initializer_list<uint8_t> cmds);
+        bool handles(uint8_t cmd) const { return table[cmd] != nullptr; }
+
+        // Radio callback. Returns false on a command without handler
+        bool dispatch(iohcPacket *packet);
+
+        const CommandStats &getStats(uint8_t cmd) const { return stats[cmd]; }
+        uint32_t getUnknown() const { return unknown; }
+        void resetStats();
+        void printStats() const;
+
+    private:
+        iohcDispatcher() = default;
+
+        static iohcDispatcher *_iohcDispatcher;
+        CommandHandler table[256]{};
+        CommandStats stats[256]{};
+        uint32_t unknown = 0;
+    };
+}
+
+#endif // IOHC_DISPATCH_H
@@ -0,0 +1,77 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef IOHC_FORMAT_H
+#define IOHC_FORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include <iohcPacket.h>
+
+#define FRAME_LINE_LEN                  320     // Longest decoded frame line, NUL included
+
+/*
+    Text formatting without heap: hex from a lookup table and a writer appending to a buffer owned by the
+    caller. The decoded frame line is built in one pass with it, printed with a single printf.
+*/
+namespace IOHC {
+    // Writes 2 * len hex digits and the NUL, out must hold 2 * len + 1 chars. Returns the digits written
+    size_t hexEncode(char *out, const uint8_t *in, size_t len, bool upper = false);
+
+    // Hex string on the stack, printf("%s", HexBuffer<6>(hmac).str)
+    template <size_t N>
+    struct HexBuffer {
+        char str[2 * N + 1];
+
+        explicit HexBuffer(const uint8_t *in, size_t len = N) { hexEncode(str, in, len < N ? len : N); }
+    };
+
+    class TextWriter {
+    public:
+        TextWriter(char *buffer, size_t size) : buffer(buffer), size(size) { if (size) buffer[0] = '\0'; }
+
+        TextWriter &str(const char *s);
+        TextWriter &str(std::string_view s);
+        TextWriter &chr(char c);
+        // Bytes as lower case hex digits, as bitrow_to_hex_string
+        TextWriter &hex(const uint8_t *in, size_t len);
+        // Value as %X, at least digits wide with leading fill (%2.2X, or %4X with a space)
+        TextWriter &hexValue(uint32_t value, uint8_t digits = 1, char fill = '0');
+        // Value as %u, at least digits wide with leading 0 (%2.2u)
+        TextWriter &dec(uint32_t value, uint8_t digits = 1);
+        // Thousandths as %.3f
+        TextWriter &fixed3(uint32_t thousandths);
+
+        const char *c_str() const { return buffer; }
+        size_t length() const { return pos; }
+        bool truncated() const { return overflow; }
+
+    private:
+        char *reserve(size_t n);
+
+        char *buffer;
+        size_t size;
+        size_t pos = 0;
+        bool overflow = false;
+    };
+
+    // The line printed by iohcPacket::decode, without its newline. elapsedUs is only shown with verbosity
+    size_t formatFrame(char *out, size_t size, const iohcPacket &packet, bool verbosity, unsigned long elapsedUs);
+}
+
+#endif // IOHC_FORMAT_H
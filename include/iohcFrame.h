@@ -0,0 +1,134 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef IOHC_FRAME_H
+#define IOHC_FRAME_H
+
+#include <cstdint>
+
+#include <iohcPacket.h>
+
+#define FRAME_HEADER_LEN                9       // CtrlByte1, CtrlByte2, target, source, cmd
+#define FRAME_MAX_DATA_LEN              (MAX_FRAME_LEN - FRAME_HEADER_LEN)
+
+/*
+    Typed views over a received frame. A frame is classified once from its protocol, cmd and data length
+    into a FrameDescriptor; its fields are then read in place through the layout table, bounds checked
+    against the frame length. This replaces the dataLen switch repeated at each access to the _msg union.
+*/
+namespace IOHC {
+    // Known data layouts, named after the _msg structs they read
+    enum class Layout : uint8_t {
+        Raw,            // Unknown, data only
+        P0x01_13,       // 1W 0x00/0x01/0x28, main on 1 byte
+        P0x00_14,
+        P0x00_16,       // Also 0x20 on 16 bytes
+        P0x20_13,
+        P0x20_15,
+        P0x2e,          // 1W pair (0x2E) and 0x39
+        P0x30,          // 1W key transfer
+        P0x2b,          // Discover answers 0x29 / 0x2B
+        P2W_0x00,       // 2W 0x00/0x01, without sequence nor MAC
+        Count
+    };
+
+    enum class Field : uint8_t {
+        Origin,
+        Acei,
+        Main,
+        Fp1,
+        Fp2,
+        Fp3,
+        Data,
+        Sequence,
+        Hmac,
+        Key,
+        Manufacturer,
+        Actuator,
+        Backbone,
+        Info,
+        Timestamp,
+        Count
+    };
+
+    struct FieldSpan {
+        uint8_t offset;     // From the first data byte
+        uint8_t length;     // 0 if not part of the layout
+    };
+
+    // Bytes of a frame read in place, empty if the field is not there
+    struct ByteView {
+        const uint8_t *data;
+        uint8_t size;
+
+        bool empty() const { return size == 0; }
+        uint8_t operator[](uint8_t i) const { return i < size ? data[i] : 0; }
+        // Big endian, as on air
+        uint32_t value() const {
+            uint32_t v = 0;
+            for (uint8_t i = 0; i < size && i < 4; i++) v = (v << 8) | data[i];
+            return v;
+        }
+    };
+
+    struct FrameDescriptor {
+        uint8_t protocol;   // 1 or 2 way
+        uint8_t cmd;
+        Layout layout;
+        uint8_t dataLen;
+    };
+    static_assert(sizeof(FrameDescriptor) == 4, "FrameDescriptor is passed by value");
+
+    const char *layoutName(Layout layout);
+    const char *fieldName(Field field);
+    FieldSpan layoutField(Layout layout, Field field);
+    FrameDescriptor classify(const uint8_t *buffer, uint8_t length);
+
+    class FrameView {
+    public:
+        FrameView(const Payload &payload, uint8_t length) : FrameView(payload.buffer, length) {}
+        FrameView(const uint8_t *buffer, uint8_t length)
+            : buffer(buffer), desc(classify(buffer, length > MAX_FRAME_LEN ? MAX_FRAME_LEN : length)) {}
+        explicit FrameView(const iohcPacket &packet) : FrameView(packet.payload, packet.buffer_length) {}
+
+        const FrameDescriptor &descriptor() const { return desc; }
+        Layout layout() const { return desc.layout; }
+        uint8_t cmd() const { return desc.cmd; }
+        bool oneWay() const { return desc.protocol == 1; }
+
+        const _header &header() const { return *reinterpret_cast<const _header *>(buffer); }
+        ByteView data() const {
+            return {buffer + FRAME_HEADER_LEN, desc.dataLen};
+        }
+
+        bool has(Field field) const { return !get(field).empty(); }
+
+        ByteView get(Field field) const {
+            FieldSpan span = layoutField(desc.layout, field);
+            if (!span.length || span.offset + span.length > desc.dataLen) return {buffer, 0};
+            return {buffer + FRAME_HEADER_LEN + span.offset, span.length};
+        }
+
+        uint8_t u8(Field field) const { return get(field)[0]; }
+        uint16_t u16(Field field) const { return static_cast<uint16_t>(get(field).value()); }
+
+    private:
+        const uint8_t *buffer;
+        FrameDescriptor desc;
+    };
+}
+
+#endif // IOHC_FRAME_H
@@ -0,0 +1,159 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef IOHC_FRAME_BUILDER_H
+#define IOHC_FRAME_BUILDER_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include <iohcFrame.h>
+#include <iohcPacket.h>
+
+#define IOHC_TX_POOL_SIZE               64      // Frames in the TX pool, twice the longest bounded batch
+
+/*
+    Frames sent. The layout of each command is declared once, in Frames below, as a FrameSpec: control
+    bytes, length and radio settings are constants, and the constant part of the payload is a template
+    copied behind the header. Building a frame writes all of it in place into a packet of the TX pool;
+    callers only fill the variable bytes. A slot stays taken until the radio has sent its frame, a batch
+    longer than the pool goes on with packets from the heap.
+*/
+namespace IOHC {
+    // CtrlByte1 bits above MsgLen, see CB1
+    constexpr uint8_t CB1_1W = 1 << 5;
+    constexpr uint8_t CB1_START = 1 << 6;
+    constexpr uint8_t CB1_END = 1 << 7;
+    // CtrlByte2 bits, see CB2
+    constexpr uint8_t CB2_PRIO = 1 << 2;
+    constexpr uint8_t CB2_LPM = 1 << 5;
+
+    struct TxProfile {
+        uint16_t repeatTime;        // ms before each emission
+        uint8_t repeat;
+        uint16_t delayed;           // ms before the first emission of a frame that is not the first of its batch
+    };
+
+    struct FrameSpec {
+        uint8_t cmd;
+        uint8_t ctrl1;              // CB1 flags, MsgLen comes from dataLen
+        uint8_t ctrl2;
+        uint8_t dataLen;
+        TxProfile tx;
+        uint8_t data[FRAME_MAX_DATA_LEN];   // Template, zero past the constant bytes
+
+        constexpr uint8_t ctrlByte1() const { return ctrl1 | (FRAME_HEADER_LEN - 1 + dataLen); }
+        constexpr uint8_t length() const { return FRAME_HEADER_LEN + dataLen; }
+
+        // Same frame for another command and payload, used by the command scans
+        constexpr FrameSpec with(uint8_t command, const uint8_t *bytes, uint8_t len) const {
+            FrameSpec spec = *this;
+            spec.cmd = command;
+            spec.dataLen = len < FRAME_MAX_DATA_LEN ? len : FRAME_MAX_DATA_LEN;
+            for (uint8_t i = 0; i < FRAME_MAX_DATA_LEN; i++) spec.data[i] = i < spec.dataLen ? bytes[i] : 0;
+            return spec;
+        }
+    };
+
+    template <size_t Len>
+    constexpr FrameSpec frameSpec(uint8_t cmd, uint8_t ctrl1, uint8_t ctrl2, TxProfile tx) {
+        static_assert(Len <= FRAME_MAX_DATA_LEN, "Payload longer than a frame");
+        return {cmd, ctrl1, ctrl2, static_cast<uint8_t>(Len), tx, {}};
+    }
+
+    // The template may be shorter than the payload, the rest is left to the caller
+    template <size_t Len, size_t N>
+    constexpr FrameSpec frameSpec(uint8_t cmd, uint8_t ctrl1, uint8_t ctrl2, TxProfile tx, const uint8_t (&bytes)[N]) {
+        static_assert(N <= Len, "Template longer than the payload");
+        FrameSpec spec = frameSpec<Len>(cmd, ctrl1, ctrl2, tx);
+        for (size_t i = 0; i < N; i++) spec.data[i] = bytes[i];
+        return spec;
+    }
+
+    namespace Frames {
+        // Answers of the gateway, main.cpp
+        constexpr TxProfile Answer{25, 0, 0};
+        constexpr FrameSpec DiscoverAnswer = frameSpec<9>(0x29, CB1_START, 0, {25, 0, 250},
+                                                          {0xff, 0xc0, 0xba, 0x11, 0xad, 0x0b, 0xcc}); // 0x0b OverKiz 0x0c Atlantic
+        constexpr FrameSpec DiscoverActuator = frameSpec<0>(0x2C, CB1_START, 0, {25, 1, 0});
+        constexpr FrameSpec DiscoverActuatorAck = frameSpec<0>(0x2D, CB1_START, 0, {25, 0, 250});
+        constexpr FrameSpec KeyTransfer = frameSpec<16>(0x32, CB1_START, 0, Answer);
+        constexpr FrameSpec ChallengeAnswer = frameSpec<6>(0x3D, CB1_START, 0, {6, 1, 0});
+        constexpr FrameSpec ChallengeKeyTransfer = frameSpec<16>(0x32, CB1_START, 0, {6, 1, 0});
+        constexpr FrameSpec NameAnswer = frameSpec<16>(0x51, CB1_START, 0, {25, 0, 50},
+                                                       {'M', 'Y', '_', 'G', 'A', 'T', 'E', 'W', 'A', 'Y'});
+
+        // Cozy 2W, iohcCozyDevice2W
+        constexpr FrameSpec CozyAskChallenge = frameSpec<0>(0x31, CB1_START | CB1_END, 0, Answer);
+        constexpr FrameSpec CozyPowerOn = frameSpec<4>(0x20, CB1_START, 0, Answer, {0x0C, 0x60, 0x01, 0x2C});
+        constexpr FrameSpec CozySetTemp = frameSpec<6>(0x20, CB1_START, 0, {25, 0, 50}, {0x0C, 0x61, 0x01, 0x03, 0xFF, 0x00});
+        constexpr FrameSpec CozySetMode = frameSpec<5>(0x20, CB1_START, 0, Answer, {0x0C, 0x61, 0x01, 0x00, 0xFF});
+        constexpr uint16_t CozySetModeDelay = 250;  // Second frame of a setMode batch only
+        constexpr FrameSpec CozySetPresence = frameSpec<5>(0x20, CB1_START, 0, Answer, {0x0C, 0x61, 0x01, 0x10, 0xFF});
+        constexpr FrameSpec CozySetWindow = frameSpec<5>(0x20, CB1_START, 0, {25, 0, 50}, {0x0C, 0x61, 0x01, 0x0E, 0xFF});
+        constexpr FrameSpec CozyMidnight = frameSpec<4>(0x20, CB1_START, 0, Answer, {0x0C, 0x60, 0x01, 0x30});
+
+        // Other 2W, iohcOtherDevice2W. Most of them are probes waiting for an answer
+        constexpr TxProfile Probe{50, 0, 250};
+        constexpr FrameSpec OtherDiscovery = frameSpec<0>(0x2A, CB1_START, CB2_PRIO, {50, 0, 0});
+        constexpr FrameSpec OtherGetName = frameSpec<0>(0x50, CB1_START, CB2_PRIO, {50, 0, 0});
+        constexpr FrameSpec OtherCustom = frameSpec<6>(0x00, CB1_START, CB2_PRIO | CB2_LPM, Probe, {0x01, 0x47, 0xc8});
+        constexpr FrameSpec OtherCustom60 = frameSpec<4>(0x20, CB1_START, CB2_PRIO, Probe, {0x0C, 0x60, 0x01, 0xFF});
+        constexpr FrameSpec OtherDiscover28 = frameSpec<0>(0x28, CB1_START | CB1_END, CB2_PRIO | CB2_LPM, Probe);
+        constexpr FrameSpec OtherDiscover2A = frameSpec<12>(0x2A, CB1_START | CB1_END, CB2_PRIO | CB2_LPM, Probe,
+                                                            {0x93, 0x32, 0xd6, 0x18, 0xde, 0x2a, 0x0f, 0xa6, 0x25, 0x0e, 0x2c, 0x7e});
+        constexpr FrameSpec OtherUnknown2E = frameSpec<1>(0x2E, CB1_START | CB1_END, CB2_PRIO | CB2_LPM, Probe);
+        constexpr FrameSpec OtherFake0 = frameSpec<6>(0x00, CB1_START, CB2_PRIO | CB2_LPM, Probe, {0x03, 0xe7, 0x32});
+        constexpr FrameSpec OtherAck = frameSpec<0>(0x33, CB1_START, CB2_PRIO, {50, 0, 0});
+        constexpr FrameSpec OtherCheck = frameSpec<0>(0x00, CB1_START, CB2_PRIO | CB2_LPM, {50, 0, 245});
+
+        // 1W remotes, iohcRemote1W. Sequence and MAC are added by the caller
+        constexpr TxProfile Remote{40, 4, 0};
+        constexpr FrameSpec RemotePair = frameSpec<sizeof(_p0x2e)>(0x2E, CB1_1W | CB1_START | CB1_END, CB2_LPM, Remote);
+        constexpr FrameSpec RemoteRemove = frameSpec<sizeof(_p0x2e)>(0x39, CB1_1W | CB1_START | CB1_END, CB2_LPM, Remote);
+        constexpr FrameSpec RemoteAdd = frameSpec<sizeof(_p0x30)>(0x30, CB1_1W | CB1_START | CB1_END, CB2_LPM, Remote);
+        // Origin 0x01 user, ACEI 0x43
+        constexpr FrameSpec Remote0x00_14 = frameSpec<sizeof(_p0x00_14)>(0x00, CB1_1W | CB1_START | CB1_END, CB2_LPM, Remote, {0x01, 0x43});
+        constexpr FrameSpec Remote0x01_13 = frameSpec<sizeof(_p0x01_13)>(0x01, CB1_1W | CB1_START | CB1_END, CB2_LPM, Remote, {0x01, 0x43});
+        constexpr FrameSpec Remote0x00_16 = frameSpec<sizeof(_p0x00_16)>(0x00, CB1_1W | CB1_START | CB1_END, CB2_LPM, Remote, {0x01, 0x43});
+    }
+
+    // Next free packet of the TX pool, from the heap when the pool is all taken. The packet is the
+    // caller's until given to iohcRadio::send, which releases it once sent
+    iohcPacket *txSlot();
+
+    // Gives a packet of txSlot back: to the pool, or to the heap it came from
+    void releaseFrame(iohcPacket *packet);
+
+    // Header, template and radio settings of spec into packet. Returns packet
+    iohcPacket *buildFrame(iohcPacket *packet, const FrameSpec &spec, const address source, const address target);
+
+    inline iohcPacket *buildFrame(const FrameSpec &spec, const address source, const address target) {
+        return buildFrame(txSlot(), spec, source, target);
+    }
+
+    inline uint8_t *frameData(iohcPacket *packet) { return packet->payload.buffer + FRAME_HEADER_LEN; }
+
+    // 1W broadcast to a device type, 10 bits of type and 6 bits set
+    inline void broadcast1W(address target, uint16_t type) {
+        uint16_t bcast = (type << 6) + 0b111111;
+        target[0] = 0x00;
+        target[1] = bcast >> 8;
+        target[2] = bcast & 0xff;
+    }
+}
+
+#endif // IOHC_FRAME_BUILDER_H
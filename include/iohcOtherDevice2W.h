@@ -20,6 +20,8 @@
 #include <string>
 #include <vector>
 #include <iohcDevice.h>
+#include <iohcDispatch.h>
+#include <iohcFrameBuilder.h>
 #include <interact.h>
 
 #define OTHER_2W_FILE  "/Other2W.json"
@@ -56,10 +58,9 @@ namespace IOHC {
         address slave_from/*[3]*/ = {0x8C, 0xCB, 0x30}; // It's the new heater kitchen Address From
         address slave_to/*[3]*/ = {0x8C, 0xCB, 0x31}; // It's the new heater kitchen Address To
 
-        Memorize memorizeOther2W; //2W only
-
         //            bool isFake(address nodeSrc, address nodeDst) override;
         void cmd(Other2WButton cmd, Tokens *data);
+        void registerHandlers(iohcDispatcher *dispatcher);
         bool load() override;
         bool save() override;
         void initializeValid();
@@ -67,8 +68,6 @@ namespace IOHC {
         std::map<uint8_t, int> mapValid;
 //        void scanDump() override {}
 
-        static void forgePacket(iohcPacket *packet, const std::vector<uint8_t> &vector, size_t typn);
-
     private:
         iohcOtherDevice2W();
         static iohcOtherDevice2W *_iohcOtherDevice2W;
@@ -207,8 +207,25 @@ namespace IOHC {
     inline unsigned long packetStamp = 0L;
     inline unsigned long relStamp = 0L;
     inline size_t lastSendCmd = 0xFF;
+    // Signal of a frame received, fixed point as the capture and the sniffer record it
+    struct RxInfo {
+        int32_t afc;            // AFC frequency correction applied, Hz
+        int16_t rssi;           // dBm x 10
+        uint8_t snr;            // dB
+        uint8_t lna;            // LNA attenuation, dB
+    };
+
+    // Emission of a frame to send, see iohcRadio::packetSender
+    struct TxInfo {
+        uint16_t repeatTime;    // ms before each emission
+        uint16_t delayed;       // ms before the first emission of a frame that is not the first of its batch
+        uint8_t repeat;
+        bool lock;              // Radio kept in TX after the frame
+    };
+
     /**
-    Class implementing the IOHC packet received/sent, including some additional members useful to track/control Radio parameters and timings
+    Class implementing the IOHC packet received/sent. A packet is either received, with the signal it came
+    with, or to send, with its emission schedule: both share the same bytes after the payload
     */
     class iohcPacket {
     public:
@@ -217,22 +234,18 @@ namespace IOHC {
         ~iohcPacket() = default;
 
         Payload payload{};
-        uint8_t buffer_length = 0;
         uint32_t frequency = CHANNEL2; // Both 1W & 2W
-        unsigned long repeatTime = 0L;
-        uint8_t repeat = 0;
-        bool lock = false;
-        unsigned long delayed = 0;
+        union {
+            RxInfo rx{};
+            TxInfo tx;
+        };
+        uint8_t buffer_length = 0;
 
-        double afc{}; // AFC freq correction applied
-        uint8_t snr{}; // in dB
-        float rssi{}; // -RSSI*2 of last packet received
-        uint8_t lna{}; // LNA attenuation in dB
+        float rssiDbm() const { return rx.rssi / 10.0f; }
+        void setRssi(float dBm) { rx.rssi = static_cast<int16_t>(dBm * 10 + (dBm < 0 ? -0.5f : 0.5f)); }
 
         void decode(bool verbosity = false);
-
-    protected:
-        uint8_t source_originator[3] = {0};
     };
+    static_assert(sizeof(iohcPacket) == MAX_FRAME_LEN + 16, "Payload, frequency, RX or TX info, length");
 }
 #endif
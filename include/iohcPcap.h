@@ -0,0 +1,78 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef IOHC_PCAP_H
+#define IOHC_PCAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+
+#include <iohcCapture.h>
+
+#define PCAP_LINKTYPE_IOHC              147     // LINKTYPE_USER0, no io-homecontrol type is registered
+#define PCAP_PSEUDO_VERSION             0
+#define PCAP_BLOCK_MAX                  160     // Largest block written, an EPB of the longest frame and its comment
+#define PCAP_LINE_PREFIX                "PCAPNG "   // Blocks sent over the console, one hex line each
+
+/*
+    pcapng export of the captured frames. Each frame goes out as an Enhanced Packet Block whose data is
+    a PcapPseudoHeader followed by the frame as on air, the direction is also given in the epb_flags
+    option. Blocks are built one at a time in a small buffer and handed to a sink, nothing else is
+    buffered: the sink writes a file on the host or prints a hex line on the console.
+*/
+namespace IOHC {
+    enum PcapFlags : uint16_t {
+        PCAP_FLAG_TX = 1 << 0,
+        PCAP_FLAG_1W = 1 << 1,
+        PCAP_FLAG_CLASSIFIED = 1 << 2,      // layout is a known one, see iohcFrame.h
+        PCAP_FLAG_TRUNCATED = 1 << 3        // Frame longer than a capture record
+    };
+
+    // Little endian, in front of every frame. Dissectors skip headerLength bytes to reach the frame
+    struct __attribute__((packed)) PcapPseudoHeader {
+        uint8_t version;
+        uint8_t headerLength;
+        uint16_t flags;             // PcapFlags
+        uint32_t frequency;         // Hz
+        int32_t afc;                // Hz
+        int16_t rssi;               // dBm x 10
+        uint8_t layout;             // IOHC::Layout of the frame
+        uint8_t cmd;
+    };
+    static_assert(sizeof(PcapPseudoHeader) == 16, "Pseudo header layout is part of the file format");
+
+    class PcapWriter {
+    public:
+        using Sink = std::function<void(const uint8_t *block, size_t size)>;
+
+        explicit PcapWriter(Sink sink) : sink(std::move(sink)) {}
+
+        // Section header and interface description, once at the start of a stream
+        void begin(const char *interfaceName = "iohc");
+        void frame(const CaptureRecord &rec);
+
+    private:
+        Sink sink;
+    };
+
+    // Sinks for the two ends: a hex line on the console, a binary file on the host
+    void printPcapBlock(const uint8_t *block, size_t size);
+    PcapWriter::Sink filePcapSink(FILE *file);
+}
+
+#endif // IOHC_PCAP_H
@@ -0,0 +1,140 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef IOHC_PLATFORM_H
+#define IOHC_PLATFORM_H
+
+/*
+    What the radio layer uses of the ESP32: the LED GPIO, esp_timer for the time stamps and the Tx ticker,
+    FreeRTOS for the radio task, its notification and the Tx mutex. On the host (RADIO_SIM builds of test/)
+    the same names get a minimal implementation: no task is started, the notification given by the
+    interrupt is counted and taken by whoever runs the radio task in its place, the ticker keeps its
+    callback until fire() is called, time is the host steady clock.
+*/
+#if defined(ESP32)
+    #include <esp32-hal-gpio.h>
+    #include <esp_timer.h>
+    #include <freertos/FreeRTOS.h>
+    #include <freertos/semphr.h>
+    #include <freertos/task.h>
+    #include <TickerUsESP32.h>
+
+namespace Platform {
+    using Ticker = TimersUS::TickerUsESP32;
+}
+#else
+    #include <chrono>
+    #include <cstdint>
+    #include <functional>
+    #include <mutex>
+
+    #ifndef IRAM_ATTR
+    #define IRAM_ATTR
+    #endif
+
+    #define pdFALSE                 0
+    #define pdTRUE                  1
+    #define pdPASS                  1
+    #define portMAX_DELAY           UINT32_MAX
+    #define pdMS_TO_TICKS(ms)       (ms)
+    #define portYIELD_FROM_ISR(x)   (void) (x)
+
+using BaseType_t = int32_t;
+using TickType_t = uint32_t;
+using TaskHandle_t = void *;
+using SemaphoreHandle_t = std::mutex *;
+
+namespace Platform {
+    // Notifications given to the radio task and not taken yet
+    inline uint32_t notifications = 0;
+
+    class Ticker {
+    public:
+        template<typename TArg>
+        void attach_ms(uint32_t milliseconds, void (*callback)(TArg), TArg arg) {
+            periodic = [callback, arg]() { callback(arg); };
+            periodMs = milliseconds;
+        }
+        template<typename TArg>
+        void delay_ms(uint32_t milliseconds, void (*callback)(TArg), TArg arg) {
+            delayed = [callback, arg]() { callback(arg); };
+            delayMs = milliseconds;
+        }
+        void detach() { periodic = nullptr; }
+        bool active() const { return periodic != nullptr; }
+        bool stopDelay() {
+            if (!delayed) return false;
+            delayed = nullptr;
+            return true;
+        }
+
+        // Runs what the timer would run next, the delayed callback first. false if nothing is armed
+        bool fire() {
+            if (delayed) {
+                auto callback = std::move(delayed);
+                delayed = nullptr;
+                callback();
+                return true;
+            }
+            if (!periodic) return false;
+            auto callback = periodic;
+            callback();
+            return true;
+        }
+        uint32_t period() const { return delayed ? delayMs : periodMs; }
+
+    private:
+        std::function<void()> periodic;
+        std::function<void()> delayed;
+        uint32_t periodMs = 0;
+        uint32_t delayMs = 0;
+    };
+}
+
+inline int64_t esp_timer_get_time() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline void digitalWrite(uint8_t pin, uint8_t value) {}
+inline int digitalRead(uint8_t pin) { return 0; }
+
+inline BaseType_t xTaskCreatePinnedToCore(void (*task)(void *), const char *name, uint32_t stack, void *arg,
+                                          uint32_t priority, TaskHandle_t *handle, BaseType_t core) {
+    return pdPASS;
+}
+inline BaseType_t xPortGetCoreID() { return 0; }
+
+inline void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *woken) { Platform::notifications += 1; }
+// Never blocks: returns the notifications given since the last call
+inline uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks) {
+    uint32_t count = Platform::notifications;
+    Platform::notifications = clear ? 0 : (count ? count - 1 : 0);
+    return count;
+}
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex() { return new std::mutex; }
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t ticks) {
+    mutex->lock();
+    return pdTRUE;
+}
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex) {
+    mutex->unlock();
+    return pdTRUE;
+}
+#endif
+
+#endif // IOHC_PLATFORM_H
@@ -0,0 +1,187 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef IOHC_PROTOCOL_H
+#define IOHC_PROTOCOL_H
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+/*
+    Names of the protocol values, declared once below as X(value, name) lists. Each list expands into a
+    constexpr array indexed by the value itself, so a lookup is a bound check and a load: no hashing, no
+    static initialisation, nothing in RAM. Unknown values give an empty name.
+*/
+
+#define IOHC_COMMANDS(X) \
+    X(0x00, "EXECUTE FUNCTION 0x00") \
+    X(0x01, "ACTIVATE MODE 0x01") \
+    X(0x03, "PRIVATE REQ 0x03") \
+    X(0x04, "PRIVATE ACK 0x04") \
+    X(0x19, "SET SENSOR VALUE 0x19") \
+    X(0x20, "PRIVATE REQ 0x20") \
+    X(0x21, "PRIVATE ACK 0x21") \
+    X(0x28, "DISCOVER REQ 0x28") \
+    X(0x29, "DISCOVER ACK 0x29") \
+    X(0x2A, "DISCOVER REMOTE REQ 0x2A") \
+    X(0x2B, "DISCOVER REMOTE ACK 0x2B") \
+    X(0x2C, "DISCOVER ACTUATOR REQ 0x2C") \
+    X(0x2D, "DISCOVER ACTUATOR ACK 0x2D") \
+    X(0x2E, "UNKNOWN_0x2E") \
+    X(0x31, "ASK_CHALLENGE_0x31") \
+    X(0x32, "KEY TRANSFERT REQ 0x32") \
+    X(0x33, "KEY TRANSFERT ACK 0x33") \
+    X(0x36, "ADDRESS REQUEST 0x36") \
+    X(0x38, "LAUNCH KEY TRANSFERT 0x38") \
+    X(0x3C, "CHALLENGE REQ 0x3C") \
+    X(0x3D, "CHALLENGE ACK 0x3D") \
+    X(0x50, "GET NAME REQ 0x50") \
+    X(0x51, "GET NAME ACK 0x51") \
+    X(0xFE, "ERROR 0xFE") \
+    X(0xFF, "DO_NOTHING")
+
+// 10 bits broadcast address of the 1W target
+#define IOHC_DEVICE_TYPES(X) \
+    X(0b0000000000, "All") \
+    X(0b0000000001, "Venetian blind") \
+    X(0b0000000010, "Roller shutter") \
+    X(0b0000000011, "Awning (External for windows)") \
+    X(0b0000000100, "Window opener") \
+    X(0b0000000101, "Garage opener") \
+    X(0b0000000110, "Light") \
+    X(0b0000000111, "Gate opener") \
+    X(0b0000001000, "Rolling Door Opener") \
+    X(0b0000001001, "Lock") \
+    X(0b0000001010, "Blind") \
+    X(0b0000001011, "Unk") \
+    X(0b0000001100, "Beacon") \
+    X(0b0000001101, "Dual Shutter") \
+    X(0b0000001110, "Heating Temperature Interface") \
+    X(0b0000001111, "On / Off Switch") \
+    X(0b0000010000, "Horizontal Awning") \
+    X(0b0000010001, "External Venetian Blind") \
+    X(0b0000010010, "Louvre Blind") \
+    X(0b0000010011, "Curtain track") \
+    X(0b0000010100, "Ventilation Point") \
+    X(0b0000010101, "Exterior heating") \
+    X(0b0000010110, "Heat pump (Not currently supported)") \
+    X(0b0000010111, "Intrusion alarm") \
+    X(0b0000011000, "Swinging Shutter")
+
+/*
+Protection Level
+0 b[000] = Personal/Human: Most secure level. Will disable all categories (Level 0 to 7).
+"Since consequences of misusing this level can deeply impact the system behaviour, and therefore the io-homecontrol image, it is mandatory for the manufacturer that wants to use this level of priority to receive an agreement from io-homecontrol®."
+
+1 b[001] = End Product/Environment = (House) Goods Protection: Local Sensors
+User Level = User Control
+2 b[010] = Level 1 - High: Controllers have a higher level of priority than others.
+3 b[011] = Level 2 - Default: Default for (Remote) Controllers. Send immediate Command(s).
+Comfort Level = Automatic Control
+4 b[100] = Level 1 - TBD
+5 b[101] = Level 2 - TBD
+6 b[110] = Level 3 - SAAC: Stand Alone Automatic Controls
+7 b[111] = Level 4 - TBD (Default Channel: KLF100)*/
+#define IOHC_ACEI_LEVELS(X) \
+    X(0, "Prot Human") \
+    X(1, "Prot Sensor") \
+    X(2, "User Controller") \
+    X(3, "User Remote") \
+    X(4, "Auto 1") \
+    X(5, "Auto 2") \
+    X(6, "Auto SAAC") \
+    X(7, "Auto 4")
+
+/*
+Specifies what or who fired the command. Typically only USER or SAAC are used.
+0x0B Automatic Cycle/External Access/Load Shedding (Managers for requiring a particular electric load shed)
+0x0D Unspecified Enviroment Sensor (Used with commands of Unknown Sensor for Protection of End-Product or house goods)
+0x10 Used when Actuator decides to move by itself (Generated by Actuator)
+0xFF Used in context with Emergency or Security commands. This command originator should never be disabled.
+*/
+#define IOHC_ORIGINATORS(X) \
+    X(0x00, "User: Local") \
+    X(0x01, "User: Remote Control") \
+    X(0x02, "Sensor: Rain") \
+    X(0x03, "Sensor: Timer") \
+    X(0x04, "Security: SCD") \
+    X(0x05, "UPS") \
+    X(0x06, "SFC") \
+    X(0x07, "LSC") \
+    X(0x08, "SAAC") \
+    X(0x09, "Sensor: Wind") \
+    X(0x0A, "Unknown") \
+    X(0x0B, "Automatic Cycle") \
+    X(0x0C, "Sensor: Local Light") \
+    X(0x0D, "Sensor: Environment") \
+    X(0x10, "Myself") \
+    X(0xC8, "Unknown") \
+    X(0xFE, "Automatic Cycle") \
+    X(0xFF, "Emergency")
+
+namespace IOHC {
+    namespace Protocol {
+        struct Name {
+            uint16_t value;
+            std::string_view name;
+        };
+
+        // Array sized to the highest value of the list, holes left empty
+        template <size_t N>
+        constexpr size_t tableSize(const Name (&names)[N]) {
+            size_t size = 0;
+            for (const auto &n: names)
+                if (n.value >= size) size = n.value + 1;
+            return size;
+        }
+
+        template <size_t Size, size_t N>
+        constexpr std::array<std::string_view, Size> makeTable(const Name (&names)[N]) {
+            std::array<std::string_view, Size> table{};
+            for (const auto &n: names) table[n.value] = n.name;
+            return table;
+        }
+
+#define IOHC_NAME(value, name) Name{value, name},
+        inline constexpr Name commandList[] = {IOHC_COMMANDS(IOHC_NAME)};
+        inline constexpr Name deviceTypeList[] = {IOHC_DEVICE_TYPES(IOHC_NAME)};
+        inline constexpr Name aceiLevelList[] = {IOHC_ACEI_LEVELS(IOHC_NAME)};
+        inline constexpr Name originatorList[] = {IOHC_ORIGINATORS(IOHC_NAME)};
+#undef IOHC_NAME
+
+        inline constexpr auto commands = makeTable<tableSize(commandList)>(commandList);
+        inline constexpr auto deviceTypes = makeTable<tableSize(deviceTypeList)>(deviceTypeList);
+        inline constexpr auto aceiLevels = makeTable<tableSize(aceiLevelList)>(aceiLevelList);
+        inline constexpr auto originators = makeTable<tableSize(originatorList)>(originatorList);
+
+        template <size_t Size>
+        constexpr std::string_view lookup(const std::array<std::string_view, Size> &table, size_t value) {
+            return value < Size ? table[value] : std::string_view{};
+        }
+    }
+
+    constexpr std::string_view commandName(uint8_t cmd) { return Protocol::lookup(Protocol::commands, cmd); }
+    constexpr std::string_view deviceTypeName(uint16_t broadcast) { return Protocol::lookup(Protocol::deviceTypes, broadcast); }
+    constexpr std::string_view aceiLevelName(uint8_t level) { return Protocol::lookup(Protocol::aceiLevels, level); }
+    constexpr std::string_view originatorName(uint8_t originator) { return Protocol::lookup(Protocol::originators, originator); }
+
+    static_assert(commandName(0x3C) == "CHALLENGE REQ 0x3C");
+    static_assert(deviceTypeName(0b0000000010) == "Roller shutter");
+    static_assert(deviceTypeName(0x3FF).empty());
+}
+
+#endif // IOHC_PROTOCOL_H
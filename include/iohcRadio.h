@@ -22,15 +22,14 @@
 #include <board-config.h>
 #include <iohcCryptoHelpers.h>
 #include <iohcPacket.h>
-
-#if defined(RADIO_SX127X)
-        #include <SX1276Helpers.h>
-#endif
-#if defined(RADIO_SX126X)
-        #include <SX126xHelpers.h>
-#endif
-#if defined(ESP32)
-    #include <TickerUsESP32.h>
+#include <iohcPlatform.h>
+#include <iohcRadioWatchdog.h>
+#include <iohcTransceiver.h>
+
+#if defined(RADIO_SIM) || defined(RADIO_SX127X)
+        #include <SX1276Transceiver.h>
+#elif defined(CC1101)
+        #include <CC1101Transceiver.h>
 #endif
 
 #define SM_GRANULARITY_US               130ULL  // Ticker function frequency in uS (100 minimum) 4 x 26µs = 104
@@ -38,32 +37,74 @@
 #define SM_PREAMBLE_RECOVERY_TIMEOUT_US 1378 // 12500   // SM_GRANULARITY_US * PREAMBLE_LSB //12500   // Maximum duration in uS of Preamble before reset of receiver
 #define DEFAULT_SCAN_INTERVAL_US        13520   // Default uS between frequency changes
 
+namespace Radio {
+#if defined(RADIO_SIM)
+    using Backend = SimTransceiver;
+#elif defined(RADIO_SX127X)
+    using Backend = SX1276Transceiver;
+#elif defined(CC1101)
+    using Backend = CC1101Transceiver;
+#else
+    #error "No radio backend selected in board-config.h"
+#endif
+}
+
 /*
     Singleton class to implement an IOHC Radio abstraction layer for controllers.
     Implements all needed functionalities to receive and send packets from/to the air, masking complexities related to frequency hopping
     IOHC timings, async sending and receiving through callbacks, ...
+    The transceiver is a template parameter (see iohcTransceiver.h), there is no virtual call on the radio path.
 */
 namespace IOHC {
+    struct CrcCheckStats {
+        uint32_t checked;
+        uint32_t failed;
+        uint32_t unchecked;         // CRC bytes not received, the frame is dropped
+    };
+
     using IohcPacketDelegate = Delegate<bool(iohcPacket *iohc)>;
 
-    class iohcRadio  {
+    template <typename Transceiver>
+    class iohcRadioT final {
         public:
-            static iohcRadio *getInstance();
-            virtual ~iohcRadio() = default;
+            static iohcRadioT *getInstance();
+            ~iohcRadioT() = default;
             void start(uint8_t num_freqs, uint32_t *scan_freqs, uint32_t scanTimeUs, IohcPacketDelegate rxCallback, IohcPacketDelegate txCallback);
-            void send(std::vector<iohcPacket*>&iohcTx);
+            // Queued behind the batch being sent, if any
+            bool send(std::vector<iohcPacket*>&iohcTx);
+            // Answers due to peers, sent now or ahead of the next frame of the batch being sent
+            void sendAnswers(std::vector<iohcPacket*>&frames);
             volatile static bool _g_preamble;
             volatile static bool _g_payload;
+            volatile static bool _g_fifo;
             volatile static bool f_lock;
-            static void tickerCounter(iohcRadio *radio);
+            static void tickerCounter(iohcRadioT *radio);
+            static void handle_interrupt_task(void *pvParameters);
+            static void handle_interrupt_fromisr();
+            // One wake up of the radio task, notified or not. Run in place of the task on the host
+            void service(uint32_t notification);
+            iohcRadioWatchdog<Transceiver> watchdog;
+            // decode() line for each frame, off when frames are looked at from a capture instead
+            bool printFrames = true;
+            // CRC checked here instead of by the radio, so that frames failing it are still captured
+            void softwareCrc(bool on);
+            bool softwareCrc() const { return softCrc; }
+            const CrcCheckStats &crcStats() const { return crcCheck; }
+        #if !defined(ESP32)
+            // Fired by the host tests in place of esp_timer
+            Platform::Ticker &txTicker() { return Sender; }
+        #endif
 
         private:
-            iohcRadio();
+            iohcRadioT();
             bool receive(bool stats);
+            bool checkCrc(iohcPacket *packet);
+            void drainFifo();
             bool sent(iohcPacket *packet);
+            void startBatch(std::vector<iohcPacket*>&iohcTx);
+            void takeAnswers();
 
-            static iohcRadio *_iohcRadio;
-            static uint8_t _flags[2];
+            static iohcRadioT *_iohcRadio;
             volatile static unsigned long _g_payload_millis;
             
             volatile static bool send_lock;
@@ -72,20 +113,27 @@ namespace IOHC {
             volatile uint32_t tickCounter = 0;
             volatile uint32_t preCounter = 0;
             volatile uint8_t txCounter = 0;
+            bool repeating = false;     // Frame at txCounter already sent, with repeats left. txMutex taken
 
             uint8_t num_freqs = 0;
             uint32_t *scan_freqs{};
             uint32_t scanTimeUs{};
             uint8_t currentFreqIdx = 0;
 
+            // Bytes already drained from the FIFO for the frame being received
+            uint8_t rxBuffer[MAX_FRAME_LEN]{};
+            uint8_t rxLength = 0;
+
+            bool softCrc = false;
+            CrcCheckStats crcCheck{};
 
         #if defined(ESP8266)
             Timers::TickerUs TickTimer;
             Timers::TickerUs Sender;
 //            Timers::TickerUs FreqScanner;
-        #elif defined(ESP32)
-            TimersUS::TickerUsESP32 TickTimer;
-            TimersUS::TickerUsESP32 Sender;
+        #else
+            Platform::Ticker TickTimer;
+            Platform::Ticker Sender;
         #endif
             iohcPacket *iohc{};
             iohcPacket *delayed{};
@@ -93,15 +141,14 @@ namespace IOHC {
             IohcPacketDelegate rxCB = nullptr;
             IohcPacketDelegate txCB = nullptr;
             std::vector<iohcPacket*> packets2send{};
+            // Answers given while a batch is sent, put in it before its next frame. txMutex guards both lists
+            std::vector<iohcPacket*> answers{};
+            SemaphoreHandle_t txMutex = nullptr;
         protected:
-            static void i_preamble();
-            static void i_payload();
-            static void packetSender(iohcRadio *radio);
-
-        #if defined(CC1101)
-            uint8_t lenghtFrame=0;
-        #endif
+            static void packetSender(iohcRadioT *radio);
     };
+
+    using iohcRadio = iohcRadioT<Radio::Backend>;
 }
 
-#endif
\ No newline at end of file
+#endif
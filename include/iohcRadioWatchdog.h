@@ -0,0 +1,170 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef IOHC_RADIO_WATCHDOG_H
+#define IOHC_RADIO_WATCHDOG_H
+
+#include <cstdint>
+#include <cstdio>
+
+#include <iohcTransceiver.h>
+
+#define WD_SILENCE_US               (15 * 60 * 1000000LL)   // No valid frame for that long is suspicious
+#define WD_RECOVERY_LEVELS          4
+
+/*
+    Supervisor of the receiver. On each check (idle timeout of the radio task) it reads the receiver
+    health: Rx mode, PLL lock, preamble detection stuck from one check to the next without any frame,
+    configuration lost, or no valid frame for WD_SILENCE_US. While unhealthy it escalates one step per
+    check through the recovery levels, each one re-checked immediately:
+        1 IRQ flags clear   2 Rx restart   3 registers replayed from the saved script   4 hardware reset
+    Counts and recovery latency (fault detected to healthy again) are kept as metrics.
+*/
+namespace IOHC {
+    enum class Recovery : uint8_t {
+        None,
+        ClearFlags,
+        RestartRx,
+        Registers,
+        HardReset
+    };
+
+    struct WatchdogMetrics {
+        uint32_t checks;
+        uint32_t faults;                                // Unhealthy checks
+        uint32_t recoveries[WD_RECOVERY_LEVELS];        // Recovery steps applied, per level
+        uint32_t recovered;                             // Back to healthy after a fault
+        int64_t lastLatencyUs;                          // Fault detected to healthy
+        int64_t maxLatencyUs;
+        int64_t lastFrameUs;                            // Last valid frame received
+    };
+
+    template <typename Transceiver>
+    class iohcRadioWatchdog {
+    public:
+        using Clock = int64_t (*)();
+
+        explicit iohcRadioWatchdog(Clock clock) : clock(clock) {}
+
+        // Working configuration to come back to, once the radio is set up
+        void arm() {
+            Transceiver::saveConfig();
+            metrics.lastFrameUs = clock();
+            silenceKickUs = metrics.lastFrameUs;
+        }
+
+        void frameReceived() {
+            metrics.lastFrameUs = clock();
+            frameSinceCheck = true;
+        }
+
+/**
+ * The function `check` reads the receiver health and applies the next recovery level while it is not
+ * healthy. It is not called while the radio transmits.
+ *
+ * @param frequency Frequency the receiver must listen to, restored after levels 3 and 4.
+ * @return Recovery level applied, Recovery::None if healthy.
+ */
+        Recovery check(uint32_t frequency) {
+            metrics.checks += 1;
+            int64_t now = clock();
+            if (healthy(now)) {
+                recovered(now);
+                return Recovery::None;
+            }
+
+            metrics.faults += 1;
+            if (level == Recovery::None)
+                faultUs = now;
+            if (level != Recovery::HardReset)
+                level = static_cast<Recovery>(static_cast<uint8_t>(level) + 1);
+            recover(level, frequency);
+            metrics.recoveries[static_cast<uint8_t>(level) - 1] += 1;
+            printf("Radio watchdog: recovery level %u\n", static_cast<uint8_t>(level));
+
+            Recovery applied = level;
+            if (healthy(clock()))
+                recovered(clock());
+            return applied;
+        }
+
+        const WatchdogMetrics &getMetrics() const { return metrics; }
+
+        void dump() const {
+            printf("Radio watchdog: %u checks %u faults %u recovered\n", metrics.checks, metrics.faults, metrics.recovered);
+            printf("\tClearFlags %u RestartRx %u Registers %u HardReset %u\n",
+                   metrics.recoveries[0], metrics.recoveries[1], metrics.recoveries[2], metrics.recoveries[3]);
+            printf("\tRecovery latency last %lldus max %lldus\n", metrics.lastLatencyUs, metrics.maxLatencyUs);
+            printf("\tLast frame %llds ago\n", (clock() - metrics.lastFrameUs) / 1000000LL);
+        }
+
+    private:
+        bool healthy(int64_t now) {
+            Radio::Health health = Transceiver::health();
+            // Preamble seen on two checks in a row without any frame in between: receiver locked up
+            bool stuck = health.preamble && preambleLastCheck && !frameSinceCheck;
+            preambleLastCheck = health.preamble;
+            frameSinceCheck = false;
+            // Silence is only worth one kick per period, the air may really be quiet
+            bool silent = now - metrics.lastFrameUs > WD_SILENCE_US && now - silenceKickUs > WD_SILENCE_US;
+            if (silent) silenceKickUs = now;
+            return health.rxMode && health.pllLock && health.config && !stuck && !silent;
+        }
+
+        void recovered(int64_t now) {
+            if (level == Recovery::None) return;
+            metrics.recovered += 1;
+            metrics.lastLatencyUs = now - faultUs;
+            if (metrics.lastLatencyUs > metrics.maxLatencyUs)
+                metrics.maxLatencyUs = metrics.lastLatencyUs;
+            level = Recovery::None;
+        }
+
+        static void recover(Recovery step, uint32_t frequency) {
+            switch (step) {
+                case Recovery::ClearFlags:
+                    Transceiver::clearIrq();
+                    break;
+                case Recovery::RestartRx:
+                    Transceiver::restartRx();
+                    break;
+                case Recovery::HardReset:
+                    Transceiver::reset();
+                    [[fallthrough]];
+                case Recovery::Registers:
+                    Transceiver::restoreConfig();
+                    // Not answering, setRx would wait for the PLL forever. Next level on next check
+                    if (!Transceiver::health().config) break;
+                    Transceiver::setFrequency(frequency);
+                    Transceiver::clearIrq();
+                    Transceiver::setRx();
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        Clock clock;
+        WatchdogMetrics metrics{};
+        Recovery level = Recovery::None;
+        int64_t faultUs = 0;
+        int64_t silenceKickUs = 0;
+        bool preambleLastCheck = false;
+        bool frameSinceCheck = false;
+    };
+}
+
+#endif // IOHC_RADIO_WATCHDOG_H
@@ -19,15 +19,26 @@
 
 #include <interact.h>
 #include <iohcDevice.h>
+#include <iohcDispatch.h>
+#include <iohcFrameBuilder.h>
+#include <atomic>
 #include <vector>
 
+#if defined(ESP32)
+    #include <freertos/FreeRTOS.h>
+    #include <freertos/semphr.h>
+#endif
+
 #define IOHC_1W_REMOTE  "/1W.json"
+#define IOHC_1W_AHEAD   4       // Next sequences with their MAC computed ahead, per remote and button
 
 /*
     Singleton class with a full implementation of a VELUX KLIxxx controller
     The type of the controller can be managed changing related value within its profile file (1W.json)
     Type can be multiple, as it would be for KLI310, KLI312 and KLI313
     Also, the address and private key can be configured within the same json file.
+    The MACs of Open, Close, Stop, Vent and ForceOpen for the next IOHC_1W_AHEAD sequences of each remote are
+    computed at idle, so that a press of these only builds its frame, and its sequence is saved at idle too.
 */
 namespace IOHC {
     enum class RemoteButton {
@@ -42,23 +53,44 @@ namespace IOHC {
         Mode1, Mode2, Mode3, Mode4
     };
 
+    // Presses of the buttons computed ahead, press to frame queued
+    struct PressStats {
+        uint32_t ahead;             // MAC taken ready
+        uint32_t computed;          // MAC computed on the press, not ready or other button
+        uint64_t aheadUs;           // Summed
+        uint64_t computedUs;
+        uint32_t maxUs;
+        uint32_t macsAhead;         // Computed at idle
+    };
+
     class iohcRemote1W : public iohcDevice {
     public:
         static iohcRemote1W* getInstance();
         ~iohcRemote1W() override = default;
 
         void cmd(RemoteButton cmd, Tokens* data);
+        void registerHandlers(iohcDispatcher *dispatcher);
         bool load() override;
         bool save() override;
 //        void scanDump() override { }
-
-        static void forgePacket(iohcPacket* packet, uint16_t typn);
+        // From the loop task: the sequences to save, then the MACs missing ahead
+        void idle();
+        void computeAhead(bool on) { ahead = on; }
+        bool computeAhead() const { return ahead; }
+        const PressStats &pressStats() const { return stats; }
 
     private:
         iohcRemote1W();
 
         static iohcRemote1W* _iohcRemote1W;
 
+        static constexpr uint8_t AHEAD_BUTTONS = 5;     // Open to ForceOpen
+        struct MacAhead {
+            bool ready;
+            uint16_t sequence;
+            uint8_t mac[6];
+        };
+
     protected:
         int8_t target[3];
         struct remote {
@@ -68,12 +100,21 @@ namespace IOHC {
             std::vector<uint8_t> type{};
             uint8_t manufacturer{};
             std::string description;
+            MacAhead ahead[AHEAD_BUTTONS][IOHC_1W_AHEAD]{};     // By button, then sequence modulo IOHC_1W_AHEAD
         };
 
+        uint8_t *commandFrame(iohcPacket *packet, const remote &r, RemoteButton cmd, uint16_t sequence);
+        bool takeAhead(remote &r, RemoteButton cmd, uint16_t sequence, uint8_t *mac);
+
         std::vector<remote> remotes;
+        uint8_t keyCap[16]{};       // Key of the last remote seen pairing, in clear
 
         std::vector<iohcPacket *> packets2send{};
 
+        bool ahead = true;
+        std::atomic<bool> sequenceChanged{false};
+        SemaphoreHandle_t aheadMutex;
+        PressStats stats{};
     };
 }
 #endif
@@ -0,0 +1,112 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef IOHC_SEQUENCE_H
+#define IOHC_SEQUENCE_H
+
+#include <cstdint>
+
+#include <iohcCapture.h>
+#include <iohcPacket.h>
+
+#if defined(ESP32)
+    #include <freertos/FreeRTOS.h>
+    #include <freertos/semphr.h>
+#endif
+
+#define IOHC_SEQUENCE_NODES             32      // 1W remotes followed, the least recently heard one is replaced
+#define IOHC_SEQUENCE_WINDOW            64      // Sequences below the highest one remembered as seen or not
+#define IOHC_SEQUENCE_JUMP              256     // A counter moving that far ahead at once has jumped
+
+/*
+    Sequence numbers of the 1W remotes on air, one window per address fed with the frames received and the
+    frames we send as one of our remotes. The highest sequence and a bitmap of the IOHC_SEQUENCE_WINDOW
+    before it classify a sequence in constant time: a new highest one, a repeat of it (each frame is sent
+    several times, the frames of one press share it), one late within the window, or a replay, seen already
+    or older than the window. A counter jumping far ahead, as after a battery swap, is accepted and counted.
+    Received and sent highest sequences are kept apart: one of our remotes sending at or below what the
+    real remote was heard with is behind, its frames are dropped by the receivers.
+*/
+namespace IOHC {
+    enum class SequenceVerdict : uint8_t {
+        Fresh,              // Above the highest one
+        Repeat,             // The highest one again
+        Late,               // Within the window, not seen yet
+        Replay,             // Within the window and seen, or older than the window
+        Jump,               // IOHC_SEQUENCE_JUMP or more above the highest one, taken as the new highest
+        Count
+    };
+
+    const char *sequenceVerdictName(SequenceVerdict verdict);
+
+    // Window of one address, public for the host benchmark
+    struct SequenceWindow {
+        uint16_t highest;
+        uint64_t seen;              // Bit n: highest - n seen
+        bool started;
+
+        SequenceVerdict observe(uint16_t sequence);
+    };
+
+    struct SequenceNode {
+        address node;
+        bool used;
+        bool heard;                 // rxHighest is set
+        bool sent;                  // txHighest is set
+        uint16_t rxHighest;
+        uint16_t txHighest;
+        uint32_t lastUse;
+        SequenceWindow window;
+        uint32_t verdicts[static_cast<uint8_t>(SequenceVerdict::Count)];
+        uint32_t behind;            // Sent at or below the highest sequence received
+    };
+
+    struct SequenceStats {
+        uint32_t verdicts[static_cast<uint8_t>(SequenceVerdict::Count)];
+        uint32_t behind;
+        uint32_t evicted;           // Node replaced, table full
+    };
+
+    class iohcSequences {
+    public:
+        static iohcSequences *getInstance();
+        virtual ~iohcSequences() = default;
+
+        SequenceVerdict observe(const address node, uint16_t sequence, Direction direction);
+        // 1W frames with a sequence, from the radio Tx path. Frames without are left out
+        void sent(const iohcPacket &packet);
+        // Copy of the node's state, false if it is not followed
+        bool find(const address node, SequenceNode *state);
+        const SequenceStats &getStats() const { return stats; }
+        void print();
+
+    private:
+        iohcSequences();
+        SequenceNode *lookup(const address node);
+        void lock();
+        void unlock();
+    #if defined(ESP32)
+        SemaphoreHandle_t mutex = nullptr;
+    #endif
+
+        static iohcSequences *_iohcSequences;
+        SequenceNode nodes[IOHC_SEQUENCE_NODES]{};
+        uint32_t useCounter = 0;
+        SequenceStats stats{};
+    };
+}
+
+#endif // IOHC_SEQUENCE_H
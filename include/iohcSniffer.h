@@ -0,0 +1,142 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef IOHC_SNIFFER_H
+#define IOHC_SNIFFER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+#include <iohcCapture.h>
+#include <iohcPacket.h>
+
+#if defined(ESP32)
+    #include <freertos/FreeRTOS.h>
+    #include <freertos/ringbuf.h>
+#endif
+
+#define SNIFFER_VERSION                 1
+#define SNIFFER_SERIAL                  Serial
+#define SNIFFER_BAUD                    921600  // CP2102 limit, about 1600 frames/s of the longest frame
+#define SNIFFER_CONSOLE_BAUD            115200  // Back to it when the sniffer stops
+#define SNIFFER_RING_SIZE               8192    // Encoded records waiting for the UART, about 90 ms at SNIFFER_BAUD
+#define SNIFFER_CHUNK                   256     // Bytes handed to the UART at once
+
+/*
+    Binary sniffer stream. Each frame sent or received goes on the serial port as a SnifferHeader, the frame
+    and a CRC, COBS encoded between two 0x00 delimiters: a receiver resynchronises on the next delimiter
+    after a lost byte, and console text printed in between makes a block of its own, rejected by the CRC.
+    The radio task encodes the record into a byte ring without waiting; a sender task empties the ring into
+    the UART driver, whose interrupt feeds the FIFO. The decoder below is shared with the host receiver.
+*/
+namespace IOHC {
+    // Little endian on the wire
+    struct __attribute__((packed)) SnifferHeader {
+        uint8_t version;
+        Direction direction;
+        uint16_t sequence;          // Gaps are frames dropped on a full ring
+        uint32_t timestampUs;       // Low 32 bits of the board time, wraps after 71 minutes
+        uint32_t frequency;         // Hz
+        int32_t afc;                // Hz, 0 for a frame sent
+        int16_t rssi;               // dBm x 10, 0 for a frame sent
+        uint8_t length;             // Frame bytes following the header
+        uint8_t reserved;
+    };
+    static_assert(sizeof(SnifferHeader) == 20, "Sniffer header layout is part of the stream format");
+
+    constexpr size_t SNIFFER_RECORD_MAX = sizeof(SnifferHeader) + MAX_FRAME_LEN + sizeof(uint16_t);
+    // COBS adds one byte per 254, then the delimiters on both sides
+    constexpr size_t SNIFFER_ENCODED_MAX = SNIFFER_RECORD_MAX + SNIFFER_RECORD_MAX / 254 + 1 + 2;
+
+    // COBS, out holds len + len / 254 + 1 bytes. No delimiter is written
+    size_t cobsEncode(uint8_t *out, const uint8_t *in, size_t len);
+    // Returns 0 on a malformed block
+    size_t cobsDecode(uint8_t *out, const uint8_t *in, size_t len);
+    // Header, frame, CRC, COBS and delimiters. Returns the bytes written in out (SNIFFER_ENCODED_MAX)
+    size_t snifferEncode(uint8_t *out, const SnifferHeader &header, const uint8_t *frame);
+
+    struct SnifferFrame {
+        SnifferHeader header;
+        uint8_t frame[MAX_FRAME_LEN];
+    };
+
+    struct SnifferDecoderStats {
+        uint32_t frames;
+        uint32_t crcErrors;
+        uint32_t framingErrors;     // Bad COBS, record too short or too long
+        uint32_t lost;              // Sequence gaps
+    };
+
+    // Receiver side, fed with the bytes as they come
+    class SnifferDecoder {
+    public:
+        using Handler = std::function<void(const SnifferFrame &frame)>;
+
+        explicit SnifferDecoder(Handler handler) : handler(std::move(handler)) {}
+        void feed(const uint8_t *data, size_t len);
+        const SnifferDecoderStats &getStats() const { return stats; }
+
+    private:
+        void block();
+
+        Handler handler;
+        uint8_t buffer[SNIFFER_ENCODED_MAX]{};
+        size_t size = 0;
+        bool overflow = false;
+        bool first = true;          // Errors before the first good record are the tail of one, not counted
+        uint16_t expected = 0;
+        SnifferDecoderStats stats{};
+    };
+
+    struct SnifferStats {
+        uint32_t sent;
+        uint32_t dropped;           // Ring full, the radio task never waits
+        uint32_t maxBacklog;        // Bytes waiting in the ring, high water mark
+    };
+
+    class iohcSniffer {
+    public:
+        static iohcSniffer *getInstance();
+        virtual ~iohcSniffer() = default;
+
+        // Switches the serial port to baud and starts streaming, stop() gives the console back
+        bool start(uint32_t baud = SNIFFER_BAUD);
+        void stop();
+        bool isRunning() const { return running; }
+
+        // Called from the radio task, never blocks
+        void record(const iohcPacket &packet, Direction direction);
+        const SnifferStats &getStats() const { return stats; }
+        // Worst delay added by the ring, from the backlog high water mark
+        uint32_t maxLatencyUs() const { return baud ? static_cast<uint32_t>(10ull * stats.maxBacklog * 1000000 / baud) : 0; }
+
+    private:
+        iohcSniffer() = default;
+    #if defined(ESP32)
+        static void senderTask(void *pvParameters);
+        RingbufHandle_t ring = nullptr;
+    #endif
+
+        static iohcSniffer *_iohcSniffer;
+        uint16_t sequence = 0;
+        uint32_t baud = 0;
+        SnifferStats stats{};
+        volatile bool running = false;
+    };
+}
+
+#endif // IOHC_SNIFFER_H
@@ -37,7 +37,7 @@ namespace IOHC {
             static iohcSystemTable *getInstance();
             virtual ~iohcSystemTable() = default;
             
-            bool addObject(address node, address backbone, uint8_t actuator[2], uint8_t manufacturer, uint8_t flags);
+            bool addObject(const address node, const address backbone, const uint8_t actuator[2], uint8_t manufacturer, uint8_t flags);
             bool addObject(iohcObject *obj);
             bool addObject(std::string key, std::string serialized);
 
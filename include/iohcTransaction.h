@@ -0,0 +1,132 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef IOHC_TRANSACTION_H
+#define IOHC_TRANSACTION_H
+
+#include <cstdint>
+
+#include <iohcCryptoHelpers.h>
+#include <iohcFrame.h>
+#include <iohcPacket.h>
+
+#if defined(ESP32)
+    #include <freertos/FreeRTOS.h>
+    #include <freertos/semphr.h>
+#endif
+
+#define IOHC_MAX_SESSIONS               16      // Peers with a 2W exchange in flight at once
+
+/*
+    2W exchanges, one session per peer. A request sent waits for its answer; the peer may ask for a
+    challenge (0x3C) first, answered by 0x3D or by a key transfer (0x32) that becomes the new request.
+    The answers expected are declared per command, the transitions and their timeouts in tables. The radio
+    feeds every 2W frame sent and received, so requests to several peers run side by side; the handlers
+    read the session of the peer to compute the challenge answer on the request it follows. The part of the
+    challenge IV made of the request is computed when it is sent, a challenge then costs one AES block.
+    Only the exchanges we start are followed: a peer starting one (0x28 discovery, 0x38 key request) has
+    no session. The table is fed from the timer and radio tasks and read from the console, under a mutex;
+    a session is read as a copy.
+*/
+namespace IOHC {
+    enum class SessionState : uint8_t {
+        Idle,
+        AwaitAnswer,        // Request sent
+        Challenged,         // 0x3C received, our answer is due
+        AwaitConfirm,       // 0x3D sent, the answer of the request is due
+        Done,
+        Refused,            // 0xFE instead of the answer
+        TimedOut,
+        Count
+    };
+
+    enum class SessionEvent : uint8_t {
+        Request,            // Sent, a command with an answer
+        Challenge,          // 0x3C received
+        Response,           // 0x3D sent
+        Answer,             // Received, the answer of the request
+        Status,             // 0xFE received
+        Timeout,
+        Count
+    };
+
+    struct Session {
+        uint32_t peer;              // Address, see sessionKey. 0 is a free session
+        SessionState state;
+        uint8_t request;            // The challenge is computed on the request and its data
+        uint8_t answer;
+        uint8_t dataLen;
+        uint8_t data[FRAME_MAX_DATA_LEN];
+        uint8_t ivPrefix[IV_PREFIX_LEN];    // Challenge IV of the request but the challenge, see challengePrefix
+        uint32_t startMs;
+        uint32_t deadlineMs;
+
+        bool active() const {
+            return state == SessionState::AwaitAnswer || state == SessionState::Challenged || state == SessionState::AwaitConfirm;
+        }
+    };
+
+    struct SessionStats {
+        uint32_t opened;
+        uint32_t done;
+        uint32_t refused;
+        uint32_t timedOut;
+        uint32_t unexpected;        // Event without transition in the state of the session
+        uint32_t evicted;           // Active session reused for another peer, the table was full
+    };
+
+    // Answer expected to a request, 0 for none
+    uint8_t expectedAnswer(uint8_t request);
+    const char *sessionStateName(SessionState state);
+    uint32_t sessionTime();
+
+    inline uint32_t sessionKey(const address peer) { return 1u << 24 | peer[0] << 16 | peer[1] << 8 | peer[2]; }
+
+    class iohcTransactions {
+    public:
+        static iohcTransactions *getInstance();
+        virtual ~iohcTransactions() = default;
+
+        // Called by the radio for each frame, 1W ones are left out
+        void sent(const iohcPacket &packet, uint32_t nowMs = sessionTime());
+        void received(const iohcPacket &packet, uint32_t nowMs = sessionTime());
+
+        // Copy of the session of a peer, false if it has none
+        bool find(const address peer, Session *session, uint32_t nowMs = sessionTime());
+        void expire(uint32_t nowMs = sessionTime());
+        uint8_t activeCount();
+        const SessionStats &getStats() const { return stats; }
+        void print(uint32_t nowMs = sessionTime());
+
+    private:
+        iohcTransactions();
+        Session *lookup(uint32_t peer, uint32_t nowMs);
+        Session *open(uint32_t peer);
+        bool apply(Session &session, SessionEvent event, uint32_t nowMs);
+        void timeOut(uint32_t nowMs);
+        void lock();
+        void unlock();
+    #if defined(ESP32)
+        SemaphoreHandle_t mutex = nullptr;
+    #endif
+
+        static iohcTransactions *_iohcTransactions;
+        Session sessions[IOHC_MAX_SESSIONS]{};
+        SessionStats stats{};
+    };
+}
+
+#endif // IOHC_TRANSACTION_H
@@ -0,0 +1,107 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef IOHC_TRANSCEIVER_H
+#define IOHC_TRANSCEIVER_H
+
+#include <cstdint>
+
+#include <board-config.h>
+#include <iohcPacket.h>
+
+/*
+    Transceiver concept used by iohcRadio, resolved at compile time (CRTP, static members only).
+    A backend derives from Transceiver<Backend> and provides:
+        init()                          Hardware, registers and carrier setup
+        attachInterrupts(isr)           Wire the radio interrupt lines to isr
+        readPins() -> Irq               Level of the interrupt lines, called from the isr
+        status() -> Status              Tx/Rx ready, decoded from the IRQ registers
+        setRx() setTx() setStandby()
+        setFrequency(hz)
+        clearFlags() clearFifo()
+        readFifo(buf, len) writeFifo(buf, len) fifoNotEmpty()
+        readSignal(packet)              RSSI, SNR, AFC of the last frame
+        health() -> Health              Receiver state checked by the watchdog
+        clearIrq() restartRx()          Recovery steps, see iohcRadioWatchdog.h
+        saveConfig() restoreConfig() reset()
+    transmit() and receiveFrame() have defaults built on the above, a backend can hide them.
+*/
+namespace Radio {
+    struct Irq {
+        bool preamble;      // Receiver locked on a preamble
+        bool payload;       // Frame received or sent
+        bool fifoLevel;     // FIFO above threshold
+    };
+
+    struct Status {
+        bool txReady;
+        bool rxReady;
+    };
+
+    struct Health {
+        bool rxMode;        // Receiver on
+        bool pllLock;
+        bool preamble;      // PreambleDetect up
+        bool config;        // Configuration as saved
+    };
+
+    template <typename Impl>
+    class Transceiver {
+    public:
+        // Bytes to read on each FifoLevel interrupt, 0 if the backend has none
+        static constexpr uint8_t fifoChunk = 0;
+        // status().txReady is raised once a frame is sent, false if the backend cannot tell
+        static constexpr bool txDone = true;
+
+        static void readSignal(IOHC::iohcPacket *packet) {}
+        // Backends checking the CRC in software anyway have nothing to turn off
+        static void setHardwareCrc(bool on) {}
+
+/**
+ * The function `transmit` sends a frame: the FIFO is emptied, Tx is entered then the frame written,
+ * so a backend starting on FIFO not empty puts the preamble on air while the frame is written.
+ */
+        static void transmit(uint8_t *buffer, uint8_t length) {
+            Impl::clearFifo();
+            Impl::setTx();
+            Impl::writeFifo(buffer, length);
+        }
+
+/**
+ * The function `receiveFrame` completes a frame already partly drained in packet, reading the
+ * remaining bytes in one burst as the length is given by the first byte (IoHome mode).
+ */
+        static void receiveFrame(IOHC::iohcPacket *packet, bool stats) {
+            if (stats)
+                Impl::readSignal(packet);
+            uint8_t *buffer = packet->payload.buffer;
+            if (!packet->buffer_length)
+                Impl::readFifo(buffer + packet->buffer_length++, 1);
+            uint8_t frameLength = (buffer[0] & 0x1F) + 1;
+            if (frameLength > packet->buffer_length) {
+                Impl::readFifo(buffer + packet->buffer_length, frameLength - packet->buffer_length);
+                packet->buffer_length = frameLength;
+            }
+            while (packet->buffer_length < MAX_FRAME_LEN && Impl::fifoNotEmpty())
+                Impl::readFifo(buffer + packet->buffer_length++, 1);
+        }
+
+    protected:
+        Transceiver() = default;
+    };
+}
+
+#endif // IOHC_TRANSCEIVER_H
@@ -14,15 +14,24 @@
    limitations under the License.
  */
 
+#if !defined(RADIO_SIM)
 #include <Arduino.h>
+#endif
 
 #include <SX1276Helpers.h>
 #include <board-config.h>
 
 #if defined(RADIO_SX127X)
+#include <cmath>
+#include <cstdio>
+#include <cstring>
 #include <map>
 
-#if defined(ESP8266)
+#if defined(RADIO_SIM)
+#ifndef IRAM_ATTR
+#define IRAM_ATTR
+#endif
+#elif defined(ESP8266)
     #include <TickerUs.h>
 #elif defined(ESP32)
 #define CONFIG_DISABLE_HAL_LOCKS true
@@ -33,7 +42,30 @@
 #endif
 
 namespace Radio {
+#if !defined(RADIO_SIM)
     SPISettings SpiSettings(4000000, MSBFIRST, SPI_MODE0);
+#endif
+
+    // Configuration registers replayed by restoreRegisters(), as bursts of contiguous registers.
+    // Status, read only and value registers (RSSI, AFC, FEI, IRQ flags, temperature, version) are left out.
+    struct regRange {
+        uint8_t first;
+        uint8_t count;
+    };
+    constexpr regRange __configRegs[] = {
+        {REG_BITRATEMSB, REG_RSSITHRESH - REG_BITRATEMSB + 1},
+        {REG_RXBW, REG_OOKAVG - REG_RXBW + 1},
+        {REG_AFCFEI, 1},
+        {REG_PREAMBLEDETECT, REG_IMAGECAL - REG_PREAMBLEDETECT + 1},
+        {REG_LOWBAT, 1},
+        {REG_DIOMAPPING1, REG_DIOMAPPING2 - REG_DIOMAPPING1 + 1},
+        {REG_PLLHOP, 1},
+        {REG_TCXO, 1},
+        {REG_PADAC, 1},
+        {REG_BITRATEFRAC, 1},
+    };
+    uint8_t __savedRegs[RADIO_REGS_SIZE];
+    bool __regsSaved = false;
 
     // Simplified bandwidth registries evaluation
     std::map<uint8_t, regBandWidth> __bw =
@@ -46,6 +78,7 @@ namespace Radio {
         {250, {0x00, 0x01}} // 250KHz
     };
 
+#if !defined(RADIO_SIM)
 /**
  * The function `SPI_beginTransaction` begins a SPI transaction and sets the RADIO_NSS pin to LOW.
  */
@@ -111,6 +144,19 @@ namespace Radio {
         printf("\nRadio Chip is ready\n");
     }
 
+/**
+ * The function `resetHardware` pulses NRESET (100µs low) and waits for the radio to be ready again.
+ * All registers are back to their power on values.
+ */
+    void resetHardware() {
+        pinMode(RADIO_RESET, OUTPUT);
+        digitalWrite(RADIO_RESET, LOW);
+        delayMicroseconds(100);
+        pinMode(RADIO_RESET, INPUT); // Floating for POR
+        delay(5);
+    }
+#endif
+
 /**
  * The `initRegisters` function initializes various registers of a radio module for both transmission
  * and reception in a C++ program.
@@ -153,13 +199,14 @@ namespace Radio {
         writeByte(REG_SYNCVALUE2, SYNC_BYTE_2);
 
         // Mapping of pins DIO0 to DIO3
-        // DIO0: PayloadReady|PacketSent    DIO1: FIFO empty    DIO2: Sync   | DIO3: TxReady
+        // DIO0: PayloadReady|PacketSent    DIO1: FIFO level    DIO2: Sync   | DIO3: TxReady
         // Mapping of pins DIO4 and DIO5
         // DIO4: PreambleDetect  DIO5: Data
         // DIO Mapping Data Packet Table 30 Page 69
         writeByte(
             REG_DIOMAPPING1,
-            RF_DIOMAPPING1_DIO0_00 | RF_DIOMAPPING1_DIO1_01 | RF_DIOMAPPING1_DIO2_11 | RF_DIOMAPPING1_DIO3_01); // Org
+            RF_DIOMAPPING1_DIO0_00 | RF_DIOMAPPING1_DIO1_00 | RF_DIOMAPPING1_DIO2_11 | RF_DIOMAPPING1_DIO3_01);
+        //    RF_DIOMAPPING1_DIO0_00 | RF_DIOMAPPING1_DIO1_01 | RF_DIOMAPPING1_DIO2_11 | RF_DIOMAPPING1_DIO3_01); // Org
         //        writeByte(REG_DIOMAPPING1, RF_DIOMAPPING1_DIO0_00 | RF_DIOMAPPING1_DIO1_01 | RF_DIOMAPPING1_DIO2_10 | RF_DIOMAPPING1_DIO3_01); // timeout on DIO2 for test
         writeByte(REG_DIOMAPPING2, RF_DIOMAPPING2_MAP_PREAMBLEDETECT | RF_DIOMAPPING2_DIO4_11 | RF_DIOMAPPING2_DIO5_10);
         // Preamble on DIO4
@@ -180,8 +227,9 @@ namespace Radio {
         // Setting Preamble Length
         writeByte(REG_PREAMBLEMSB, PREAMBLE_MSB);
         writeByte(REG_PREAMBLELSB, PREAMBLE_LSB);
-        // FIFO Threshold - currently useless
-        writeByte(REG_FIFOTHRESH, RF_FIFOTHRESH_TXSTARTCONDITION_FIFONOTEMPTY);
+        // Tx starts as soon as the first byte is in the FIFO, so the frame is written while the preamble is on air
+        // FifoLevel on DIO1 lets Rx drain the FIFO while the frame is still arriving
+        writeByte(REG_FIFOTHRESH, RF_FIFOTHRESH_TXSTARTCONDITION_FIFONOTEMPTY | RADIO_FIFO_THRESHOLD);
 
         // ---------------- RX Register init section ----------------
         // Set lenght checking if passed as parameter
@@ -313,15 +361,19 @@ namespace Radio {
     //     for (uint8_t idx=0; idx <= 64; ++idx)
     //         readByte(REG_FIFO);
     // }
-    void clearBuffer() {
-        // Taille du buffer FIFO du SX1276
-        const uint8_t bufferSize = 64;
-
-        // Lire le buffer par paquets de 32 octets
-        for (uint8_t i = 0; i < bufferSize; i += 32) {
-            uint8_t buffer[32]; // Tableau temporaire pour stocker les octets lus
-            readBytes/*Burst*/(REG_FIFO, buffer, sizeof(buffer)); // Lire 32 octets à la fois
-        }
+    // void clearBuffer() {
+    //     // Taille du buffer FIFO du SX1276
+    //     const uint8_t bufferSize = 64;
+    //
+    //     // Lire le buffer par paquets de 32 octets
+    //     for (uint8_t i = 0; i < bufferSize; i += 32) {
+    //         uint8_t buffer[32]; // Tableau temporaire pour stocker les octets lus
+    //         readBytes/*Burst*/(REG_FIFO, buffer, sizeof(buffer)); // Lire 32 octets à la fois
+    //     }
+    // }
+    void IRAM_ATTR clearBuffer() {
+        // Setting FifoOverrun clears the FIFO in one access
+        writeByte(REG_IRQFLAGS2, RF_IRQFLAGS2_FIFOOVERRUN);
     }
 
     //     void clearFlags() {
@@ -358,6 +410,7 @@ namespace Radio {
         return (getByte);
     }
 
+#if !defined(RADIO_SIM)
     void IRAM_ATTR readBytes(uint8_t regAddr, uint8_t *out, uint8_t len) {
         SPI_beginTransaction();
         SPI.transfer(regAddr); // Send Address
@@ -367,10 +420,13 @@ namespace Radio {
         SPI_endTransaction();
     }
 
+#endif
+
     bool IRAM_ATTR writeByte(uint8_t regAddr, uint8_t data, bool check) {
         return writeBytes(regAddr, &data, 1, check);
     }
 
+#if !defined(RADIO_SIM)
     auto IRAM_ATTR writeBytes(uint8_t regAddr, uint8_t *in, uint8_t len, bool check) -> bool {
         SPI_beginTransaction();
         SPI.write(regAddr | SPI_Write); // Send Address with Write flag
@@ -394,6 +450,7 @@ namespace Radio {
 
         return true;
     }
+#endif
 
     uint16_t IRAM_ATTR readWord(uint8_t regAddr) {
         uint8_t lowByte = readByte(regAddr);
@@ -484,33 +541,122 @@ namespace Radio {
         return __bw.rbegin()->second;
     }
 
-    void dump() {
-        uint8_t idx = 0;
-
-        Serial.printf("#Type\tRegister Name\tAddress[Hex]\tValue[Hex]\n");
-        do {
-            Serial.printf("REG\tname\t0x%2.2x\t0x%2.2x\n", idx, readByte(idx));
-            idx += 1;
-        } while (idx < 0x7f);
-        Serial.printf("PKT\tFalse;False;255;0;\nXTAL\t32000000\n");
-        // Serial.printf("\n");
-        dumpReal();
+/**
+ * The function `dump` takes a snapshot of the registers and prints it as one hex line, to be decoded
+ * on the host (see debug_resisters.cpp). The radio is only held for the snapshot burst, printing
+ * and decoding happen afterwards.
+ *
+ * @param decode Also prints the registers table and decodes them on the device, slow.
+ */
+    void dump(bool decode) {
+        uint8_t registers[RADIO_REGS_SIZE];
+        snapshot(registers);
+        printSnapshot(registers);
+        if (!decode) return;
+
+        printf("#Type\tRegister Name\tAddress[Hex]\tValue[Hex]\n");
+        for (uint8_t idx = 0; idx < 0x7f; idx++)
+            printf("REG\tname\t0x%2.2x\t0x%2.2x\n", idx, registers[idx]);
+        printf("PKT\tFalse;False;255;0;\nXTAL\t32000000\n");
+        dump_fsk_registers(registers);
     }
 
     void dumpReal() {
-        uint8_t registers[0x80];
-        registers[0] = 0x00;
-        readBytes(0x01, registers + 1, 0x7F);
+        dump(true);
+    }
+
+/**
+ * The function `snapshot` reads all the registers in a single SPI burst.
+ *
+ * @param regs Buffer of RADIO_REGS_SIZE bytes, RegFifo is not read to leave the FIFO untouched.
+ */
+    void IRAM_ATTR snapshot(uint8_t *regs) {
+        regs[0] = 0x00;
+        readBytes(0x01, regs + 1, RADIO_REGS_SIZE - 1);
+    }
+
+    void printSnapshot(const uint8_t *regs) {
         // sx127x_dump_registers(registers, device);
-        for (int idx = 0; idx < sizeof(registers); idx++) {
+        for (int idx = 0; idx < RADIO_REGS_SIZE; idx++) {
             if (idx != 0) {
                 printf(",");
             }
-            printf("0x%2.2x", registers[idx]);
+            printf("0x%2.2x", regs[idx]);
         }
         printf("\n");
+    }
 
-        dump_fsk_registers(registers);
+/**
+ * The function `saveRegisters` keeps a snapshot of the working configuration in RAM, replayed by
+ * `restoreRegisters` when the radio has lost it (brownout, glitch, hardware reset).
+ */
+    void saveRegisters() {
+        snapshot(__savedRegs);
+        // Write only bits, they read back as 0 anyway
+        __savedRegs[REG_RXCONFIG] &= ~(RF_RXCONFIG_RESTARTRXWITHOUTPLLLOCK | RF_RXCONFIG_RESTARTRXWITHPLLLOCK);
+        __savedRegs[REG_IMAGECAL] &= ~(RF_IMAGECAL_IMAGECAL_START | RF_IMAGECAL_IMAGECAL_RUNNING);
+        __regsSaved = true;
+    }
+
+/**
+ * The function `restoreRegisters` puts the radio in Standby and writes back the saved configuration.
+ * The caller puts it back on the right frequency and mode.
+ */
+    void restoreRegisters() {
+        if (!__regsSaved) return;
+        writeByte(REG_OPMODE, (__savedRegs[REG_OPMODE] & ~RF_OPMODE_MASK) | RF_OPMODE_STANDBY);
+        for (const auto &range: __configRegs)
+            writeBytes(range.first, __savedRegs + range.first, range.count);
+    }
+
+/**
+ * The function `registersIntact` checks the sync word and packet engine setup against the saved
+ * configuration, they are back to defaults after an unnoticed reset of the radio.
+ */
+    bool registersIntact() {
+        if (!__regsSaved) return true;
+        uint8_t regs[REG_PACKETCONFIG2 - REG_SYNCCONFIG + 1];
+        readBytes(REG_SYNCCONFIG, regs, sizeof(regs));
+        // Sync size changes between Rx and Tx
+        regs[0] &= RF_SYNCCONFIG_SYNCSIZE_MASK;
+        return (__savedRegs[REG_SYNCCONFIG] & RF_SYNCCONFIG_SYNCSIZE_MASK) == regs[0] &&
+               memcmp(__savedRegs + REG_SYNCCONFIG + 1, regs + 1, sizeof(regs) - 1) == 0;
+    }
+
+/**
+ * The function `clearIrqFlags` clears the IRQ flags which are cleared by writing 1, the FIFO with them.
+ */
+    void IRAM_ATTR clearIrqFlags() {
+        uint8_t out[2] = {
+            RF_IRQFLAGS1_RSSI | RF_IRQFLAGS1_PREAMBLEDETECT | RF_IRQFLAGS1_SYNCADDRESSMATCH | RF_IRQFLAGS1_TIMEOUT,
+            RF_IRQFLAGS2_FIFOOVERRUN | RF_IRQFLAGS2_LOWBAT
+        };
+        writeBytes(REG_IRQFLAGS1, out, 2);
+    }
+
+/**
+ * The function `restartRx` restarts the receiver chain, waiting for the PLL to lock again.
+ */
+    void IRAM_ATTR restartRx() {
+        writeByte(REG_RXCONFIG, readByte(REG_RXCONFIG) | RF_RXCONFIG_RESTARTRXWITHPLLLOCK);
+    }
+
+/**
+ * The function `diff` prints the registers which differ between two snapshots.
+ *
+ * @param baseline Reference snapshot, as saved by the `regSave` command.
+ * @param regs Current snapshot.
+ * @return Number of registers changed.
+ */
+    uint8_t diff(const uint8_t *baseline, const uint8_t *regs) {
+        uint8_t changed = 0;
+        for (uint8_t idx = 1; idx < RADIO_REGS_SIZE; idx++) {
+            if (baseline[idx] == regs[idx]) continue;
+            printf("0x%2.2x\t0x%2.2x -> 0x%2.2x\n", idx, baseline[idx], regs[idx]);
+            changed += 1;
+        }
+        printf("%u registers changed\n", changed);
+        return changed;
     }
 }
 #endif
@@ -0,0 +1,519 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <SX1276Sim.h>
+#include <SX1276Helpers.h>
+#include <board-config.h>
+#include <iohcCrc.h>
+
+#if defined(RADIO_SIM)
+#include <cstdio>
+#include <cstring>
+
+#define SIM_MODE_SWITCH_NS      60000   // Standby to Tx/Rx, PLL lock included
+#define SIM_PREAMBLE_DETECT     2       // Bytes of preamble before PreambleDetect rises
+#define SIM_FREQ_TOLERANCE      10000   // Hz
+
+namespace Radio::Sim {
+    // Power on values of the registers the driver relies on
+    static constexpr struct { uint8_t reg; uint8_t value; } __defaults[] = {
+        {REG_OPMODE, RF_OPMODE_STANDBY},
+        {REG_BITRATEMSB, 0x1A}, {REG_BITRATELSB, 0x0B},
+        {REG_FDEVMSB, 0x00}, {REG_FDEVLSB, 0x52},
+        {REG_FRFMSB, 0x6C}, {REG_FRFMID, 0x80}, {REG_FRFLSB, 0x00},
+        {REG_PACONFIG, 0x4F}, {REG_PARAMP, 0x09}, {REG_OCP, 0x2B},
+        {REG_LNA, 0x20}, {REG_RXCONFIG, 0x0E}, {REG_RSSICONFIG, 0x02},
+        {REG_RSSICOLLISION, 0x0A}, {REG_RSSITHRESH, 0xFF}, {REG_RSSIVALUE, 0xFF},
+        {REG_RXBW, 0x15}, {REG_AFCBW, 0x0B},
+        {REG_PREAMBLEDETECT, 0xAA}, {REG_OSC, 0x07},
+        {REG_PREAMBLEMSB, 0x00}, {REG_PREAMBLELSB, 0x03},
+        {REG_SYNCCONFIG, 0x93},
+        {REG_SYNCVALUE1, 0x01}, {REG_SYNCVALUE2, 0x01}, {REG_SYNCVALUE3, 0x01}, {REG_SYNCVALUE4, 0x01},
+        {REG_SYNCVALUE5, 0x01}, {REG_SYNCVALUE6, 0x01}, {REG_SYNCVALUE7, 0x01}, {REG_SYNCVALUE8, 0x01},
+        {REG_PACKETCONFIG1, 0x90}, {REG_PACKETCONFIG2, 0x40}, {REG_PAYLOADLENGTH, 0x40},
+        {REG_FIFOTHRESH, RF_FIFOTHRESH_FIFOTHRESHOLD_THRESHOLD},
+        {REG_IMAGECAL, 0x82}, {REG_VERSION, 0x12}, {REG_PLLHOP, 0x2D}, {REG_PADAC, 0x84},
+    };
+
+    Chip::Chip() { reset(); }
+
+    Chip &chip() {
+        static Chip _chip;
+        return _chip;
+    }
+
+/**
+ * The function `reset` puts the model back in its power on state, as a pulse on NRESET would do.
+ * Virtual time and counters are kept so a reset can be part of a measured sequence.
+ */
+    void Chip::reset() {
+        memset(regs, 0, sizeof(regs));
+        for (const auto &d: __defaults)
+            regs[d.reg] = d.value;
+        fifoClear();
+        flags1 = RF_IRQFLAGS1_MODEREADY;
+        flags2 = 0;
+        air = Air::Idle;
+        airTx = false;
+        faultMode = Fault::None;
+    }
+
+/**
+ * The function `fault` injects a radio failure, see Fault for what clears each of them.
+ */
+    void Chip::fault(Fault f) {
+        sync();
+        faultMode = f;
+        switch (f) {
+            case Fault::StuckPreamble:
+                flags1 |= RF_IRQFLAGS1_PREAMBLEDETECT;
+                if (!airTx) air = Air::Idle;
+                break;
+            case Fault::ConfigLost: {
+                uint64_t clock = clockNs;
+                reset();
+                clockNs = clock;
+                break;
+            }
+            default:
+                break;
+        }
+        edges();
+    }
+
+    void Chip::spiCost(uint8_t len) {
+        stats.spiTransactions += 1;
+        stats.spiBytes += len + 1; // Address byte included
+        clockNs += SIM_SPI_OVERHEAD_NS + SIM_SPI_BYTE_NS;
+        sync();
+    }
+
+    void Chip::readBytes(uint8_t regAddr, uint8_t *out, uint8_t len) {
+        spiCost(len);
+        regAddr &= 0x7F;
+        for (uint8_t idx = 0; idx < len; ++idx) {
+            clockNs += SIM_SPI_BYTE_NS;
+            sync();
+            if (faultMode == Fault::Dead) {
+                out[idx] = 0;
+                continue;
+            }
+            switch (regAddr) {
+                case REG_FIFO: out[idx] = fifoPop(); break;
+                case REG_IRQFLAGS1: out[idx] = irqFlags1(); break;
+                case REG_IRQFLAGS2: out[idx] = irqFlags2(); break;
+                default: out[idx] = regs[regAddr]; break;
+            }
+            // FIFO access does not increment the address
+            if (regAddr != REG_FIFO)
+                regAddr = (regAddr + 1) & 0x7F;
+        }
+    }
+
+    void Chip::writeBytes(uint8_t regAddr, const uint8_t *in, uint8_t len) {
+        spiCost(len);
+        regAddr &= 0x7F;
+        for (uint8_t idx = 0; idx < len; ++idx) {
+            clockNs += SIM_SPI_BYTE_NS;
+            sync();
+            if (faultMode == Fault::Dead) continue;
+            uint8_t value = in[idx];
+            switch (regAddr) {
+                case REG_FIFO:
+                    fifoPush(value);
+                    if ((regs[REG_OPMODE] & ~RF_OPMODE_MASK) == RF_OPMODE_TRANSMITTER && air == Air::Idle) {
+                        bool notEmpty = regs[REG_FIFOTHRESH] & RF_FIFOTHRESH_TXSTARTCONDITION_FIFONOTEMPTY;
+                        if (notEmpty || fifoCount > fifoThreshold())
+                            startTx();
+                    }
+                    break;
+                case REG_OPMODE:
+                    // LongRangeMode can only be changed in Sleep
+                    if ((regs[REG_OPMODE] & ~RF_OPMODE_MASK) != RF_OPMODE_SLEEP)
+                        value = (value & RF_OPMODE_LONGRANGEMODE_MASK) | (regs[REG_OPMODE] & ~RF_OPMODE_LONGRANGEMODE_MASK);
+                    regs[REG_OPMODE] = value;
+                    setMode(value & ~RF_OPMODE_MASK);
+                    break;
+                case REG_IRQFLAGS1:
+                    flags1 &= ~(value & (RF_IRQFLAGS1_RSSI | RF_IRQFLAGS1_TIMEOUT |
+                                         RF_IRQFLAGS1_PREAMBLEDETECT | RF_IRQFLAGS1_SYNCADDRESSMATCH));
+                    break;
+                case REG_IRQFLAGS2:
+                    if (value & RF_IRQFLAGS2_FIFOOVERRUN) {
+                        flags2 &= ~RF_IRQFLAGS2_FIFOOVERRUN;
+                        fifoClear();
+                    }
+                    flags2 &= ~(value & RF_IRQFLAGS2_LOWBAT);
+                    break;
+                case REG_RXCONFIG:
+                    // Restart bits are write only: abort the current reception
+                    if (value & (RF_RXCONFIG_RESTARTRXWITHOUTPLLLOCK | RF_RXCONFIG_RESTARTRXWITHPLLLOCK)) {
+                        if (faultMode == Fault::StuckPreamble || faultMode == Fault::PllUnlock)
+                            faultMode = Fault::None;
+                        if (!airTx) air = Air::Idle;
+                        flags1 &= ~(RF_IRQFLAGS1_PREAMBLEDETECT | RF_IRQFLAGS1_SYNCADDRESSMATCH);
+                        fifoClear();
+                    }
+                    regs[regAddr] = value & ~(RF_RXCONFIG_RESTARTRXWITHOUTPLLLOCK | RF_RXCONFIG_RESTARTRXWITHPLLLOCK);
+                    break;
+                case REG_IMAGECAL:
+                    // Calibration completes instantly
+                    regs[regAddr] = value & ~(RF_IMAGECAL_IMAGECAL_START | RF_IMAGECAL_IMAGECAL_RUNNING);
+                    break;
+                case REG_OSC:
+                    regs[regAddr] = value & ~RF_OSC_RCCALSTART;
+                    break;
+                case REG_VERSION:
+                    break;
+                default:
+                    regs[regAddr] = value;
+                    break;
+            }
+            if (regAddr != REG_FIFO)
+                regAddr = (regAddr + 1) & 0x7F;
+        }
+        edges();
+    }
+
+    void Chip::setMode(uint8_t mode) {
+        if (faultMode == Fault::StuckPreamble || faultMode == Fault::PllUnlock)
+            faultMode = Fault::None;
+        flags1 &= ~(RF_IRQFLAGS1_RXREADY | RF_IRQFLAGS1_TXREADY | RF_IRQFLAGS1_PLLLOCK);
+        flags2 &= ~RF_IRQFLAGS2_PACKETSENT;
+        flags1 |= RF_IRQFLAGS1_MODEREADY;
+        // Whatever was on air is lost on a mode change
+        air = Air::Idle;
+        airTx = false;
+
+        switch (mode) {
+            case RF_OPMODE_SLEEP:
+                fifoClear();
+                break;
+            case RF_OPMODE_SYNTHESIZER_TX:
+            case RF_OPMODE_SYNTHESIZER_RX:
+                clockNs += SIM_MODE_SWITCH_NS;
+                flags1 |= RF_IRQFLAGS1_PLLLOCK;
+                break;
+            case RF_OPMODE_TRANSMITTER: {
+                clockNs += SIM_MODE_SWITCH_NS;
+                flags1 |= RF_IRQFLAGS1_TXREADY | RF_IRQFLAGS1_PLLLOCK;
+                bool notEmpty = regs[REG_FIFOTHRESH] & RF_FIFOTHRESH_TXSTARTCONDITION_FIFONOTEMPTY;
+                if ((notEmpty && fifoCount) || fifoCount > fifoThreshold())
+                    startTx();
+                break;
+            }
+            case RF_OPMODE_RECEIVER:
+                clockNs += SIM_MODE_SWITCH_NS;
+                flags1 |= RF_IRQFLAGS1_RXREADY | RF_IRQFLAGS1_PLLLOCK;
+                flags1 &= ~(RF_IRQFLAGS1_PREAMBLEDETECT | RF_IRQFLAGS1_SYNCADDRESSMATCH);
+                break;
+            case RF_OPMODE_STANDBY:
+                standbyNs = clockNs;
+                break;
+            default:
+                break;
+        }
+    }
+
+    void Chip::startTx() {
+        stats.txLatency = static_cast<uint32_t>(clockNs - standbyNs);
+        if (stats.txLatency > stats.txLatencyMax) stats.txLatencyMax = stats.txLatency;
+        air = Air::Preamble;
+        airTx = true;
+        airLen = 0;
+        airPos = 0;
+        airCount = preambleBytes();
+        airNextNs = clockNs + byteTimeNs();
+    }
+
+/**
+ * The function `inject` puts a frame on the virtual air. It is received only if the model is listening
+ * on the same channel and not already busy with another frame, like a real receiver.
+ *
+ * @param frame Raw frame as written in the FIFO by the transmitter, CRC excluded.
+ * @param len Length of the frame.
+ * @param frequency Channel in Hz the frame is sent on.
+ * @param rssi Signal level in dBm reported in REG_RSSIVALUE.
+ * @return true if the receiver started to demodulate the frame.
+ */
+    bool Chip::inject(const uint8_t *frame, uint8_t len, uint32_t frequency, int16_t rssi) {
+        stats.framesInjected += 1;
+        sync();
+        int64_t offset = static_cast<int64_t>(frequency) - this->frequency();
+        if ((regs[REG_OPMODE] & ~RF_OPMODE_MASK) != RF_OPMODE_RECEIVER || air != Air::Idle || faultMode != Fault::None ||
+            offset > SIM_FREQ_TOLERANCE || offset < -SIM_FREQ_TOLERANCE || len == 0 || len > SIM_MAX_AIR_FRAME) {
+            stats.framesDropped += 1;
+            return false;
+        }
+        memcpy(airFrame, frame, len);
+        airLen = len;
+        airPos = 0;
+        airTx = false;
+        air = Air::Preamble;
+        airCount = preambleBytes();
+        airNextNs = clockNs + byteTimeNs();
+        regs[REG_RSSIVALUE] = static_cast<uint8_t>(-rssi * 2);
+        return true;
+    }
+
+    void Chip::advance(uint64_t ns) {
+        clockNs += ns;
+        sync();
+    }
+
+/**
+ * The function `sync` plays the air activity up to the current virtual time, one byte at a time,
+ * updating the FIFO and the IRQ flags the way the packet handler does.
+ */
+    void Chip::sync() {
+        while (air != Air::Idle && airNextNs <= clockNs) {
+            switch (air) {
+                case Air::Preamble:
+                    if (!airTx && preambleBytes() - airCount + 1 >= SIM_PREAMBLE_DETECT)
+                        flags1 |= RF_IRQFLAGS1_PREAMBLEDETECT;
+                    if (airCount <= 1) {
+                        air = Air::Sync;
+                        airCount = syncBytes();
+                    } else airCount -= 1;
+                    break;
+                case Air::Sync:
+                    if (airCount <= 1) {
+                        if (!airTx) flags1 |= RF_IRQFLAGS1_SYNCADDRESSMATCH;
+                        air = Air::Payload;
+                    } else airCount -= 1;
+                    break;
+                case Air::Payload:
+                    if (airTx) {
+                        if (!fifoCount) {
+                            // Transmitter starved: the frame is truncated on air
+                            stats.fifoUnderruns += 1;
+                            air = Air::Idle;
+                            airTx = false;
+                            return;
+                        }
+                        airFrame[airPos] = fifoPop();
+                        if (airPos == 0) airLen = (airFrame[0] & 0x1F) + 1;
+                        airPos += 1;
+                    } else {
+                        fifoPush(airFrame[airPos++]);
+                    }
+                    if (airPos >= airLen) {
+                        air = Air::Crc;
+                        airCount = 2;
+                    }
+                    break;
+                case Air::Crc:
+                    // Without the CRC check the packet engine hands the CRC bytes over with the frame
+                    if (!airTx && !(regs[REG_PACKETCONFIG1] & RF_PACKETCONFIG1_CRC_ON)) {
+                        uint16_t crc = IOHC::crc16(airFrame, airLen);
+                        fifoPush(airCount == 2 ? crc & 0xff : crc >> 8);
+                    }
+                    if (airCount <= 1) {
+                        air = Air::Idle;
+                        if (airTx) {
+                            flags2 |= RF_IRQFLAGS2_PACKETSENT;
+                            stats.framesSent += 1;
+                            airTx = false;
+                            if (txCB) txCB(airFrame, airLen, frequency());
+                        } else if (!(flags2 & RF_IRQFLAGS2_FIFOOVERRUN)) {
+                            stats.framesReceived += 1;
+                            // PayloadReady is cleared by the FIFO empty: a frame read out before its end never raises it
+                            if (fifoCount) {
+                                flags2 |= RF_IRQFLAGS2_PAYLOADREADY | RF_IRQFLAGS2_CRCOK;
+                                rxEndNs = airNextNs;
+                            }
+                        } else stats.framesDropped += 1;
+                    } else airCount -= 1;
+                    break;
+                case Air::Idle:
+                default:
+                    break;
+            }
+            airNextNs += byteTimeNs();
+        }
+        edges();
+    }
+
+/**
+ * The function `edges` raises the interrupt callback when one of the wired DIO lines goes up.
+ * The callback reads the lines back through dio(), so it is not reentered from there.
+ */
+    void Chip::edges() {
+        if (!irqCB || inIrq) return;
+        uint8_t levels = dioLevel(0) | (dioLevel(1) << 1) | (dioLevel(4) << 4);
+        uint8_t rising = levels & ~dioLevels;
+        dioLevels = levels;
+        if (rising) {
+            inIrq = true;
+            irqCB();
+            inIrq = false;
+        }
+    }
+
+    void Chip::fifoPush(uint8_t byte) {
+        if (fifoCount >= SIM_FIFO_SIZE) {
+            flags2 |= RF_IRQFLAGS2_FIFOOVERRUN;
+            stats.fifoOverruns += 1;
+            return;
+        }
+        fifo[(fifoHead + fifoCount) % SIM_FIFO_SIZE] = byte;
+        fifoCount += 1;
+    }
+
+    uint8_t Chip::fifoPop() {
+        if (!fifoCount) return 0;
+        uint8_t byte = fifo[fifoHead];
+        fifoHead = (fifoHead + 1) % SIM_FIFO_SIZE;
+        fifoCount -= 1;
+        // PayloadReady falls with the last byte read out
+        if (!fifoCount) {
+            flags2 &= ~(RF_IRQFLAGS2_PAYLOADREADY | RF_IRQFLAGS2_CRCOK);
+            if (rxEndNs) {
+                stats.rxLatency = static_cast<uint32_t>(clockNs - rxEndNs);
+                if (stats.rxLatency > stats.rxLatencyMax) stats.rxLatencyMax = stats.rxLatency;
+                rxEndNs = 0;
+            }
+        }
+        return byte;
+    }
+
+    void Chip::fifoClear() {
+        fifoHead = 0;
+        fifoCount = 0;
+        flags2 &= ~(RF_IRQFLAGS2_PAYLOADREADY | RF_IRQFLAGS2_CRCOK);
+        rxEndNs = 0;
+    }
+
+    uint8_t Chip::irqFlags1() const {
+        switch (faultMode) {
+            case Fault::StuckPreamble: return flags1 | RF_IRQFLAGS1_PREAMBLEDETECT;
+            case Fault::PllUnlock: return flags1 & ~RF_IRQFLAGS1_PLLLOCK;
+            default: return flags1;
+        }
+    }
+
+    uint8_t Chip::irqFlags2() const {
+        uint8_t flags = flags2;
+        if (fifoCount >= SIM_FIFO_SIZE) flags |= RF_IRQFLAGS2_FIFOFULL;
+        if (!fifoCount) flags |= RF_IRQFLAGS2_FIFOEMPTY;
+        if (fifoCount > fifoThreshold()) flags |= RF_IRQFLAGS2_FIFOLEVEL;
+        return flags;
+    }
+
+    uint64_t Chip::byteTimeNs() const {
+        // Bitrate = FXOSC / BitRate(15:0), 8 bits per byte: 8e9 / (32e6 / br) = 250 * br
+        uint32_t br = (regs[REG_BITRATEMSB] << 8) | regs[REG_BITRATELSB];
+        return br ? 250ULL * br : 250ULL;
+    }
+
+    uint32_t Chip::frequency() const {
+        uint32_t frf = (regs[REG_FRFMSB] << 16) | (regs[REG_FRFMID] << 8) | regs[REG_FRFLSB];
+        return static_cast<uint32_t>((static_cast<uint64_t>(frf) * FXOSC) >> 19);
+    }
+
+    bool Chip::dio(uint8_t pin) {
+        sync();
+        return dioLevel(pin);
+    }
+
+    bool Chip::dioLevel(uint8_t pin) const {
+        uint8_t f1 = irqFlags1();
+        uint8_t f2 = irqFlags2();
+        uint8_t map1 = regs[REG_DIOMAPPING1];
+        uint8_t map2 = regs[REG_DIOMAPPING2];
+        bool tx = (regs[REG_OPMODE] & ~RF_OPMODE_MASK) == RF_OPMODE_TRANSMITTER;
+
+        switch (pin) {
+            case 0:
+                switch (map1 >> 6) {
+                    case 0b00: return tx ? f2 & RF_IRQFLAGS2_PACKETSENT : f2 & RF_IRQFLAGS2_PAYLOADREADY;
+                    case 0b01: return !tx && (f2 & RF_IRQFLAGS2_CRCOK);
+                    default: return false;
+                }
+            case 1:
+                switch ((map1 >> 4) & 0x03) {
+                    case 0b00: return f2 & RF_IRQFLAGS2_FIFOLEVEL;
+                    case 0b01: return f2 & RF_IRQFLAGS2_FIFOEMPTY;
+                    case 0b10: return f2 & RF_IRQFLAGS2_FIFOFULL;
+                    default: return false;
+                }
+            case 2:
+                switch ((map1 >> 2) & 0x03) {
+                    case 0b00: return f2 & RF_IRQFLAGS2_FIFOFULL;
+                    case 0b01: return f1 & RF_IRQFLAGS1_RXREADY;
+                    case 0b10: return f1 & RF_IRQFLAGS1_TIMEOUT;
+                    default: return f1 & RF_IRQFLAGS1_SYNCADDRESSMATCH;
+                }
+            case 3:
+                switch (map1 & 0x03) {
+                    case 0b00: return f2 & RF_IRQFLAGS2_FIFOEMPTY;
+                    case 0b01: return f1 & RF_IRQFLAGS1_TXREADY;
+                    default: return false;
+                }
+            case 4:
+                switch (map2 >> 6) {
+                    case 0b01: return f1 & RF_IRQFLAGS1_PLLLOCK;
+                    case 0b10: return f1 & RF_IRQFLAGS1_TIMEOUT;
+                    case 0b11: return (map2 & RF_DIOMAPPING2_MAP_PREAMBLEDETECT) ? f1 & RF_IRQFLAGS1_PREAMBLEDETECT : f1 & RF_IRQFLAGS1_RSSI;
+                    default: return false;
+                }
+            case 5:
+                switch ((map2 >> 4) & 0x03) {
+                    case 0b01: return f1 & RF_IRQFLAGS1_PLLLOCK;
+                    case 0b11: return f1 & RF_IRQFLAGS1_MODEREADY;
+                    default: return false;
+                }
+            default:
+                return false;
+        }
+    }
+}
+
+/*
+    SPI transport of the Radio:: API, routed to the model instead of the SX1276.
+    Everything above it in SX1276Helpers.cpp (registers init, carrier, modes, dump) is shared.
+*/
+namespace Radio {
+    void initHardware() {
+        Sim::chip().reset();
+        writeByte(REG_OPMODE, RF_OPMODE_STANDBY); // Put Radio in Standby mode
+        printf("\nRadio Chip is ready (simulated)\n");
+    }
+
+    void resetHardware() {
+        Sim::chip().reset();
+        Sim::chip().advance(5100000); // NRESET pulse and POR wait
+    }
+
+    void readBytes(uint8_t regAddr, uint8_t *out, uint8_t len) {
+        Sim::chip().readBytes(regAddr, out, len);
+    }
+
+    bool writeBytes(uint8_t regAddr, uint8_t *in, uint8_t len, bool check) {
+        Sim::chip().writeBytes(regAddr, in, len);
+
+        if (check && regAddr != REG_FIFO) {
+            // One burst read back, as long as the longest write
+            uint8_t getBytes[UINT8_MAX + 1];
+            Sim::chip().readBytes(regAddr, getBytes, len);
+            if (memcmp(in, getBytes, len) != 0)
+                return false;
+        }
+
+        return true;
+    }
+}
+#endif
@@ -106,6 +106,10 @@ namespace TimersUS {
         // }
     }
 
+    bool TickerUsESP32::stopDelay() {
+        return _timer_delayed && esp_timer_stop(_timer_delayed) == ESP_OK;
+    }
+
     /**
     * @brief Check if ESP timer is active. This is used to prevent an attacker from trying to re - start the timer when it's time to do something other than reset it to the default value.
     * @return True if timer is active false otherwise ( no timer
@@ -1092,4 +1092,12 @@ int main(int argc, char **argv) {
   }
   return EXIT_SUCCESS;
 }
-}
\ No newline at end of file
+}
+
+#if defined(REGS_DECODER)
+// Host side decoder of the line printed by the `dump` command
+// g++ -DREGS_DECODER -o regs src/debug_resisters.cpp && ./regs "0x00,0x09,0x1a,..."
+int main(int argc, char **argv) {
+  return Radio::main(argc, argv);
+}
+#endif
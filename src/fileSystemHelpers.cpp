@@ -108,4 +108,44 @@ void rm(const char *fname) {
       return;
     }
     LittleFS.remove(fname);
-}
\ No newline at end of file
+}
+
+/**
+ * The function `writeBlob` stores a binary buffer in a file, replacing its previous content.
+ * 
+ * @param fname Name of the file.
+ * @param data Buffer to store.
+ * @param size Size of the buffer.
+ * 
+ * @return true if all the bytes were written.
+ */
+bool writeBlob(const char *fname, const uint8_t *data, size_t size) {
+    File file = LittleFS.open(fname, "w");
+    if (!file) {
+      Serial.printf("Failed to open %s for writing\n", fname);
+      return false;
+    }
+    size_t written = file.write(data, size);
+    file.close();
+    return written == size;
+}
+
+/**
+ * The function `readBlob` reads back a binary buffer stored by `writeBlob`.
+ * 
+ * @param fname Name of the file.
+ * @param data Buffer to fill.
+ * @param size Size of the buffer.
+ * 
+ * @return Number of bytes read, 0 if the file does not exist.
+ */
+size_t readBlob(const char *fname, uint8_t *data, size_t size) {
+    if (!LittleFS.exists(fname)) {
+      Serial.printf("File %s does not exists\n\n", fname);
+      return 0;
+    }
+    File file = LittleFS.open(fname, "r");
+    size_t read = file.read(data, size);
+    file.close();
+    return read;
+}
@@ -14,6 +14,16 @@
    limitations under the License.
  */
 #include <fileSystemHelpers.h>
+#include <iohcAuth1W.h>
+#include <iohcCapture.h>
+#include <iohcChallenge.h>
+#include <iohcCryptoBench.h>
+#include <iohcCryptoHelpers.h>
+#include <iohcDispatch.h>
+#include <iohcPcap.h>
+#include <iohcSequence.h>
+#include <iohcSniffer.h>
+#include <iohcTransaction.h>
 #include <iohcRemote1W.h>
 #include <iohcCozyDevice2W.h>
 #include <iohcOtherDevice2W.h>
@@ -115,11 +125,120 @@ void createCommands() {
     Cmd::addHandler((char *) "pairMode", (char *) "pairMode", [](Tokens *cmd)-> void { pairMode = !pairMode; });
 
     // Utils
-    Cmd::addHandler((char *) "dump", (char *) "Dump Transceiver registers", [](Tokens *cmd)-> void {
-        Radio::dump();
+    Cmd::addHandler((char *) "dump", (char *) "Dump Transceiver registers, decode to decode them here", [](Tokens *cmd)-> void {
+        Radio::dump(cmd->size() > 1 && cmd->at(1) == "decode");
 //        Serial.printf("*%d packets in memory\t", nextPacket);
 //        Serial.printf("*%d devices discovered\n\n", sysTable->size());
     });
+    Cmd::addHandler((char *) "regSave", (char *) "Save Transceiver registers as baseline", [](Tokens *cmd)-> void {
+        uint8_t regs[RADIO_REGS_SIZE];
+        Radio::snapshot(regs);
+        if (writeBlob(RADIO_REGS_BASELINE, regs, sizeof(regs)))
+            printf("Baseline saved to %s\n", RADIO_REGS_BASELINE);
+    });
+    Cmd::addHandler((char *) "regDiff", (char *) "Transceiver registers changed from baseline", [](Tokens *cmd)-> void {
+        uint8_t regs[RADIO_REGS_SIZE];
+        Radio::snapshot(regs);
+        uint8_t baseline[RADIO_REGS_SIZE];
+        if (readBlob(RADIO_REGS_BASELINE, baseline, sizeof(baseline)) != sizeof(baseline)) return;
+        Radio::diff(baseline, regs);
+    });
+    Cmd::addHandler((char *) "radioWd", (char *) "Radio watchdog checks, recoveries and latency", [](Tokens *cmd)-> void {
+        IOHC::iohcRadio::getInstance()->watchdog.dump();
+    });
+    Cmd::addHandler((char *) "capture", (char *) "Frames capture on/off, stats without argument", [](Tokens *cmd)-> void {
+        auto *capture = IOHC::iohcCapture::getInstance();
+        if (cmd->size() > 1) capture->setEnabled(cmd->at(1) == "on");
+        const auto &stats = capture->getStats();
+        printf("Capture %s: %u queued %u dropped %u written\n", capture->isEnabled() ? "on" : "off",
+               stats.queued, stats.dropped, stats.written);
+    });
+    Cmd::addHandler((char *) "capDump", (char *) "Export captured frames, last n only if given", [](Tokens *cmd)-> void {
+        IOHC::iohcCapture::getInstance()->dump(cmd->size() > 1 ? strtoul(cmd->at(1).c_str(), nullptr, 10) : 0);
+    });
+    Cmd::addHandler((char *) "capClear", (char *) "Erase captured frames", [](Tokens *cmd)-> void {
+        IOHC::iohcCapture::getInstance()->clear();
+    });
+    Cmd::addHandler((char *) "capPcap", (char *) "Export captured frames as pcapng, for tools/iohc2pcapng", [](Tokens *cmd)-> void {
+        IOHC::PcapWriter pcap(IOHC::printPcapBlock);
+        printf("-----BEGIN IOHC PCAPNG-----\n");
+        pcap.begin();
+        IOHC::iohcCapture::getInstance()->forEach(cmd->size() > 1 ? strtoul(cmd->at(1).c_str(), nullptr, 10) : 0,
+                                                  [&pcap](const IOHC::CaptureRecord &rec) { pcap.frame(rec); });
+        printf("-----END IOHC PCAPNG-----\n");
+    });
+    Cmd::addHandler((char *) "sniffer", (char *) "Binary frames stream on/off [baud], see tools/iohcsniff", [](Tokens *cmd)-> void {
+        auto *sniffer = IOHC::iohcSniffer::getInstance();
+        auto *radio = IOHC::iohcRadio::getInstance();
+        if (cmd->size() > 1 && cmd->at(1) == "on") {
+            uint32_t baud = cmd->size() > 2 ? strtoul(cmd->at(2).c_str(), nullptr, 10) : SNIFFER_BAUD;
+            if (!baud) {
+                printf("Sniffer: %s is not a baud rate\n", cmd->at(2).c_str());
+                return;
+            }
+            // Decoded lines would only slow the stream down, they are dropped by the receiver anyway
+            if (sniffer->start(baud)) radio->printFrames = false;
+        } else if (cmd->size() > 1 && cmd->at(1) == "off") {
+            sniffer->stop();
+            radio->printFrames = true;
+        } else {
+            const auto &stats = sniffer->getStats();
+            printf("Sniffer %s: %u sent %u dropped, backlog max %u bytes (%u us)\n", sniffer->isRunning() ? "on" : "off",
+                   stats.sent, stats.dropped, stats.maxBacklog, sniffer->maxLatencyUs());
+        }
+    });
+    Cmd::addHandler((char *) "decode", (char *) "Decoded frames on the console on/off", [](Tokens *cmd)-> void {
+        auto *radio = IOHC::iohcRadio::getInstance();
+        radio->printFrames = cmd->size() > 1 ? cmd->at(1) == "on" : !radio->printFrames;
+        printf("Decoded frames %s\n", radio->printFrames ? "on" : "off");
+    });
+    Cmd::addHandler((char *) "crcCheck", (char *) "Frame CRC checked in software instead of by radio, on/off", [](Tokens *cmd)-> void {
+        auto *radio = IOHC::iohcRadio::getInstance();
+        if (cmd->size() > 1) radio->softwareCrc(cmd->at(1) == "on");
+        const auto &stats = radio->crcStats();
+        printf("Software CRC %s: %u checked, %u failed, %u dropped without CRC\n", radio->softwareCrc() ? "on" : "off",
+               stats.checked, stats.failed, stats.unchecked);
+    });
+    Cmd::addHandler((char *) "ahead", (char *) "1W MACs computed ahead on/off, press latency without arg", [](Tokens *cmd)-> void {
+        auto *remote = IOHC::iohcRemote1W::getInstance();
+        if (cmd->size() > 1) remote->computeAhead(cmd->at(1) == "on");
+        const auto &stats = remote->pressStats();
+        printf("1W MACs ahead %s, %u computed at idle\n", remote->computeAhead() ? "on" : "off", stats.macsAhead);
+        printf("Press to frame queued: %u ready %.1f us avg, %u computed %.1f us avg, max %u us\n",
+               stats.ahead, stats.ahead ? 1.0 * stats.aheadUs / stats.ahead : 0.0,
+               stats.computed, stats.computed ? 1.0 * stats.computedUs / stats.computed : 0.0, stats.maxUs);
+    });
+    Cmd::addHandler((char *) "auth", (char *) "1W frames received by MAC verdict, last ones", [](Tokens *cmd)-> void {
+        IOHC::iohcAuth1W::getInstance()->print();
+    });
+    Cmd::addHandler((char *) "sequences", (char *) "1W sequence windows per remote, received and sent, drift", [](Tokens *cmd)-> void {
+        IOHC::iohcSequences::getInstance()->print();
+    });
+    Cmd::addHandler((char *) "challenges", (char *) "2W challenges per peer, answers, batches and latency", [](Tokens *cmd)-> void {
+        IOHC::iohcChallenges::getInstance()->print();
+    });
+    Cmd::addHandler((char *) "rxStats", (char *) "Received frames and handler time per command, reset", [](Tokens *cmd)-> void {
+        auto *dispatcher = IOHC::iohcDispatcher::getInstance();
+        if (cmd->size() > 1 && cmd->at(1) == "reset") dispatcher->resetStats();
+        else dispatcher->printStats();
+    });
+    Cmd::addHandler((char *) "sessions", (char *) "2W exchanges per peer and their state", [](Tokens *cmd)-> void {
+        IOHC::iohcTransactions::getInstance()->print();
+    });
+    Cmd::addHandler((char *) "keyBench", (char *) "HMAC and challenge answer with/without key cache, rounds", [](Tokens *cmd)-> void {
+        uint32_t rounds = cmd->size() > 1 ? strtoul(cmd->at(1).c_str(), nullptr, 10) : 1000;
+        if (!rounds) rounds = 1000;
+        iohcCrypto::benchKeyCache(rounds);
+    });
+    Cmd::addHandler((char *) "aesBench", (char *) "Check AES backends on known answers and time them, blocks", [](Tokens *cmd)-> void {
+        uint32_t blocks = cmd->size() > 1 ? strtoul(cmd->at(1).c_str(), nullptr, 10) : 2000;
+        if (iohcCrypto::aesSelfTest()) iohcCrypto::aesBench(blocks);
+    });
+    Cmd::addHandler((char *) "cryptoBench", (char *) "Time each crypto primitive and protocol operation, rounds", [](Tokens *cmd)-> void {
+        uint32_t rounds = cmd->size() > 1 ? strtoul(cmd->at(1).c_str(), nullptr, 10) : 1000;
+        if (!rounds) rounds = 1000;
+        if (iohcCrypto::cryptoSelfTest()) iohcCrypto::cryptoBench(rounds);
+    });
     /*    
     //    Cmd::addHandler((char *)"dump2", (char *)"Dump Transceiver registers 1Col", [](Tokens*cmd)->void {Radio::dump2(); Serial.printf("*%d packets in memory\t", nextPacket); Serial.printf("*%d devices discovered\n\n", sysTable->size());});
     Cmd::addHandler((char *) "list1W", (char *) "List received packets", [](Tokens *cmd)-> void {
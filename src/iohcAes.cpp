@@ -0,0 +1,324 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <cstdio>
+#include <cstring>
+
+#include <iohcAes.h>
+
+#if defined(ESP32)
+    #include <Arduino.h>
+    #include <esp_timer.h>
+#else
+    #include <chrono>
+    #if defined(__x86_64__) || defined(__i386__)
+        #include <x86intrin.h>
+    #endif
+#endif
+
+namespace iohcCrypto {
+    namespace {
+        constexpr uint8_t xtime(uint8_t x) { return x << 1 ^ (x & 0x80 ? 0x1b : 0); }
+
+        constexpr uint8_t gmul(uint8_t a, uint8_t b) {
+            uint8_t r = 0;
+            for (; b; b >>= 1, a = xtime(a))
+                if (b & 1) r ^= a;
+            return r;
+        }
+
+        // S-box and T-table computed at build time, they land in flash like the literal tables they replace
+        struct Tables {
+            uint8_t sbox[256];
+            uint32_t te[256];       // Column (2s, s, s, 3s), the three other columns are its rotations
+        };
+
+        constexpr Tables makeTables() {
+            Tables t{};
+            for (int x = 0; x < 256; x++) {
+                uint8_t inv = 0;
+                for (int y = 1; y < 256 && x; y++)
+                    if (gmul(x, y) == 1) { inv = y; break; }
+                uint8_t s = inv;
+                for (int i = 1; i < 5; i++) s ^= static_cast<uint8_t>(inv << i | inv >> (8 - i));
+                s ^= 0x63;
+                t.sbox[x] = s;
+                t.te[x] = static_cast<uint32_t>(xtime(s)) << 24 | s << 16 | s << 8 | (xtime(s) ^ s);
+            }
+            return t;
+        }
+
+        constexpr Tables tables = makeTables();
+        static_assert(tables.sbox[0x00] == 0x63 && tables.sbox[0x53] == 0xed && tables.sbox[0xff] == 0x16);
+
+        inline uint32_t load32(const uint8_t *p) { return p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3]; }
+        inline void store32(uint8_t *p, uint32_t w) {
+            p[0] = w >> 24;
+            p[1] = w >> 16;
+            p[2] = w >> 8;
+            p[3] = w;
+        }
+        inline uint32_t ror32(uint32_t w, int n) { return w >> n | w << (32 - n); }
+        inline uint32_t rol32(uint32_t w, int n) { return w << n | w >> (32 - n); }
+
+        template<typename SubWord>
+        void expandWith(AesRoundKeys &schedule, const uint8_t *key, SubWord subWord) {
+            uint32_t *rk = schedule.rk;
+            for (int i = 0; i < 4; i++) rk[i] = load32(key + 4 * i);
+            uint8_t rcon = 0x01;
+            for (int i = 4; i < 44; i++) {
+                uint32_t t = rk[i - 1];
+                if (i % 4 == 0) {
+                    t = subWord(rol32(t, 8)) ^ static_cast<uint32_t>(rcon) << 24;
+                    rcon = xtime(rcon);
+                }
+                rk[i] = rk[i - 4] ^ t;
+            }
+        }
+
+        uint32_t tableSubWord(uint32_t w) {
+            const uint8_t *s = tables.sbox;
+            return s[w >> 24] << 24 | s[w >> 16 & 0xff] << 16 | s[w >> 8 & 0xff] << 8 | s[w & 0xff];
+        }
+
+        // Four bytes at once in a word, no branch nor memory access depending on them
+        inline uint32_t xtime4(uint32_t w) { return (w & 0x7f7f7f7f) << 1 ^ (w >> 7 & 0x01010101) * 0x1b; }
+
+        inline uint32_t mul4(uint32_t a, uint32_t b) {
+            uint32_t r = 0;
+            for (int i = 0; i < 8; i++) {
+                r ^= a & (b >> i & 0x01010101) * 0xff;
+                a = xtime4(a);
+            }
+            return r;
+        }
+
+        inline uint32_t rotBytes4(uint32_t w, int n) {
+            return (w << n & ((0xffu << n & 0xff) * 0x01010101)) | (w >> (8 - n) & ((1u << n) - 1) * 0x01010101);
+        }
+
+        // The S-box computed: inverse as x^254 (0 stays 0), then the affine transform
+        uint32_t portableSubWord(uint32_t x) {
+            uint32_t y = mul4(x, x);
+            uint32_t z = y;
+            for (int i = 0; i < 6; i++) {
+                y = mul4(y, y);
+                z = mul4(z, y);
+            }
+            return z ^ rotBytes4(z, 1) ^ rotBytes4(z, 2) ^ rotBytes4(z, 3) ^ rotBytes4(z, 4) ^ 0x63636363;
+        }
+    }
+
+    void AesTTable::expand(Schedule &schedule, const uint8_t *key) {
+        expandWith(schedule, key, tableSubWord);
+    }
+
+/**
+ * The function `encrypt` of the T-table backend does SubBytes, ShiftRows and MixColumns of a column in four
+ * lookups of one 1 KiB table, rotated for the rows, instead of the byte operations of each step.
+ */
+    void AesTTable::encrypt(const Schedule &schedule, const uint8_t *in, uint8_t *out) {
+        const uint32_t *rk = schedule.rk;
+        const uint32_t *te = tables.te;
+        uint32_t s0 = load32(in) ^ rk[0], s1 = load32(in + 4) ^ rk[1];
+        uint32_t s2 = load32(in + 8) ^ rk[2], s3 = load32(in + 12) ^ rk[3];
+
+        for (int round = 1; round < 10; round++) {
+            rk += 4;
+            uint32_t t0 = te[s0 >> 24] ^ ror32(te[s1 >> 16 & 0xff], 8) ^ ror32(te[s2 >> 8 & 0xff], 16) ^ ror32(te[s3 & 0xff], 24) ^ rk[0];
+            uint32_t t1 = te[s1 >> 24] ^ ror32(te[s2 >> 16 & 0xff], 8) ^ ror32(te[s3 >> 8 & 0xff], 16) ^ ror32(te[s0 & 0xff], 24) ^ rk[1];
+            uint32_t t2 = te[s2 >> 24] ^ ror32(te[s3 >> 16 & 0xff], 8) ^ ror32(te[s0 >> 8 & 0xff], 16) ^ ror32(te[s1 & 0xff], 24) ^ rk[2];
+            uint32_t t3 = te[s3 >> 24] ^ ror32(te[s0 >> 16 & 0xff], 8) ^ ror32(te[s1 >> 8 & 0xff], 16) ^ ror32(te[s2 & 0xff], 24) ^ rk[3];
+            s0 = t0;
+            s1 = t1;
+            s2 = t2;
+            s3 = t3;
+        }
+
+        // Last round without MixColumns
+        const uint8_t *s = tables.sbox;
+        rk += 4;
+        store32(out, (s[s0 >> 24] << 24 | s[s1 >> 16 & 0xff] << 16 | s[s2 >> 8 & 0xff] << 8 | s[s3 & 0xff]) ^ rk[0]);
+        store32(out + 4, (s[s1 >> 24] << 24 | s[s2 >> 16 & 0xff] << 16 | s[s3 >> 8 & 0xff] << 8 | s[s0 & 0xff]) ^ rk[1]);
+        store32(out + 8, (s[s2 >> 24] << 24 | s[s3 >> 16 & 0xff] << 16 | s[s0 >> 8 & 0xff] << 8 | s[s1 & 0xff]) ^ rk[2]);
+        store32(out + 12, (s[s3 >> 24] << 24 | s[s0 >> 16 & 0xff] << 16 | s[s1 >> 8 & 0xff] << 8 | s[s2 & 0xff]) ^ rk[3]);
+    }
+
+    void AesPortable::expand(Schedule &schedule, const uint8_t *key) {
+        expandWith(schedule, key, portableSubWord);
+    }
+
+/**
+ * The function `encrypt` of the portable backend computes the S-box in GF(2^8) on a column at a time and
+ * never indexes memory with the data, so its time does not depend on the key nor on the block.
+ */
+    void AesPortable::encrypt(const Schedule &schedule, const uint8_t *in, uint8_t *out) {
+        const uint32_t *rk = schedule.rk;
+        uint32_t s[4], t[4];
+        for (int c = 0; c < 4; c++) s[c] = load32(in + 4 * c) ^ rk[c];
+
+        for (int round = 1; round <= 10; round++) {
+            for (uint32_t &column: s) column = portableSubWord(column);
+            // ShiftRows, row r of a column comes from the column r further
+            for (int c = 0; c < 4; c++)
+                t[c] = (s[c] & 0xff000000) | (s[(c + 1) & 3] & 0x00ff0000) | (s[(c + 2) & 3] & 0x0000ff00) | (s[(c + 3) & 3] & 0x000000ff);
+            if (round < 10)
+                for (uint32_t &column: t) {
+                    uint32_t r1 = rol32(column, 8);
+                    column = xtime4(column ^ r1) ^ r1 ^ rol32(column, 16) ^ rol32(column, 24);
+                }
+            for (int c = 0; c < 4; c++) s[c] = t[c] ^ rk[4 * round + c];
+        }
+        for (int c = 0; c < 4; c++) store32(out + 4 * c, s[c]);
+    }
+
+#if defined(ESP32)
+    // A context expanded again is freed first, mbedtls_aes_free takes a zeroed one as well
+    void AesHardware::expand(Schedule &schedule, const uint8_t *key) {
+        mbedtls_aes_free(&schedule);
+        mbedtls_aes_init(&schedule);
+        mbedtls_aes_setkey_enc(&schedule, key, 128);
+    }
+
+    void AesHardware::release(Schedule &schedule) {
+        mbedtls_aes_free(&schedule);
+    }
+
+    void AesHardware::encrypt(const Schedule &schedule, const uint8_t *in, uint8_t *out) {
+        // The peripheral is loaded from the context, which is not changed
+        mbedtls_aes_crypt_ecb(const_cast<Schedule *>(&schedule), MBEDTLS_AES_ENCRYPT, in, out);
+    }
+#endif
+
+    namespace {
+        struct KnownAnswer {
+            uint8_t key[16];
+            uint8_t plain[16];
+            uint8_t cipher[16];
+        };
+
+        // FIPS-197 appendices B and C.1, SP 800-38A F.1.1 (ECB-AES128)
+        const KnownAnswer knownAnswers[] = {
+            {{0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c},
+             {0x32, 0x43, 0xf6, 0xa8, 0x88, 0x5a, 0x30, 0x8d, 0x31, 0x31, 0x98, 0xa2, 0xe0, 0x37, 0x07, 0x34},
+             {0x39, 0x25, 0x84, 0x1d, 0x02, 0xdc, 0x09, 0xfb, 0xdc, 0x11, 0x85, 0x97, 0x19, 0x6a, 0x0b, 0x32}},
+            {{0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f},
+             {0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff},
+             {0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30, 0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a}},
+            {{0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c},
+             {0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a},
+             {0x3a, 0xd7, 0x7b, 0xb4, 0x0d, 0x7a, 0x36, 0x60, 0xa8, 0x9e, 0xca, 0xf3, 0x24, 0x66, 0xef, 0x97}},
+            {{0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c},
+             {0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51},
+             {0xf5, 0xd3, 0xd5, 0x85, 0x03, 0xb9, 0x69, 0x9d, 0xe7, 0x85, 0x89, 0x5a, 0x96, 0xfd, 0xba, 0xaf}},
+            {{0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c},
+             {0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11, 0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef},
+             {0x43, 0xb1, 0xcd, 0x7f, 0x59, 0x8e, 0xce, 0x23, 0x88, 0x1b, 0x00, 0xe3, 0xed, 0x03, 0x06, 0x88}},
+            {{0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c},
+             {0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17, 0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10},
+             {0x7b, 0x0c, 0x78, 0x5e, 0x27, 0xe8, 0xad, 0x3f, 0x82, 0x23, 0x20, 0x71, 0x04, 0x72, 0x5d, 0xd4}},
+        };
+
+        template<typename Backend>
+        bool check() {
+            bool ok = true;
+            for (size_t v = 0; v < sizeof(knownAnswers) / sizeof(knownAnswers[0]); v++) {
+                const KnownAnswer &known = knownAnswers[v];
+                typename Backend::Schedule schedule{};
+                Backend::expand(schedule, known.key);
+                uint8_t block[16];
+                Backend::encrypt(schedule, known.plain, block);
+                bool same = !memcmp(block, known.cipher, 16);
+                // In place as the callers do
+                memcpy(block, known.plain, 16);
+                Backend::encrypt(schedule, block, block);
+                same &= !memcmp(block, known.cipher, 16);
+                if (!same) printf("AES %s: known answer %u failed\n", Backend::name, static_cast<unsigned>(v));
+                ok &= same;
+                Backend::release(schedule);
+            }
+            return ok;
+        }
+
+        uint64_t benchNow() {
+        #if defined(ESP32)
+            return esp_timer_get_time() * 1000;
+        #else
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        #endif
+        }
+
+        uint64_t cycles() {
+        #if !defined(ESP32) && (defined(__x86_64__) || defined(__i386__))
+            return __rdtsc();
+        #else
+            return 0;
+        #endif
+        }
+
+        uint32_t cpuMhz() {
+        #if defined(ESP32)
+            return getCpuFrequencyMhz();
+        #else
+            return 0;
+        #endif
+        }
+
+        // Blocks chained, each one the input of the next, as latency matters more than throughput here
+        template<typename Backend>
+        void bench(uint32_t blocks) {
+            auto *schedule = new typename Backend::Schedule{};
+            uint8_t block[16] = {};
+            uint64_t start = benchNow();
+            for (uint32_t i = 0; i < blocks / 16 + 1; i++) Backend::expand(*schedule, knownAnswers[i & 1].key);
+            double expandNs = static_cast<double>(benchNow() - start) / (blocks / 16 + 1);
+
+            start = benchNow();
+            uint64_t startCycles = cycles();
+            for (uint32_t i = 0; i < blocks; i++) Backend::encrypt(*schedule, block, block);
+            uint64_t elapsedCycles = cycles() - startCycles;
+            double ns = static_cast<double>(benchNow() - start) / blocks;
+            double perBlock = elapsedCycles ? static_cast<double>(elapsedCycles) / blocks : ns * cpuMhz() / 1000;
+            printf("%-9s %9.1f ns/block %9.0f cycles/block %9.1f ns/key (%02x)\n", Backend::name, ns, perBlock, expandNs, block[0]);
+            Backend::release(*schedule);
+            delete schedule;
+        }
+    }
+
+    bool aesSelfTest() {
+        bool ok = check<AesTTable>();
+        ok &= check<AesPortable>();
+    #if defined(ESP32)
+        ok &= check<AesHardware>();
+    #endif
+        printf("AES known answers %s, %s backend in use\n", ok ? "ok" : "FAILED", AesBackend::name);
+        return ok;
+    }
+
+/**
+ * The function `aesBench` times every backend compiled. Cycles are read from the TSC on x86 hosts and
+ * derived from the CPU frequency on the ESP32.
+ */
+    void aesBench(uint32_t blocks) {
+        if (!blocks) return;
+        bench<AesTTable>(blocks);
+        bench<AesPortable>(blocks);
+    #if defined(ESP32)
+        bench<AesHardware>(blocks);
+    #endif
+    }
+}
@@ -0,0 +1,203 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <cstdio>
+#include <cstring>
+
+#include <iohcAuth1W.h>
+#include <iohcFrame.h>
+#include <iohcSequence.h>
+
+namespace IOHC {
+    iohcAuth1W *iohcAuth1W::_iohcAuth1W = nullptr;
+
+    namespace {
+        constexpr const char *verdictNames[] = {"authentic", "replay", "forged", "unknown key"};
+        static_assert(sizeof(verdictNames) / sizeof(verdictNames[0]) == static_cast<uint8_t>(AuthVerdict::Count));
+    }
+
+    const char *authVerdictName(AuthVerdict verdict) {
+        return verdict < AuthVerdict::Count ? verdictNames[static_cast<uint8_t>(verdict)] : "?";
+    }
+
+    iohcAuth1W *iohcAuth1W::getInstance() {
+        if (!_iohcAuth1W)
+            _iohcAuth1W = new iohcAuth1W();
+        return _iohcAuth1W;
+    }
+
+/**
+ * The function `begin` makes the queue and starts the verifier task, below the radio task so that
+ * reception is never held by a verification.
+ */
+    bool iohcAuth1W::begin() {
+        if (ready) return true;
+    #if defined(ESP32)
+        mutex = xSemaphoreCreateMutex();
+        queue = xQueueCreate(IOHC_AUTH_QUEUE_LEN, sizeof(QueuedFrame));
+        if (!queue || !mutex) {
+            printf("1W auth: no memory for the queue\n");
+            return false;
+        }
+        if (xTaskCreatePinnedToCore(verifierTask, "auth_verifier", 4096, this, tskIDLE_PRIORITY + 2, nullptr, tskNO_AFFINITY) != pdPASS) {
+            printf("1W auth: can't start verifier\n");
+            return false;
+        }
+    #endif
+        ready = true;
+        return true;
+    }
+
+    iohcAuth1W::KnownKey *iohcAuth1W::find(const address node) {
+        for (auto &known: keys)
+            if (known.used && !memcmp(known.node, node, sizeof(address))) return &known;
+        return nullptr;
+    }
+
+    bool iohcAuth1W::setKey(const address node, const uint8_t *key, iohcCrypto::KeyKind kind) {
+        lock();
+        KnownKey *known = find(node);
+        if (!known)
+            for (auto &free: keys)
+                if (!free.used) {
+                    known = &free;
+                    break;
+                }
+        if (known) {
+            known->used = true;
+            known->kind = kind;
+            memcpy(known->node, node, sizeof(address));
+            memcpy(known->key, key, sizeof(known->key));
+        }
+        unlock();
+        if (!known) printf("1W auth: no room for the key of %02X%02X%02X\n", node[0], node[1], node[2]);
+        return known != nullptr;
+    }
+
+    void iohcAuth1W::forget(const address node) {
+        lock();
+        if (KnownKey *known = find(node)) known->used = false;
+        unlock();
+    }
+
+/**
+ * The function `submit` queues a copy of a 1W frame carrying a MAC for the verifier. It is called on
+ * the radio task: when the queue is full the frame is counted as dropped, never waited for.
+ */
+    void iohcAuth1W::submit(const iohcPacket &packet) {
+        if (!ready) return;
+        FrameView view(packet);
+        if (!view.oneWay() || !view.has(Field::Hmac)) return;
+
+    #if defined(ESP32)
+        QueuedFrame queued;
+        queued.length = packet.buffer_length < MAX_FRAME_LEN ? packet.buffer_length : MAX_FRAME_LEN;
+        memcpy(queued.frame, packet.payload.buffer, queued.length);
+        if (xQueueSend(queue, &queued, 0) != pdTRUE) {
+            stats.dropped += 1;
+            return;
+        }
+        stats.queued += 1;
+        uint32_t waiting = uxQueueMessagesWaiting(queue);
+        if (waiting > stats.maxQueued) stats.maxQueued = waiting;
+    #else
+        stats.queued += 1;
+        verify(packet.payload.buffer, packet.buffer_length, nullptr);
+    #endif
+    }
+
+/**
+ * The function `verify` computes the MAC of a frame again with the key of its source, over the bytes
+ * from the command to the sequence, and compares it in constant time. A right MAC with a sequence the
+ * window of the remote has seen, or older than the window, is a replay; the repeats of a frame, and the
+ * frames of one press sharing a sequence, carry the highest one and are authentic. A forged frame is
+ * kept out of the window, it would move it on.
+ *
+ * @return false if the frame is not a 1W frame with a MAC, result is then left as is.
+ */
+    bool iohcAuth1W::verify(const uint8_t *frame, uint8_t length, AuthResult *result) {
+        FrameView view(frame, length);
+        ByteView sequence = view.get(Field::Sequence);
+        ByteView mac = view.get(Field::Hmac);
+        if (!view.oneWay() || sequence.empty() || mac.empty()) return false;
+
+        AuthResult r{};
+        memcpy(r.source, view.header().source, sizeof(address));
+        r.cmd = view.cmd();
+        r.sequence = sequence.value();
+
+        lock();
+        KnownKey *known = find(r.source);
+        if (!known) {
+            r.verdict = AuthVerdict::UnknownKey;
+        } else {
+            const uint8_t *from = &view.header().cmd;
+            uint8_t iv[16];
+            uint8_t expected[16];
+            iohcCrypto::hmacInitialValue(iv, from, sequence.data - from, sequence.data);
+            iohcCrypto::encryptBlock(iohcCrypto::KeyId::of(known->kind, known->node), known->key, iv, expected);
+            uint8_t diff = 0;
+            for (uint8_t i = 0; i < mac.size; i++) diff |= expected[i] ^ mac.data[i];
+            r.verdict = diff ? AuthVerdict::Forged : AuthVerdict::Authentic;
+        }
+        // Without key the sequence is still followed, unauthenticated
+        if (r.verdict != AuthVerdict::Forged) {
+            SequenceVerdict window = iohcSequences::getInstance()->observe(r.source, r.sequence, Direction::Rx);
+            if (r.verdict == AuthVerdict::Authentic && window == SequenceVerdict::Replay) r.verdict = AuthVerdict::Replay;
+        }
+        stats.verdicts[static_cast<uint8_t>(r.verdict)] += 1;
+        recent[results++ % IOHC_AUTH_RECENT] = r;
+        unlock();
+
+        if (result) *result = r;
+        return true;
+    }
+
+#if defined(ESP32)
+    void iohcAuth1W::verifierTask(void *pvParameters) {
+        auto *auth = static_cast<iohcAuth1W *>(pvParameters);
+        QueuedFrame queued;
+        AuthResult result;
+        while (true) {
+            if (xQueueReceive(auth->queue, &queued, portMAX_DELAY) != pdTRUE) continue;
+            if (!auth->verify(queued.frame, queued.length, &result)) continue;
+            if (result.verdict == AuthVerdict::Replay || result.verdict == AuthVerdict::Forged)
+                printf("1W %s: %02X%02X%02X cmd %02X sequence %04X\n", authVerdictName(result.verdict),
+                       result.source[0], result.source[1], result.source[2], result.cmd, result.sequence);
+        }
+    }
+
+    void iohcAuth1W::lock() { xSemaphoreTake(mutex, portMAX_DELAY); }
+    void iohcAuth1W::unlock() { xSemaphoreGive(mutex); }
+#else
+    void iohcAuth1W::lock() {}
+    void iohcAuth1W::unlock() {}
+#endif
+
+    void iohcAuth1W::print() {
+        uint8_t count = 0;
+        for (const auto &known: keys) count += known.used;
+        printf("1W auth: %u keys, %u queued, %u dropped, queue max %u\n", count, stats.queued, stats.dropped, stats.maxQueued);
+        for (uint8_t v = 0; v < static_cast<uint8_t>(AuthVerdict::Count); v++)
+            printf("\t%-12s %u\n", authVerdictName(static_cast<AuthVerdict>(v)), stats.verdicts[v]);
+        uint32_t first = results > IOHC_AUTH_RECENT ? results - IOHC_AUTH_RECENT : 0;
+        for (uint32_t i = first; i < results; i++) {
+            const AuthResult &r = recent[i % IOHC_AUTH_RECENT];
+            printf("\t%02X%02X%02X cmd %02X sequence %04X %s\n", r.source[0], r.source[1], r.source[2], r.cmd, r.sequence,
+                   authVerdictName(r.verdict));
+        }
+    }
+}
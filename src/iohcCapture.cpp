@@ -0,0 +1,334 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <cstring>
+
+#include <iohcCapture.h>
+#include <iohcFormat.h>
+
+#if defined(ESP32)
+    #include <esp_timer.h>
+#else
+    #include <chrono>
+#endif
+
+namespace IOHC {
+    iohcCapture *iohcCapture::_iohcCapture = nullptr;
+
+    namespace {
+        constexpr uint16_t PAGE_RECORDS = CAPTURE_PAGE_SIZE / sizeof(CaptureRecord);
+
+        uint64_t captureTime() {
+        #if defined(ESP32)
+            return esp_timer_get_time();
+        #else
+            return std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        #endif
+        }
+
+        uint32_t recordOffset(uint32_t slot) {
+            return CAPTURE_DATA_OFFSET + slot * sizeof(CaptureRecord);
+        }
+    }
+
+#if defined(ESP32)
+/**
+ * The function `open` opens the ring file for random access, creating it filled with zeros (free
+ * records) when it does not exist or is too small.
+ */
+    bool CaptureFile::open(const char *path, size_t size) {
+        if (LittleFS.exists(path)) {
+            file = LittleFS.open(path, "r+");
+            if (file && file.size() >= size) return true;
+            file.close();
+            LittleFS.remove(path);
+        }
+        File created = LittleFS.open(path, "w");
+        if (!created) return false;
+        uint8_t zeros[256] = {};
+        for (size_t done = 0; done < size; done += sizeof(zeros))
+            created.write(zeros, sizeof(zeros));
+        created.close();
+        file = LittleFS.open(path, "r+");
+        return static_cast<bool>(file);
+    }
+
+    bool CaptureFile::read(uint32_t offset, void *data, size_t size) {
+        return file.seek(offset) && file.read(static_cast<uint8_t *>(data), size) == size;
+    }
+
+    bool CaptureFile::write(uint32_t offset, const void *data, size_t size) {
+        return file.seek(offset) && file.write(static_cast<const uint8_t *>(data), size) == size;
+    }
+
+    void CaptureFile::flush() { file.flush(); }
+    void CaptureFile::close() { file.close(); }
+#else
+    bool CaptureFile::open(const char *path, size_t size) {
+        file = fopen(path, "r+b");
+        if (file) {
+            fseek(file, 0, SEEK_END);
+            if (static_cast<size_t>(ftell(file)) >= size) return true;
+            fclose(file);
+        }
+        file = fopen(path, "w+b");
+        if (!file) return false;
+        uint8_t zeros[256] = {};
+        for (size_t done = 0; done < size; done += sizeof(zeros))
+            fwrite(zeros, 1, sizeof(zeros), file);
+        fflush(file);
+        return true;
+    }
+
+    bool CaptureFile::read(uint32_t offset, void *data, size_t size) {
+        return !fseek(file, offset, SEEK_SET) && fread(data, 1, size, file) == size;
+    }
+
+    bool CaptureFile::write(uint32_t offset, const void *data, size_t size) {
+        return !fseek(file, offset, SEEK_SET) && fwrite(data, 1, size, file) == size;
+    }
+
+    void CaptureFile::flush() { fflush(file); }
+    void CaptureFile::close() { if (file) fclose(file); file = nullptr; }
+#endif
+
+    iohcCapture *iohcCapture::getInstance() {
+        if (!_iohcCapture)
+            _iohcCapture = new iohcCapture();
+        return _iohcCapture;
+    }
+
+/**
+ * The function `begin` opens (or creates) the ring file, finds back the write position and starts
+ * the writer task.
+ *
+ * @param path Ring file on LittleFS.
+ * @param capacity Records in the ring. A file made for another capacity or format is recreated.
+ * @return true if the capture is running.
+ */
+    bool iohcCapture::begin(const char *path, uint32_t capacity) {
+        if (ready) return true;
+        if (!file.open(path, recordOffset(capacity))) {
+            printf("Capture: can't open %s\n", path);
+            return false;
+        }
+
+    #if defined(ESP32)
+        mutex = xSemaphoreCreateMutex();
+        queue = xQueueCreate(CAPTURE_QUEUE_LEN, sizeof(CaptureRecord));
+        if (!queue || !mutex) {
+            printf("Capture: no memory for the queue\n");
+            return false;
+        }
+    #endif
+
+        CaptureHeader expected{};
+        memcpy(expected.magic, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC));
+        expected.version = CAPTURE_VERSION;
+        expected.recordSize = sizeof(CaptureRecord);
+        expected.capacity = capacity;
+        header = expected;
+
+        CaptureHeader stored{};
+        file.read(0, &stored, sizeof(stored));
+        if (memcmp(&stored, &expected, sizeof(expected)) != 0) {
+            file.write(0, &header, sizeof(header));
+            clear();
+        } else {
+            recover();
+        }
+
+    #if defined(ESP32)
+        if (xTaskCreatePinnedToCore(writerTask, "capture_writer", 4096, this, tskIDLE_PRIORITY + 1, nullptr, tskNO_AFFINITY) != pdPASS) {
+            printf("Capture: can't start writer\n");
+            return false;
+        }
+    #endif
+        ready = true;
+        printf("Capture: %s %u records, next sequence %u\n", path, header.capacity, sequence);
+        return true;
+    }
+
+/**
+ * The function `recover` finds the last record written, the one with the highest sequence number,
+ * reading the ring a page at a time. The next record goes in the slot after it.
+ */
+    void iohcCapture::recover() {
+        uint32_t last = 0;
+        next = 0;
+        for (uint32_t slot = 0; slot < header.capacity; slot += PAGE_RECORDS) {
+            uint32_t count = header.capacity - slot < PAGE_RECORDS ? header.capacity - slot : PAGE_RECORDS;
+            if (!file.read(recordOffset(slot), page, count * sizeof(CaptureRecord))) break;
+            for (uint32_t i = 0; i < count; i++) {
+                if (page[i].sequence > last) {
+                    last = page[i].sequence;
+                    next = (slot + i + 1) % header.capacity;
+                }
+            }
+        }
+        sequence = last + 1;
+        pending = 0;
+    }
+
+/**
+ * The function `record` copies a frame into a capture record and queues it for the writer. It is
+ * called on the radio task: when the queue is full the frame is counted as dropped, never waited for.
+ */
+    void iohcCapture::record(const iohcPacket &packet, Direction direction) {
+        if (!ready || !enabled) return;
+
+        CaptureRecord rec{};
+        rec.frequency = packet.frequency;
+        rec.timestampUs = captureTime();
+        // A frame sent has no signal measured, its packet holds the emission schedule instead
+        if (direction == Direction::Rx) {
+            rec.afc = packet.rx.afc;
+            rec.rssi = packet.rx.rssi;
+        }
+        rec.direction = direction;
+        rec.length = packet.buffer_length < MAX_FRAME_LEN ? packet.buffer_length : MAX_FRAME_LEN;
+        memcpy(rec.frame, packet.payload.buffer, rec.length);
+
+    #if defined(ESP32)
+        if (xQueueSend(queue, &rec, 0) != pdTRUE) {
+            stats.dropped += 1;
+            return;
+        }
+        stats.queued += 1;
+        uint32_t waiting = uxQueueMessagesWaiting(queue);
+        if (waiting > stats.maxQueued) stats.maxQueued = waiting;
+    #else
+        stats.queued += 1;
+        append(rec);
+    #endif
+    }
+
+#if defined(ESP32)
+    void iohcCapture::writerTask(void *pvParameters) {
+        auto *capture = static_cast<iohcCapture *>(pvParameters);
+        CaptureRecord rec;
+        while (true) {
+            if (xQueueReceive(capture->queue, &rec, pdMS_TO_TICKS(CAPTURE_FLUSH_MS)) == pdTRUE) {
+                capture->lock();
+                capture->append(rec);
+                capture->unlock();
+            } else {
+                capture->flush();
+            }
+        }
+    }
+
+    void iohcCapture::lock() { xSemaphoreTake(mutex, portMAX_DELAY); }
+    void iohcCapture::unlock() { xSemaphoreGive(mutex); }
+#else
+    void iohcCapture::lock() {}
+    void iohcCapture::unlock() {}
+#endif
+
+    void iohcCapture::append(const CaptureRecord &rec) {
+        page[pending] = rec;
+        page[pending].sequence = sequence++;
+        if (++pending == PAGE_RECORDS)
+            writePage();
+    }
+
+/**
+ * The function `writePage` writes the batched records in one write, two when the batch wraps around
+ * the end of the ring.
+ */
+    void iohcCapture::writePage() {
+        uint16_t done = 0;
+        while (done < pending) {
+            uint32_t count = pending - done;
+            if (count > header.capacity - next) count = header.capacity - next;
+            file.write(recordOffset(next), page + done, count * sizeof(CaptureRecord));
+            next = (next + count) % header.capacity;
+            done += count;
+        }
+        file.flush();
+        stats.written += pending;
+        stats.pages += 1;
+        pending = 0;
+    }
+
+    void iohcCapture::flush() {
+        lock();
+        if (pending) writePage();
+        unlock();
+    }
+
+    void iohcCapture::clear() {
+        lock();
+        memset(page, 0, sizeof(page));
+        for (uint32_t slot = 0; slot < header.capacity; slot += PAGE_RECORDS) {
+            uint32_t count = header.capacity - slot < PAGE_RECORDS ? header.capacity - slot : PAGE_RECORDS;
+            file.write(recordOffset(slot), page, count * sizeof(CaptureRecord));
+        }
+        file.flush();
+        next = 0;
+        sequence = 1;
+        pending = 0;
+        unlock();
+    }
+
+/**
+ * The function `forEach` reads the records oldest first and hands them to visit. The lock is only held
+ * while a record is read, so a slow visitor (the console) does not stall the writer; records written
+ * over meanwhile are skipped, their sequence being newer than the one expected.
+ *
+ * @param last Only the last records, all of them if 0.
+ */
+    void iohcCapture::forEach(uint32_t last, const std::function<void(const CaptureRecord &rec)> &visit) {
+        if (!ready) return;
+        flush();
+        lock();
+        uint32_t written = sequence - 1 - pending;     // Frames queued since flush() are not on file
+        uint32_t stored = written < header.capacity ? written : header.capacity;
+        uint32_t skip = last && last < stored ? stored - last : 0;
+        uint32_t slot = (stored < header.capacity ? 0 : next) + skip;
+        uint32_t expected = written - stored + 1 + skip;
+        unlock();
+
+        CaptureRecord rec;
+        for (uint32_t i = skip; i < stored; i++, slot++, expected++) {
+            lock();
+            bool read = file.read(recordOffset(slot % header.capacity), &rec, sizeof(rec));
+            unlock();
+            if (!read) break;
+            if (rec.sequence != expected) continue;
+            visit(rec);
+        }
+    }
+
+/**
+ * The function `dump` prints the records oldest first, one line each, for export over the console:
+ * sequence;timestamp us;frequency Hz;rssi dBm;afc Hz;direction;frame in hex
+ *
+ * @param last Only the last records, all of them if 0.
+ */
+    void iohcCapture::dump(uint32_t last) {
+        forEach(last, [](const CaptureRecord &rec) {
+            char line[96];
+            TextWriter(line, sizeof(line)).hex(rec.frame, rec.length < MAX_FRAME_LEN ? rec.length : MAX_FRAME_LEN);
+            printf("%u;%llu;%u;%.1f;%d;%s;%s\n", rec.sequence, static_cast<unsigned long long>(rec.timestampUs),
+                   static_cast<unsigned>(rec.frequency), rec.rssi / 10.0, static_cast<int>(rec.afc),
+                   rec.direction == Direction::Tx ? "TX" : "RX", line);
+        });
+        printf("Capture: %u queued %u dropped %u written in %u pages, queue max %u\n", stats.queued, stats.dropped,
+               stats.written, stats.pages, stats.maxQueued);
+    }
+}
@@ -0,0 +1,223 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <crypto2Wutils.h>
+#include <iohcChallenge.h>
+#include <iohcCryptoHelpers.h>
+#include <iohcFrameBuilder.h>
+
+#include <iohcRadio.h>
+
+namespace IOHC {
+    iohcChallenges *iohcChallenges::_iohcChallenges = nullptr;
+
+    namespace {
+        constexpr uint8_t KEY_TRANSFER_REQUEST = 0x31;
+        constexpr uint8_t CHALLENGE_LEN = sizeof(ChallengeContext::challenge);
+        static_assert(IV_PREFIX_LEN + CHALLENGE_LEN == sizeof(iohcCrypto::Block));
+
+        // The key is sent on a challenge to 0x31 whatever its data, the IV is made of the command alone
+        const uint8_t *keyTransferPrefix() {
+            static uint8_t prefix[IV_PREFIX_LEN];
+            static bool computed = (iohcCrypto::challengePrefix(prefix, KEY_TRANSFER_REQUEST, nullptr, 0), true);
+            (void) computed;
+            return prefix;
+        }
+    }
+
+    uint32_t challengeTime() {
+        return static_cast<uint32_t>(esp_timer_get_time());
+    }
+
+    iohcChallenges *iohcChallenges::getInstance() {
+        if (!_iohcChallenges)
+            _iohcChallenges = new iohcChallenges();
+        return _iohcChallenges;
+    }
+
+    // Challenged from the radio task, answered from the timer task, printed from the console
+    iohcChallenges::iohcChallenges() {
+    #if defined(ESP32)
+        mutex = xSemaphoreCreateMutex();
+    #endif
+    }
+
+#if defined(ESP32)
+    void iohcChallenges::lock() { xSemaphoreTake(mutex, portMAX_DELAY); }
+    void iohcChallenges::unlock() { xSemaphoreGive(mutex); }
+#else
+    void iohcChallenges::lock() {}
+    void iohcChallenges::unlock() {}
+#endif
+
+/**
+ * The function `lookup` finds the context of a peer, or takes a free one, or the one challenged the
+ * longest ago, an answer already given first.
+ */
+    ChallengeContext *iohcChallenges::lookup(uint32_t peer) {
+        ChallengeContext *victim = &contexts[0];
+        for (auto &c: contexts) {
+            if (c.peer == peer) return &c;
+            if (!victim->peer) continue;
+            if (!c.peer || (victim->pending && !c.pending) ||
+                (victim->pending == c.pending && static_cast<int32_t>(c.receivedUs - victim->receivedUs) < 0))
+                victim = &c;
+        }
+        if (victim->peer) stats.evicted += 1;
+        *victim = ChallengeContext{};
+        victim->peer = peer;
+        return victim;
+    }
+
+/**
+ * The function `challenged` keeps the challenge of a peer with the IV prefix of the request it challenges,
+ * copied from the session so that a request sent meanwhile to the same peer leaves the answer as it should
+ * be. It is answered right away, with the other challenges pending then. The same challenge on the same
+ * request is answered again from the context.
+ */
+    bool iohcChallenges::challenged(const iohcPacket &packet, uint32_t nowUs) {
+        const _header &header = packet.payload.packet.header;
+        const uint8_t *challenge = packet.payload.buffer + FRAME_HEADER_LEN;
+        Session session;
+        bool inFlight = iohcTransactions::getInstance()->find(header.source, &session);
+
+        lock();
+        stats.challenged += 1;
+        if (!inFlight || session.state != SessionState::Challenged) {
+            stats.noRequest += 1;
+            unlock();
+            return false;
+        }
+        ChallengeContext *c = lookup(sessionKey(header.source));
+        bool keyTransfer = session.request == KEY_TRANSFER_REQUEST;
+        const uint8_t *prefix = keyTransfer ? keyTransferPrefix() : session.ivPrefix;
+        // Same IV, same answer
+        if (c->answered && c->keyTransfer == keyTransfer && !memcmp(c->ivPrefix, prefix, IV_PREFIX_LEN) &&
+            !memcmp(c->challenge, challenge, CHALLENGE_LEN)) {
+            stats.repeated += 1;
+        } else {
+            memcpy(c->challenge, challenge, CHALLENGE_LEN);
+            c->request = session.request;
+            memcpy(c->ivPrefix, prefix, IV_PREFIX_LEN);
+            c->keyTransfer = keyTransfer;
+            c->answered = false;
+        }
+        memcpy(c->gateway, header.target, sizeof(address));
+        c->pending = true;
+        c->receivedUs = nowUs;
+        unlock();
+        flush(nowUs);
+        return true;
+    }
+
+/**
+ * The function `computeAnswers` puts the IV of every context together, its prefix then its challenge,
+ * then encrypts them all with the transfer key at once. The key transferred on a challenge to 0x31 is
+ * xored with its encrypted IV.
+ */
+    void iohcChallenges::computeAnswers(ChallengeContext *const *contexts, uint8_t count) {
+        iohcCrypto::Block blocks[IOHC_CHALLENGE_PEERS];
+        if (count > IOHC_CHALLENGE_PEERS) count = IOHC_CHALLENGE_PEERS;
+        for (uint8_t i = 0; i < count; i++) {
+            memcpy(blocks[i], contexts[i]->ivPrefix, IV_PREFIX_LEN);
+            memcpy(blocks[i] + IV_PREFIX_LEN, contexts[i]->challenge, CHALLENGE_LEN);
+        }
+        iohcCrypto::encryptBlocks(iohcCrypto::KeyId::of(iohcCrypto::KeyKind::Transfer), transfert_key, blocks, blocks, count);
+        for (uint8_t i = 0; i < count; i++) {
+            ChallengeContext *c = contexts[i];
+            memcpy(c->answer, blocks[i], sizeof(c->answer));
+            if (c->keyTransfer)
+                for (uint8_t b = 0; b < sizeof(c->answer); b++) c->answer[b] ^= transfert_key[b];
+            c->answered = true;
+        }
+    }
+
+/**
+ * The function `flush` answers every pending challenge. The answers missing are computed in one batch,
+ * the frames built and handed to the radio together: a challenge received meanwhile waits for the lock
+ * and is answered by the next flush, ahead of the next frame sent. They are printed once handed over,
+ * printing takes longer than the peers wait, from copies since the radio releases the frames once sent.
+ */
+    uint8_t iohcChallenges::flush(uint32_t nowUs) {
+        ChallengeContext *due[IOHC_CHALLENGE_PEERS];
+        ChallengeContext *missing[IOHC_CHALLENGE_PEERS];
+        struct {
+            uint8_t cmd;
+            uint32_t peer;
+            uint8_t answer[sizeof(ChallengeContext::answer)];
+            uint8_t length;
+        } handed[IOHC_CHALLENGE_PEERS];
+        uint8_t count = 0, toCompute = 0;
+        std::vector<iohcPacket *> frames;
+
+        lock();
+        for (auto &c: contexts) {
+            if (!c.pending) continue;
+            due[count++] = &c;
+            if (!c.answered) missing[toCompute++] = &c;
+        }
+        if (!count) {
+            unlock();
+            return 0;
+        }
+        computeAnswers(missing, toCompute);
+
+        for (uint8_t i = 0; i < count; i++) {
+            ChallengeContext *c = due[i];
+            const FrameSpec &spec = c->keyTransfer ? Frames::ChallengeKeyTransfer : Frames::ChallengeAnswer;
+            const address peer = {static_cast<uint8_t>(c->peer >> 16), static_cast<uint8_t>(c->peer >> 8), static_cast<uint8_t>(c->peer)};
+            iohcPacket *packet = buildFrame(spec, c->gateway, peer);
+            memcpy(frameData(packet), c->answer, spec.dataLen);
+            frames.push_back(packet);
+            handed[i].cmd = spec.cmd;
+            handed[i].peer = c->peer;
+            memcpy(handed[i].answer, c->answer, spec.dataLen);
+            handed[i].length = spec.dataLen;
+            c->pending = false;
+            if (nowUs - c->receivedUs > stats.maxLatencyUs) stats.maxLatencyUs = nowUs - c->receivedUs;
+        }
+        stats.answered += count;
+        stats.batches += 1;
+        if (count > stats.largestBatch) stats.largestBatch = count;
+        unlock();
+
+        iohcRadio::getInstance()->sendAnswers(frames);
+        for (uint8_t i = 0; i < count; i++) {
+            printf("Challenge response %2.2X to %6.6X: ", handed[i].cmd, handed[i].peer & 0xFFFFFF);
+            for (uint8_t b = 0; b < handed[i].length; b++) printf("%02X ", handed[i].answer[b]);
+            printf("\n");
+        }
+        return count;
+    }
+
+    void iohcChallenges::print() {
+        printf("%u challenged, %u answered in %u batches (largest %u), %u repeated, %u without request, %u evicted, %u us at most\n",
+               stats.challenged, stats.answered, stats.batches, stats.largestBatch, stats.repeated, stats.noRequest,
+               stats.evicted, stats.maxLatencyUs);
+        lock();
+        for (const auto &c: contexts) {
+            if (!c.peer) continue;
+            printf("\t%6.6X %2.2X challenge ", c.peer & 0xFFFFFF, c.request);
+            for (uint8_t b: c.challenge) printf("%02X", b);
+            printf(" %s\n", c.pending ? "pending" : c.answered ? (c.keyTransfer ? "key sent" : "answered") : "-");
+        }
+        unlock();
+    }
+}
@@ -15,9 +15,15 @@
  */
 
 #include <iohcCozyDevice2W.h>
-#include <LittleFS.h>
+#include <iohcOtherDevice2W.h>
+#if defined(ESP32)
+    #include <LittleFS.h>
+    #include <ArduinoJson.h>
+#endif
+#include <iohcChallenge.h>
 #include <iohcCryptoHelpers.h>
-#include <ArduinoJson.h>
+#include <crypto2Wutils.h>
+#include <iohcTransaction.h>
 #include <numeric>
 
 namespace IOHC {
@@ -33,33 +39,6 @@ namespace IOHC {
         return _iohcCozyDevice2W;
     }
 
-    /**
-    * @brief Forge a Cozy packet into iohcPacket. This is the function that is called when calling a command
-    * @param packet * The IOHC packet to forge
-    * @param toSend
-    */
-    void iohcCozyDevice2W::forgePacket(iohcPacket *packet, const std::vector<unsigned char> &toSend) {
-        digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
-        IOHC::relStamp = esp_timer_get_time();
-
-        // Common Flags
-        // 8 if protocol version is 0 else 10
-        packet->payload.packet.header.CtrlByte1.asStruct.MsgLen = sizeof(_header) - 1;
-        packet->payload.packet.header.CtrlByte1.asStruct.Protocol = 0;
-        packet->payload.packet.header.CtrlByte1.asStruct.StartFrame = 1;
-        packet->payload.packet.header.CtrlByte1.asStruct.EndFrame = 0;
-        packet->payload.packet.header.CtrlByte2.asByte = 0;
-
-        packet->payload.packet.header.CtrlByte1.asByte += toSend.size();
-        memcpy(packet->payload.buffer + 9, toSend.data(), toSend.size());
-        packet->buffer_length = toSend.size() + 9;
-
-        packet->frequency = CHANNEL2;
-        packet->repeatTime = 25;
-        packet->repeat = 0;
-        packet->lock = false;
-    }
-
     /**
     * @brief Checks if this cozy our fake gateway. This is used to detect if we have an IOCHA device that is in charge of the IOCHA and should be woken up.
     * @param nodeSrc The source node address of the IOCHA.
@@ -73,82 +52,149 @@ namespace IOHC {
         return this->Fake;
     }
 
+    // Frame sent back right away, from the radio task, ahead of a batch being sent
+    void iohcCozyDevice2W::answer(iohcPacket *packet) {
+        std::vector<iohcPacket *> frames{packet};
+        _radioInstance->sendAnswers(frames);
+        digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
+    }
+
+    /**
+    * @brief Registers the gateway side of the 2W pairing and of the challenges: discover, key transfer,
+    * challenge and name requests. The answers go back from the address that was asked
+    * @param dispatcher Table of the received commands
+    */
+    void iohcCozyDevice2W::registerHandlers(iohcDispatcher *dispatcher) {
+        dispatcher->on(RECEIVED_DISCOVER_0x28, [](iohcPacket *iohc) {
+            printf("2W Pairing Asked\n");
+            if (!Cmd::pairMode) return;
+            auto *cozy = getInstance();
+            cozy->answer(buildFrame(Frames::DiscoverAnswer, cozy->gateway, iohc->payload.packet.header.source));
+        });
+
+        dispatcher->on(RECEIVED_DISCOVER_ANSWER_0x29, [](iohcPacket *iohc) {
+            printf("2W Device want to be paired\n");
+            if (!Cmd::pairMode) return;
+
+            for (uint8_t i = 9; i < 18; i++)
+                printf("%02X ", iohc->payload.buffer[i]);
+            printf("\n");
+            printf("Sending SEND_DISCOVER_ACTUATOR_0x2C \n");
+
+            /* Swap */
+            getInstance()->answer(buildFrame(Frames::DiscoverActuator, iohc->payload.packet.header.target, iohc->payload.packet.header.source));
+        });
+
+        dispatcher->on(RECEIVED_DISCOVER_ACTUATOR_0x2C, [](iohcPacket *iohc) {
+            printf("2W Actuator Ack Asked\n");
+            if (!Cmd::pairMode) return;
+
+            /* Swap */
+            getInstance()->answer(buildFrame(Frames::DiscoverActuatorAck, iohc->payload.packet.header.target, iohc->payload.packet.header.source));
+        });
+
+        dispatcher->on(RECEIVED_LAUNCH_KEY_TRANSFERT_0x38, [](iohcPacket *iohc) {
+            printf("2W Key Transfert Asked after Command %2.2X\n", iohc->payload.packet.header.cmd);
+            if (!Cmd::pairMode) return;
+
+            const uint8_t *key_transfert = frameData(iohc);
+            for (int i = 0; i < 6; i++) {
+                printf("%02X ", key_transfert[i]);
+            }
+            printf("\n");
+            unsigned char initial_value[16];
+            iohcCrypto::challengeInitialValue(initial_value, SEND_ASK_CHALLENGE_0x31, nullptr, 0, key_transfert); //0x38
+            printf("2) Initial value used for key encryption: ");
+            for (unsigned char i: initial_value) {
+                printf("%02X ", i);
+            }
+            printf("\n");
+
+            /* Swap */
+            auto *packet = buildFrame(Frames::KeyTransfer, iohc->payload.packet.header.target, iohc->payload.packet.header.source);
+            uint8_t *encrypted_key = frameData(packet);
+            iohcCrypto::encryptBlock(iohcCrypto::KeyId::of(iohcCrypto::KeyKind::Transfer), transfert_key, initial_value, initial_value);
+            //  XORing transfert_key
+            for (int i = 0; i < 16; i++) {
+                encrypted_key[i] = initial_value[i] ^ transfert_key[i];
+            }
+            printf("2) Encrypted 2-way key to be sent with SEND_KEY_TRANSFERT_0x32: ");
+            for (int i = 0; i < 16; i++) {
+                printf("%02X ", encrypted_key[i]);
+            }
+            printf("\n");
+            getInstance()->answer(packet);
+        });
+
+        dispatcher->on(RECEIVED_WRITE_PRIVATE_0x20, [](iohcPacket *iohc) {
+            IOHC::lastSendCmd = iohc->payload.packet.header.cmd;
+        });
+
+        dispatcher->on(RECEIVED_CHALLENGE_REQUEST_0x3C, [](iohcPacket *iohc) {
+            auto *cozy = getInstance();
+            // Answer only to our gateway, not to others devices
+            if (!cozy->isFake(iohc->payload.packet.header.source, iohc->payload.packet.header.target)) return;
+
+            if (Cmd::scanMode) {
+                printf("Challenge asked after LastSend Command %2.2X\n", IOHC::lastSendCmd);
+                iohcOtherDevice2W::getInstance()->mapValid[IOHC::lastSendCmd] = RECEIVED_CHALLENGE_REQUEST_0x3C;
+                return;
+            }
+
+            // Answered from the request in flight with this peer, with those of the other peers challenging
+            if (!iohcChallenges::getInstance()->challenged(*iohc))
+                printf("Challenge without request in flight\n");
+        });
+
+        dispatcher->on(RECEIVED_GET_NAME_0x50, [](iohcPacket *iohc) {
+            auto *cozy = getInstance();
+            if (!cozy->isFake(iohc->payload.packet.header.source, iohc->payload.packet.header.target)) return;
+            cozy->answer(buildFrame(Frames::NameAnswer, cozy->gateway, iohc->payload.packet.header.source));
+        });
+
+        // Answer of 0x50
+        dispatcher->on(0x51, [](iohcPacket *iohc) {
+            for (uint8_t i = 9; i < 25; i++)
+                printf("%c", std::toupper(iohc->payload.buffer[i]));
+            printf("\n");
+        });
+    }
+
     /// Emulates device button press
     void iohcCozyDevice2W::cmd(DeviceButton cmd, Tokens *data) {
         if (!_radioInstance) {
-            Serial.println("NO RADIO INSTANCE");
+            printf("NO RADIO INSTANCE\n");
             _radioInstance = IOHC::iohcRadio::getInstance();
         }
 
         switch (cmd) {
             case DeviceButton::associate: {
-                std::vector<uint8_t> toSend = {};
-
                 packets2send.clear();
-                auto* packet = new iohcPacket;
-                forgePacket(packet, toSend);
-
-                packet->payload.packet.header.cmd = iohcDevice::SEND_ASK_CHALLENGE_0x31;
-                memorizeSend.memorizedData = toSend;
-                memorizeSend.memorizedCmd = iohcDevice::SEND_ASK_CHALLENGE_0x31;
-
-                packet->payload.packet.header.CtrlByte1.asStruct.StartFrame = 1;
-                packet->payload.packet.header.CtrlByte1.asStruct.EndFrame = 1;
+                packets2send.push_back(buildFrame(Frames::CozyAskChallenge, gateway, master_to));
 
-                memcpy(packet->payload.packet.header.source, gateway, 3);
-                memcpy(packet->payload.packet.header.target, master_to, 3);
-
-                packets2send.push_back(packet);
                 digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
                 _radioInstance->send(packets2send);
                 break;
             }
             case DeviceButton::powerOn: {
-                std::vector<uint8_t> toSend = {0x0C, 0x60, 0x01, 0x2C};
-
                 packets2send.clear();
-                auto* packet = new iohcPacket;
-                forgePacket(packet, toSend);
-
-                packet->payload.packet.header.cmd = iohcDevice::SEND_WRITE_PRIVATE_0x20;
-                memorizeSend.memorizedCmd = iohcDevice::SEND_WRITE_PRIVATE_0x20;
-                memorizeSend.memorizedData = toSend;
-
-                packet->payload.packet.header.CtrlByte1.asStruct.StartFrame = 1;
-
-                memcpy(packet->payload.packet.header.source, gateway, 3);
-                memcpy(packet->payload.packet.header.target, master_to, 3);
+                packets2send.push_back(buildFrame(Frames::CozyPowerOn, gateway, master_to));
 
-                packets2send.push_back(packet);
                 digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
                 _radioInstance->send(packets2send);
 
                 break;
             }
             case DeviceButton::setTemp: {
-                std::vector<uint8_t> toSend = {0x0C, 0x61, 0x01, 0x03, 0xFF, 0x00};
-
                 int temp = 10 * std::stof(data->at(1));
-                toSend[4] = temp;
 
                 int addr = 0;
                 if (data->size() == 2) addr = 0;
                 else addr = std::stoi(data->at(2));
 
                 packets2send.clear();
-                auto* packet = new iohcPacket;
-                forgePacket(packet, toSend);
-
-                packet->payload.packet.header.cmd = iohcDevice::SEND_WRITE_PRIVATE_0x20;
-                memorizeSend.memorizedData = toSend;
-                memorizeSend.memorizedCmd = iohcDevice::SEND_WRITE_PRIVATE_0x20;
-
-                packet->payload.packet.header.CtrlByte1.asStruct.StartFrame = 1;
-
-                memcpy(packet->payload.packet.header.source, gateway, 3);
-                memcpy(packet->payload.packet.header.target, addresses.at(addr).data()/* 0 Master_to*/, 3);
-
-                packet->delayed = 50;
+                auto *packet = buildFrame(Frames::CozySetTemp, gateway, addresses.at(addr).data()/* 0 Master_to*/);
+                frameData(packet)[4] = temp;
 
                 packets2send.push_back(packet);
                 digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
@@ -158,38 +204,27 @@ namespace IOHC {
                 break;
             }
             case DeviceButton::setMode: {
-                std::vector<uint8_t> toSend = {0x0C, 0x61, 0x01, 0x00, 0xFF};
-
+                uint8_t mode = 0xFF;
                 const char *dat = data->at(1).c_str();
-                if (strcasecmp(dat, "auto") == 0) toSend[4] = 0x00;
-                if (strcasecmp(dat, "manual") == 0) toSend[4] = 0x01;
-                if (strcasecmp(dat, "prog") == 0) toSend[4] = 0x02;
-                // if (strcasecmp(data, "special") == 0) toSend[4] = 0x03;
-                if (strcasecmp(dat, "off") == 0) toSend[4] = 0x04; // TODO if mode off, disable setPresence
+                if (strcasecmp(dat, "auto") == 0) mode = 0x00;
+                if (strcasecmp(dat, "manual") == 0) mode = 0x01;
+                if (strcasecmp(dat, "prog") == 0) mode = 0x02;
+                // if (strcasecmp(data, "special") == 0) mode = 0x03;
+                if (strcasecmp(dat, "off") == 0) mode = 0x04; // TODO if mode off, disable setPresence
 
                 // int addr = 0;
                 // if (data->size() == 2) addr = 0;
                 // else addr = std::stoi(data->at(2));
 
-                size_t dest = 0;
-
                 packets2send.clear();
                 for (const auto &addr: addresses) {
-                    packets2send.push_back(new iohcPacket);
-                    forgePacket(packets2send.back(), toSend);
-
-                    packets2send.back()->payload.packet.header.cmd = iohcDevice::SEND_WRITE_PRIVATE_0x20;
-                    memorizeSend.memorizedData = toSend;
-                    memorizeSend.memorizedCmd = iohcDevice::SEND_WRITE_PRIVATE_0x20;
-
-                    packets2send.back()->payload.packet.header.CtrlByte1.asStruct.StartFrame = 1;
-                    memcpy(packets2send.back()->payload.packet.header.source, gateway, 3);
-                    memcpy(packets2send.back()->payload.packet.header.target,
-                           addresses.at(dest/*addr*/).data()/* 0 Master_to*/, 3);
-
-                    dest++;
+                    auto *packet = buildFrame(Frames::CozySetMode, gateway, addr.data()/* 0 Master_to*/);
+                    frameData(packet)[4] = mode;
+                    packets2send.push_back(packet);
                 }
-                packets2send[1]->delayed = 250;
+                // Only the second frame waits, the others follow each other
+                if (packets2send.size() > 1)
+                    packets2send[1]->tx.delayed = Frames::CozySetModeDelay;
                 digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
 
                 _radioInstance->send(packets2send);
@@ -197,76 +232,44 @@ namespace IOHC {
                 break;
             }
             case DeviceButton::setPresence: {
-                std::vector<uint8_t> toSend = {0x0C, 0x61, 0x01, 0x10, 0xFF};
-
+                uint8_t presence = 0xFF;
                 const char *dat = data->at(1).c_str();
-                if (strcasecmp(dat, "on") == 0) toSend[4] = 0x01;
-                if (strcasecmp(dat, "off") == 0) toSend[4] = 0x00;
+                if (strcasecmp(dat, "on") == 0) presence = 0x01;
+                if (strcasecmp(dat, "off") == 0) presence = 0x00;
 
                 packets2send.clear();
-                packets2send.push_back(new iohcPacket);
-                forgePacket(packets2send.back(), toSend);
-
-                packets2send.back()->payload.packet.header.cmd = iohcDevice::SEND_WRITE_PRIVATE_0x20;
-                memorizeSend.memorizedData = toSend;
-                memorizeSend.memorizedCmd = iohcDevice::SEND_WRITE_PRIVATE_0x20;
-
-                packets2send.back()->payload.packet.header.CtrlByte1.asStruct.StartFrame = 1;
-
-                memcpy(packets2send.back()->payload.packet.header.source, gateway, 3);
-                memcpy(packets2send.back()->payload.packet.header.target, master_to, 3);
+                auto *packet = buildFrame(Frames::CozySetPresence, gateway, master_to);
+                frameData(packet)[4] = presence;
+                packets2send.push_back(packet);
 
                 digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
                 _radioInstance->send(packets2send);
                 break;
             }
             case DeviceButton::setWindow: {
-                std::vector<uint8_t> toSend = {0x0C, 0x61, 0x01, 0x0E, 0xFF};
-
+                uint8_t window = 0xFF;
                 const char *dat = data->at(1).c_str();
-                if (strcasecmp(dat, "open") == 0) toSend[4] = 0x01;
-                if (strcasecmp(dat, "close") == 0) toSend[4] = 0x00;
+                if (strcasecmp(dat, "open") == 0) window = 0x01;
+                if (strcasecmp(dat, "close") == 0) window = 0x00;
 
                 int addr = 0;
                 if (data->size() == 2) addr = 0;
                 else addr = std::stoi(data->at(2));
 
                 packets2send.clear();
-                packets2send.push_back(new iohcPacket);
-                forgePacket(packets2send.back(), toSend);
-
-                packets2send.back()->payload.packet.header.cmd = iohcDevice::SEND_WRITE_PRIVATE_0x20;
-                memorizeSend.memorizedData = toSend;
-                memorizeSend.memorizedCmd = iohcDevice::SEND_WRITE_PRIVATE_0x20;
-
-                packets2send.back()->payload.packet.header.CtrlByte1.asStruct.StartFrame = 1;
-
-                memcpy(packets2send.back()->payload.packet.header.source, gateway, 3);
-                memcpy(packets2send.back()->payload.packet.header.target, addresses.at(addr).data()/* 0 Master_to*/, 3);
-
-                packets2send.back()->delayed = 50;
+                auto *packet = buildFrame(Frames::CozySetWindow, gateway, addresses.at(addr).data()/* 0 Master_to*/);
+                frameData(packet)[4] = window;
+                packets2send.push_back(packet);
 
                 digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
                 _radioInstance->send(packets2send);
                 break;
             }
             case DeviceButton::midnight: {
-                // std::vector<uint8_t> toSend = {0x00, 0x0c, 0x00, 0x00, 0x03, 0x00, 0x00, 0x01, 0x53};
-                std::vector<uint8_t> toSend = {0x0c, 0x60, 0x01, 0x30};
-                //, 0x2b, 0x05, 0x00, 0x0f, 0x04, 0x0c, 0xe7, 0x07};
-
+                // {0x00, 0x0c, 0x00, 0x00, 0x03, 0x00, 0x00, 0x01, 0x53};
+                // {0x0c, 0x60, 0x01, 0x30, 0x2b, 0x05, 0x00, 0x0f, 0x04, 0x0c, 0xe7, 0x07};
                 packets2send.clear();
-                packets2send.push_back(new iohcPacket);
-                forgePacket(packets2send.back(), toSend);
-
-                packets2send.back()->payload.packet.header.cmd = iohcDevice::SEND_WRITE_PRIVATE_0x20;
-                memorizeSend.memorizedData = toSend;
-                memorizeSend.memorizedCmd = iohcDevice::SEND_WRITE_PRIVATE_0x20;
-
-                packets2send.back()->payload.packet.header.CtrlByte1.asStruct.StartFrame = 1;
-
-                memcpy(packets2send.back()->payload.packet.header.source, gateway, 3);
-                memcpy(packets2send.back()->payload.packet.header.target, master_to, 3);
+                packets2send.push_back(buildFrame(Frames::CozyMidnight, gateway, master_to));
 
                 digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
                 _radioInstance->send(packets2send);
@@ -286,6 +289,11 @@ namespace IOHC {
     */
     bool iohcCozyDevice2W::load() {
         _radioInstance = iohcRadio::getInstance();
+    #if !defined(ESP32)
+        // No filesystem on the host
+        printf("*2W Cozy devices not available\n");
+        return false;
+    #else
         // Load Cozy 2W device settings from file
         if (LittleFS.exists(COZY_2W_FILE))
             Serial.printf("Loading Cozy 2W devices settings from %s\n", COZY_2W_FILE);
@@ -322,6 +330,7 @@ namespace IOHC {
         Serial.printf("Loaded %d x 2W devices\n", devices.size()); // _type.size());
 
         return true;
+    #endif
     }
 
     /**
@@ -331,6 +340,9 @@ namespace IOHC {
      * @return false
      */
     bool iohcCozyDevice2W::save() {
+    #if !defined(ESP32)
+        return false;
+    #else
         fs::File f = LittleFS.open(COZY_2W_FILE, "a+");
         JsonDocument doc;
         for (const auto &d: devices) {
@@ -361,5 +373,6 @@ namespace IOHC {
         f.close();
 
         return true;
+    #endif
     }
 }
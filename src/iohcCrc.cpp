@@ -0,0 +1,94 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <iohcCrc.h>
+
+namespace IOHC {
+    namespace {
+        constexpr uint16_t crcBits(uint16_t crc, int bits) {
+            for (int i = 0; i < bits; i++)
+                crc = (crc >> 1) ^ (crc & 1 ? CRC_POLYNOMIAL_CCITT : 0);
+            return crc;
+        }
+
+        struct CrcTable {
+            uint16_t entry[256];
+        };
+
+        // The byte table, and for slice-by-4 the same byte 1, 2 and 3 bytes earlier. Apart so that the
+        // linker drops the 2 KiB of the slices when slice-by-4 is not used
+        struct CrcSlices {
+            uint16_t slice[4][256];
+        };
+
+        constexpr CrcTable makeCrcTable() {
+            CrcTable t{};
+            for (int b = 0; b < 256; b++) t.entry[b] = crcBits(b, 8);
+            return t;
+        }
+
+        constexpr CrcTable crcTable = makeCrcTable();
+        static_assert(crcTable.entry[1] == 0x1189 && crcTable.entry[0x80] == 0x8408);
+
+        constexpr CrcSlices makeCrcSlices() {
+            CrcSlices t{};
+            for (int b = 0; b < 256; b++) t.slice[0][b] = crcTable.entry[b];
+            for (int k = 1; k < 4; k++)
+                for (int b = 0; b < 256; b++)
+                    t.slice[k][b] = (t.slice[k - 1][b] >> 8) ^ crcTable.entry[t.slice[k - 1][b] & 0xff];
+            return t;
+        }
+
+        constexpr CrcSlices crcSlices = makeCrcSlices();
+
+        inline uint16_t crcByte(uint16_t crc, uint8_t byte) {
+            return (crc >> 8) ^ crcTable.entry[(crc ^ byte) & 0xff];
+        }
+    }
+
+    uint16_t crc16Bitwise(const uint8_t *data, size_t len, uint16_t crc) {
+        for (size_t i = 0; i < len; i++)
+            crc = crcBits(crc ^ data[i], 8);
+        return crc;
+    }
+
+    uint16_t crc16Table(const uint8_t *data, size_t len, uint16_t crc) {
+        for (size_t i = 0; i < len; i++) crc = crcByte(crc, data[i]);
+        return crc;
+    }
+
+/**
+ * The function `crc16Slice4` folds the 16 bit CRC into the first two bytes of each group of four, then looks
+ * the four bytes up in their own table: four independent loads instead of a chain of four.
+ */
+    uint16_t crc16Slice4(const uint8_t *data, size_t len, uint16_t crc) {
+        const auto &s = crcSlices.slice;
+        for (; len >= 4; data += 4, len -= 4) {
+            uint16_t x = crc ^ (data[0] | data[1] << 8);
+            crc = s[3][x & 0xff] ^ s[2][x >> 8] ^ s[1][data[2]] ^ s[0][data[3]];
+        }
+        for (; len; len--) crc = crcByte(crc, *data++);
+        return crc;
+    }
+
+    uint16_t crc16(const uint8_t *data, size_t len, uint16_t crc) {
+    #if defined(IOHC_CRC_SLICE_BY_4)
+        return crc16Slice4(data, len, crc);
+    #else
+        return crc16Table(data, len, crc);
+    #endif
+    }
+}
@@ -0,0 +1,274 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <cstdio>
+#include <cstring>
+
+#include <crypto2Wutils.h>
+#include <iohcAuth1W.h>
+#include <iohcCryptoBench.h>
+#include <iohcCryptoHelpers.h>
+#include <iohcFrameBuilder.h>
+
+#if defined(ESP32)
+    #include <esp_heap_caps.h>
+    #include <esp_timer.h>
+#else
+    #include <chrono>
+#endif
+
+namespace iohcCrypto {
+#if !defined(ESP32)
+    uint32_t hostAllocations = 0;
+#endif
+
+    namespace {
+        // Results go through it so that the loops are not optimised away
+        volatile uint8_t sink;
+
+        uint64_t benchNs() {
+        #if defined(ESP32)
+            return esp_timer_get_time() * 1000ull;
+        #else
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        #endif
+        }
+
+        uint32_t heapAllocations() {
+        #if defined(ESP32)
+            multi_heap_info_t info;
+            heap_caps_get_info(&info, MALLOC_CAP_DEFAULT);
+            return info.allocated_blocks;
+        #else
+            return hostAllocations;
+        #endif
+        }
+
+        template<typename Op>
+        void run(const char *op, uint32_t rounds, Op &&operation) {
+            uint32_t allocations = heapAllocations();
+            uint64_t start = benchNs();
+            for (uint32_t r = 0; r < rounds; r++) operation(r);
+            uint64_t elapsed = benchNs() - start;
+            // Blocks freed are not seen on the ESP32, the count can go down
+            auto allocated = static_cast<int32_t>(heapAllocations() - allocations);
+
+            double ns = 1.0 * elapsed / rounds;
+            printf("crypto;%s;%u;%.1f;%.0f;%.2f\n", op, rounds, ns, ns > 0 ? 1e9 / ns : 0.0, 1.0 * allocated / rounds);
+        }
+
+        const uint8_t node[3] = {0xbe, 0x0c, 0x48};
+        const uint8_t remoteKey[16] = {0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef, 0x10, 0x32, 0x54, 0x76, 0x98, 0xba, 0xdc, 0xfe};
+        const uint8_t request[] = {0x0c, 0x61, 0x01, 0x03, 0xd7, 0x00};
+        const uint8_t challenge[6] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x66};
+
+        // A Close press as iohcRemote1W sends it, signed with remoteKey
+        void closePress(IOHC::iohcPacket &press) {
+            IOHC::address broadcast;
+            IOHC::broadcast1W(broadcast, 0);
+            IOHC::buildFrame(&press, IOHC::Frames::Remote0x00_14, node, broadcast);
+            press.payload.packet.msg.p0x00_14.main[0] = 0xc8;
+            uint8_t *sequence = press.payload.packet.msg.p0x00_14.sequence;
+            sequence[0] = 0x24;
+            sequence[1] = 0x16;
+            const uint8_t *from = &press.payload.packet.header.cmd;
+            uint8_t mac[16];
+            create_1W_hmac(mac, sequence, remoteKey, from, sequence - from, node);
+            memcpy(press.payload.packet.msg.p0x00_14.hmac, mac, 6);
+        }
+
+        // Block encrypted by the backend alone, without the key cache
+        void reference(const uint8_t *key, const uint8_t *in, uint8_t *out) {
+            AesBackend::Schedule schedule{};
+            AesBackend::expand(schedule, key);
+            AesBackend::encrypt(schedule, in, out);
+            AesBackend::release(schedule);
+        }
+
+        bool same(const char *op, const uint8_t *result, const uint8_t *expected, size_t len) {
+            if (!memcmp(result, expected, len)) return true;
+            printf("# %s differs from its reference\n", op);
+            return false;
+        }
+    }
+
+/**
+ * The function `cryptoSelfTest` checks what each operation of the bench computes against the same
+ * computation made of the backend alone: cached and missed keys, 1W MAC, key transfer and verdicts, 2W
+ * answers from the request and from its IV prefix.
+ */
+    bool cryptoSelfTest() {
+        const KeyId remoteId = KeyId::of(KeyKind::Remote, node);
+        const KeyId transferId = KeyId::of(KeyKind::Transfer);
+        IOHC::iohcPacket press;
+        closePress(press);
+        const uint8_t *sequence = press.payload.packet.msg.p0x00_14.sequence;
+        const uint8_t *from = &press.payload.packet.header.cmd;
+        const size_t len = sequence - from;
+        uint8_t iv[16], result[16], expected[16];
+        bool ok = true;
+
+        reference(remoteKey, challenge, expected);
+        encryptBlock(remoteId, remoteKey, challenge, result);
+        ok &= same("aes.cached", result, expected, 16);
+        invalidateKey(remoteId);
+        encryptBlock(remoteId, remoteKey, challenge, result);
+        ok &= same("aes.miss", result, expected, 16);
+
+        hmacInitialValue(iv, from, len, sequence);
+        reference(remoteKey, iv, expected);
+        create_1W_hmac(result, sequence, remoteKey, from, len, node);
+        ok &= same("1w.hmac", result, expected, 16);
+        ok &= same("1w.hmac", press.payload.packet.msg.p0x00_14.hmac, expected, 6);
+
+        memcpy(result, remoteKey, 16);
+        encrypt_1W_key(node, result);
+        encrypt_1W_key(node, result);
+        ok &= same("1w.key", result, remoteKey, 16);
+
+        auto *auth = IOHC::iohcAuth1W::getInstance();
+        auth->setKey(node, remoteKey, KeyKind::Remote);
+        IOHC::AuthResult verdict{};
+        press.payload.packet.msg.p0x00_14.hmac[0] ^= 0x01;
+        auth->verify(press.payload.buffer, press.buffer_length, &verdict);
+        if (verdict.verdict != IOHC::AuthVerdict::Forged) {
+            printf("# 1w.verify %s for a wrong MAC\n", IOHC::authVerdictName(verdict.verdict));
+            ok = false;
+        }
+        press.payload.packet.msg.p0x00_14.hmac[0] ^= 0x01;
+        auth->verify(press.payload.buffer, press.buffer_length, &verdict);
+        if (verdict.verdict != IOHC::AuthVerdict::Authentic) {
+            printf("# 1w.verify %s for the right MAC\n", IOHC::authVerdictName(verdict.verdict));
+            ok = false;
+        }
+        auth->forget(node);
+
+        challengeInitialValue(iv, 0x20, request, sizeof(request), challenge);
+        reference(transfert_key, iv, expected);
+        encryptBlock(transferId, transfert_key, iv, result);
+        ok &= same("2w.challenge", result, expected, 16);
+        challengePrefix(iv, 0x20, request, sizeof(request));
+        memcpy(iv + IV_PREFIX_LEN, challenge, sizeof(challenge));
+        encryptBlock(transferId, transfert_key, iv, result);
+        ok &= same("2w.challenge.prefix", result, expected, 16);
+
+        challengeInitialValue(iv, 0x31, nullptr, 0, challenge);
+        reference(transfert_key, iv, expected);
+        for (uint8_t i = 0; i < 16; i++) expected[i] ^= transfert_key[i];
+        encryptBlock(transferId, transfert_key, iv, result);
+        for (uint8_t i = 0; i < 16; i++) result[i] ^= transfert_key[i];
+        ok &= same("2w.keytransfer", result, expected, 16);
+
+        printf("# crypto operations %s\n", ok ? "ok" : "FAILED");
+        return ok;
+    }
+
+/**
+ * The function `cryptoBench` runs each primitive, then each protocol operation, on the frames and keys
+ * of a Close press and of a 2W pairing. The 1W verification goes through the verifier with a key set for
+ * the bench address and forgotten afterwards; its frames show in the verdict counters.
+ */
+    void cryptoBench(uint32_t rounds) {
+        const KeyId remoteId = KeyId::of(KeyKind::Remote, node);
+        const KeyId transferId = KeyId::of(KeyKind::Transfer);
+        IOHC::iohcPacket press;
+        closePress(press);
+        const uint8_t *sequence = press.payload.packet.msg.p0x00_14.sequence;
+        const uint8_t *from = &press.payload.packet.header.cmd;
+        const size_t len = sequence - from;
+
+        AesBackend::Schedule schedule{};
+        AesBackend::expand(schedule, remoteKey);
+        uint8_t block[16]{};
+
+        printf("# crypto bench, AES %s, %u rounds\n", AesBackend::name, rounds);
+        printf("# crypto;op;rounds;ns/op;ops/s;allocs/op\n");
+
+        // Primitives
+        run("aes.expand", rounds, [&](uint32_t r) {
+            block[0] = r;
+            AesBackend::expand(schedule, block);
+            sink = *reinterpret_cast<const uint8_t *>(&schedule);
+        });
+        AesBackend::expand(schedule, remoteKey);
+        run("aes.encrypt", rounds, [&](uint32_t) {
+            AesBackend::encrypt(schedule, block, block);
+            sink = block[0];
+        });
+        AesBackend::release(schedule);
+        run("aes.cached", rounds, [&](uint32_t) {
+            encryptBlock(remoteId, remoteKey, block, block);
+            sink = block[0];
+        });
+        run("aes.miss", rounds, [&](uint32_t) {
+            invalidateKey(remoteId);
+            encryptBlock(remoteId, remoteKey, block, block);
+            sink = block[0];
+        });
+        run("iv.checksum", rounds, [&](uint32_t r) {
+            sink = ivChecksum(from, len, r);
+        });
+        run("iv.hmac", rounds, [&](uint32_t) {
+            hmacInitialValue(block, from, len, sequence);
+            sink = block[9];
+        });
+        run("iv.challenge", rounds, [&](uint32_t) {
+            challengeInitialValue(block, 0x20, request, sizeof(request), challenge);
+            sink = block[9];
+        });
+
+        // Protocol operations
+        run("1w.hmac", rounds, [&](uint32_t) {
+            create_1W_hmac(block, sequence, remoteKey, from, len, node);
+            sink = block[0];
+        });
+        run("1w.key", rounds, [&](uint32_t) {
+            encrypt_1W_key(node, block);
+            sink = block[0];
+        });
+        auto *auth = IOHC::iohcAuth1W::getInstance();
+        auth->setKey(node, remoteKey, KeyKind::Remote);
+        run("1w.verify", rounds, [&](uint32_t) {
+            IOHC::AuthResult result;
+            auth->verify(press.payload.buffer, press.buffer_length, &result);
+            sink = static_cast<uint8_t>(result.verdict);
+        });
+        auth->forget(node);
+        // 0x3C answered with a 0x3D
+        run("2w.challenge", rounds, [&](uint32_t) {
+            challengeInitialValue(block, 0x20, request, sizeof(request), challenge);
+            encryptBlock(transferId, transfert_key, block, block);
+            sink = block[0];
+        });
+        // The same from the IV prefix computed when the request was sent (iohcTransactions)
+        uint8_t prefix[IV_PREFIX_LEN];
+        challengePrefix(prefix, 0x20, request, sizeof(request));
+        run("2w.challenge.prefix", rounds, [&](uint32_t) {
+            memcpy(block, prefix, IV_PREFIX_LEN);
+            memcpy(block + IV_PREFIX_LEN, challenge, sizeof(challenge));
+            encryptBlock(transferId, transfert_key, block, block);
+            sink = block[0];
+        });
+        // 0x38 answered with a 0x32, the key xored with the encrypted IV
+        run("2w.keytransfer", rounds, [&](uint32_t) {
+            challengeInitialValue(block, 0x31, nullptr, 0, challenge);
+            encryptBlock(transferId, transfert_key, block, block);
+            for (uint8_t i = 0; i < 16; i++) block[i] ^= transfert_key[i];
+            sink = block[0];
+        });
+    }
+}
@@ -16,6 +16,16 @@
 
 #include <iohcCryptoHelpers.h>
 #include <crypto2Wutils.h> 
+#include <iohcFormat.h>
+#include <cstring>
+
+#if defined(ESP32)
+    #include <esp_timer.h>
+    #include <freertos/FreeRTOS.h>
+    #include <freertos/semphr.h>
+#else
+    #include <chrono>
+#endif
 /*
     Helper function to convert a string containing hex numbers to a bytes sequence; one byte every two characters
 */
@@ -35,106 +45,187 @@ size_t i;
     Helper function to convert a byte sequence to an hex string
 */
 std::string bytesToHexString(const uint8_t *byteString, uint8_t len) {
-    char rec[len*2+1];
-
-    for (uint8_t i=0; i<len; i++)
-        sprintf((rec+(i*2)), "%2.2x", byteString[i]);
-
-    return std::string(rec);
+    std::string rec(2 * len, '\0');
+    IOHC::hexEncode(rec.data(), byteString, len);
+    return rec;
 }
 
 namespace iohcCrypto {
     std::string transfer_key = "34c3466ed88f4e8e16aa473949884373";
 
+    namespace {
+        struct CachedKey {
+            bool used;
+            iohcCrypto::KeyId id;
+            uint8_t key[16];
+            uint32_t lastUse;
+            AesBackend::Schedule schedule;
+        };
+
+        CachedKey keyCache[IOHC_KEY_CACHE_SIZE];
+        iohcCrypto::KeyCacheStats cacheStats;
+        uint32_t useCounter = 0;
+
+        // Frames are authenticated from the radio task and built from the console one
+    #if defined(ESP32)
+        SemaphoreHandle_t cacheMutex() {
+            static SemaphoreHandle_t mutex = xSemaphoreCreateMutex();
+            return mutex;
+        }
+        void lockCache() { xSemaphoreTake(cacheMutex(), portMAX_DELAY); }
+        void unlockCache() { xSemaphoreGive(cacheMutex()); }
+    #else
+        void lockCache() {}
+        void unlockCache() {}
+    #endif
+
+        bool sameId(const iohcCrypto::KeyId &a, const iohcCrypto::KeyId &b) {
+            return a.kind == b.kind && !memcmp(a.node, b.node, sizeof(a.node));
+        }
 
-#if defined(ESP8266)
-    AES128 aes128;
-    CTR<AES128> ctraes128;
-#elif defined(ESP32)
-    mbedtls_aes_context aes;
-#endif
-    
-    uint16_t computeCrc(uint8_t data, uint16_t crc = 0) {
-        crc ^= data;
-        for (int i = 0; i < 8; ++i) {
-            unsigned int remainder = (crc & 1) ? CRC_POLYNOMIAL_CCITT : 0;
-            crc = (crc >> 1) ^ remainder;
+        uint64_t benchTime() {
+        #if defined(ESP32)
+            return esp_timer_get_time();
+        #else
+            return std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        #endif
         }
-        return crc;
     }
 
-    /*
-    Returns the CRC value for the given data frame.
-    Used for whole io-homecontrol frames integrity check
-    */
-    uint16_t radioPacketComputeCrc(uint8_t *buffer, uint8_t bufferLength) {
-        uint16_t crc = 0;
-
-        for (uint8_t i=0; i<bufferLength; i++)
-            crc = computeCrc(buffer[i], crc);
+/**
+ * The function `cachedKey` finds the schedule cached for the key identity, the cache locked. The
+ * identity is looked up first, then the key bytes are compared, so that a key replaced under the same
+ * identity is expanded again instead of used stale. A new identity takes a free entry or the least
+ * recently used one, whose schedule is expanded again in place: the backend frees the former one.
+ */
+    static CachedKey *cachedKey(const KeyId &id, const uint8_t *key) {
+        CachedKey *entry = nullptr;
+        CachedKey *victim = &keyCache[0];
+        for (auto &cached: keyCache) {
+            if (cached.used && sameId(cached.id, id)) {
+                entry = &cached;
+                break;
+            }
+            if (!cached.used) victim = &cached;
+            else if (victim->used && cached.lastUse < victim->lastUse) victim = &cached;
+        }
 
-        return crc;
+        if (entry && !memcmp(entry->key, key, sizeof(entry->key))) {
+            cacheStats.hits += 1;
+        } else {
+            if (!entry) {
+                if (victim->used) cacheStats.evictions += 1;
+                entry = victim;
+            }
+            entry->used = true;
+            entry->id = id;
+            memcpy(entry->key, key, sizeof(entry->key));
+            AesBackend::expand(entry->schedule, key);
+            cacheStats.expansions += 1;
+        }
+        entry->lastUse = ++useCounter;
+        return entry;
     }
 
-    /*
-    Returns the CRC value for the given data frame.
-    Used for whole io-homecontrol frames integrity check
-    */
-    uint16_t radioPacketComputeCrc(std::vector<uint8_t>& buffer) {
-        uint16_t crc = 0;
-
-        for (uint8_t buf : buffer)
-            crc = computeCrc(buf, crc);
-
-        return crc;
+    void encryptBlock(const KeyId &id, const uint8_t *key, const uint8_t *in, uint8_t *out) {
+        lockCache();
+        AesBackend::encrypt(cachedKey(id, key)->schedule, in, out);
+        unlockCache();
     }
 
-    std::tuple<uint8_t, uint8_t> computeChecksum(uint8_t frame_byte, uint8_t chksum1, uint8_t chksum2) {
-        uint8_t tmpchksum = frame_byte ^ chksum2;
-        chksum2 = ((chksum1 & 0x7f)<<1) & 0xff;
-        if (tmpchksum >= 0x80)
-            chksum2 |= 1;
-
-        if ((chksum1 & 0x80) == 0)
-            return std::make_tuple(chksum2, (tmpchksum<<1)&0xff);
+    void encryptBlocks(const KeyId &id, const uint8_t *key, const Block *in, Block *out, size_t count) {
+        lockCache();
+        const auto &schedule = cachedKey(id, key)->schedule;
+        for (size_t i = 0; i < count; i++) AesBackend::encrypt(schedule, in[i], out[i]);
+        unlockCache();
+    }
 
-        return std::make_tuple(chksum2^0x55, ((tmpchksum<<1)^0x5b)&0xff);
+    void invalidateKey(const KeyId &id) {
+        lockCache();
+        for (auto &cached: keyCache)
+            if (cached.used && sameId(cached.id, id)) {
+                AesBackend::release(cached.schedule);
+                cached.used = false;
+            }
+        unlockCache();
     }
 
-    std::vector<uint8_t> constructInitialValue(const std::vector<uint8_t>& frame_data, const uint8_t *challenge = nullptr, const uint8_t *sequence_number = nullptr) {
-        if (!challenge && !sequence_number) {
-            printf("Cannot create initial value: no mode selected\n");
-            return {};
+    void invalidateKeys() {
+        lockCache();
+        for (auto &cached: keyCache) {
+            if (cached.used) AesBackend::release(cached.schedule);
+            cached.used = false;
         }
+        unlockCache();
+    }
 
-        std::vector<uint8_t> initial_value(16, 0);
-        initial_value[8] = 0;
-        initial_value[9] = 0;
-        size_t i = 0;
-        while (i < frame_data.size()) {
-            std::tie(initial_value[8], initial_value[9]) = computeChecksum(frame_data[i], initial_value[8], initial_value[9]);
-            if (i < 8)
-                initial_value[i] = frame_data[i];
-            i++;
+    const KeyCacheStats &keyCacheStats() { return cacheStats; }
+
+    namespace {
+        // One byte of the IV checksum: a 16 bit shift register, 0x555B folded back when its top bit goes out
+        constexpr uint16_t checksumStep(uint16_t checksum, uint8_t byte) {
+            uint16_t x = checksum ^ byte;
+            return static_cast<uint16_t>(x << 1 ^ (x & 0x8000 ? 0x555b : 0));
         }
 
-        if (i < 8)
-            for (size_t j = i; j < 8; j++)
-                initial_value[j] = 0x55;
+        // What the top byte of the checksum folds back over 8 bytes. The bytes themselves only shift in
+        // meanwhile: they never reach the top bit before the last step
+        struct ChecksumTable {
+            uint16_t fold[256];
+        };
+
+        constexpr ChecksumTable makeChecksumTable() {
+            ChecksumTable table{};
+            for (int top = 0; top < 256; top++) {
+                uint16_t checksum = top << 8;
+                for (int i = 0; i < 8; i++) checksum = checksumStep(checksum, 0);
+                table.fold[top] = checksum;
+            }
+            return table;
+        }
 
-        if (!challenge && sequence_number) {
-            for (i = 12; i < 16; i++)
-                initial_value[i] = 0x55;
+        constexpr ChecksumTable checksumTable = makeChecksumTable();
+    }
 
-            initial_value[10] = sequence_number[0];
-            initial_value[11] = sequence_number[1];
-        }
-        else if (challenge) {
-            for (i = 10; i < 16; i++)
-                initial_value[i] = challenge[i - 10];
+/**
+ * The function `ivChecksum` runs the IV checksum over a frame, 8 bytes per table lookup then byte per
+ * byte for the tail.
+ *
+ * @param checksum The checksum of what precedes data, 0 at the start of the frame.
+ */
+    uint16_t ivChecksum(const uint8_t *data, size_t len, uint16_t checksum) {
+        for (; len >= 8; data += 8, len -= 8) {
+            uint16_t in = data[0] << 8 ^ data[1] << 7 ^ data[2] << 6 ^ data[3] << 5 ^
+                          data[4] << 4 ^ data[5] << 3 ^ data[6] << 2 ^ data[7] << 1;
+            checksum = static_cast<uint16_t>(checksum << 8 ^ in ^ checksumTable.fold[checksum >> 8]);
         }
+        for (; len; len--) checksum = checksumStep(checksum, *data++);
+        return checksum;
+    }
+
+    void hmacInitialValue(uint8_t *iv, const uint8_t *frame, size_t len, const uint8_t *sequence) {
+        memset(iv, 0x55, 16);
+        if (len) memcpy(iv, frame, len < 8 ? len : 8);
+        uint16_t checksum = ivChecksum(frame, len);
+        iv[8] = checksum >> 8;
+        iv[9] = checksum;
+        iv[10] = sequence[0];
+        iv[11] = sequence[1];
+    }
 
-        return initial_value;
+    void challengePrefix(uint8_t *prefix, uint8_t cmd, const uint8_t *data, size_t len) {
+        memset(prefix, 0x55, 8);
+        prefix[0] = cmd;
+        if (len) memcpy(prefix + 1, data, len < 7 ? len : 7);
+        uint16_t checksum = ivChecksum(data, len, checksumStep(0, cmd));
+        prefix[8] = checksum >> 8;
+        prefix[9] = checksum;
+    }
+
+    void challengeInitialValue(uint8_t *iv, uint8_t cmd, const uint8_t *data, size_t len, const uint8_t *challenge) {
+        challengePrefix(iv, cmd, data, len);
+        memcpy(iv + IV_PREFIX_LEN, challenge, 6);
     }
 
 /*
@@ -143,27 +234,11 @@ namespace iohcCrypto {
     - Controller key in clear
     - frame data starting from Command byte
 */
-    void create_1W_hmac(uint8_t *hmac, const uint8_t *seq_number, uint8_t *controller_key, const std::vector<uint8_t>& frame_data) {
-        std::vector<uint8_t> iv;
-        #if defined(HELTEC)
-            mbedtls_aes_init(&aes);
-        #endif
-
-        iv = constructInitialValue(frame_data, nullptr, seq_number);
-
-        #if defined(ESP8266)
-            aes128.setKey(controller_key, 16);
-            aes128.encryptBlock(hmac, iv.data());
-        #elif defined(ESP32)
-            mbedtls_aes_setkey_enc( &aes, controller_key, 128 );
-           
-//        for (uint8_t a=0; a<16; a++){
-//            hmac[a] = 0;
-//        }
-        mbedtls_aes_crypt_ecb(&aes, MBEDTLS_AES_ENCRYPT, iv.data(), hmac);
-//        mbedtls_aes_free( &aes );
-        #endif        
-
+    void create_1W_hmac(uint8_t *hmac, const uint8_t *seq_number, const uint8_t *controller_key,
+                        const uint8_t *frame, size_t len, const uint8_t *node) {
+        uint8_t iv[16];
+        hmacInitialValue(iv, frame, len, seq_number);
+        encryptBlock(KeyId::of(KeyKind::Remote, node), controller_key, iv, hmac);
     }
 
 /*
@@ -172,16 +247,11 @@ namespace iohcCrypto {
     - Key in clear (or encrypted to decrypt)
 */
     void encrypt_1W_key(const uint8_t *node_address, uint8_t *key) {
-        #if defined(ESP32)
-            mbedtls_aes_init(&aes);
-        #endif
-
-        uint8_t btransfer[16];
-        uint8_t captured[16] = {};
-
-        hexStringToBytes(transfer_key, btransfer);
+        static uint8_t btransfer[16];
+        static bool parsed = hexStringToBytes(transfer_key, btransfer);
+        (void) parsed;
 
-        std::vector<uint8_t> iv(16, 0);
+        uint8_t iv[16];
         for (int i = 0; i < 13; i += 3) {
             iv[i] = node_address[0];
             iv[i + 1] = node_address[1];
@@ -189,27 +259,74 @@ namespace iohcCrypto {
         }
         iv[15] = node_address[0];
 
-    /*  
-        uint8_t captured[16] = {0};
-        aes128.setKey((uint8_t *)btransfer, 16);
-        aes128.encryptBlock(captured, iv.data());
-
+        // CFB (or CTR) over a single block: the key is xored with the encrypted IV
+        uint8_t stream[16];
+        encryptBlock(KeyId::of(KeyKind::Transfer), btransfer, iv, stream);
         for (int i = 0; i < 16; ++i)
-            key[i] ^= captured[i];
-    */
-        #if defined(ESP8266)
-    //  Use CTR encryption instead of AES. It includes xor with the key
-            ctraes128.setKey(btransfer, 16);
-            ctraes128.setIV(iv.data(), 16);
-            ctraes128.setCounterSize(4);
-            ctraes128.encrypt(key, key, 16);
-        #elif defined(ESP32)
-            size_t iv_offset = 0;
-            mbedtls_aes_setkey_enc( &aes, (uint8_t *)btransfer, 128 );
-            mbedtls_aes_crypt_cfb128(&aes, MBEDTLS_AES_ENCRYPT, 16, &iv_offset, iv.data(), (uint8_t *)key, captured);
-            for (int i = 0; i < 16; ++i)
-                key[i] = captured[i];
-            mbedtls_aes_free( &aes );
-        #endif
+            key[i] ^= stream[i];
+    }
+}
+namespace iohcCrypto {
+/**
+ * The function `benchKeyCache` times the per frame crypto of a 1W HMAC and of a 2W challenge answer,
+ * once with the key expanded for each frame as before the cache, once through the cache, and checks that
+ * both give the same blocks.
+ */
+    void benchKeyCache(uint32_t rounds) {
+        const uint8_t node[3] = {0x12, 0x34, 0x56};
+        const uint8_t remoteKey[16] = {0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef, 0x10, 0x32, 0x54, 0x76, 0x98, 0xba, 0xdc, 0xfe};
+        const uint8_t frame[] = {0x00, 0x01, 0x43, 0xd2, 0x00, 0x00};
+        const uint8_t request[] = {0x0c, 0x61, 0x01, 0x03, 0xd7, 0x00};
+        const uint8_t challenge[6] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x66};
+        uint8_t sequence[2] = {0x00, 0x00};
+        uint8_t legacy[16]{}, cached[16]{};
+        bool same = true;
+        uint32_t sink = 0;
+        auto *schedule = new AesBackend::Schedule{};
+
+        uint64_t start = benchTime();
+        for (uint32_t r = 0; r < rounds; r++) {
+            sequence[1] = r;
+            uint8_t iv[16];
+            hmacInitialValue(iv, frame, sizeof(frame), sequence);
+            AesBackend::expand(*schedule, remoteKey);
+            AesBackend::encrypt(*schedule, iv, legacy);
+            sink += legacy[0];
+        }
+        uint64_t hmacLegacy = benchTime() - start;
+        start = benchTime();
+        for (uint32_t r = 0; r < rounds; r++) {
+            sequence[1] = r;
+            create_1W_hmac(cached, sequence, remoteKey, frame, sizeof(frame), node);
+            sink += cached[0];
+        }
+        uint64_t hmacCached = benchTime() - start;
+        same &= !memcmp(legacy, cached, 16);
+
+        start = benchTime();
+        for (uint32_t r = 0; r < rounds; r++) {
+            uint8_t iv[16];
+            challengeInitialValue(iv, 0x20, request, sizeof(request), challenge);
+            AesBackend::expand(*schedule, transfert_key);
+            AesBackend::encrypt(*schedule, iv, legacy);
+            sink += legacy[0];
+        }
+        uint64_t challengeLegacy = benchTime() - start;
+        start = benchTime();
+        for (uint32_t r = 0; r < rounds; r++) {
+            uint8_t iv[16];
+            challengeInitialValue(iv, 0x20, request, sizeof(request), challenge);
+            encryptBlock(KeyId::of(KeyKind::Transfer), transfert_key, iv, cached);
+            sink += cached[0];
+        }
+        uint64_t challengeCached = benchTime() - start;
+        same &= !memcmp(legacy, cached, 16);
+        AesBackend::release(*schedule);
+        delete schedule;
+
+        printf("%u rounds, blocks %s (%u)\n", rounds, same ? "identical" : "DIFFER", sink & 1);
+        printf("1W HMAC        %8.2f us expanded per frame, %8.2f us cached\n", 1.0 * hmacLegacy / rounds, 1.0 * hmacCached / rounds);
+        printf("2W challenge   %8.2f us expanded per frame, %8.2f us cached\n", 1.0 * challengeLegacy / rounds, 1.0 * challengeCached / rounds);
+        printf("Key cache: %u hits, %u expansions, %u evictions\n", cacheStats.hits, cacheStats.expansions, cacheStats.evictions);
     }
-}
\ No newline at end of file
+}
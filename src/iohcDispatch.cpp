@@ -0,0 +1,103 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <cstdio>
+#include <cstring>
+
+#include <iohcDispatch.h>
+
+#if defined(ESP32)
+    #include <esp_timer.h>
+#else
+    #include <chrono>
+#endif
+
+namespace IOHC {
+    iohcDispatcher *iohcDispatcher::_iohcDispatcher = nullptr;
+
+    namespace {
+        uint32_t dispatchTime() {
+        #if defined(ESP32)
+            return static_cast<uint32_t>(esp_timer_get_time());
+        #else
+            return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+        #endif
+        }
+
+        void nothing(iohcPacket *) {}
+    }
+
+    iohcDispatcher *iohcDispatcher::getInstance() {
+        if (!_iohcDispatcher)
+            _iohcDispatcher = new iohcDispatcher();
+        return _iohcDispatcher;
+    }
+
+    void iohcDispatcher::on(uint8_t cmd, CommandHandler handler) {
+        table[cmd] = handler;
+    }
+
+    void iohcDispatcher::on(std::initializer_list<uint8_t> cmds, CommandHandler handler) {
+        for (uint8_t cmd: cmds) table[cmd] = handler;
+    }
+
+    void iohcDispatcher::ignore(std::initializer_list<uint8_t> cmds) {
+        on(cmds, nothing);
+    }
+
+/**
+ * The function `dispatch` runs the handler of the command of a received frame and accounts for it. It is
+ * called on the radio task, handlers must not wait.
+ *
+ * @param packet The frame received.
+ * @return false if no handler is registered for the command.
+ */
+    bool iohcDispatcher::dispatch(iohcPacket *packet) {
+        uint8_t cmd = packet->payload.packet.header.cmd;
+        CommandHandler handler = table[cmd];
+        if (!handler) {
+            unknown += 1;
+            printf("Received Unknown command %02X ", cmd);
+            return false;
+        }
+
+        uint32_t start = dispatchTime();
+        handler(packet);
+        uint32_t elapsed = dispatchTime() - start;
+
+        CommandStats &entry = stats[cmd];
+        entry.hits += 1;
+        entry.totalUs += elapsed;
+        if (elapsed > entry.maxUs) entry.maxUs = elapsed;
+        return true;
+    }
+
+    void iohcDispatcher::resetStats() {
+        memset(stats, 0, sizeof(stats));
+        unknown = 0;
+    }
+
+    void iohcDispatcher::printStats() const {
+        printf("Cmd      Hits   Avg us   Max us\n");
+        for (uint16_t cmd = 0; cmd < 256; cmd++) {
+            const CommandStats &entry = stats[cmd];
+            if (!entry.hits) continue;
+            printf(" %2.2X  %8u %8u %8u\n", cmd, entry.hits, entry.totalUs / entry.hits, entry.maxUs);
+        }
+        printf("Unknown %u\n", unknown);
+    }
+}
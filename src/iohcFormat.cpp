@@ -0,0 +1,196 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <array>
+#include <cstring>
+
+#include <iohcFormat.h>
+#include <iohcFrame.h>
+#include <iohcProtocol.h>
+
+namespace IOHC {
+    namespace {
+        // Two digits per byte value, lower then upper case
+        using HexTable = std::array<std::array<char, 512>, 2>;
+
+        constexpr HexTable hexDigits = [] {
+            HexTable t{};
+            constexpr char lower[] = "0123456789abcdef";
+            constexpr char upper[] = "0123456789ABCDEF";
+            for (unsigned i = 0; i < 256; i++) {
+                t[0][2 * i] = lower[i >> 4];
+                t[0][2 * i + 1] = lower[i & 0x0F];
+                t[1][2 * i] = upper[i >> 4];
+                t[1][2 * i + 1] = upper[i & 0x0F];
+            }
+            return t;
+        }();
+    }
+
+    size_t hexEncode(char *out, const uint8_t *in, size_t len, bool upper) {
+        const char *digits = hexDigits[upper].data();
+        for (size_t i = 0; i < len; i++) {
+            memcpy(out + 2 * i, digits + 2 * in[i], 2);
+        }
+        out[2 * len] = '\0';
+        return 2 * len;
+    }
+
+/**
+ * The function `reserve` makes room for n chars before the NUL. When the buffer is full the writer keeps
+ * what fits and marks itself truncated, later appends are dropped.
+ */
+    char *TextWriter::reserve(size_t n) {
+        if (overflow || pos + n >= size) {
+            overflow = true;
+            return nullptr;
+        }
+        char *at = buffer + pos;
+        pos += n;
+        buffer[pos] = '\0';
+        return at;
+    }
+
+    TextWriter &TextWriter::str(const char *s) {
+        return str(std::string_view(s));
+    }
+
+    TextWriter &TextWriter::str(std::string_view s) {
+        if (char *at = reserve(s.size())) memcpy(at, s.data(), s.size());
+        return *this;
+    }
+
+    TextWriter &TextWriter::chr(char c) {
+        if (char *at = reserve(1)) *at = c;
+        return *this;
+    }
+
+    TextWriter &TextWriter::hex(const uint8_t *in, size_t len) {
+        if (char *at = reserve(2 * len)) hexEncode(at, in, len);
+        return *this;
+    }
+
+    TextWriter &TextWriter::hexValue(uint32_t value, uint8_t digits, char fill) {
+        char tmp[8];
+        uint8_t n = 0;
+        do {
+            tmp[n++] = hexDigits[1][2 * (value & 0x0F) + 1];
+            value >>= 4;
+        } while (value && n < sizeof(tmp));
+        while (n < digits && n < sizeof(tmp)) tmp[n++] = fill;
+        if (char *at = reserve(n))
+            while (n) *at++ = tmp[--n];
+        return *this;
+    }
+
+    TextWriter &TextWriter::dec(uint32_t value, uint8_t digits) {
+        char tmp[10];
+        uint8_t n = 0;
+        do {
+            tmp[n++] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value);
+        while (n < digits && n < sizeof(tmp)) tmp[n++] = '0';
+        if (char *at = reserve(n))
+            while (n) *at++ = tmp[--n];
+        return *this;
+    }
+
+    TextWriter &TextWriter::fixed3(uint32_t thousandths) {
+        return dec(thousandths / 1000).chr('.').dec(thousandths % 1000, 3);
+    }
+
+/**
+ * The function `formatFrame` writes the decoded line of a frame: control bytes, addresses, data in hex,
+ * then the fields of its layout (see iohcFrame.h), with the labels and widths decode() has always printed.
+ * A short 0x30 or pairing frame gets its data alone, 2W fields past the end print as 0. Nothing is allocated,
+ * the line is cut if out is short.
+ *
+ * @param out Buffer for the line, FRAME_LINE_LEN is enough for any frame.
+ * @param elapsedUs Time since the previous frame, printed in ms with verbosity.
+ * @return Length of the line.
+ */
+    size_t formatFrame(char *out, size_t size, const iohcPacket &packet, bool verbosity, unsigned long elapsedUs) {
+        TextWriter line(out, size);
+        FrameView frame(packet);
+        const _header &header = frame.header();
+        const CB1 &cb1 = header.CtrlByte1.asStruct;
+        const CB2 &cb2 = header.CtrlByte2.asStruct;
+
+        char dir = ' ';
+        if (cb1.Protocol) dir = '>';
+        else if (cb1.StartFrame && !cb1.EndFrame) dir = '>';
+        else if (!cb1.StartFrame && cb1.EndFrame) dir = '<';
+
+        line.chr('(').dec(cb1.MsgLen, 2).str(") ").dec(cb1.Protocol ? 1 : 2).str("W S ")
+            .str(cb1.StartFrame ? "1" : "0").str(" E ").str(cb1.EndFrame ? "1" : "0").chr(' ');
+
+        if (cb2.LPM) line.str("[LPM]");
+        if (cb2.Beacon) line.str("[B]");
+        if (cb2.Routed) line.str("[R]");
+        if (cb2.Prio) line.str("[PRIO]");
+        if (cb2.Unk2) line.str("[U2]");
+        if (cb2.Unk3) line.str("[U3]");
+        if (cb2.Version) line.str("[V]").dec(cb2.Version);
+
+        line.str("\tFROM ");
+        for (uint8_t b: header.source) line.hexValue(b, 2);
+        line.str(" TO ");
+        for (uint8_t b: header.target) line.hexValue(b, 2);
+        line.str(" CMD ").hexValue(header.cmd, 2);
+
+        if (verbosity) line.str(" +").fixed3(elapsedUs).chr('\t');
+        line.chr(' ').chr(dir).chr(' ');
+
+        uint8_t dataLen = frame.descriptor().dataLen;
+        line.str(" DATA(").dec(dataLen, 2).str(") ");
+        if (frame.oneWay() || dataLen != 0) line.chr(' ').hex(frame.data().data, dataLen);
+
+        // Fields of the layout the frame was classified to, as the former decode() switch printed them
+        if (frame.has(Field::Key) && frame.has(Field::Sequence))
+            line.str("\tMANU ").hexValue(frame.u8(Field::Manufacturer)).str(" DATA ").hexValue(frame.u8(Field::Data))
+                .str(" \tKEY ").hex(frame.get(Field::Key).data, 16).str(" SEQ ").hex(frame.get(Field::Sequence).data, 2).chr(' ');
+        else if (frame.layout() == Layout::P0x2e && frame.has(Field::Hmac))
+            line.str("\tDATA ").hexValue(frame.u8(Field::Data)).chr(' ');
+        if (frame.has(Field::Hmac))
+            line.str("\tSEQ ").hex(frame.get(Field::Sequence).data, 2).str(" MAC ").hex(frame.get(Field::Hmac).data, 6).chr(' ');
+        if (frame.has(Field::Origin)) {
+            // 0x20 frames name the origin after the manufacturer, main is on its first byte for 0x00 on 14
+            bool isPrivate = frame.oneWay() && frame.cmd() == 0x20;
+            bool wide = frame.has(Field::Data);
+            uint32_t main = frame.layout() == Layout::P0x00_14 ? frame.u8(Field::Main) << 8 : frame.get(Field::Main).value();
+            line.str(!isPrivate ? " Org " : wide ? " Manu " : " Manuf ").hexValue(frame.u8(Field::Origin))
+                .str(" Acei ").hexValue(frame.u8(Field::Acei))
+                .str(" Main ").hexValue(main, wide ? 4 : 1, ' ').str(" fp1 ").hexValue(frame.u8(Field::Fp1)).chr(' ');
+            if (frame.has(Field::Fp2) || frame.layout() == Layout::P2W_0x00) line.str("fp2 ").hexValue(frame.u8(Field::Fp2)).chr(' ');
+            if (frame.has(Field::Fp3)) line.str("fp3 ").hexValue(frame.u8(Field::Fp3)).chr(' ');
+            if (wide) line.str("Data ").hexValue(frame.u16(Field::Data), 4, ' ');
+
+            if (!isPrivate) {
+                AceiUnion acei{frame.u8(Field::Acei)};
+                line.str(" Acei ").dec(acei.asStruct.level).chr(' ').dec(acei.asStruct.service).chr(' ')
+                    .dec(acei.asStruct.extended).chr(' ').dec(acei.asStruct.isvalid).chr(' ');
+            }
+        }
+
+        if (frame.oneWay()) {
+            uint16_t broadcast = (header.target[1] << 2) | ((header.target[2] >> 6) & 0x03);
+            line.str(" Type ").str(deviceTypeName(broadcast)).chr(' ');
+        }
+
+        return line.length();
+    }
+}
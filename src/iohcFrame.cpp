@@ -0,0 +1,156 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <array>
+#include <iohcFrame.h>
+
+namespace IOHC {
+    namespace {
+        constexpr uint8_t FIELDS = static_cast<uint8_t>(Field::Count);
+        constexpr uint8_t LAYOUTS = static_cast<uint8_t>(Layout::Count);
+
+        struct LayoutDesc {
+            const char *name;
+            FieldSpan fields[FIELDS];
+        };
+
+        struct FieldDef {
+            Field field;
+            uint8_t length;
+        };
+
+        // Fields are laid out one after the other, in the order given
+        template <size_t N>
+        constexpr LayoutDesc layout(const char *name, const FieldDef (&defs)[N]) {
+            LayoutDesc desc{name, {}};
+            uint8_t offset = 0;
+            for (const auto &def: defs) {
+                desc.fields[static_cast<uint8_t>(def.field)] = {offset, def.length};
+                offset += def.length;
+            }
+            return desc;
+        }
+
+        constexpr FieldDef p0x01_13[] = {{Field::Origin, 1}, {Field::Acei, 1}, {Field::Main, 1}, {Field::Fp1, 1}, {Field::Fp2, 1}, {Field::Sequence, 2}, {Field::Hmac, 6}};
+        constexpr FieldDef p0x00_14[] = {{Field::Origin, 1}, {Field::Acei, 1}, {Field::Main, 2}, {Field::Fp1, 1}, {Field::Fp2, 1}, {Field::Sequence, 2}, {Field::Hmac, 6}};
+        constexpr FieldDef p0x00_16[] = {{Field::Origin, 1}, {Field::Acei, 1}, {Field::Main, 2}, {Field::Fp1, 1}, {Field::Fp2, 1}, {Field::Data, 2}, {Field::Sequence, 2}, {Field::Hmac, 6}};
+        constexpr FieldDef p0x20_13[] = {{Field::Origin, 1}, {Field::Acei, 1}, {Field::Main, 2}, {Field::Fp1, 1}, {Field::Sequence, 2}, {Field::Hmac, 6}};
+        constexpr FieldDef p0x20_15[] = {{Field::Origin, 1}, {Field::Acei, 1}, {Field::Main, 2}, {Field::Fp1, 1}, {Field::Fp2, 1}, {Field::Fp3, 1}, {Field::Sequence, 2}, {Field::Hmac, 6}};
+        constexpr FieldDef p0x2e[] = {{Field::Data, 1}, {Field::Sequence, 2}, {Field::Hmac, 6}};
+        constexpr FieldDef p0x30[] = {{Field::Key, 16}, {Field::Manufacturer, 1}, {Field::Data, 1}, {Field::Sequence, 2}};
+        constexpr FieldDef p0x2b[] = {{Field::Actuator, 2}, {Field::Backbone, 3}, {Field::Manufacturer, 1}, {Field::Info, 1}, {Field::Timestamp, 2}};
+        constexpr FieldDef p2W_0x00[] = {{Field::Origin, 1}, {Field::Acei, 1}, {Field::Main, 1}, {Field::Fp1, 1}, {Field::Fp2, 1}};
+
+        // Indexed by Layout
+        constexpr LayoutDesc layouts[LAYOUTS] = {
+            {"raw", {}},
+            layout("0x01_13", p0x01_13),
+            layout("0x00_14", p0x00_14),
+            layout("0x00_16", p0x00_16),
+            layout("0x20_13", p0x20_13),
+            layout("0x20_15", p0x20_15),
+            layout("0x2e", p0x2e),
+            layout("0x30", p0x30),
+            layout("0x2b", p0x2b),
+            layout("2W_0x00", p2W_0x00),
+        };
+
+        // Indexed by Field
+        constexpr const char *fieldNames[FIELDS] = {
+            "origin", "acei", "main", "fp1", "fp2", "fp3", "data", "sequence", "hmac", "key",
+            "manufacturer", "actuator", "backbone", "info", "timestamp"
+        };
+
+        // Commands sharing the same choice of layout
+        enum Family : uint8_t {
+            None,
+            Execute1W,      // 0x00 0x01 0x28, layout by data length
+            Private1W,      // 0x20, layout by data length
+            Pair1W,
+            Key1W,
+            Discover,
+            Execute2W,
+            Families
+        };
+
+        using FamilyTable = std::array<std::array<uint8_t, 256>, 2>;
+        using LengthTable = std::array<std::array<Layout, FRAME_MAX_DATA_LEN + 1>, Families>;
+
+        // [2 way, 1 way][cmd]
+        constexpr FamilyTable families = [] {
+            FamilyTable t{};
+            for (uint8_t way = 0; way < 2; way++) {
+                t[way][0x29] = Discover;
+                t[way][0x2B] = Discover;
+            }
+            t[1][0x00] = t[1][0x01] = t[1][0x28] = Execute1W;
+            t[1][0x20] = Private1W;
+            t[1][0x2E] = t[1][0x39] = Pair1W;
+            t[1][0x30] = Key1W;
+            t[0][0x00] = t[0][0x01] = Execute2W;
+            return t;
+        }();
+
+        // [family][data length]
+        constexpr LengthTable layoutsByLength = [] {
+            LengthTable t{};
+            for (uint8_t len = 0; len <= FRAME_MAX_DATA_LEN; len++) {
+                t[Pair1W][len] = Layout::P0x2e;
+                t[Key1W][len] = Layout::P0x30;
+                t[Discover][len] = Layout::P0x2b;
+                t[Execute2W][len] = len ? Layout::P2W_0x00 : Layout::Raw;
+            }
+            t[Execute1W][13] = Layout::P0x01_13;
+            t[Execute1W][14] = Layout::P0x00_14;
+            t[Execute1W][16] = Layout::P0x00_16;
+            t[Private1W][13] = Layout::P0x20_13;
+            t[Private1W][15] = Layout::P0x20_15;
+            t[Private1W][16] = Layout::P0x00_16;
+            return t;
+        }();
+    }
+
+    const char *layoutName(Layout layout) {
+        return layout < Layout::Count ? layouts[static_cast<uint8_t>(layout)].name : "?";
+    }
+
+    const char *fieldName(Field field) {
+        return field < Field::Count ? fieldNames[static_cast<uint8_t>(field)] : "?";
+    }
+
+    FieldSpan layoutField(Layout layout, Field field) {
+        if (layout >= Layout::Count || field >= Field::Count) return {0, 0};
+        return layouts[static_cast<uint8_t>(layout)].fields[static_cast<uint8_t>(field)];
+    }
+
+/**
+ * The function `classify` finds the layout of a frame with two table lookups, the command family from
+ * the protocol and cmd, then the layout of that family for the data length.
+ *
+ * @param buffer Frame as received, starting with CtrlByte1.
+ * @param length Frame length, header included.
+ * @return The descriptor, with Layout::Raw if the frame is not known or shorter than its header.
+ */
+    FrameDescriptor classify(const uint8_t *buffer, uint8_t length) {
+        if (length < FRAME_HEADER_LEN) return {0, 0, Layout::Raw, 0};
+        const auto &header = *reinterpret_cast<const _header *>(buffer);
+        uint8_t oneWay = header.CtrlByte1.asStruct.Protocol;
+        uint8_t dataLen = length - FRAME_HEADER_LEN;
+        if (dataLen > FRAME_MAX_DATA_LEN) dataLen = FRAME_MAX_DATA_LEN;
+        uint8_t family = families[oneWay][header.cmd];
+        return {static_cast<uint8_t>(oneWay ? 1 : 2), header.cmd, layoutsByLength[family][dataLen], dataLen};
+    }
+}
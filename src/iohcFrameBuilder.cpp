@@ -0,0 +1,74 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <atomic>
+#include <cstring>
+
+#include <iohcFrameBuilder.h>
+
+namespace IOHC {
+    namespace {
+        iohcPacket txPool[IOHC_TX_POOL_SIZE];
+        std::atomic<bool> txBusy[IOHC_TX_POOL_SIZE];
+        std::atomic<uint32_t> txNext{0};
+    }
+
+/**
+ * The function `txSlot` lends the next free packet of the TX pool, round-robin so that a packet given
+ * back is the last one lent again. Frames are built from the console task and from the radio callback,
+ * a slot is claimed by its busy flag. With the whole pool queued or on air, the packet comes from the
+ * heap and `releaseFrame` deletes it.
+ */
+    iohcPacket *txSlot() {
+        for (uint8_t tries = 0; tries < IOHC_TX_POOL_SIZE; tries++) {
+            uint32_t slot = txNext.fetch_add(1, std::memory_order_relaxed) % IOHC_TX_POOL_SIZE;
+            bool busy = false;
+            if (txBusy[slot].compare_exchange_strong(busy, true, std::memory_order_acquire))
+                return &txPool[slot];
+        }
+        return new iohcPacket;
+    }
+
+    void releaseFrame(iohcPacket *packet) {
+        if (packet >= txPool && packet < txPool + IOHC_TX_POOL_SIZE)
+            txBusy[packet - txPool].store(false, std::memory_order_release);
+        else
+            delete packet;
+    }
+
+/**
+ * The function `buildFrame` writes a whole frame from its spec: both control bytes, the addresses,
+ * the command and the payload template, then the radio settings. The template is copied at its full
+ * size so that a reused packet keeps nothing of its previous frame.
+ */
+    iohcPacket *buildFrame(iohcPacket *packet, const FrameSpec &spec, const address source, const address target) {
+        _header &header = packet->payload.packet.header;
+        header.CtrlByte1.asByte = spec.ctrlByte1();
+        header.CtrlByte2.asByte = spec.ctrl2;
+        memcpy(header.target, target, sizeof(address));
+        memcpy(header.source, source, sizeof(address));
+        header.cmd = spec.cmd;
+        memcpy(frameData(packet), spec.data, FRAME_MAX_DATA_LEN);
+        packet->buffer_length = spec.length();
+
+        packet->frequency = CHANNEL2;
+        packet->tx.repeatTime = spec.tx.repeatTime;
+        packet->tx.repeat = spec.tx.repeat;
+        packet->tx.delayed = spec.tx.delayed;
+        packet->tx.lock = false;
+        return packet;
+    }
+}
@@ -15,8 +15,10 @@
  */
 
 #include <iohcOtherDevice2W.h>
-#include <LittleFS.h>
-#include <ArduinoJson.h>
+#if defined(ESP32)
+    #include <LittleFS.h>
+    #include <ArduinoJson.h>
+#endif
 #include <iohcCryptoHelpers.h>
 #include <string>
 #include <iohcRadio.h>
@@ -40,39 +42,9 @@ namespace IOHC {
 
     address fake_gateway = {0xba, 0x11, 0xad};
 
-    void iohcOtherDevice2W::forgePacket(iohcPacket *packet, const std::vector<uint8_t> &toSend, size_t typn = 0) {
-        digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
-        IOHC::relStamp = esp_timer_get_time();
-
-        packet->payload.packet.header.CtrlByte1.asStruct.MsgLen = sizeof(_header) - 1;
-
-        packet->payload.packet.header.cmd = 0x2A; //0x28; //typn;
-        // Common Flags
-        packet->payload.packet.header.CtrlByte1.asStruct.EndFrame = 0;
-        packet->payload.packet.header.CtrlByte2.asByte = 0;
-        packet->payload.packet.header.CtrlByte2.asStruct.Prio = 1;
-        packet->payload.packet.header.CtrlByte2.asStruct.LPM = 0;
-
-        // Broadcast Target
-        u_int16_t bcast = typn;
-        //            uint16_t bcast = /*(_type.at(typn)<<6)*/(typn)<<6 + 0b111111;
-        packet->payload.packet.header.target[0] = 0x00;
-        packet->payload.packet.header.target[1] = bcast >> 8;
-        packet->payload.packet.header.target[2] = bcast & 0x00ff;
-
-        packet->payload.packet.header.CtrlByte1.asByte += toSend.size();
-        memcpy(packet->payload.buffer + 9, toSend.data(), toSend.size());
-        packet->buffer_length = toSend.size() + 9;
-
-        packet->frequency = CHANNEL2;
-        packet->repeatTime = 50;
-        packet->repeat = 0;
-        packet->lock = false;
-    }
-
     void iohcOtherDevice2W::cmd(Other2WButton cmd, Tokens *data) {
         if (!_radioInstance) {
-            Serial.println("NO RADIO INSTANCE");
+            printf("NO RADIO INSTANCE\n");
             _radioInstance = iohcRadio::getInstance();
         }
         packets2send.clear();
@@ -80,17 +52,10 @@ namespace IOHC {
         // Emulates device button press
         switch (cmd) {
             case Other2WButton::discovery: {
-                int bec = 0;
-
+                // One frame per broadcast address, more than the TX pool holds: the rest comes from the heap
                 for (int j = 0; j < 255; j++) {
-                    packets2send.push_back(new iohcPacket);
-
-                    std::string discovery = "d430477706ba11ad31"; //28"; //"2b578ebc37334d6e2f50a4dfa9";
-                    std::vector<uint8_t> toSend = {};
-                    packets2send.back()->buffer_length = hexStringToBytes(
-                        discovery, packets2send.back()/*[j]*/->payload.buffer);
-                    forgePacket(packets2send.back()/*[j]*//*->payload.buffer[4]*/, toSend, bec);
-                    bec += 0x01;
+                    address broadcast = {0x00, 0x00, static_cast<uint8_t>(j)};
+                    packets2send.push_back(buildFrame(Frames::OtherDiscovery, fake_gateway, broadcast));
                     // packets2send.back()/*[j]*/->repeatTime = 225;
                 }
 
@@ -100,8 +65,6 @@ namespace IOHC {
             }
             case Other2WButton::getName: {
 
-                std::vector<uint8_t> toSend = {}; // {0x0C, 0x60, 0x01, 0xFF};
-
                 // const char* dat = data->at(1).c_str();
 
                 int value = std::stol(data->at(1).c_str(), nullptr, 16);
@@ -112,20 +75,7 @@ namespace IOHC {
                 // uint8_t target[3] = {0x08, 0x42, 0xE3};
                 // toSend[3] = custom;
 
-                packets2send.push_back(new iohcPacket);
-                forgePacket(packets2send.back(), toSend, 0);
-                packets2send.back()->payload.packet.header.cmd = SEND_GET_NAME_0x50;
-                // memorizeSend.memorizedData = toSend;
-                // memorizeSend.memorizedCmd = SEND_WRITE_PRIVATE_0x20;
-
-                packets2send.back()->payload.packet.header.CtrlByte1.asStruct.StartFrame = 1;
-//                packets2send.back()->payload.packet.header.CtrlByte1.asByte += toSend.size();
-
-                memcpy(packets2send.back()->payload.packet.header.source, fake_gateway, 3);
-                memcpy(packets2send.back()->payload.packet.header.target, target, 3);
-
-//                memcpy(packets2send.back()->payload.buffer + 9, toSend.data(), toSend.size());
-//                packets2send.back()->buffer_length = toSend.size() + 9;
+                packets2send.push_back(buildFrame(Frames::OtherGetName, fake_gateway, target));
 
                 digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
                 // packets2send.back()->delayed = 501;
@@ -133,7 +83,6 @@ namespace IOHC {
                 break;
             }
             case Other2WButton::custom: {
-                std::vector<uint8_t> toSend = {0x01, 0x47, 0xc8, 0x00, 0x00, 0x00};
                 //{0x03, 0x65, 0xd4, 0x00, 0x00, 0x00}; //{0x0C, 0x60, 0x01, 0xFF, 0xFF};
                 //const char* dat = data->at(1).c_str();
                 for (int acei = 0; acei < 256; acei++) {
@@ -143,92 +92,40 @@ namespace IOHC {
                     // Only other ACEI are valids, other give answer: 0xFE 0x58
                     if (!ACEI.asStruct.isvalid || ACEI.asStruct.service != 0) continue;
 
-                    toSend[1] = acei; //custom;
-                    // toSend[2] = acei;
-
                     address from = {0x08, 0x42, 0xe3}; //data->at(1).c_str(); //
                     address to = {0xda, 0x2e, 0xe6}; //
                     address to_1 = {0x05, 0x4e, 0x17}; //{0x31, 0x58, 0x24}; //
 
 //                    packets2send.clear();
-                    packets2send.push_back(new iohcPacket);
-                    forgePacket(packets2send.back(), toSend);
-
-                    packets2send.back()->payload.packet.header.cmd = 0x00; //SEND_WRITE_PRIVATE_0x20;
-                    memorizeOther2W.memorizedData = toSend;
-                    memorizeOther2W.memorizedCmd = 0x00; //SEND_WRITE_PRIVATE_0x20;
-
-                    packets2send.back()->payload.packet.header.CtrlByte1.asStruct.StartFrame = 1;
-
-                    packets2send.back()->payload.packet.header.CtrlByte2.asStruct.LPM = 1;
-                    packets2send.back()->payload.packet.header.CtrlByte2.asStruct.Prio = 1;
-
-                    memcpy(packets2send.back()->payload.packet.header.source, from/*gateway*/, 3);
-                    memcpy(packets2send.back()->payload.packet.header.target, to_1, 3);
-
-                    packets2send.back()->delayed = 250; // Give enough time for the answer
+                    auto *packet = buildFrame(Frames::OtherCustom, from/*gateway*/, to_1);
+                    frameData(packet)[1] = acei; //custom;
+                    packets2send.push_back(packet);
                 }
                 digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
                 _radioInstance->send(packets2send);
                 break;
             }
             case Other2WButton::custom60: {
-                std::vector<uint8_t> toSend = {0x0C, 0x60, 0x01, 0xFF};
                 // Accepted command {0x0C, 0x61, 0x01, 0xFF, FF};
-                const char *dat = data->at(1).c_str();
-
                 //                for (int custom = 0; custom < 256; custom++) {
                 int custom = std::stoi(data->at(1));
 
-                toSend[3] = custom; //custom;
-
 //                packets2send.clear();
-                packets2send.push_back(new iohcPacket);
-                forgePacket(packets2send.back(), toSend);
-
-                packets2send.back()->payload.packet.header.cmd = iohcDevice::SEND_WRITE_PRIVATE_0x20;
-                memorizeOther2W.memorizedData = toSend;
-                memorizeOther2W.memorizedCmd = iohcDevice::SEND_WRITE_PRIVATE_0x20;
-
-                packets2send.back()->payload.packet.header.CtrlByte1.asStruct.StartFrame = 1;
-
-                // packets2send.back()->payload.packet.header.CtrlByte2.asStruct.LPM = 1;
-                // packets2send.back()->payload.packet.header.CtrlByte2.asStruct.Prio = 1;
+                auto *packet = buildFrame(Frames::OtherCustom60, gateway/*master_from*/, master_to/*slave_to*/);
+                frameData(packet)[3] = custom; //custom;
+                packets2send.push_back(packet);
 
-                memcpy(packets2send.back()->payload.packet.header.source, gateway/*master_from*/, 3);
-                memcpy(packets2send.back()->payload.packet.header.target, master_to/*slave_to*/, 3);
-
-                packets2send.back()->delayed = 250;
                 digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
                 _radioInstance->send(packets2send);
                 break;
             }
             case Other2WButton::discover28: {
-                std::vector<uint8_t> toSend = {};
-
                 //                uint8_t broadcast[3];
                 address broadcast = {0x00, 0xFF, 0xFB}; //{0x02, 0x02, 0xFB}; //data->at(1).c_str();
                 //            hexStringToBytes(dat, broadcast);
 //                packets2send.clear();
-                size_t i = 0;
-                for (i = 0; i < 10; i++) {
-                    packets2send.push_back(new iohcPacket);
-                    forgePacket(packets2send[i], toSend);
-
-                    packets2send[i]->payload.packet.header.cmd = iohcDevice::SEND_DISCOVER_0x28;
-                    memorizeOther2W.memorizedData = toSend;
-                    memorizeOther2W.memorizedCmd = iohcDevice::SEND_DISCOVER_0x28;
-
-                    packets2send[i]->payload.packet.header.CtrlByte1.asStruct.StartFrame = 1;
-                    packets2send[i]->payload.packet.header.CtrlByte1.asStruct.EndFrame = 1;
-
-                    packets2send.back()->payload.packet.header.CtrlByte2.asStruct.LPM = 1;
-                    packets2send.back()->payload.packet.header.CtrlByte2.asStruct.Prio = 1;
-
-                    memcpy(packets2send[i]->payload.packet.header.source, gateway, 3);
-                    memcpy(packets2send[i]->payload.packet.header.target, broadcast, 3);
-
-                    packets2send[i]->delayed = 250; // Give enough time for the answer
+                for (size_t i = 0; i < 10; i++) {
+                    packets2send.push_back(buildFrame(Frames::OtherDiscover28, gateway, broadcast));
                 }
                 digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
                 _radioInstance->send(packets2send);
@@ -252,42 +149,15 @@ namespace IOHC {
 
 //                packets2send.clear();
                 for (size_t i = 0; i < 30; i++) {
-                    packets2send.push_back(new iohcPacket);
-
-                    if (i > 20) {
-                        std::vector<uint8_t> toSend = {0x00};
-                        forgePacket(packets2send.back(), toSend);
-                        packets2send.back()->payload.packet.header.cmd = iohcDevice::SEND_UNKNOWN_0x2E;
-                        memcpy(packets2send.back()->payload.packet.header.target, broadcast_3f, 3);
-                    }
-                    if (i <= 20) {
-                        std::vector<uint8_t> toSend = {};
-                        forgePacket(packets2send.back(), toSend);
-                        packets2send.back()->payload.packet.header.cmd = iohcDevice::SEND_DISCOVER_0x28;
-                        memcpy(packets2send.back()->payload.packet.header.target, broadcast_3b, 3);
-                    }
-                    if (i <= 10) {
-                        std::vector<uint8_t> toSend = {
-                            0x93, 0x32, 0xd6, 0x18, 0xde, 0x2a, 0x0f, 0xa6, 0x25, 0x0e, 0x2c, 0x7e
-                        };
-                        forgePacket(packets2send.back(), toSend);
-                        packets2send.back()->payload.packet.header.cmd = iohcDevice::SEND_DISCOVER_REMOTE_0x2A;
-                        memcpy(packets2send.back()->payload.packet.header.target, broadcast_3b, 3);
-                    }
-                    //                    packets2send.back()->payload.packet.header.cmd = iohcDevice::SEND_DISCOVER_REMOTE_0x2A;
+                    if (i <= 10)
+                        packets2send.push_back(buildFrame(Frames::OtherDiscover2A, /*from*/real/*gateway*/, broadcast_3b));
+                    else if (i <= 20)
+                        packets2send.push_back(buildFrame(Frames::OtherDiscover28, /*from*/real/*gateway*/, broadcast_3b));
+                    else
+                        packets2send.push_back(buildFrame(Frames::OtherUnknown2E, /*from*/real/*gateway*/, broadcast_3f));
 
                     //                    memorizeSend.memorizedData = toSend; //.assign(toSend, toSend + 12);
                     //                    memorizeSend.memorizedCmd = iohcDevice::SEND_DISCOVER_REMOTE_0x2A;
-
-                    packets2send.back()->payload.packet.header.CtrlByte1.asStruct.StartFrame = 1;
-                    packets2send.back()->payload.packet.header.CtrlByte1.asStruct.EndFrame = 1;
-
-                    packets2send.back()->payload.packet.header.CtrlByte2.asStruct.LPM = 1;
-                    packets2send.back()->payload.packet.header.CtrlByte2.asStruct.Prio = 1;
-
-                    memcpy(packets2send.back()->payload.packet.header.source, /*from*/real/*gateway*/, 3);
-
-                    packets2send.back()->delayed = 250; // Give enough time for the answer
                 }
                 digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
 
@@ -298,8 +168,6 @@ namespace IOHC {
             case Other2WButton::fake0: {
                 // 09:54:36.226 > (14) 2W S 1 E 0  FROM 0842E3 TO 14E00E CMD 00, F868.950 s+0.000   >  DATA(06)  03 e7 00 00 00 00
                 //                digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
-                /*std::vector<uint8_t>*/
-                std::vector<uint8_t> toSend = {0x03, 0xe7, 0x32, 0x00, 0x00, 0x00};
                 //{0x03, 0x00, 0x00}; //  Not good for Cmd 0x01 Answer FE 0x10
 
                 address gateway = {0xba, 0x11, 0xad}; //{0x08, 0x42, 0xe3};
@@ -314,25 +182,9 @@ namespace IOHC {
                 };
 
 //                packets2send.clear();
-                size_t i = 0;
-                for (i = 0; i < 15; i++) {
-                    packets2send.push_back(new iohcPacket);
-                    forgePacket(packets2send.back(), toSend);
-
-                    packets2send.back()->payload.packet.header.cmd = 0x00;
-                    memorizeOther2W.memorizedData = toSend;
-                    memorizeOther2W.memorizedCmd = 0x00;
+                for (size_t i = 0; i < 15; i++) {
+                    packets2send.push_back(buildFrame(Frames::OtherFake0, from/*gateway*/, guessed[i]));
                     IOHC::lastSendCmd = 0x00;
-
-                    packets2send.back()->payload.packet.header.CtrlByte1.asStruct.StartFrame = 1;
-
-                    packets2send.back()->payload.packet.header.CtrlByte2.asStruct.LPM = 1;
-                    // packets2send.back()->payload.packet.header.CtrlByte2.asStruct.Unk1 = 1;
-
-                    memcpy(packets2send.back()->payload.packet.header.source, from/*gateway*/, 3);
-                    memcpy(packets2send.back()->payload.packet.header.target, guessed[i], 3);
-
-                    packets2send.back()->delayed = 250; // Give enough time for the answer
                 }
                 digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
                 _radioInstance->send(packets2send);
@@ -340,20 +192,8 @@ namespace IOHC {
                 break;
             }
             case Other2WButton::ack: {
-                std::vector<uint8_t> toSend = {};
-
 //                packets2send.clear();
-                packets2send.push_back(new iohcPacket);
-                forgePacket(packets2send.back(), toSend);
-
-                packets2send.back()->payload.packet.header.cmd = iohcDevice::SEND_KEY_TRANSFERT_ACK_0x33;
-                memorizeOther2W.memorizedCmd = iohcDevice::SEND_KEY_TRANSFERT_ACK_0x33;
-                memorizeOther2W.memorizedData = toSend;
-
-                packets2send.back()->payload.packet.header.CtrlByte1.asStruct.StartFrame = 1;
-
-                memcpy(packets2send.back()->payload.packet.header.source, gateway, 3);
-                memcpy(packets2send.back()->payload.packet.header.target, master_from, 3);
+                packets2send.push_back(buildFrame(Frames::OtherAck, gateway, master_from));
 
                 digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
                 _radioInstance->send(packets2send);
@@ -361,6 +201,7 @@ namespace IOHC {
             }
             case Other2WButton::checkCmd: {
                 std::vector<uint8_t> toSend;
+                toSend.reserve(FRAME_MAX_DATA_LEN);
                 // = {}; //{0x01, 0x02, 0x03, 0x04, 0x05, 0x06}; //, 0x07, 0x08, 0x09, 0x10, 0x11, 0x12};
                 uint8_t special12[] = {
                     0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16,
@@ -418,28 +259,16 @@ namespace IOHC {
                         if (command.first == 0x60 || command.first == 0x82)
                             toSend.assign(special12, special12 + 21);
 
-                        packets2send.push_back(new iohcPacket);
-                        forgePacket(packets2send.back(), toSend);
-                        packets2send.back()->payload.packet.header.cmd = command.first;
-                        memorizeOther2W.memorizedCmd = packets2send.back()->payload.packet.header.cmd;
-
-                        packets2send.back()->payload.packet.header.CtrlByte1.asStruct.StartFrame = 1;
-                        packets2send.back()->payload.packet.header.CtrlByte1.asStruct.EndFrame = 0;
-                        packets2send.back()->payload.packet.header.CtrlByte2.asStruct.LPM = 1;
-                        packets2send.back()->payload.packet.header.CtrlByte2.asStruct.Prio = 1;
-
-                        memcpy(packets2send.back()->payload.packet.header.source, gateway/*from*//*gateway*/, 3);
+                        // As many frames as valid commands, they can outnumber the TX pool and come from the heap
+                        FrameSpec probe = Frames::OtherCheck.with(command.first, toSend.data(), toSend.size());
                         // if (command.first == 0x14 || command.first == 0x19 || command.first == 0x1e || command.first == 0x2a || command.first == 0x34 || command.first == 0x4a) {
-                        // memcpy(packets2send.back()->payload.packet.header.target, broad, 3);
-                        // } else {
-                        memcpy(packets2send.back()->payload.packet.header.target, master_to, 3);
+                        // target broad
                         // }
-
-                        packets2send.back()->delayed = 245;
+                        packets2send.push_back(buildFrame(probe, gateway/*from*//*gateway*/, master_to));
                     }
                     toSend.clear();
                 }
-                Serial.printf("valid %u\n", counter);
+                printf("valid %u\n", counter);
                 digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
 
                 _radioInstance->send(packets2send);
@@ -451,6 +280,26 @@ namespace IOHC {
         //        save(); // Save Other associated devices
     }
 
+    /**
+    * @brief Registers the answers recorded while scanning (scanMode) against the command that was sent
+    * @param dispatcher Table of the received commands
+    */
+    void iohcOtherDevice2W::registerHandlers(iohcDispatcher *dispatcher) {
+        // Commands of other controllers, followed by the transactions when they are ours
+        dispatcher->ignore({0x00, 0x01, 0x03, 0x19});
+
+        dispatcher->on({0x04, 0x0D, RECEIVED_DISCOVER_ACTUATOR_ACK_0x2D, 0x4B, 0x55, 0x57, 0x59}, [](iohcPacket *iohc) {
+            if (!Cmd::scanMode) return;
+            getInstance()->mapValid[IOHC::lastSendCmd] = iohc->payload.packet.header.cmd;
+        });
+
+        // Status, its first byte tells why the command was refused
+        dispatcher->on(RECEIVED_STATUS_0xFE, [](iohcPacket *iohc) {
+            if (!Cmd::scanMode) return;
+            getInstance()->mapValid[IOHC::lastSendCmd] = iohc->payload.buffer[9];
+        });
+    }
+
     /* Initialise all valids commands for scanMode(checkCmd), other arent implemented in 2W devices
      00 04 - 01 04 - 03 04 - 0a 0D - 0c 0D - 19 1a - 1e fe - 20 21 - 23 24 - 28 29 - 2a(12) 2b - 2c 2d - 2e 2f - 31 3c - 32(16) 33 - 36 37 - 38(6) 32 - 39 fe - 3c(6) 3d - 46(9) 47 - 48(9) 49 - 4a(18) 4b
      50 51 - 52(16) 53 - 54 55 - 56 57 - 60(21) .. - 64(2) 65 - 6e(9) fe - 6f(9) .. - 71 72 - 73(3) .. - 80 81 - 82(21) .. - 84  85 - 86 87 - 88 89 - 8a(18) 8c - 8b(1) 8c - 8e .. - 90 91 - 92(16) 93 - 94 95 - 96(12) 97 - 98 99
@@ -514,6 +363,11 @@ namespace IOHC {
 
     bool iohcOtherDevice2W::load() {
         _radioInstance = iohcRadio::getInstance();
+    #if !defined(ESP32)
+        // No filesystem on the host
+        printf("*2W Other devices not available\n");
+        return false;
+    #else
         if (LittleFS.exists(OTHER_2W_FILE))
             Serial.printf("Loading Other 2W devices settings from %s\n", OTHER_2W_FILE);
         else {
@@ -548,6 +402,7 @@ namespace IOHC {
         }
 
         return true;
+    #endif
     }
 
     /**
@@ -557,6 +412,9 @@ namespace IOHC {
      * @return false
      */
     bool iohcOtherDevice2W::save() {
+    #if !defined(ESP32)
+        return false;
+    #else
         fs::File f = LittleFS.open(OTHER_2W_FILE, "a+");
         /*Dynamic*/
         JsonDocument doc; //(256);
@@ -584,5 +442,6 @@ namespace IOHC {
         f.close();
 
         return true;
+    #endif
     }
 }
@@ -0,0 +1,154 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <cstring>
+
+#include <iohcFormat.h>
+#include <iohcFrame.h>
+#include <iohcPcap.h>
+#include <iohcProtocol.h>
+
+namespace IOHC {
+    namespace {
+        constexpr uint32_t SECTION_HEADER_BLOCK = 0x0A0D0D0A;
+        constexpr uint32_t INTERFACE_DESCRIPTION_BLOCK = 0x00000001;
+        constexpr uint32_t ENHANCED_PACKET_BLOCK = 0x00000006;
+        constexpr uint32_t BYTE_ORDER_MAGIC = 0x1A2B3C4D;
+
+        constexpr uint16_t OPT_ENDOFOPT = 0;
+        constexpr uint16_t OPT_COMMENT = 1;
+        constexpr uint16_t SHB_USERAPPL = 4;
+        constexpr uint16_t IF_NAME = 2;
+        constexpr uint16_t IF_DESCRIPTION = 3;
+        constexpr uint16_t IF_TSRESOL = 9;
+        constexpr uint16_t EPB_FLAGS = 2;
+
+        constexpr uint32_t EPB_INBOUND = 1;
+        constexpr uint32_t EPB_OUTBOUND = 2;
+
+        // One block in host byte order, as pcapng allows with its byte order magic
+        class Block {
+        public:
+            explicit Block(uint32_t type) { u32(type).u32(0); }
+
+            Block &u16(uint16_t v) { return bytes(&v, sizeof(v)); }
+            Block &u32(uint32_t v) { return bytes(&v, sizeof(v)); }
+
+            Block &bytes(const void *data, size_t len) {
+                if (size + len > sizeof(buffer)) {
+                    overflow = true;
+                    return *this;
+                }
+                memcpy(buffer + size, data, len);
+                size += len;
+                return *this;
+            }
+
+            Block &pad() {
+                static constexpr uint8_t zeros[4] = {};
+                return bytes(zeros, (4 - size % 4) % 4);
+            }
+
+            Block &option(uint16_t code, const void *data, size_t len) {
+                return u16(code).u16(static_cast<uint16_t>(len)).bytes(data, len).pad();
+            }
+
+            Block &option(uint16_t code, const char *text) { return option(code, text, strlen(text)); }
+
+            // Closes the options, then writes the total length at both ends of the block
+            void send(const PcapWriter::Sink &sink) {
+                u16(OPT_ENDOFOPT).u16(0);
+                uint32_t total = size + sizeof(uint32_t);
+                u32(total);
+                memcpy(buffer + 4, &total, sizeof(total));
+                if (!overflow) sink(buffer, size);
+            }
+
+        private:
+            uint8_t buffer[PCAP_BLOCK_MAX]{};
+            size_t size = 0;
+            bool overflow = false;
+        };
+    }
+
+/**
+ * The function `begin` writes the section header and the single interface of the stream, with
+ * microsecond timestamps and PCAP_LINKTYPE_IOHC frames.
+ */
+    void PcapWriter::begin(const char *interfaceName) {
+        Block(SECTION_HEADER_BLOCK)
+            .u32(BYTE_ORDER_MAGIC).u16(1).u16(0)
+            .u32(0xFFFFFFFF).u32(0xFFFFFFFF)    // Section length unknown, the stream is written as it goes
+            .option(SHB_USERAPPL, "iown-homecontrol")
+            .send(sink);
+
+        const uint8_t tsresol = 6;
+        Block(INTERFACE_DESCRIPTION_BLOCK)
+            .u16(PCAP_LINKTYPE_IOHC).u16(0).u32(sizeof(PcapPseudoHeader) + MAX_FRAME_LEN)
+            .option(IF_NAME, interfaceName)
+            .option(IF_DESCRIPTION, "io-homecontrol radio, time since boot")
+            .option(IF_TSRESOL, &tsresol, sizeof(tsresol))
+            .send(sink);
+    }
+
+/**
+ * The function `frame` writes one captured frame as an Enhanced Packet Block. The frame is classified
+ * again to fill the pseudo header, and its layout and command names go in the comment so that the
+ * capture reads without the dissector.
+ */
+    void PcapWriter::frame(const CaptureRecord &rec) {
+        uint8_t length = rec.length < MAX_FRAME_LEN ? rec.length : MAX_FRAME_LEN;
+        FrameView view(rec.frame, length);
+
+        PcapPseudoHeader pseudo{};
+        pseudo.version = PCAP_PSEUDO_VERSION;
+        pseudo.headerLength = sizeof(pseudo);
+        pseudo.flags = (rec.direction == Direction::Tx ? PCAP_FLAG_TX : 0) | (view.oneWay() ? PCAP_FLAG_1W : 0) |
+                       (view.layout() != Layout::Raw ? PCAP_FLAG_CLASSIFIED : 0) |
+                       (rec.length > MAX_FRAME_LEN ? PCAP_FLAG_TRUNCATED : 0);
+        pseudo.frequency = rec.frequency;
+        pseudo.afc = rec.afc;
+        pseudo.rssi = rec.rssi;
+        pseudo.layout = static_cast<uint8_t>(view.layout());
+        pseudo.cmd = view.cmd();
+
+        char comment[64];
+        TextWriter text(comment, sizeof(comment));
+        text.str(layoutName(view.layout()));
+        if (length >= FRAME_HEADER_LEN) text.chr(' ').str(commandName(view.cmd()));
+
+        uint32_t captured = sizeof(pseudo) + length;
+        uint32_t flags = rec.direction == Direction::Tx ? EPB_OUTBOUND : EPB_INBOUND;
+        Block(ENHANCED_PACKET_BLOCK)
+            .u32(0)
+            .u32(static_cast<uint32_t>(rec.timestampUs >> 32)).u32(static_cast<uint32_t>(rec.timestampUs))
+            .u32(captured).u32(sizeof(pseudo) + rec.length)
+            .bytes(&pseudo, sizeof(pseudo)).bytes(rec.frame, length).pad()
+            .option(EPB_FLAGS, &flags, sizeof(flags))
+            .option(OPT_COMMENT, text.c_str())
+            .send(sink);
+    }
+
+    void printPcapBlock(const uint8_t *block, size_t size) {
+        char line[2 * PCAP_BLOCK_MAX + 1];
+        hexEncode(line, block, size < PCAP_BLOCK_MAX ? size : PCAP_BLOCK_MAX);
+        printf(PCAP_LINE_PREFIX "%s\n", line);
+    }
+
+    PcapWriter::Sink filePcapSink(FILE *file) {
+        return [file](const uint8_t *block, size_t size) { fwrite(block, 1, size, file); };
+    }
+}
@@ -14,21 +14,29 @@
    limitations under the License.
  */
 
-#include <esp32-hal-gpio.h>
+#include <cstring>
 #include <map>
-
+#include <type_traits>
+
+#include <iohcAuth1W.h>
+#include <iohcCapture.h>
+#include <iohcCrc.h>
+#include <iohcFrameBuilder.h>
+#include <iohcSequence.h>
+#include <iohcSniffer.h>
+#include <iohcTransaction.h>
 #include <iohcRadio.h>
 #include <utility>
 
 namespace IOHC {
-    iohcRadio *iohcRadio::_iohcRadio = nullptr;
-    volatile bool iohcRadio::_g_preamble = false;
-    volatile bool iohcRadio::_g_payload = false;
-    volatile unsigned long iohcRadio::_g_payload_millis = 0L;
-    uint8_t iohcRadio::_flags[2] = {0, 0};
-    volatile bool iohcRadio::f_lock = false;
-    volatile bool iohcRadio::send_lock = false;
-    volatile bool iohcRadio::txMode = false;
+    template <typename Transceiver> iohcRadioT<Transceiver> *iohcRadioT<Transceiver>::_iohcRadio = nullptr;
+    template <typename Transceiver> volatile bool iohcRadioT<Transceiver>::_g_preamble = false;
+    template <typename Transceiver> volatile bool iohcRadioT<Transceiver>::_g_payload = false;
+    template <typename Transceiver> volatile bool iohcRadioT<Transceiver>::_g_fifo = false;
+    template <typename Transceiver> volatile unsigned long iohcRadioT<Transceiver>::_g_payload_millis = 0L;
+    template <typename Transceiver> volatile bool iohcRadioT<Transceiver>::f_lock = false;
+    template <typename Transceiver> volatile bool iohcRadioT<Transceiver>::send_lock = false;
+    template <typename Transceiver> volatile bool iohcRadioT<Transceiver>::txMode = false;
 
     TaskHandle_t handle_interrupt;
     /**
@@ -37,56 +45,62 @@ namespace IOHC {
      *
      * @param pvParameters The `pvParameters` parameter in the `handle_interrupt_task` function is a void
      * pointer that can be used to pass any data or object to the task when it is created. In this specific
-     * function, it is being cast to a pointer of type `iohcRadio` and then passed to the
+     * function, it is being cast to a pointer of type `iohcRadioT` and then passed to the
      */
-    void IRAM_ATTR handle_interrupt_task(void *pvParameters) {
-        static uint32_t thread_notification;
+    template <typename Transceiver>
+    void IRAM_ATTR iohcRadioT<Transceiver>::handle_interrupt_task(void *pvParameters) {
         const TickType_t xMaxBlockTime = pdMS_TO_TICKS(655 * 4); // 218.4 );
-        while (true) {
-            thread_notification = ulTaskNotifyTake(pdTRUE, xMaxBlockTime/*xNoDelay*/); // Attendre la notification
-            if (thread_notification && (iohcRadio::_g_payload || iohcRadio::_g_preamble)) {
-                iohcRadio::tickerCounter((iohcRadio *) pvParameters);
-            }
+        auto *radio = (iohcRadioT *) pvParameters;
+        while (true)
+            radio->service(ulTaskNotifyTake(pdTRUE, xMaxBlockTime/*xNoDelay*/)); // Attendre la notification
+    }
+
+/**
+ * The function `service` handles one wake up of the radio task: the interrupt lines that notified it,
+ * or the receiver check when it was idle for its whole block time.
+ *
+ * @param notification Notifications taken, 0 on the block time out.
+ */
+    template <typename Transceiver>
+    void IRAM_ATTR iohcRadioT<Transceiver>::service(uint32_t notification) {
+        if (notification && (_g_payload || _g_preamble || _g_fifo)) {
+            tickerCounter(this);
+        } else if (!notification && scan_freqs && !txMode && packets2send.empty()) {
+            // Idle for xMaxBlockTime, make sure the receiver is still listening
+            watchdog.check(scan_freqs[currentFreqIdx]);
         }
     }
 
     /**
-     * The function `handle_interrupt_fromisr` reads digital inputs and notifies a thread to wake up when
+     * The function `handle_interrupt_fromisr` reads the radio interrupt lines and notifies a thread to wake up when
      * the interrupt service routine is complete.
      */
-    void IRAM_ATTR handle_interrupt_fromisr(/*void *arg*/) {
-        iohcRadio::_g_preamble = digitalRead(RADIO_PREAMBLE_DETECTED);
-        iohcRadio::f_lock = iohcRadio::_g_preamble;
-        iohcRadio::_g_payload = digitalRead(RADIO_PACKET_AVAIL);
+    template <typename Transceiver>
+    void IRAM_ATTR iohcRadioT<Transceiver>::handle_interrupt_fromisr(/*void *arg*/) {
+        Radio::Irq irq = Transceiver::readPins();
+        _g_preamble = irq.preamble;
+        f_lock = _g_preamble;
+        _g_payload = irq.payload;
+        _g_fifo = irq.fifoLevel;
         // Notify the thread so it will wake up when the ISR is complete
         BaseType_t xHigherPriorityTaskWoken = pdFALSE;
         vTaskNotifyGiveFromISR(handle_interrupt/*_task*/, &xHigherPriorityTaskWoken);
         portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
     }
 
-    iohcRadio::iohcRadio() {
-        Radio::initHardware();
-        Radio::calibrate();
-
-        Radio::initRegisters(MAX_FRAME_LEN);
-        Radio::setCarrier(Radio::Carrier::Deviation, 19200);
-        Radio::setCarrier(Radio::Carrier::Bitrate, 38400);
-        Radio::setCarrier(Radio::Carrier::Bandwidth, 250);
-        Radio::setCarrier(Radio::Carrier::Modulation, Radio::Modulation::FSK);
+    template <typename Transceiver>
+    iohcRadioT<Transceiver>::iohcRadioT() : watchdog(esp_timer_get_time) {
+        static_assert(std::is_base_of_v<Radio::Transceiver<Transceiver>, Transceiver>,
+                      "Radio backend must derive from Radio::Transceiver<Backend>");
+        static_assert(!std::is_polymorphic_v<iohcRadioT>, "No vtable on the radio path");
+        Transceiver::init();
+        txMutex = xSemaphoreCreateMutex();
 
         // Attach interrupts to Preamble detected and end of packet sent/received
         /* TODO this is wrongly named and/or assigned, but work like that*/
         //        printf("Starting TickTimer Handler...\n");
         //        TickTimer.attach_us(SM_GRANULARITY_US/*SM_GRANULARITY_MS*/, tickerCounter, this);
-#if defined(RADIO_SX127X)
-        //        attachInterrupt(RADIO_PACKET_AVAIL, i_payload, CHANGE); //
-        //        attachInterrupt(RADIO_PREAMBLE_DETECTED, i_preamble, CHANGE); //
-        attachInterrupt(RADIO_DIO0_PIN, handle_interrupt_fromisr, RISING); //CHANGE); //
-        //        attachInterrupt(RADIO_DIO1_PIN, handle_interrupt_fromisr, RISING); // CHANGE); //
-        attachInterrupt(RADIO_DIO2_PIN, handle_interrupt_fromisr, RISING); //CHANGE); //
-#elif defined(CC1101)
-        attachInterrupt(RADIO_PREAMBLE_DETECTED, i_preamble, RISING);
-#endif
+        Transceiver::attachInterrupts(handle_interrupt_fromisr);
 
         // start state machine
         printf("Starting Interrupt Handler...\n");
@@ -101,14 +115,15 @@ namespace IOHC {
     }
 
     /**
-     * @brief The function `iohcRadio::getInstance()` returns a pointer to a single instance of the `iohcRadio`
+     * @brief The function `iohcRadioT::getInstance()` returns a pointer to a single instance of the `iohcRadioT`
      * class, creating it if it doesn't already exist.
      *
-     * @return An instance of the `iohcRadio` class is being returned.
+     * @return An instance of the `iohcRadioT` class is being returned.
      */
-    iohcRadio *iohcRadio::getInstance() {
+    template <typename Transceiver>
+    iohcRadioT<Transceiver> *iohcRadioT<Transceiver>::getInstance() {
         if (!_iohcRadio)
-            _iohcRadio = new iohcRadio();
+            _iohcRadio = new iohcRadioT();
         return _iohcRadio;
     }
 
@@ -132,20 +147,22 @@ namespace IOHC {
  * type `IohcPacketDelegate`. It is a callback function that will be called when a packet is
  * transmitted by the radio. This callback function can be provided by the user of the `
  */
-    void iohcRadio::start(uint8_t num_freqs, uint32_t *scan_freqs, uint32_t scanTimeUs,
-                          IohcPacketDelegate rxCallback = nullptr, IohcPacketDelegate txCallback = nullptr) {
+    template <typename Transceiver>
+    void iohcRadioT<Transceiver>::start(uint8_t num_freqs, uint32_t *scan_freqs, uint32_t scanTimeUs,
+                          IohcPacketDelegate rxCallback, IohcPacketDelegate txCallback) {
         this->num_freqs = num_freqs;
         this->scan_freqs = scan_freqs;
         this->scanTimeUs = scanTimeUs ? scanTimeUs : DEFAULT_SCAN_INTERVAL_US;
         this->rxCB = std::move(rxCallback);
         this->txCB = std::move(txCallback);
 
-        Radio::clearBuffer();
-        Radio::clearFlags();
+        Transceiver::clearFifo();
+        Transceiver::clearFlags();
         /* We always start at freq[0] the 1W/2W channel*/
-        Radio::setCarrier(Radio::Carrier::Frequency, scan_freqs[0]); //868950000);
+        Transceiver::setFrequency(scan_freqs[0]); //868950000);
         // Radio::calibrate();
-        Radio::setRx();
+        Transceiver::setRx();
+        watchdog.arm();
     }
 
 /**
@@ -160,19 +177,21 @@ namespace IOHC {
  * based on the conditions met within the function. Here is a breakdown of the possible return
  * scenarios:
  */
-    void IRAM_ATTR iohcRadio::tickerCounter(iohcRadio *radio) {
+    template <typename Transceiver>
+    void IRAM_ATTR iohcRadioT<Transceiver>::tickerCounter(iohcRadioT *radio) {
         // Not need to put in IRAM as we reuse task for µs instead ISR
-#if defined(RADIO_SX127X)
-        Radio::readBytes(REG_IRQFLAGS1, _flags, sizeof(_flags));
+        Radio::Status status = Transceiver::status();
 
         // If Int of PayLoad
         if (_g_payload) {
             // if TX ready?
-            if (_flags[0] & RF_IRQFLAGS1_TXREADY) {
+            if (status.txReady) {
                 radio->sent(radio->iohc);
-                Radio::clearFlags();
+                // Last emission of the frame, its packet goes back to the TX pool
+                if (radio->iohc->tx.repeat == 0) releaseFrame(radio->iohc);
+                Transceiver::clearFlags();
                 if (!txMode) {
-                    Radio::setRx();
+                    Transceiver::setRx();
                     f_lock = false;
                 }
                 // radio->sent(radio->iohc); // Put after Workaround to permit MQTT sending. No more needed
@@ -180,21 +199,31 @@ namespace IOHC {
             }
             // if in RX mode?
             radio->receive(false);
-            Radio::clearFlags();
+            Transceiver::clearFlags();
             radio->tickCounter = 0;
             radio->preCounter = 0;
             return;
         }
 
+        // FIFO above threshold while the frame is still arriving
+        if (_g_fifo) {
+            if (status.rxReady)
+                radio->drainFifo();
+            return;
+        }
+
         if (_g_preamble) {
             radio->tickCounter = 0;
             radio->preCounter += 1;
+            // New frame, forget what was drained of a previous one not completed (CRC error)
+            if (radio->preCounter == 1)
+                radio->rxLength = 0;
 
             //            if (_flags[0] & RF_IRQFLAGS1_SYNCADDRESSMATCH) radio->preCounter = 0;
             // In case of Sync received resets the preamble duration
             if ((radio->preCounter * SM_GRANULARITY_US) >= SM_PREAMBLE_RECOVERY_TIMEOUT_US) {
                 // Avoid hanging on a too long preamble detect
-                Radio::clearFlags();
+                Transceiver::clearFlags();
                 radio->preCounter = 0;
             }
         }
@@ -211,41 +240,76 @@ namespace IOHC {
         if (radio->currentFreqIdx >= radio->num_freqs)
             radio->currentFreqIdx = 0;
 
-        Radio::setCarrier(Radio::Carrier::Frequency, radio->scan_freqs[radio->currentFreqIdx]);
-
-#elif defined(CC1101)
-        if (__g_preamble){
-            radio->receive();
-            radio->tickCounter = 0;
-            radio->preCounter = 0;
-            return;
-        }
-
-        if (f_lock)
-            return;
-
-        if ((++radio->tickCounter * SM_GRANULARITY_US) < radio->scanTimeUs)
-            return;
-#endif
+        Transceiver::setFrequency(radio->scan_freqs[radio->currentFreqIdx]);
     }
 
     /**
      * The `send` function in the `iohcRadio` class sends packets stored in a vector with a specified
-     * repeat time.
+     * repeat time. While a batch is being sent, they are queued behind it and follow its last frame.
      *
      * @param iohcTx `iohcTx` is a reference to a vector of pointers to `iohcPacket` objects.
      *
-     * @return If `txMode` is true, the `send` function will return early without executing the rest of the
-     * code inside the function.
+     * @return false if there was nothing to send. Answers to peers go through sendAnswers() instead, ahead of
+     * the frames queued.
      */
-    void iohcRadio::send(std::vector<iohcPacket *> &iohcTx) {
-        if (txMode) return;
+    template <typename Transceiver>
+    bool iohcRadioT<Transceiver>::send(std::vector<iohcPacket *> &iohcTx) {
+        if (iohcTx.empty()) return false;
+        xSemaphoreTake(txMutex, portMAX_DELAY);
+        if (!txMode && packets2send.empty()) {
+            startBatch(iohcTx);
+        } else {
+            packets2send.insert(packets2send.end(), iohcTx.begin(), iohcTx.end());
+            iohcTx.clear();
+        }
+        xSemaphoreGive(txMutex);
+        return true;
+    }
 
+    // Batch taken over, its first frame sent when the ticker fires, txMutex taken
+    template <typename Transceiver>
+    void iohcRadioT<Transceiver>::startBatch(std::vector<iohcPacket *> &iohcTx) {
         packets2send = iohcTx; //std::move(iohcTx); //
         iohcTx.clear();
 
         txCounter = 0;
-        Sender.attach_ms(packets2send[txCounter]->repeatTime, packetSender, this);
+        repeating = false;
+        Sender.attach_ms(packets2send[txCounter]->tx.repeatTime, packetSender, this);
+    }
+
+/**
+ * The function `sendAnswers` sends frames answering peers (challenge answers, key transfers) as soon as
+ * the radio allows. A free radio sends them right away. During a batch they are put before its next frame,
+ * sent back to back: at the end of the frame being repeated, or at once if the batch is waiting before a
+ * delayed frame, which then waits its delay again after them. txMutex is held from the check of the radio
+ * to the handoff, so that a batch starting or ending meanwhile cannot make them refused.
+ */
+    template <typename Transceiver>
+    void iohcRadioT<Transceiver>::sendAnswers(std::vector<iohcPacket *> &frames) {
+        if (frames.empty()) return;
+        xSemaphoreTake(txMutex, portMAX_DELAY);
+        if (!txMode && packets2send.empty()) {
+            startBatch(frames);
+            xSemaphoreGive(txMutex);
+            return;
+        }
+        answers.insert(answers.end(), frames.begin(), frames.end());
+        frames.clear();
+        // Unless the delay is over and packetSender is already taking them
+        if (txCounter < packets2send.size() && packets2send[txCounter] == nullptr && delayed && Sender.stopDelay()) {
+            packets2send[txCounter] = delayed;
+            takeAnswers();
+            Sender.attach_ms(packets2send[txCounter]->tx.repeatTime, packetSender, this);
+        }
+        xSemaphoreGive(txMutex);
+    }
+
+    // Answers waiting go before the next frame of the batch, txMutex taken
+    template <typename Transceiver>
+    void iohcRadioT<Transceiver>::takeAnswers() {
+        if (answers.empty()) return;
+        packets2send.insert(packets2send.begin() + txCounter, answers.begin(), answers.end());
+        answers.clear();
     }
 
 /**
@@ -256,62 +320,80 @@ namespace IOHC {
  * @param radio The `radio` parameter in the `packetSender` function is a pointer to an object of type
  * `iohcRadio`. It is used to access and manipulate data and functions within the `iohcRadio` class.
  */
-    void IRAM_ATTR iohcRadio::packetSender(iohcRadio *radio) {
+    template <typename Transceiver>
+    void IRAM_ATTR iohcRadioT<Transceiver>::packetSender(iohcRadioT *radio) {
         digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
         // Stop frequency hopping
         f_lock = true;
         txMode = true; // Avoid Radio put in Rx mode at next packet sent/received
+        xSemaphoreTake(radio->txMutex, portMAX_DELAY);
         // Using Delayed Packet radio->txCounter)
         if (radio->packets2send[radio->txCounter] == nullptr) {
+            // Answers given during the delay go first, the delayed frame waits again after them
+            if (!radio->answers.empty() && radio->delayed != nullptr) {
+                radio->packets2send[radio->txCounter] = radio->delayed;
+                radio->takeAnswers();
+                radio->iohc = radio->packets2send[radio->txCounter];
+            }
             // Plus de Delayed Packet
-            if (radio->delayed != nullptr)
+            else if (radio->delayed != nullptr)
                 // Use Saved Delayed Packet
                 radio->iohc = radio->delayed;
-        } else
+        } else {
+            // Answers given since the previous frame ended go first, a frame being repeated ends first
+            if (!radio->repeating) radio->takeAnswers();
             radio->iohc = radio->packets2send[radio->txCounter];
+        }
 
         //        if (radio->iohc->frequency != 0) {
         if (radio->iohc->frequency != radio->scan_freqs[radio->currentFreqIdx]) {
             // printf("ChangedFreq !\n");
-            Radio::setCarrier(Radio::Carrier::Frequency, radio->iohc->frequency);
+            Transceiver::setFrequency(radio->iohc->frequency);
         }
         // else {
         //     radio->iohc->frequency = radio->scan_freqs[radio->currentFreqIdx];
         // }
 
-        Radio::setStandby();
-        Radio::clearFlags();
-
-#if defined(RADIO_SX127X)
-        Radio::writeBytes(REG_FIFO, radio->iohc->payload.buffer, radio->iohc->buffer_length);
+        Transceiver::setStandby();
+        Transceiver::clearFlags();
 
-#elif defined(CC1101)
-        Radio::sendFrame(radio->iohc->payload.buffer, radio->iohc->buffer_length); // Prepare (encode, add crc, and so no) the packet for CC1101
-#endif
+        // SX1276 Tx start condition is FifoNotEmpty: the preamble goes on air with the first byte written,
+        // the rest of the frame is written while it is sent.
+        Transceiver::transmit(radio->iohc->payload.buffer, radio->iohc->buffer_length);
+        iohcCapture::getInstance()->record(*radio->iohc, Direction::Tx);
+        iohcSniffer::getInstance()->record(*radio->iohc, Direction::Tx);
+        iohcTransactions::getInstance()->sent(*radio->iohc);
+        iohcSequences::getInstance()->sent(*radio->iohc);
 
         packetStamp = esp_timer_get_time();
-        radio->iohc->decode(true); //false);
+        if (radio->printFrames) radio->iohc->decode(true); //false);
 
         IOHC::lastSendCmd = radio->iohc->payload.packet.header.cmd;
 
-        Radio::setTx();
         // There is no need to maintain radio locked between packets transmission unless clearly asked
-        txMode = radio->iohc->lock;
-
-        if (radio->iohc->repeat)
-            radio->iohc->repeat -= 1;
-        if (radio->iohc->repeat == 0) {
+        txMode = radio->iohc->tx.lock;
+
+        if (radio->iohc->tx.repeat)
+            radio->iohc->tx.repeat -= 1;
+        radio->repeating = radio->iohc->tx.repeat != 0;
+        // Without Tx done the frame is taken as sent once written, its packet given back after the last emission
+        if constexpr (!Transceiver::txDone) {
+            radio->sent(radio->iohc);
+            if (radio->iohc->tx.repeat == 0) releaseFrame(radio->iohc);
+        }
+        if (radio->iohc->tx.repeat == 0) {
             radio->Sender.detach();
             ++radio->txCounter;
+            radio->takeAnswers();
             if (radio->txCounter < radio->packets2send.size() && radio->packets2send[radio->txCounter] != nullptr) {
                 //if (radio->packets2send[++(radio->txCounter)]) {
-                if (radio->packets2send[radio->txCounter]->delayed != 0) {
+                if (radio->packets2send[radio->txCounter]->tx.delayed != 0) {
                     radio->delayed = radio->packets2send[radio->txCounter];
                     radio->packets2send[radio->txCounter] = nullptr;
-                    radio->Sender.delay_ms(radio->delayed/*radio->packets2send[radio->txCounter]*/->delayed,
+                    radio->Sender.delay_ms(radio->delayed/*radio->packets2send[radio->txCounter]*/->tx.delayed,
                                            packetSender, radio);
                 } else {
-                    radio->Sender.attach_ms(radio->packets2send[radio->txCounter]->repeatTime, packetSender, radio);
+                    radio->Sender.attach_ms(radio->packets2send[radio->txCounter]->tx.repeatTime, packetSender, radio);
                 }
             } else {
                 // In any case, after last packet sent, unlock the radio
@@ -319,6 +401,7 @@ namespace IOHC {
                 radio->packets2send.clear();
             }
         }
+        xSemaphoreGive(radio->txMutex);
         digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
     }
 
@@ -332,7 +415,8 @@ namespace IOHC {
  * calling the `txCB` function with the `packet` parameter. If `txCB` is not null, the return value
  * will be the result of calling `txCB(packet)`, otherwise it will be `false`.
  */
-    bool IRAM_ATTR iohcRadio::sent(iohcPacket *packet) {
+    template <typename Transceiver>
+    bool IRAM_ATTR iohcRadioT<Transceiver>::sent(iohcPacket *packet) {
         bool ret = false;
         if (txCB) {
             ret = txCB(packet);
@@ -352,133 +436,94 @@ namespace IOHC {
  * 
  * @return The function `iohcRadio::receive` is returning a boolean value `true`.
  */
-    bool IRAM_ATTR iohcRadio::receive(bool stats = false) {
+    template <typename Transceiver>
+    bool IRAM_ATTR iohcRadioT<Transceiver>::receive(bool stats) {
         digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
-        // bool frmErr = false;
         iohc = new iohcPacket;
-        iohc->buffer_length = 0;
         iohc->frequency = scan_freqs[currentFreqIdx];
 
         _g_payload_millis = esp_timer_get_time();
         packetStamp = _g_payload_millis;
-#if defined(RADIO_SX127X)
-        if (stats) {
-            iohc->rssi = static_cast<float>(Radio::readByte(REG_RSSIVALUE)) / -2.0f;
-            int16_t thres = Radio::readByte(REG_RSSITHRESH);
-            iohc->snr = iohc->rssi > thres ? 0 : (thres - iohc->rssi);
-            //            iohc->lna = RF96lnaMap[ (Radio::readByte(REG_LNA) >> 5) & 0x7 ];
-            int16_t f = (uint16_t) Radio::readByte(REG_AFCMSB);
-            f = (f << 8) | (uint16_t) Radio::readByte(REG_AFCLSB);
-            //            iohc->afc = f * (32000000.0 / 524288.0); // static_cast<float>(1 << 19));
-            iohc->afc = /*(int32_t)*/f * 61.0;
-            //            iohc->rssiAt = micros();
-        }
-#elif defined(CC1101)
-        __g_preamble = false;
-
-        uint8_t tmprssi=Radio::SPIgetRegValue(REG_RSSI);
-        if (tmprssi>=128)
-            iohc->rssi = (float)((tmprssi-256)/2)-74;
-        else
-            iohc->rssi = (float)(tmprssi/2)-74;
-
-        uint8_t bytesInFIFO = Radio::SPIgetRegValue(REG_RXBYTES, 6, 0);
-        size_t readBytes = 0;
-        uint32_t lastPop = millis();
-#endif
-
-#if defined(RADIO_SX127X)
-
-        while (Radio::dataAvail()) {
-            iohc->payload.buffer[iohc->buffer_length++] = Radio::readByte(REG_FIFO);
-        }
-
-#elif defined(CC1101)
-        uint8_t lenghtFrameCoded = 0xFF;
-        uint8_t tmpBuffer[64]={0x00};
-        while (readBytes < lenghtFrameCoded) {
-            if ( (readBytes>=1) && (lenghtFrameCoded==0xFF) ){ // Obtain frame lenght
-                lenghtFrame = (Radio::reverseByte( ((uint8_t)(tmpBuffer[0]<<4) | (uint8_t)(tmpBuffer[1]>>4)))) & 0b00011111;
-                lenghtFrameCoded = ((lenghtFrame + 2 + 1)*8) + ((lenghtFrame + 2 + 1)*2);   // Calculate Num of bits of encoded frame (add 2 bit per byte)
-                lenghtFrameCoded = ceil((float)lenghtFrameCoded/8);                         // divide by 8 bits per byte and round to up
-                Radio::setPktLenght(lenghtFrameCoded);
-                //Serial.printf("BytesReaded: %d\tlenghtFrame: 0x%d\t lenghtFrameCoded: 0x%d\n", readBytes, lenghtFrame,  lenghtFrameCoded);
-            }
-
-            if (bytesInFIFO == 0) {
-                if (millis() - lastPop > 5) {
-                    // readData was required to read a packet longer than the one received.
-                    //Serial.println("No data for more than 5mS. Stop here.");
-                    break;
-                } else {
-                    delay(1);
-                    bytesInFIFO = Radio::SPIgetRegValue(REG_RXBYTES, 6, 0);
-                    continue;
-                }
-            }
-
-            // read the minimum between "remaining length" and bytesInFifo
-            uint8_t bytesToRead = (((uint8_t)(lenghtFrameCoded - readBytes))<(bytesInFIFO)?((uint8_t)(lenghtFrameCoded - readBytes)):(bytesInFIFO));
-            Radio::SPIreadRegisterBurst(REG_FIFO, bytesToRead, &(tmpBuffer[readBytes]));
-            readBytes += bytesToRead;
-            lastPop = millis();
 
-            // Get how many bytes are left in FIFO.
-            bytesInFIFO = Radio::SPIgetRegValue(REG_RXBYTES, 6, 0);
+        // Start with what was drained on FifoLevel, the backend reads the rest
+        memcpy(iohc->payload.buffer, rxBuffer, rxLength);
+        iohc->buffer_length = rxLength;
+        rxLength = 0;
+        Transceiver::receiveFrame(iohc, stats);
+        bool valid = !softCrc || !iohc->buffer_length || checkCrc(iohc);
+        if (iohc->buffer_length) {
+            if (valid) watchdog.frameReceived();
+            iohcCapture::getInstance()->record(*iohc, Direction::Rx);
+            iohcSniffer::getInstance()->record(*iohc, Direction::Rx);
+            if (valid) iohcTransactions::getInstance()->received(*iohc);
+            if (valid) iohcAuth1W::getInstance()->submit(*iohc);
         }
 
-
-        frmErr=true;
-        if (lenghtFrameCoded<255){
-            int8_t lenFuncDecodeFrame = Radio::decodeFrame(tmpBuffer, lenghtFrameCoded);
-            if (lenFuncDecodeFrame>0 && lenFuncDecodeFrame<=MAX_FRAME_LEN){
-                if (iohcUtils::radioPacketComputeCrc(tmpBuffer, lenFuncDecodeFrame) == 0 ){
-                    iohc->buffer_length = lenFuncDecodeFrame;
-                    memcpy(iohc->payload.buffer, tmpBuffer, lenFuncDecodeFrame);  // volcamos el resultado al array de origen
-                    frmErr=false;
-                }
-            }
-        }
-
-        // Flush then standby according to RXOFF_MODE (default: RADIOLIB_CC1101_RXOFF_IDLE)
-        if (Radio::SPIgetRegValue(REG_MCSM1, 3, 2) == RF_RXOFF_IDLE) {
-            Radio::SPIsendCommand(CMD_IDLE);                    // set mode to standby
-            Radio::SPIsendCommand(CMD_FLUSH_RX | CMD_READ);     // flush Rx FIFO
-        }
-
-        f_lock = false;
-        Radio::SPIsendCommand(CMD_RX);
-
-#endif
-
         // Radio::clearFlags();
-        if (rxCB) rxCB(iohc);
-        iohc->decode(true); //stats);
+        if (rxCB && valid) rxCB(iohc);
+        if (printFrames) iohc->decode(true); //stats);
         free(iohc); // correct Bug memory
         digitalWrite(RX_LED, false);
         return true;
     }
 
 /**
- * The function `i_preamble` sets the value of `f_lock` based on the state of `_g_preamble` or
- * `__g_preamble` depending on the defined radio type.
+ * The function `checkCrc` checks a frame received with the radio CRC off. It relies on the SX1276 packet
+ * engine, io-homecontrol mode and variable length, still counting the two CRC bytes in the packet when
+ * CrcOn is cleared: it only skips the check and hands them over in the FIFO after the payload, before
+ * PayloadReady (SX1276Sim does the same). They are already read with a short frame, still in the FIFO
+ * after the longest ones, and removed from the frame whatever the result.
+ *
+ * @return false if the CRC is wrong, or did not come: such a frame, shorter than its length byte or from
+ * a chip that does not hand the CRC over, is counted apart and dropped like a wrong one.
  */
-    void IRAM_ATTR iohcRadio::i_preamble() {
-#if defined(RADIO_SX127X)
-        _g_preamble = digitalRead(RADIO_PREAMBLE_DETECTED);
-#elif defined(CC1101)
-        __g_preamble = true;
-#endif
-        f_lock = _g_preamble;
+    template <typename Transceiver>
+    bool IRAM_ATTR iohcRadioT<Transceiver>::checkCrc(iohcPacket *packet) {
+        uint8_t *buffer = packet->payload.buffer;
+        uint8_t frameLength = (buffer[0] & 0x1F) + 1;
+        uint8_t crc[2];
+        uint8_t got = 0;
+        while (got < 2 && frameLength + got < packet->buffer_length) {
+            crc[got] = buffer[frameLength + got];
+            got += 1;
+        }
+        while (got < 2 && Transceiver::fifoNotEmpty())
+            Transceiver::readFifo(crc + got++, 1);
+        if (packet->buffer_length > frameLength) packet->buffer_length = frameLength;
+
+        if (got < 2 || packet->buffer_length < frameLength) {
+            crcCheck.unchecked += 1;
+            return false;
+        }
+        crcCheck.checked += 1;
+        if (crc16(crc, 2, crc16(buffer, frameLength)) == 0) return true;
+        crcCheck.failed += 1;
+        return false;
+    }
+
+    template <typename Transceiver>
+    void iohcRadioT<Transceiver>::softwareCrc(bool on) {
+        softCrc = on;
+        Transceiver::setHardwareCrc(!on);
     }
 
 /**
- * The function `iohcRadio::i_payload()` reads the value of a digital pin and stores it in a variable
- * `_g_payload` if the macro `RADIO_SX127X` is defined.
+ * The function `drainFifo` reads the bytes waiting in the FIFO while the frame is still being received.
+ * FifoLevel guarantees more than the backend threshold bytes are there, so they are read in one burst
+ * and only the tail of the frame is left for `receive` once the payload is ready.
+ * The chunk holding the last byte of the frame is never drained: PayloadReady is cleared by the FIFO
+ * empty, a frame read out before its end would not raise it.
  */
-    void IRAM_ATTR iohcRadio::i_payload() {
-#if defined(RADIO_SX127X)
-        _g_payload = digitalRead(RADIO_PACKET_AVAIL);
-#endif
+    template <typename Transceiver>
+    void IRAM_ATTR iohcRadioT<Transceiver>::drainFifo() {
+        constexpr uint8_t chunk = Transceiver::fifoChunk;
+        if (!chunk) return;
+        if (rxLength + chunk > MAX_FRAME_LEN)
+            rxLength = 0; // Not a frame we know, start again
+        if (rxLength && rxLength + chunk >= (rxBuffer[0] & 0x1F) + 1) return;
+        Transceiver::readFifo(rxBuffer + rxLength, chunk);
+        rxLength += chunk;
     }
+
+    template class iohcRadioT<Radio::Backend>;
 }
@@ -15,15 +15,19 @@
  */
 
 #include <iohcRemote1W.h>
-#include <LittleFS.h>
-#include <ArduinoJson.h>
+#if defined(ESP32)
+    #include <LittleFS.h>
+    #include <ArduinoJson.h>
+    #include <esp_timer.h>
+#endif
 
+#include <iohcAuth1W.h>
 #include <iohcCryptoHelpers.h>
 
 namespace IOHC {
     iohcRemote1W* iohcRemote1W::_iohcRemote1W = nullptr;
 
-    iohcRemote1W::iohcRemote1W() = default;
+    iohcRemote1W::iohcRemote1W() : aheadMutex(xSemaphoreCreateMutex()) {}
 
     iohcRemote1W* iohcRemote1W::getInstance() {
         if (!_iohcRemote1W) {
@@ -33,31 +37,6 @@ namespace IOHC {
         return _iohcRemote1W;
     }
 
-    void iohcRemote1W::forgePacket(iohcPacket* packet, uint16_t typn) {
-        IOHC::relStamp = esp_timer_get_time();
-        digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
-
-        packet->payload.packet.header.CtrlByte1.asStruct.MsgLen = sizeof(_header) - 1;
-        packet->payload.packet.header.CtrlByte1.asStruct.Protocol = 1;
-        packet->payload.packet.header.CtrlByte1.asStruct.StartFrame = 1;
-        packet->payload.packet.header.CtrlByte1.asStruct.EndFrame = 1;
-        packet->payload.packet.header.CtrlByte2.asByte = 0;
-        packet->payload.packet.header.CtrlByte2.asStruct.LPM = 1;
-        // Broadcast Target
-        uint16_t bcast = (typn << 6) + 0b111111; 
-        packet->payload.packet.header.target[0] = 0x00;
-        packet->payload.packet.header.target[1] = bcast >> 8;
-        packet->payload.packet.header.target[2] = bcast & 0x00ff;
-
-        packet->frequency = CHANNEL2;
-        packet->repeatTime = 40;
-        packet->repeat = 4;
-        packet->lock = false;
-        
-    }
-
-    std::vector<uint8_t> frame;
-
     void iohcRemote1W::cmd(RemoteButton cmd, Tokens* data) {
         if (data->size() == 1) {return; }
         std::string description = data->at(1).c_str();
@@ -115,33 +94,21 @@ namespace IOHC {
 //                for (auto&r: remotes) {
                 if (!found) break;
 
-                    auto* packet = new iohcPacket;
-                    IOHC::iohcRemote1W::forgePacket(packet, r.type[0]);
-                    // Packet length
-                    packet->payload.packet.header.CtrlByte1.asStruct.MsgLen += sizeof(_p0x2e);
-
+                    address broadcast;
+                    broadcast1W(broadcast, r.type[0]);
                     // Source (me)
-                    for (size_t i = 0; i < sizeof(address); i++)
-                        packet->payload.packet.header.source[i] = r.node[i];
-
-                    //Command
-                    packet->payload.packet.header.cmd = 0x2e;
-                    // Data
-                    packet->payload.packet.msg.p0x2e.data = 0x00;
+                    auto* packet = buildFrame(Frames::RemotePair, r.node, broadcast);
                     // Sequence
                     packet->payload.packet.msg.p0x2e.sequence[0] = r.sequence >> 8;
                     packet->payload.packet.msg.p0x2e.sequence[1] = r.sequence & 0x00ff;
                     r.sequence += 1;
                     // hmac
-                    frame = std::vector(&packet->payload.packet.header.cmd, &packet->payload.packet.header.cmd + 2);
                     uint8_t hmac[16];
-                    iohcCrypto::create_1W_hmac(hmac, packet->payload.packet.msg.p0x2e.sequence, r.key, frame);
+                    iohcCrypto::create_1W_hmac(hmac, packet->payload.packet.msg.p0x2e.sequence, r.key, &packet->payload.packet.header.cmd, 2, r.node);
 
                     for (uint8_t i = 0; i < 6; i++)
                         packet->payload.packet.msg.p0x2e.hmac[i] = hmac[i];
 
-                    packet->buffer_length = packet->payload.packet.header.CtrlByte1.asStruct.MsgLen + 1;
-
                     packets2send.push_back(packet);
                     // if (typn) packet->payload.packet.header.CtrlByte2.asStruct.LPM = 0; //TODO only first is LPM
                     digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
@@ -158,33 +125,20 @@ namespace IOHC {
                 if (!found) break;
 
 
-                    auto* packet = new iohcPacket;
-                    IOHC::iohcRemote1W::forgePacket(packet, r.type[0]);
-                    // Packet length
-                    //                    packet->payload.packet.header.CtrlByte1.asStruct.MsgLen = sizeof(_header) - 1;
-                    packet->payload.packet.header.CtrlByte1.asStruct.MsgLen += sizeof(_p0x2e);
-
+                    address broadcast;
+                    broadcast1W(broadcast, r.type[0]);
                     // Source (me)
-                    for (size_t i = 0; i < sizeof(address); i++)
-                        packet->payload.packet.header.source[i] = r.node[i];
-
-                    //Command
-                    packet->payload.packet.header.cmd = 0x39;
-                    // Data
-                    packet->payload.packet.msg.p0x2e.data = 0x00;
+                    auto* packet = buildFrame(Frames::RemoteRemove, r.node, broadcast);
                     // Sequence
                     packet->payload.packet.msg.p0x2e.sequence[0] = r.sequence >> 8;
                     packet->payload.packet.msg.p0x2e.sequence[1] = r.sequence & 0x00ff;
                     r.sequence += 1;
                     // hmac
                     uint8_t hmac[16];
-                    frame = std::vector(&packet->payload.packet.header.cmd, &packet->payload.packet.header.cmd + 2);
-                    iohcCrypto::create_1W_hmac(hmac, packet->payload.packet.msg.p0x2e.sequence, r.key, frame);
+                    iohcCrypto::create_1W_hmac(hmac, packet->payload.packet.msg.p0x2e.sequence, r.key, &packet->payload.packet.header.cmd, 2, r.node);
                     for (uint8_t i = 0; i < 6; i++)
                         packet->payload.packet.msg.p0x2e.hmac[i] = hmac[i];
 
-                    packet->buffer_length = packet->payload.packet.header.CtrlByte1.asStruct.MsgLen + 1;
-
                     packets2send.push_back(packet);
                     digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
 //                }
@@ -200,16 +154,10 @@ namespace IOHC {
 //                for (auto&r: remotes) {
                 if (!found) break;
 
-                    auto* packet = new iohcPacket;
-                    IOHC::iohcRemote1W::forgePacket(packet, r.type[0]);
-                    // Packet length
-                    packet->payload.packet.header.CtrlByte1.asStruct.MsgLen += sizeof(_p0x30);
-
+                    address broadcast;
+                    broadcast1W(broadcast, r.type[0]);
                     // Source (me)
-                    for (size_t i = 0; i < sizeof(address); i++)
-                        packet->payload.packet.header.source[i] = r.node[i];
-                    //Command
-                    packet->payload.packet.header.cmd = 0x30;
+                    auto* packet = buildFrame(Frames::RemoteAdd, r.node, broadcast);
 
                     // Encrypted key
                     uint8_t encKey[16];
@@ -226,8 +174,6 @@ namespace IOHC {
                     packet->payload.packet.msg.p0x30.sequence[1] = r.sequence & 0x00ff;
                     r.sequence += 1;
 
-                    packet->buffer_length = packet->payload.packet.header.CtrlByte1.asStruct.MsgLen + 1;
-
                     packets2send.push_back(packet);
                     digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
 //                }
@@ -241,43 +187,111 @@ namespace IOHC {
 //                for (auto&r: remotes) {
                 if (!found) break;
 
-                    auto* packet = new iohcPacket;
-                    IOHC::iohcRemote1W::forgePacket(packet, r.type[0]);
-                    // Packet length
-                    // packet->payload.packet.header.CtrlByte1.asStruct.MsgLen += sizeof(_p0x00);
-                    // Source (me)
-                    for (size_t i = 0; i < sizeof(address); i++)
-                        packet->payload.packet.header.source[i] = r.node[i];
-                    //Command
-                    packet->payload.packet.header.cmd = 0x00;
-                    packet->payload.packet.msg.p0x00_14.origin = 0x01; // Command Source Originator is: 0x01 User
-                    //Acei packet->payload.packet.msg.p0x00.acei;
-                    setAcei(packet->payload.packet.msg.p0x00_14.acei, 0x43); //0xE7); //0x61);
-                    switch (cmd) {
-                        // Switch for Main Parameter of cmd 0x00: Open/Close/Stop/Ventilation
-                        case RemoteButton::Open:
-                            packet->payload.packet.msg.p0x00_14.main[0] = 0x00;
-                            packet->payload.packet.msg.p0x00_14.main[1] = 0x00;
-                            break;
-                        case RemoteButton::Close:
-                            packet->payload.packet.msg.p0x00_14.main[0] = 0xc8;
-                            packet->payload.packet.msg.p0x00_14.main[1] = 0x00;
-                            break;
-                        case RemoteButton::Stop:
-                            packet->payload.packet.msg.p0x00_14.main[0] = 0xd2;
-                            packet->payload.packet.msg.p0x00_14.main[1] = 0x00;
-                            break;
-                        case RemoteButton::Vent:
-                            packet->payload.packet.msg.p0x00_14.main[0] = 0xd8;
-                            packet->payload.packet.msg.p0x00_14.main[1] = 0x03;
-                            break;
-                        case RemoteButton::ForceOpen:
-                            packet->payload.packet.msg.p0x00_14.main[0] = 0x64;
-                            packet->payload.packet.msg.p0x00_14.main[1] = 0x00;
-                            break;
-                        case RemoteButton::Mode1:{
-                            /* fast = 4x13 Increment fp2 - slow = 0x01 4x13 followed 0x00 4x14 Main 0xD2
-                            Every 9 : 10:31:38.367 > (23) 1W S 1 E 1  FROM B60D1A TO 00003F CMD 20 <  DATA(15)  02db000900000323e7ceefedf9ce81        SEQ 23e7 MAC ceefedf9ce81  Org 2 Acei DB Main 9 fp1 0 fp2 0  Acei 6 3 1 1  Type All
+                    int64_t pressed = esp_timer_get_time();
+                    auto* packet = txSlot();
+                    uint8_t *sequence = commandFrame(packet, r, cmd, r.sequence);
+                    if (!sequence) return; // cmd is not recognized
+                    /*
+                                        if (r.type == 6) { // Vert
+                                            //typen
+                                            packet->payload.packet.msg.p0x00_14.fp1 = 0x80;
+                                            packet->payload.packet.msg.p0x00_14.fp2 = 0xD3;
+                                            // Packet length
+                                            packet->payload.packet.header.CtrlByte1.asStruct.MsgLen += sizeof(_p0x00_14);
+                                        }
+                    */
+                    // if (r.type == 6) { // Jaune
+                    //     packet->payload.packet.msg.p0x00.fp1 = 0x80;
+                    //     packet->payload.packet.msg.p0x00.fp2 = 0xC8;
+                    //     // Packet length
+                    //     packet->payload.packet.header.CtrlByte1.asStruct.MsgLen += sizeof(_p0x00);
+                    // }
+                    // hmac, over the frame from its command to its sequence
+                    uint8_t *hmac = sequence + 2;
+                    bool wasAhead = takeAhead(r, cmd, r.sequence, hmac);
+                    if (!wasAhead) {
+                        uint8_t mac[16];
+                        iohcCrypto::create_1W_hmac(mac, sequence, r.key, &packet->payload.packet.header.cmd, sequence - &packet->payload.packet.header.cmd, r.node);
+                        memcpy(hmac, mac, 6);
+                    }
+                    /*
+                                        if (r.type == 0xff) {
+                                            packet->payload.packet.header.cmd = 0x20;
+                                            packet->payload.packet.msg.p0x00_14.origin = 0x02;
+                                            packet->payload.packet.msg.p0x00_14.acei.asByte = 0xDB;
+                                            packet->payload.packet.header.CtrlByte1.asStruct.MsgLen += sizeof(_p0x00_14);
+                                        }
+                    */
+                    r.sequence += 1;
+                    // hmac
+                    // uint8_t hmac[16];
+                    // frame = std::vector(&packet->payload.packet.header.cmd, &packet->payload.packet.header.cmd + 7 + toAdd);
+                    // iohcCrypto::create_1W_hmac(hmac, packet->payload.packet.msg.p0x00.sequence, _key, frame);
+                    // for (uint8_t i = 0; i < 6; i++) {
+                    //     packet->payload.packet.msg.p0x00.hmac[i] = hmac[i];
+                    //     packet->payload.packet.msg.p0x00_all.hmac[i] = hmac[i];
+                    // }
+                    packets2send.push_back(packet);
+                    digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
+                    _radioInstance->send(packets2send);
+
+                    auto us = static_cast<uint32_t>(esp_timer_get_time() - pressed);
+                    if (wasAhead) {
+                        stats.ahead++;
+                        stats.aheadUs += us;
+                    } else {
+                        stats.computed++;
+                        stats.computedUs += us;
+                    }
+                    if (us > stats.maxUs) stats.maxUs = us;
+                }
+                break;
+//            }
+        }
+        // Save sequence number at idle: the console and the Tx ticker share the timer task, a flash write here
+        // would hold the first frame
+        sequenceChanged = true;
+    }
+
+/**
+ * The function `commandFrame` writes the frame of a command button press at the given sequence, its MAC
+ * left to the caller, and returns where the sequence is (the MAC follows it), nullptr for a button that
+ * is not a command. The MAC covers the frame from its command to this sequence.
+ */
+    uint8_t *iohcRemote1W::commandFrame(iohcPacket *packet, const remote &r, RemoteButton cmd, uint16_t sequence) {
+        // Packet length, the mode buttons of the type 0 remotes have their own
+        const FrameSpec &spec = r.type[0] == 0 && (cmd == RemoteButton::Mode1 || cmd == RemoteButton::Mode2) ? Frames::Remote0x01_13
+                              : r.type[0] == 0 && cmd == RemoteButton::Mode4 ? Frames::Remote0x00_16
+                              : Frames::Remote0x00_14;
+        address broadcast;
+        broadcast1W(broadcast, r.type[0]);
+        // Source (me), Command Source Originator is: 0x01 User, Acei 0x43 //0xE7); //0x61);
+        buildFrame(packet, spec, r.node, broadcast);
+        switch (cmd) {
+            // Switch for Main Parameter of cmd 0x00: Open/Close/Stop/Ventilation
+            case RemoteButton::Open:
+                packet->payload.packet.msg.p0x00_14.main[0] = 0x00;
+                packet->payload.packet.msg.p0x00_14.main[1] = 0x00;
+                break;
+            case RemoteButton::Close:
+                packet->payload.packet.msg.p0x00_14.main[0] = 0xc8;
+                packet->payload.packet.msg.p0x00_14.main[1] = 0x00;
+                break;
+            case RemoteButton::Stop:
+                packet->payload.packet.msg.p0x00_14.main[0] = 0xd2;
+                packet->payload.packet.msg.p0x00_14.main[1] = 0x00;
+                break;
+            case RemoteButton::Vent:
+                packet->payload.packet.msg.p0x00_14.main[0] = 0xd8;
+                packet->payload.packet.msg.p0x00_14.main[1] = 0x03;
+                break;
+            case RemoteButton::ForceOpen:
+                packet->payload.packet.msg.p0x00_14.main[0] = 0x64;
+                packet->payload.packet.msg.p0x00_14.main[1] = 0x00;
+                break;
+            case RemoteButton::Mode1:{
+                /* fast = 4x13 Increment fp2 - slow = 0x01 4x13 followed 0x00 4x14 Main 0xD2
+                Every 9 : 10:31:38.367 > (23) 1W S 1 E 1  FROM B60D1A TO 00003F CMD 20 <  DATA(15)  02db000900000323e7ceefedf9ce81        SEQ 23e7 MAC ceefedf9ce81  Org 2 Acei DB Main 9 fp1 0 fp2 0  Acei 6 3 1 1  Type All
 16:59:58.148 > (21) 1W S 1 E 1  FROM B60D1A TO 00003F CMD 01 >  DATA(13)  01430500112416406780a53021    SEQ 2416 MAC 406780a53021  Org 1 Acei 43 Main 5 fp1 0 fp2 11  Acei 2 0 1 1  Type All
 16:59:58.188 > (21) 1W S 1 E 1  FROM B60D1A TO 00003F CMD 01 <  DATA(13)  01430500112416406780a53021    SEQ 2416 MAC 406780a53021  Org 1 Acei 43 Main 5 fp1 0 fp2 11  Acei 2 0 1 1  Type All
 16:59:58.212 > (21) 1W S 1 E 1  FROM B60D1A TO 00003F CMD 01 <  DATA(13)  01430500112416406780a53021    SEQ 2416 MAC 406780a53021  Org 1 Acei 43 Main 5 fp1 0 fp2 11  Acei 2 0 1 1  Type All
@@ -290,18 +304,18 @@ namespace IOHC {
 16:59:58.422 > (23) 1W S 1 E 1  FROM B60D1A TO 00003F CMD 20 <  DATA(15)  02db000900000324182ea14f27d208        SEQ 2418 MAC 2ea14f27d208  Org 2 Acei DB Main 9 fp1 0 fp2 0  Acei 6 3 1 1  Type All
 16:59:58.448 > (23) 1W S 1 E 1  FROM B60D1A TO 00003F CMD 20 <  DATA(15)  02db000900000324182ea14f27d208        SEQ 2418 MAC 2ea14f27d208  Org 2 Acei DB Main 9 fp1 0 fp2 0  Acei 6 3 1 1  Type All
 16:59:58.472 > (23) 1W S 1 E 1  FROM B60D1A TO 00003F CMD 20 <  DATA(15)  02db000900000324182ea14f27d208        SEQ 2418 MAC 2ea14f27d208  Org 2 Acei DB Main 9 fp1 0 fp2 0  Acei 6 3 1 1  Type All
-                           */
-                            //   r.sequence = 0x0835; //DEBUG
-                            packet->payload.packet.header.cmd = 0x01;
-                            packet->payload.packet.msg.p0x01_13.main = 0x00;
-                            packet->payload.packet.msg.p0x01_13.fp1 = 0x01; // Observed // 0x02; //IZYMO
-                            packet->payload.packet.msg.p0x01_13.fp2 = r.sequence & 0xFF;
-                            // if (packet->payload.packet.header.source[2] == 0x1A) {packet->payload.packet.msg.p0x01_13.fp1 = 0x80;packet->payload.packet.msg.p0x01_13.fp2 = 0xD3;packet->payload.packet.header.source[2] = 0x1B; packet->payload.packet.msg.p0x01_13.fp2 = r.sequence--;}
-                            break;
-                        }
-
-                        case RemoteButton::Mode2: {
-                            /* Always: press = 0x01 4x13 followed by release = 0x01 4x13 Increment fp2
+               */
+                //   r.sequence = 0x0835; //DEBUG
+                packet->payload.packet.header.cmd = 0x01;
+                packet->payload.packet.msg.p0x01_13.main = 0x00;
+                packet->payload.packet.msg.p0x01_13.fp1 = 0x01; // Observed // 0x02; //IZYMO
+                packet->payload.packet.msg.p0x01_13.fp2 = sequence & 0xFF;
+                // if (packet->payload.packet.header.source[2] == 0x1A) {packet->payload.packet.msg.p0x01_13.fp1 = 0x80;packet->payload.packet.msg.p0x01_13.fp2 = 0xD3;packet->payload.packet.header.source[2] = 0x1B; packet->payload.packet.msg.p0x01_13.fp2 = r.sequence--;}
+                break;
+            }
+
+            case RemoteButton::Mode2: {
+                /* Always: press = 0x01 4x13 followed by release = 0x01 4x13 Increment fp2
 12:46:44.045 > (21) 1W S 1 E 1  FROM B60D1B TO 00003F CMD 01 >  DATA(13)  0143000276085a643d86021cdf    SEQ 085a MAC 643d86021cdf  Org 1 Acei 43 Main 0 fp1 2 fp2 76  Acei 2 0 1 1  Type All
 12:46:44.068 > (21) 1W S 1 E 1  FROM B60D1B TO 00003F CMD 01 <  DATA(13)  0143000276085a643d86021cdf    SEQ 085a MAC 643d86021cdf  Org 1 Acei 43 Main 0 fp1 2 fp2 76  Acei 2 0 1 1  Type All
 12:46:44.092 > (21) 1W S 1 E 1  FROM B60D1B TO 00003F CMD 01 <  DATA(13)  0143000276085a643d86021cdf    SEQ 085a MAC 643d86021cdf  Org 1 Acei 43 Main 0 fp1 2 fp2 76  Acei 2 0 1 1  Type All
@@ -310,19 +324,19 @@ namespace IOHC {
 12:46:44.414 > (21) 1W S 1 E 1  FROM B60D1B TO 00003F CMD 01 <  DATA(13)  0143000277085b9c9dd8d480dd    SEQ 085b MAC 9c9dd8d480dd  Org 1 Acei 43 Main 0 fp1 2 fp2 77  Acei 2 0 1 1  Type All
 12:46:44.437 > (21) 1W S 1 E 1  FROM B60D1B TO 00003F CMD 01 <  DATA(13)  0143000277085b9c9dd8d480dd    SEQ 085b MAC 9c9dd8d480dd  Org 1 Acei 43 Main 0 fp1 2 fp2 77  Acei 2 0 1 1  Type All
 12:46:44.463 > (21) 1W S 1 E 1  FROM B60D1B TO 00003F CMD 01 <  DATA(13)  0143000277085b9c9dd8d480dd    SEQ 085b MAC 9c9dd8d480dd  Org 1 Acei 43 Main 0 fp1 2 fp2 77  Acei 2 0 1 1  Type All
-                           */
-                            //   r.sequence = 0x085A; //DEBUG
-                            packet->payload.packet.header.cmd = 0x01;
-                            packet->payload.packet.msg.p0x01_13.main/*[0]*/ = 0x00;
-                            // packet->payload.packet.msg.p0x01_13.main[1] = 0x02;
-                            packet->payload.packet.msg.p0x01_13.fp1 = 0x02;
-                            packet->payload.packet.msg.p0x01_13.fp2 =  r.sequence & 0xFF;
-                            // if (packet->payload.packet.header.source[2] == 0x1A) {packet->payload.packet.header.source[2] = 0x1B; packet->payload.packet.msg.p0x01_13.fp2++; r.sequence += 1;} // DEBUG r.sequence;}
-                            break;
-                    }
-                    /*Light or up/down*/
-                    case RemoteButton::Mode3:{
-                        // r.sequence = 0x2262; // DEBUG
+               */
+                //   r.sequence = 0x085A; //DEBUG
+                packet->payload.packet.header.cmd = 0x01;
+                packet->payload.packet.msg.p0x01_13.main/*[0]*/ = 0x00;
+                // packet->payload.packet.msg.p0x01_13.main[1] = 0x02;
+                packet->payload.packet.msg.p0x01_13.fp1 = 0x02;
+                packet->payload.packet.msg.p0x01_13.fp2 =  r.sequence & 0xFF;
+                // if (packet->payload.packet.header.source[2] == 0x1A) {packet->payload.packet.header.source[2] = 0x1B; packet->payload.packet.msg.p0x01_13.fp2++; r.sequence += 1;} // DEBUG r.sequence;}
+                break;
+        }
+        /*Light or up/down*/
+        case RemoteButton::Mode3:{
+            // r.sequence = 0x2262; // DEBUG
 /* 0x00 4x16 + 0x00 4x14 + 0x00 4x16
 11:26:26.903 > (24) 1W S 1 E 1  FROM B60D1A TO 0001BF CMD 00 >  DATA(16)  0143000080d300002262bcff22b0d713      SEQ 2262 MAC bcff22b0d713  Type Light  Org 1 Acei 43 Main 0 fp1 80 fp2 D3  Acei 2 0 1 1
 11:26:26.927 > (24) 1W S 1 E 1  FROM B60D1A TO 0001BF CMD 00 <  DATA(16)  0143000080d300002262bcff22b0d713      SEQ 2262 MAC bcff22b0d713  Type Light  Org 1 Acei 43 Main 0 fp1 80 fp2 D3  Acei 2 0 1 1
@@ -337,9 +351,9 @@ namespace IOHC {
 11:26:27.179 > (24) 1W S 1 E 1  FROM B60D1A TO 0001BF CMD 00 <  DATA(16)  0143000080c80000226359c4c4837a4f      SEQ 2263 MAC 59c4c4837a4f  Type Light  Org 1 Acei 43 Main 0 fp1 80 fp2 C8  Acei 2 0 1 1
 11:26:27.206 > (24) 1W S 1 E 1  FROM B60D1A TO 0001BF CMD 00 <  DATA(16)  0143000080c80000226359c4c4837a4f      SEQ 2263 MAC 59c4c4837a4f  Type Light  Org 1 Acei 43 Main 0 fp1 80 fp2 C8  Acei 2 0 1 1
 */
-                        break;
-                    }
-                    case RemoteButton::Mode4: {
+            break;
+        }
+        case RemoteButton::Mode4: {
 /* 0x00 4x16  MAIN D200 FP 20 FP2 CC DATA A200 or MAIN D200 FP 20 FP2 CD DATA 2E00
 Every 9 -> 0x20 12:41:28.171 > (23) 1W S 1 E 1  FROM B60D1A TO 00003F CMD 20 <  DATA(15)  02db0009000003233d56ca3c456f2d        SEQ 233d MAC 56ca3c456f2d  Org 2 Acei DB Main 9 fp1 0 fp2 0  Acei 6 3 1 1  Type All
 10:10:36.905 > (24) 1W S 1 E 1  FROM B60D1A TO 00003F CMD 00 >  DATA(16)  0143d20020cd2e00 23d5ec80e44be6b6      SEQ 23d5 MAC ec80e44be6b6  Org 1 Acei 43 Main D200 fp1 20 fp2 CD Data 2E00 Acei 2 0 1 1  Type All
@@ -357,117 +371,127 @@ Every 9 -> 0x20 12:41:28.171 > (23) 1W S 1 E 1  FROM B60D1A TO 00003F CMD 20 <
 10:12:18.402 > (23) 1W S 1 E 1  FROM B60D1A TO 00003F CMD 20 <  DATA(15)  02db0009000003 23dc49fa35972c4b        SEQ 23dc MAC 49fa35972c4b  Org 2 Acei DB Main 9 fp1 0 fp2 0  Acei 6 3 1 1  Type All
 10:12:18.427 > (23) 1W S 1 E 1  FROM B60D1A TO 00003F CMD 20 <  DATA(15)  02db0009000003 23dc49fa35972c4b        SEQ 23dc MAC 49fa35972c4b  Org 2 Acei DB Main 9 fp1 0 fp2 0  Acei 6 3 1 1  Type All
 */
-                            // r.sequence = 0x2313; // DEBUG
-                            packet->payload.packet.header.cmd = 0x00;
-                            packet->payload.packet.msg.p0x00_16.main[0] = 0xd2;
-                            packet->payload.packet.msg.p0x00_16.main[1] = 0x00;
-                            packet->payload.packet.msg.p0x00_16.fp1 = 0x20;
-                            packet->payload.packet.msg.p0x00_16.fp2 = 0xCD;
-                            packet->payload.packet.msg.p0x00_16.data[0] = 0x2E;
-                            packet->payload.packet.msg.p0x00_16.data[1] = 0x00;
-                             if (packet->payload.packet.header.source[2] == 0x1B) {
-                                // packet->payload.packet.header.source[2] = 0x1A;
-                                packet->payload.packet.msg.p0x00_16.fp2 = 0xCC;
-                                packet->payload.packet.msg.p0x00_16.data[0] = 0xA2;
-                            }
-
-                        break;
-                    }
-                        default: // If reaching default here, then cmd is not recognized, then return
-                            return;
-                    }
-                    /*
-                                        if (r.type == 6) { // Vert
-                                            //typen
-                                            packet->payload.packet.msg.p0x00_14.fp1 = 0x80;
-                                            packet->payload.packet.msg.p0x00_14.fp2 = 0xD3;
-                                            // Packet length
-                                            packet->payload.packet.header.CtrlByte1.asStruct.MsgLen += sizeof(_p0x00_14);
-                                        }
-                    */
-                    // if (r.type == 6) { // Jaune
-                    //     packet->payload.packet.msg.p0x00.fp1 = 0x80;
-                    //     packet->payload.packet.msg.p0x00.fp2 = 0xC8;
-                    //     // Packet length
-                    //     packet->payload.packet.header.CtrlByte1.asStruct.MsgLen += sizeof(_p0x00);
-                    // }
-                    // hmac
-                    uint8_t hmac[16];
-                    // frame = std::vector(&packet->payload.packet.header.cmd, &packet->payload.packet.header.cmd + 7);
-                    // + toAdd);
-
-                    if (r.type[0] == 0 && (cmd == RemoteButton::Mode1 ||  cmd == RemoteButton::Mode2)) {
-                        //                        // packet->payload.packet.header.cmd = 0x01;
-                        packet->payload.packet.header.CtrlByte1.asStruct.MsgLen += sizeof(_p0x01_13) ;
-                        //                        // _sequence -= 1; // Use same sequence as light
-                        packet->payload.packet.msg.p0x01_13.sequence[0] = r.sequence >> 8;
-                        packet->payload.packet.msg.p0x01_13.sequence[1] = r.sequence & 0x00ff;
-                        uint8_t toAdd = 5 + 1; // OK
-                        frame = std::vector(&packet->payload.packet.header.cmd, &packet->payload.packet.header.cmd + toAdd);
-                        iohcCrypto::create_1W_hmac(hmac, packet->payload.packet.msg.p0x01_13.sequence, r.key, frame);
-                        for (uint8_t i = 0; i < 6; i++) {
-                            packet->payload.packet.msg.p0x01_13.hmac[i] = hmac[i];
-                        }
-                    }
+                // r.sequence = 0x2313; // DEBUG
+                packet->payload.packet.header.cmd = 0x00;
+                packet->payload.packet.msg.p0x00_16.main[0] = 0xd2;
+                packet->payload.packet.msg.p0x00_16.main[1] = 0x00;
+                packet->payload.packet.msg.p0x00_16.fp1 = 0x20;
+                packet->payload.packet.msg.p0x00_16.fp2 = 0xCD;
+                packet->payload.packet.msg.p0x00_16.data[0] = 0x2E;
+                packet->payload.packet.msg.p0x00_16.data[1] = 0x00;
+                 if (packet->payload.packet.header.source[2] == 0x1B) {
+                    // packet->payload.packet.header.source[2] = 0x1A;
+                    packet->payload.packet.msg.p0x00_16.fp2 = 0xCC;
+                    packet->payload.packet.msg.p0x00_16.data[0] = 0xA2;
+                }
 
-                    else if (r.type[0] == 0 && (cmd == RemoteButton::Mode4 )) {
-
-                        //                        // packet->payload.packet.header.cmd = 0x01;
-                        packet->payload.packet.header.CtrlByte1.asStruct.MsgLen += sizeof(_p0x00_16) ;
-                        //                        // _sequence -= 1; // Use same sequence as light
-                        packet->payload.packet.msg.p0x00_16.sequence[0] = r.sequence >> 8;
-                        packet->payload.packet.msg.p0x00_16.sequence[1] = r.sequence & 0x00ff;
-                        uint8_t toAdd = 8 + 1;
-                        frame = std::vector(&packet->payload.packet.header.cmd, &packet->payload.packet.header.cmd + toAdd);
-                        iohcCrypto::create_1W_hmac(hmac, packet->payload.packet.msg.p0x00_16.sequence, r.key, frame);
-                        for (uint8_t i = 0; i < 6; i++) {
-                            packet->payload.packet.msg.p0x00_16.hmac[i] = hmac[i];
-                        }
-                    }
-                    else {
-                        packet->payload.packet.header.CtrlByte1.asStruct.MsgLen += sizeof(_p0x00_14) ;
-                        // Sequence
-                        packet->payload.packet.msg.p0x00_14.sequence[0] = r.sequence >> 8;
-                        packet->payload.packet.msg.p0x00_14.sequence[1] = r.sequence & 0x00ff;
-                        uint8_t toAdd =  6 + 1; //OK
-                        frame = std::vector(&packet->payload.packet.header.cmd, &packet->payload.packet.header.cmd + toAdd);
-                        iohcCrypto::create_1W_hmac(hmac, packet->payload.packet.msg.p0x00_14.sequence, r.key, frame);
-                        for (uint8_t i = 0; i < 6; i++) {
-                            packet->payload.packet.msg.p0x00_14.hmac[i] = hmac[i];
-                        }
-                    }
-                    /*
-                                        if (r.type == 0xff) {
-                                            packet->payload.packet.header.cmd = 0x20;
-                                            packet->payload.packet.msg.p0x00_14.origin = 0x02;
-                                            packet->payload.packet.msg.p0x00_14.acei.asByte = 0xDB;
-                                            packet->payload.packet.header.CtrlByte1.asStruct.MsgLen += sizeof(_p0x00_14);
-                                        }
-                    */
-                    r.sequence += 1;
-                    // hmac
-                    // uint8_t hmac[16];
-                    // frame = std::vector(&packet->payload.packet.header.cmd, &packet->payload.packet.header.cmd + 7 + toAdd);
-                    // iohcCrypto::create_1W_hmac(hmac, packet->payload.packet.msg.p0x00.sequence, _key, frame);
-                    // for (uint8_t i = 0; i < 6; i++) {
-                    //     packet->payload.packet.msg.p0x00.hmac[i] = hmac[i];
-                    //     packet->payload.packet.msg.p0x00_all.hmac[i] = hmac[i];
-                    // }
-                    packet->buffer_length = packet->payload.packet.header.CtrlByte1.asStruct.MsgLen + 1;
+            break;
+        }
+            default: // If reaching default here, then cmd is not recognized
+                return nullptr;
+        }
+        // Sequence and MAC end every command frame
+        uint8_t *seq = frameData(packet) + spec.dataLen - 2 - 6;
+        seq[0] = sequence >> 8;
+        seq[1] = sequence & 0x00ff;
+        return seq;
+    }
 
-                    packets2send.push_back(packet);
-                    digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
+/**
+ * The function `takeAhead` copies the MAC computed ahead for this button and sequence if there is one,
+ * and frees its entry for a later sequence.
+ */
+    bool iohcRemote1W::takeAhead(remote &r, RemoteButton cmd, uint16_t sequence, uint8_t *mac) {
+        auto button = static_cast<int>(cmd) - static_cast<int>(RemoteButton::Open);
+        if (!ahead || button < 0 || button >= AHEAD_BUTTONS) return false;
+        xSemaphoreTake(aheadMutex, portMAX_DELAY);
+        MacAhead &entry = r.ahead[button][sequence % IOHC_1W_AHEAD];
+        bool ready = entry.ready && entry.sequence == sequence;
+        if (ready) {
+            memcpy(mac, entry.mac, sizeof(entry.mac));
+            entry.ready = false;
+        }
+        xSemaphoreGive(aheadMutex);
+        return ready;
+    }
+
+/**
+ * The function `idle` runs from the loop task when nothing else does. It saves the sequences changed
+ * by presses, then computes the MACs missing for the next IOHC_1W_AHEAD sequences of every remote, one
+ * at a time outside of the lock so that a press waits at most for an entry to be written.
+ */
+    void iohcRemote1W::idle() {
+        if (sequenceChanged.exchange(false)) save();
+        if (!ahead) return;
+
+        iohcPacket frame;
+        for (auto &r: remotes) {
+            uint16_t next = r.sequence;
+            for (uint16_t sequence = next; sequence != static_cast<uint16_t>(next + IOHC_1W_AHEAD); sequence++) {
+                for (uint8_t button = 0; button < AHEAD_BUTTONS; button++) {
+                    MacAhead &entry = r.ahead[button][sequence % IOHC_1W_AHEAD];
+                    if (entry.ready && entry.sequence == sequence) continue;
+
+                    auto cmd = static_cast<RemoteButton>(static_cast<int>(RemoteButton::Open) + button);
+                    uint8_t *seq = commandFrame(&frame, r, cmd, sequence);
+                    uint8_t mac[16];
+                    iohcCrypto::create_1W_hmac(mac, seq, r.key, &frame.payload.packet.header.cmd, seq - &frame.payload.packet.header.cmd, r.node);
+
+                    xSemaphoreTake(aheadMutex, portMAX_DELAY);
+                    entry.sequence = sequence;
+                    memcpy(entry.mac, mac, sizeof(entry.mac));
+                    entry.ready = true;
+                    xSemaphoreGive(aheadMutex);
+                    stats.macsAhead++;
                 }
-                _radioInstance->send(packets2send);
-                break;
-//            }
+            }
         }
-        this->save(); // Save sequence number
+    }
+
+    /**
+     * Registers the 1W learning frames seen on air: the key sent by a remote being added is kept in
+     * clear, then the MAC of the next 0x39 is computed with it
+     */
+    void iohcRemote1W::registerHandlers(iohcDispatcher *dispatcher) {
+        dispatcher->on(0x30, [](iohcPacket *iohc) {
+            uint8_t *key = getInstance()->keyCap;
+            memcpy(key, iohc->payload.packet.msg.p0x30.enc_key, 16);
+
+            iohcCrypto::encrypt_1W_key((const uint8_t *) iohc->payload.packet.header.source, key);
+            // A new key for this remote, its previous schedule is of no use
+            iohcCrypto::invalidateKey(iohcCrypto::KeyId::of(iohcCrypto::KeyKind::Remote, iohc->payload.packet.header.source));
+            // Its next frames are authenticated with it
+            iohcAuth1W::getInstance()->setKey(iohc->payload.packet.header.source, key, iohcCrypto::KeyKind::Learnt);
+            printf("CLEAR KEY: ");
+            for (uint8_t idx = 0; idx < 16; idx++)
+                printf("%2.2X", key[idx]);
+            printf("\n");
+        });
+
+        dispatcher->on(0x2E, [](iohcPacket *) {
+            printf("1W Learning mode\n");
+        });
+
+        dispatcher->on(0x39, [](iohcPacket *iohc) {
+            uint8_t *key = getInstance()->keyCap;
+            if (key[0] == 0) return;
+            uint8_t hmac[16];
+            iohcCrypto::create_1W_hmac(hmac, iohc->payload.packet.msg.p0x39.sequence, key, &iohc->payload.packet.header.cmd, 2,
+                                       iohc->payload.packet.header.source);
+            printf("MAC: ");
+            for (uint8_t idx = 0; idx < 6; idx++)
+                printf("%2.2X", hmac[idx]);
+            printf("\n");
+        });
     }
 
    bool iohcRemote1W::load() {
         _radioInstance = iohcRadio::getInstance();
-
+    #if !defined(ESP32)
+        // No filesystem on the host
+        printf("*1W remote not available\n");
+        return false;
+    #else
         if (LittleFS.exists(IOHC_1W_REMOTE))
             Serial.printf("Loading 1W remote settings from %s\n", IOHC_1W_REMOTE);
         else {
@@ -522,13 +546,18 @@ Every 9 -> 0x20 12:41:28.171 > (23) 1W S 1 E 1  FROM B60D1A TO 00003F CMD 20 <
             r.manufacturer = jobj["manufacturer_id"].as<uint8_t>();
             r.description = jobj["description"].as<std::string>();
             remotes.push_back(r);
+            iohcAuth1W::getInstance()->setKey(r.node, r.key, iohcCrypto::KeyKind::Remote);
         }
 
         Serial.printf("Loaded %d x 1W remotes\n", remotes.size()); // _type.size());
         // _sequence = 0x1402;    // DEBUG
         return true;
+    #endif
     }
    bool iohcRemote1W::save() {
+    #if !defined(ESP32)
+        return false;
+    #else
         fs::File f = LittleFS.open(IOHC_1W_REMOTE, "w+");
         JsonDocument doc; 
         for (const auto&r: remotes) {
@@ -562,5 +591,6 @@ Every 9 -> 0x20 12:41:28.171 > (23) 1W S 1 E 1  FROM B60D1A TO 00003F CMD 20 <
         f.close();
 
         return true;
+    #endif
     }
 }
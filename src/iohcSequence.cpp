@@ -0,0 +1,169 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <cstdio>
+#include <cstring>
+
+#include <iohcFrame.h>
+#include <iohcSequence.h>
+
+namespace IOHC {
+    iohcSequences *iohcSequences::_iohcSequences = nullptr;
+
+    namespace {
+        constexpr const char *verdictNames[] = {"fresh", "repeat", "late", "replay", "jump"};
+        static_assert(sizeof(verdictNames) / sizeof(verdictNames[0]) == static_cast<uint8_t>(SequenceVerdict::Count));
+        static_assert(IOHC_SEQUENCE_WINDOW <= 64, "The window is one 64 bit word");
+        static_assert(IOHC_SEQUENCE_JUMP < 0x8000, "Half of the sequences are ahead, half behind");
+    }
+
+    const char *sequenceVerdictName(SequenceVerdict verdict) {
+        return verdict < SequenceVerdict::Count ? verdictNames[static_cast<uint8_t>(verdict)] : "?";
+    }
+
+/**
+ * The function `observe` classifies a sequence against the window and moves the window on. Sequences
+ * wrap: half of them, up to 0x7FFF, are ahead of the highest one and the other half behind it.
+ */
+    SequenceVerdict SequenceWindow::observe(uint16_t sequence) {
+        if (!started) {
+            started = true;
+            highest = sequence;
+            seen = 1;
+            return SequenceVerdict::Fresh;
+        }
+        auto ahead = static_cast<int16_t>(sequence - highest);
+        if (ahead > 0) {
+            seen = ahead < IOHC_SEQUENCE_WINDOW ? seen << ahead | 1 : 1;
+            highest = sequence;
+            return ahead >= IOHC_SEQUENCE_JUMP ? SequenceVerdict::Jump : SequenceVerdict::Fresh;
+        }
+        auto behind = static_cast<uint16_t>(highest - sequence);
+        if (behind == 0) return SequenceVerdict::Repeat;
+        if (behind >= IOHC_SEQUENCE_WINDOW) return SequenceVerdict::Replay;
+        uint64_t bit = 1ull << behind;
+        if (seen & bit) return SequenceVerdict::Replay;
+        seen |= bit;
+        return SequenceVerdict::Late;
+    }
+
+    iohcSequences *iohcSequences::getInstance() {
+        if (!_iohcSequences)
+            _iohcSequences = new iohcSequences();
+        return _iohcSequences;
+    }
+
+    // Fed from the verifier task and from the Tx timer
+    iohcSequences::iohcSequences() {
+    #if defined(ESP32)
+        mutex = xSemaphoreCreateMutex();
+    #endif
+    }
+
+#if defined(ESP32)
+    void iohcSequences::lock() { xSemaphoreTake(mutex, portMAX_DELAY); }
+    void iohcSequences::unlock() { xSemaphoreGive(mutex); }
+#else
+    void iohcSequences::lock() {}
+    void iohcSequences::unlock() {}
+#endif
+
+/**
+ * The function `lookup` finds the node of an address, or takes a free one, or the least recently heard
+ * one whose history is then lost.
+ */
+    SequenceNode *iohcSequences::lookup(const address node) {
+        SequenceNode *victim = &nodes[0];
+        for (auto &n: nodes) {
+            if (n.used && !memcmp(n.node, node, sizeof(address))) return &n;
+            if (!n.used) {
+                if (victim->used) victim = &n;
+            } else if (victim->used && n.lastUse < victim->lastUse) {
+                victim = &n;
+            }
+        }
+        if (victim->used) stats.evicted += 1;
+        *victim = SequenceNode{};
+        victim->used = true;
+        memcpy(victim->node, node, sizeof(address));
+        return victim;
+    }
+
+    SequenceVerdict iohcSequences::observe(const address node, uint16_t sequence, Direction direction) {
+        lock();
+        SequenceNode *n = lookup(node);
+        n->lastUse = ++useCounter;
+        SequenceVerdict verdict = n->window.observe(sequence);
+        if (direction == Direction::Rx) {
+            if (!n->heard || static_cast<int16_t>(sequence - n->rxHighest) > 0) n->rxHighest = sequence;
+            n->heard = true;
+        } else {
+            if (n->heard && static_cast<int16_t>(sequence - n->rxHighest) <= 0) {
+                n->behind += 1;
+                stats.behind += 1;
+                // Once per frame, not for each of its repeats
+                if (verdict != SequenceVerdict::Repeat)
+                    printf("1W %02X%02X%02X sent %04X, the remote was heard at %04X\n", node[0], node[1], node[2], sequence, n->rxHighest);
+            }
+            if (!n->sent || static_cast<int16_t>(sequence - n->txHighest) > 0) n->txHighest = sequence;
+            n->sent = true;
+        }
+        n->verdicts[static_cast<uint8_t>(verdict)] += 1;
+        stats.verdicts[static_cast<uint8_t>(verdict)] += 1;
+        unlock();
+        return verdict;
+    }
+
+    void iohcSequences::sent(const iohcPacket &packet) {
+        FrameView view(packet);
+        if (!view.oneWay()) return;
+        ByteView sequence = view.get(Field::Sequence);
+        if (sequence.empty()) return;
+        observe(view.header().source, sequence.value(), Direction::Tx);
+    }
+
+    bool iohcSequences::find(const address node, SequenceNode *state) {
+        bool found = false;
+        lock();
+        for (const auto &n: nodes)
+            if (n.used && !memcmp(n.node, node, sizeof(address))) {
+                *state = n;
+                found = true;
+                break;
+            }
+        unlock();
+        return found;
+    }
+
+    void iohcSequences::print() {
+        printf("1W sequences, %u behind, %u evicted:", stats.behind, stats.evicted);
+        for (uint8_t v = 0; v < static_cast<uint8_t>(SequenceVerdict::Count); v++)
+            printf(" %u %s", stats.verdicts[v], sequenceVerdictName(static_cast<SequenceVerdict>(v)));
+        printf("\n\tnode    rx    tx    drift  fresh repeat late replay jump behind\n");
+        lock();
+        for (const auto &n: nodes) {
+            if (!n.used) continue;
+            printf("\t%02X%02X%02X  ", n.node[0], n.node[1], n.node[2]);
+            n.heard ? printf("%04X  ", n.rxHighest) : printf("----  ");
+            n.sent ? printf("%04X  ", n.txHighest) : printf("----  ");
+            // Presses our remote is behind the real one
+            n.heard && n.sent ? printf("%6d", static_cast<int16_t>(n.rxHighest - n.txHighest)) : printf("%6s", "");
+            const uint32_t *v = n.verdicts;
+            printf("  %5u %6u %4u %6u %4u %6u\n", v[0], v[1], v[2], v[3], v[4], n.behind);
+        }
+        unlock();
+    }
+}
@@ -0,0 +1,235 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <cstring>
+
+#include <iohcCrc.h>
+#include <iohcSniffer.h>
+
+#if defined(ESP32)
+    #include <Arduino.h>
+    #include <esp_timer.h>
+#else
+    #include <chrono>
+#endif
+
+namespace IOHC {
+    iohcSniffer *iohcSniffer::_iohcSniffer = nullptr;
+
+    namespace {
+        uint32_t snifferTime() {
+        #if defined(ESP32)
+            return static_cast<uint32_t>(esp_timer_get_time());
+        #else
+            return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+        #endif
+        }
+    }
+
+/**
+ * The function `cobsEncode` replaces the zeros of a block by the distance to the next one, so that 0x00
+ * is left free to delimit the blocks on the wire.
+ */
+    size_t cobsEncode(uint8_t *out, const uint8_t *in, size_t len) {
+        size_t codeAt = 0;
+        size_t o = 1;
+        uint8_t code = 1;
+        for (size_t i = 0; i < len; i++) {
+            if (in[i] == 0) {
+                out[codeAt] = code;
+                codeAt = o++;
+                code = 1;
+                continue;
+            }
+            out[o++] = in[i];
+            if (++code == 0xFF) {
+                out[codeAt] = code;
+                codeAt = o++;
+                code = 1;
+            }
+        }
+        out[codeAt] = code;
+        return o;
+    }
+
+    size_t cobsDecode(uint8_t *out, const uint8_t *in, size_t len) {
+        size_t i = 0;
+        size_t o = 0;
+        while (i < len) {
+            uint8_t code = in[i++];
+            if (code == 0) return 0;
+            for (uint8_t j = 1; j < code; j++) {
+                if (i >= len || in[i] == 0) return 0;
+                out[o++] = in[i++];
+            }
+            if (code != 0xFF && i < len) out[o++] = 0;
+        }
+        return o;
+    }
+
+    size_t snifferEncode(uint8_t *out, const SnifferHeader &header, const uint8_t *frame) {
+        uint8_t record[SNIFFER_RECORD_MAX];
+        uint8_t length = header.length < MAX_FRAME_LEN ? header.length : MAX_FRAME_LEN;
+        memcpy(record, &header, sizeof(header));
+        reinterpret_cast<SnifferHeader *>(record)->length = length;
+        memcpy(record + sizeof(header), frame, length);
+        size_t size = sizeof(header) + length;
+        uint16_t crc = crc16(record, size);
+        record[size++] = crc & 0xFF;
+        record[size++] = crc >> 8;
+
+        out[0] = 0;
+        size_t n = 1 + cobsEncode(out + 1, record, size);
+        out[n++] = 0;
+        return n;
+    }
+
+/**
+ * The function `feed` cuts the stream on the delimiters; empty blocks, found between two records, are
+ * skipped.
+ */
+    void SnifferDecoder::feed(const uint8_t *data, size_t len) {
+        for (size_t i = 0; i < len; i++) {
+            if (data[i] == 0) {
+                if (size || overflow) block();
+                size = 0;
+                overflow = false;
+            } else if (size < sizeof(buffer)) {
+                buffer[size++] = data[i];
+            } else {
+                overflow = true;
+            }
+        }
+    }
+
+    void SnifferDecoder::block() {
+        uint8_t record[SNIFFER_ENCODED_MAX];
+        size_t n = overflow ? 0 : cobsDecode(record, buffer, size);
+        const auto &header = *reinterpret_cast<const SnifferHeader *>(record);
+        if (n < sizeof(SnifferHeader) + sizeof(uint16_t) || header.version != SNIFFER_VERSION ||
+            header.length > MAX_FRAME_LEN || n != sizeof(SnifferHeader) + header.length + sizeof(uint16_t)) {
+            if (!first) stats.framingErrors += 1;
+            return;
+        }
+        uint16_t crc = record[n - 2] | record[n - 1] << 8;
+        if (crc16(record, n - 2) != crc) {
+            if (!first) stats.crcErrors += 1;
+            return;
+        }
+
+        if (!first) stats.lost += static_cast<uint16_t>(header.sequence - expected);
+        first = false;
+        expected = header.sequence + 1;
+        stats.frames += 1;
+
+        SnifferFrame frame;
+        frame.header = header;
+        memcpy(frame.frame, record + sizeof(SnifferHeader), header.length);
+        handler(frame);
+    }
+
+    iohcSniffer *iohcSniffer::getInstance() {
+        if (!_iohcSniffer)
+            _iohcSniffer = new iohcSniffer();
+        return _iohcSniffer;
+    }
+
+/**
+ * The function `start` switches the serial port to the sniffer speed. The ring and its sender task are
+ * made on the first start and kept afterwards.
+ *
+ * @param baud Serial speed while streaming, the receiver must use the same.
+ * @return true if the stream is running.
+ */
+    bool iohcSniffer::start(uint32_t baud) {
+    #if defined(ESP32)
+        if (!ring) {
+            ring = xRingbufferCreate(SNIFFER_RING_SIZE, RINGBUF_TYPE_BYTEBUF);
+            if (!ring || xTaskCreatePinnedToCore(senderTask, "sniffer_sender", 2048, this, tskIDLE_PRIORITY + 2, nullptr, tskNO_AFFINITY) != pdPASS) {
+                printf("Sniffer: can't start sender\n");
+                return false;
+            }
+        }
+        printf("Sniffer: binary stream at %u bauds, stop with 'sniffer off'\n", baud);
+        SNIFFER_SERIAL.flush();
+        SNIFFER_SERIAL.updateBaudRate(baud);
+    #endif
+        this->baud = baud;
+        stats = {};
+        running = true;
+        return true;
+    }
+
+    void iohcSniffer::stop() {
+        if (!running) return;
+        running = false;
+    #if defined(ESP32)
+        // Let the sender empty the ring before the speed changes
+        while (xRingbufferGetCurFreeSize(ring) < SNIFFER_RING_SIZE - SNIFFER_ENCODED_MAX) vTaskDelay(pdMS_TO_TICKS(10));
+        SNIFFER_SERIAL.flush();
+        SNIFFER_SERIAL.updateBaudRate(SNIFFER_CONSOLE_BAUD);
+    #endif
+        printf("Sniffer: %u sent %u dropped, latency max %u us\n", stats.sent, stats.dropped, maxLatencyUs());
+    }
+
+/**
+ * The function `record` encodes a frame into the ring. It is called on the radio task: a full ring
+ * drops the frame, the sequence still moves on so that the receiver sees the gap.
+ */
+    void iohcSniffer::record(const iohcPacket &packet, Direction direction) {
+        if (!running) return;
+
+        SnifferHeader header{};
+        header.version = SNIFFER_VERSION;
+        header.direction = direction;
+        header.sequence = sequence++;
+        header.timestampUs = snifferTime();
+        header.frequency = packet.frequency;
+        if (direction == Direction::Rx) {
+            header.afc = packet.rx.afc;
+            header.rssi = packet.rx.rssi;
+        }
+        header.length = packet.buffer_length;
+
+        uint8_t out[SNIFFER_ENCODED_MAX];
+        size_t n = snifferEncode(out, header, packet.payload.buffer);
+    #if defined(ESP32)
+        if (xRingbufferSend(ring, out, n, 0) != pdTRUE) {
+            stats.dropped += 1;
+            return;
+        }
+        uint32_t backlog = SNIFFER_RING_SIZE - xRingbufferGetCurFreeSize(ring);
+        if (backlog > stats.maxBacklog) stats.maxBacklog = backlog;
+    #else
+        (void) n;
+    #endif
+        stats.sent += 1;
+    }
+
+#if defined(ESP32)
+    void iohcSniffer::senderTask(void *pvParameters) {
+        auto *sniffer = static_cast<iohcSniffer *>(pvParameters);
+        while (true) {
+            size_t size = 0;
+            auto *data = static_cast<uint8_t *>(xRingbufferReceiveUpTo(sniffer->ring, &size, portMAX_DELAY, SNIFFER_CHUNK));
+            if (!data) continue;
+            SNIFFER_SERIAL.write(data, size);
+            vRingbufferReturnItem(sniffer->ring, data);
+        }
+    }
+#endif
+}
@@ -31,7 +31,7 @@ namespace IOHC {
         return _iohcSystemTable;
     }
 
-    bool iohcSystemTable::addObject(address node, address backbone, uint8_t actuator[2], uint8_t manufacturer, uint8_t flags) {
+    bool iohcSystemTable::addObject(const address node, const address backbone, const uint8_t actuator[2], uint8_t manufacturer, uint8_t flags) {
         changed = true;
         std::string s0 = bytesToHexString(node, 3);
         auto *tmp = new iohcObject (node, backbone, actuator, manufacturer, flags);
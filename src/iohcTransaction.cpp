@@ -0,0 +1,278 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <cstdio>
+#include <cstring>
+
+#include <iohcTransaction.h>
+
+#if defined(ESP32)
+    #include <esp_timer.h>
+#else
+    #include <chrono>
+#endif
+
+namespace IOHC {
+    iohcTransactions *iohcTransactions::_iohcTransactions = nullptr;
+
+    namespace {
+        constexpr uint8_t CHALLENGE = 0x3C;
+        constexpr uint8_t CHALLENGE_ANSWER = 0x3D;
+        constexpr uint8_t STATUS = 0xFE;
+
+        // Request and answer, as found by checkCmd (see iohcOtherDevice2W::initializeValid)
+        constexpr uint8_t exchanges[][2] = {
+            {0x00, 0x04}, {0x01, 0x04}, {0x03, 0x04}, {0x0A, 0x0D}, {0x0C, 0x0D}, {0x19, 0x1A}, {0x1E, 0xFE},
+            {0x20, 0x21}, {0x23, 0x24}, {0x28, 0x29}, {0x2A, 0x2B}, {0x2C, 0x2D}, {0x2E, 0x2F}, {0x31, 0x3C},
+            {0x32, 0x33}, {0x36, 0x37}, {0x38, 0x32}, {0x39, 0xFE}, {0x3C, 0x3D}, {0x46, 0x47}, {0x48, 0x49},
+            {0x4A, 0x4B}, {0x50, 0x51}, {0x52, 0x53}, {0x54, 0x55}, {0x56, 0x57}, {0x64, 0x65}, {0x6E, 0xFE},
+            {0x71, 0x72}, {0x80, 0x81}, {0x84, 0x85}, {0x86, 0x87}, {0x88, 0x89}, {0x8A, 0x8C}, {0x8B, 0x8C},
+            {0x90, 0x91}, {0x92, 0x93}, {0x94, 0x95}, {0x96, 0x97}, {0x98, 0x99},
+        };
+
+        struct AnswerTable {
+            uint8_t answer[256];
+        };
+
+        constexpr AnswerTable makeAnswers() {
+            AnswerTable table{};
+            for (const auto &e: exchanges) table.answer[e[0]] = e[1];
+            return table;
+        }
+
+        constexpr AnswerTable answers = makeAnswers();
+
+        using S = SessionState;
+        constexpr auto N = S::Count;
+        constexpr uint8_t EVENTS = static_cast<uint8_t>(SessionEvent::Count);
+
+        // Next state per state and event, Count where the event is not expected
+        constexpr SessionState transitions[static_cast<uint8_t>(S::Count)][EVENTS] = {
+            //                Request         Challenge      Response         Answer   Status      Timeout
+            /* Idle */        {S::AwaitAnswer, N,            N,               N,       N,          N},
+            /* AwaitAnswer */ {S::AwaitAnswer, S::Challenged, N,              S::Done, S::Refused, S::TimedOut},
+            /* Challenged */  {S::AwaitAnswer, S::Challenged, S::AwaitConfirm, N,      S::Refused, S::TimedOut},
+            /* AwaitConfirm */{S::AwaitAnswer, S::Challenged, S::AwaitConfirm, S::Done, S::Refused, S::TimedOut},
+            /* Done */        {S::AwaitAnswer, N,            N,               N,       N,          N},
+            /* Refused */     {S::AwaitAnswer, N,            N,               N,       N,          N},
+            /* TimedOut */    {S::AwaitAnswer, N,            N,               N,       N,          N},
+        };
+
+        // Time allowed in each state, 0 for the final ones. The repeats of the radio are within
+        constexpr uint16_t timeoutsMs[static_cast<uint8_t>(S::Count)] = {0, 500, 300, 500, 0, 0, 0};
+
+        constexpr const char *stateNames[static_cast<uint8_t>(S::Count)] = {
+            "idle", "await answer", "challenged", "await confirm", "done", "refused", "timed out"
+        };
+
+        bool is2W(const iohcPacket &packet) {
+            return packet.buffer_length >= FRAME_HEADER_LEN && !packet.payload.packet.header.CtrlByte1.asStruct.Protocol;
+        }
+
+        // Wrap safe, deadlines are less than a minute ahead
+        bool passed(uint32_t nowMs, uint32_t deadlineMs) {
+            return static_cast<int32_t>(nowMs - deadlineMs) >= 0;
+        }
+    }
+
+    uint8_t expectedAnswer(uint8_t request) { return answers.answer[request]; }
+
+    const char *sessionStateName(SessionState state) { return stateNames[static_cast<uint8_t>(state)]; }
+
+    uint32_t sessionTime() {
+    #if defined(ESP32)
+        return static_cast<uint32_t>(esp_timer_get_time() / 1000);
+    #else
+        return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    #endif
+    }
+
+    iohcTransactions *iohcTransactions::getInstance() {
+        if (!_iohcTransactions)
+            _iohcTransactions = new iohcTransactions();
+        return _iohcTransactions;
+    }
+
+    // Fed from the Tx ticker and the radio task, read from the console and the challenge handler
+    iohcTransactions::iohcTransactions() {
+    #if defined(ESP32)
+        mutex = xSemaphoreCreateMutex();
+    #endif
+    }
+
+#if defined(ESP32)
+    void iohcTransactions::lock() { xSemaphoreTake(mutex, portMAX_DELAY); }
+    void iohcTransactions::unlock() { xSemaphoreGive(mutex); }
+#else
+    void iohcTransactions::lock() {}
+    void iohcTransactions::unlock() {}
+#endif
+
+/**
+ * The function `apply` moves a session along the transition table. A timeout past the deadline is applied
+ * first, so that a late frame is matched against the timed out session and not against the one it came
+ * too late for.
+ *
+ * @return false if the event is not expected in the state of the session, which is left as is.
+ */
+    bool iohcTransactions::apply(Session &session, SessionEvent event, uint32_t nowMs) {
+        if (event != SessionEvent::Timeout && session.active() && passed(nowMs, session.deadlineMs))
+            apply(session, SessionEvent::Timeout, nowMs);
+
+        SessionState next = transitions[static_cast<uint8_t>(session.state)][static_cast<uint8_t>(event)];
+        if (next == SessionState::Count) {
+            if (event != SessionEvent::Timeout) stats.unexpected += 1;
+            return false;
+        }
+
+        session.state = next;
+        session.deadlineMs = nowMs + timeoutsMs[static_cast<uint8_t>(next)];
+        switch (next) {
+            case SessionState::Done: stats.done += 1; break;
+            case SessionState::Refused: stats.refused += 1; break;
+            case SessionState::TimedOut: stats.timedOut += 1; break;
+            default: break;
+        }
+        return true;
+    }
+
+    Session *iohcTransactions::lookup(uint32_t peer, uint32_t nowMs) {
+        for (auto &session: sessions) {
+            if (session.peer != peer) continue;
+            if (session.active() && passed(nowMs, session.deadlineMs)) apply(session, SessionEvent::Timeout, nowMs);
+            return &session;
+        }
+        return nullptr;
+    }
+
+    // A free session, else the one finished first, else the oldest active one
+    Session *iohcTransactions::open(uint32_t peer) {
+        Session *victim = nullptr;
+        for (auto &session: sessions) {
+            if (!session.peer) {
+                victim = &session;
+                break;
+            }
+            if (!victim || (victim->active() && !session.active()) ||
+                (victim->active() == session.active() && static_cast<int32_t>(session.startMs - victim->startMs) < 0))
+                victim = &session;
+        }
+        if (victim->peer && victim->active()) stats.evicted += 1;
+        *victim = {};
+        victim->peer = peer;
+        stats.opened += 1;
+        return victim;
+    }
+
+/**
+ * The function `sent` records a 2W frame sent. A request keeps its command and data, as the peer may ask
+ * for a challenge on them, and the IV prefix made of them, computed while the request is on air; our
+ * challenge answer only moves the session on. Other frames need no answer
+ * and are left out. A repeat of the request keeps the session and its deadline; the same command with
+ * other data is a new request, its data and IV prefix replace those of the previous one.
+ */
+    void iohcTransactions::sent(const iohcPacket &packet, uint32_t nowMs) {
+        if (!is2W(packet)) return;
+        const _header &header = packet.payload.packet.header;
+        uint32_t peer = sessionKey(header.target);
+
+        if (header.cmd == CHALLENGE_ANSWER) {
+            lock();
+            if (Session *session = lookup(peer, nowMs)) apply(*session, SessionEvent::Response, nowMs);
+            unlock();
+            return;
+        }
+        uint8_t answer = expectedAnswer(header.cmd);
+        if (!answer) return;
+        uint8_t dataLen = packet.buffer_length - FRAME_HEADER_LEN;
+        const uint8_t *data = packet.payload.buffer + FRAME_HEADER_LEN;
+
+        lock();
+        Session *session = lookup(peer, nowMs);
+        if (!session) session = open(peer);
+        if (session->state == SessionState::AwaitAnswer && session->request == header.cmd &&
+            session->dataLen == dataLen && !memcmp(session->data, data, dataLen)) {
+            unlock();
+            return;
+        }
+
+        session->request = header.cmd;
+        session->answer = answer;
+        session->dataLen = dataLen;
+        memcpy(session->data, data, dataLen);
+        iohcCrypto::challengePrefix(session->ivPrefix, session->request, session->data, session->dataLen);
+        session->startMs = nowMs;
+        apply(*session, SessionEvent::Request, nowMs);
+        unlock();
+    }
+
+    void iohcTransactions::received(const iohcPacket &packet, uint32_t nowMs) {
+        if (!is2W(packet)) return;
+        const _header &header = packet.payload.packet.header;
+        lock();
+        if (Session *session = lookup(sessionKey(header.source), nowMs)) {
+            if (header.cmd == CHALLENGE) apply(*session, SessionEvent::Challenge, nowMs);
+            else if (header.cmd == session->answer) apply(*session, SessionEvent::Answer, nowMs);
+            else if (header.cmd == STATUS) apply(*session, SessionEvent::Status, nowMs);
+            else stats.unexpected += 1;
+        }
+        unlock();
+    }
+
+    bool iohcTransactions::find(const address peer, Session *session, uint32_t nowMs) {
+        lock();
+        const Session *found = lookup(sessionKey(peer), nowMs);
+        if (found) *session = *found;
+        unlock();
+        return found;
+    }
+
+    void iohcTransactions::expire(uint32_t nowMs) {
+        lock();
+        timeOut(nowMs);
+        unlock();
+    }
+
+    // Sessions past their deadline, mutex taken
+    void iohcTransactions::timeOut(uint32_t nowMs) {
+        for (auto &session: sessions)
+            if (session.peer && session.active() && passed(nowMs, session.deadlineMs))
+                apply(session, SessionEvent::Timeout, nowMs);
+    }
+
+    uint8_t iohcTransactions::activeCount() {
+        uint8_t count = 0;
+        lock();
+        for (const auto &session: sessions)
+            if (session.peer && session.active()) count++;
+        unlock();
+        return count;
+    }
+
+    void iohcTransactions::print(uint32_t nowMs) {
+        lock();
+        timeOut(nowMs);
+        for (const auto &session: sessions) {
+            if (!session.peer) continue;
+            printf("%6.6X %2.2X>%2.2X %-13s %u ms ago\n", session.peer & 0xFFFFFF, session.request, session.answer,
+                   sessionStateName(session.state), nowMs - session.startMs);
+        }
+        unlock();
+        printf("%u opened, %u done, %u refused, %u timed out, %u unexpected, %u evicted\n", stats.opened, stats.done,
+               stats.refused, stats.timedOut, stats.unexpected, stats.evicted);
+    }
+}
@@ -0,0 +1,25 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <iohcAes.h>
+
+// FIPS-197 known answers of every backend, then their cycles per block
+
+int main() {
+    bool ok = iohcCrypto::aesSelfTest();
+    iohcCrypto::aesBench(1000000);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,123 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+#include <iohcAuth1W.h>
+#include <iohcCapture.h>
+#include <iohcFrameBuilder.h>
+#include <iohcSequence.h>
+
+// Verdicts on frames made with known keys, then verifications per second against the worst frame rate on air
+
+namespace {
+    using namespace IOHC;
+
+    struct BenchRemote {
+        address node;
+        uint8_t key[16];
+        uint16_t sequence;
+    };
+
+    // A Close press of the remote, as iohcRemote1W sends it
+    iohcPacket press(const BenchRemote &remote, uint16_t sequence) {
+        iohcPacket packet;
+        address broadcast;
+        broadcast1W(broadcast, 0);
+        buildFrame(&packet, Frames::Remote0x00_14, remote.node, broadcast);
+        packet.payload.packet.msg.p0x00_14.main[0] = 0xc8;
+        uint8_t *seq = packet.payload.packet.msg.p0x00_14.sequence;
+        seq[0] = sequence >> 8;
+        seq[1] = sequence & 0xff;
+        uint8_t mac[16];
+        iohcCrypto::create_1W_hmac(mac, seq, remote.key, &packet.payload.packet.header.cmd,
+                                   seq - &packet.payload.packet.header.cmd, remote.node);
+        memcpy(packet.payload.packet.msg.p0x00_14.hmac, mac, 6);
+        return packet;
+    }
+
+    AuthVerdict verdict(const iohcPacket &packet) {
+        AuthResult result{};
+        result.verdict = AuthVerdict::Count;
+        iohcAuth1W::getInstance()->verify(packet.payload.buffer, packet.buffer_length, &result);
+        return result.verdict;
+    }
+}
+
+int main() {
+    auto *auth = iohcAuth1W::getInstance();
+    auth->begin();
+
+    std::mt19937 random(0x1d);
+    BenchRemote remotes[IOHC_AUTH_KEYS];
+    for (uint8_t i = 0; i < IOHC_AUTH_KEYS; i++) {
+        auto &r = remotes[i];
+        r.node[0] = 0xb6;
+        r.node[1] = 0x0d;
+        r.node[2] = i;
+        for (uint8_t &b: r.key) b = random();
+        r.sequence = random();
+        auth->setKey(r.node, r.key, i & 1 ? iohcCrypto::KeyKind::Learnt : iohcCrypto::KeyKind::Remote);
+    }
+
+    const BenchRemote &r = remotes[0];
+    iohcPacket first = press(r, r.sequence);
+    iohcPacket forged = first;
+    forged.payload.packet.msg.p0x00_14.main[0] = 0x00;     // Close made Open, MAC kept
+    BenchRemote stranger = r;
+    stranger.node[0] = 0x11;
+    bool ok = verdict(first) == AuthVerdict::Authentic &&
+              verdict(first) == AuthVerdict::Authentic &&                   // Repeat of the same press
+              verdict(press(r, r.sequence + 1)) == AuthVerdict::Authentic &&
+              verdict(first) == AuthVerdict::Replay &&
+              verdict(forged) == AuthVerdict::Forged &&
+              verdict(press(stranger, 1)) == AuthVerdict::UnknownKey &&
+              verdict(press(r, r.sequence - IOHC_SEQUENCE_WINDOW)) == AuthVerdict::Replay &&   // Older than the window
+              verdict(press(r, r.sequence + 0x9000)) == AuthVerdict::Replay;     // Too far ahead is taken as behind
+    iohcPacket twoW = first;
+    twoW.payload.packet.header.CtrlByte1.asByte &= ~(1 << 5);
+    AuthResult none{};
+    ok &= !auth->verify(twoW.payload.buffer, twoW.buffer_length, &none);
+    printf("Verdicts %s\n", ok ? "ok" : "WRONG");
+    auth->print();
+
+    // Ready made frames, so that only the verification is timed. Sequences move on at each round
+    constexpr uint32_t ROUNDS = 200;
+    auto run = [&](uint8_t count) {
+        static iohcPacket frames[IOHC_AUTH_KEYS][ROUNDS];
+        for (uint8_t i = 0; i < count; i++)
+            for (uint32_t round = 0; round < ROUNDS; round++)
+                frames[i][round] = press(remotes[i], remotes[i].sequence + 0x100 + round);
+        uint32_t authentic = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t round = 0; round < ROUNDS; round++)
+            for (uint8_t i = 0; i < count; i++) authentic += verdict(frames[i][round]) == AuthVerdict::Authentic;
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        double vps = count * ROUNDS / elapsed.count();
+        const auto &cache = iohcCrypto::keyCacheStats();
+        printf("%2u remotes: %.0f verifications/s, %.2f us each, %.0f x worst case %u frames/s, %u/%u authentic, %u expansions\n",
+               count, vps, 1e6 / vps, vps / CAPTURE_WORST_FPS, CAPTURE_WORST_FPS, authentic, count * ROUNDS, cache.expansions);
+        for (uint8_t i = 0; i < count; i++) remotes[i].sequence += 0x100 + ROUNDS;
+        return authentic == count * ROUNDS;
+    };
+    // Within the key cache, then more remotes than it holds
+    ok &= run(4);
+    ok &= run(IOHC_AUTH_KEYS);
+    return ok ? 0 : 1;
+}
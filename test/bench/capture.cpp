@@ -0,0 +1,59 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <chrono>
+#include <cstdio>
+
+#include <iohcCapture.h>
+
+// Writer throughput with a file standing in for LittleFS, against the worst frame rate on air
+
+int main() {
+    using namespace IOHC;
+    constexpr uint32_t FRAMES = 200000;
+    const char *path = "capture-bench.bin";
+    remove(path);
+
+    auto *capture = iohcCapture::getInstance();
+    if (!capture->begin(path)) return 1;
+
+    iohcPacket received, sent;
+    received.buffer_length = sent.buffer_length = 23;
+    for (uint8_t i = 0; i < received.buffer_length; i++) received.payload.buffer[i] = sent.payload.buffer[i] = i;
+    received.rx.afc = -1200;
+    received.setRssi(-71.5f);
+    sent.tx = {35, 0, 1, false};
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < FRAMES; i++) capture->record(i & 1 ? sent : received, i & 1 ? Direction::Tx : Direction::Rx);
+    capture->flush();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    double fps = FRAMES / elapsed.count();
+    printf("%u frames in %.3f s: %.0f frames/s, %.1f x worst case %u frames/s, %.1f us/frame\n", FRAMES, elapsed.count(),
+           fps, fps / CAPTURE_WORST_FPS, CAPTURE_WORST_FPS, 1e6 / fps);
+    capture->dump(3);
+
+    // The signal of a frame received is kept, a frame sent has none
+    bool signal = true;
+    capture->forEach(4, [&signal](const CaptureRecord &rec) {
+        bool tx = rec.direction == Direction::Tx;
+        signal &= rec.afc == (tx ? 0 : -1200) && rec.rssi == (tx ? 0 : -715);
+    });
+    if (!signal) printf("Signal of the records wrong\n");
+    remove(path);
+    return capture->getStats().written == FRAMES && signal ? 0 : 1;
+}
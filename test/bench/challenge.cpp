@@ -0,0 +1,137 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include <crypto2Wutils.h>
+#include <iohcChallenge.h>
+#include <iohcCryptoHelpers.h>
+#include <iohcTransaction.h>
+
+// Heaters challenging one grouped command: each answer against the one the 0x3C handler computed alone,
+// then the answers of all heaters from their IV prefixes in one batch against one by one from the requests
+
+namespace {
+    using namespace IOHC;
+
+    const address gateway = {0xba, 0x11, 0xad};
+
+    iohcPacket frame(const address source, const address target, uint8_t cmd, const uint8_t *data, uint8_t len) {
+        iohcPacket packet{};
+        packet.payload.packet.header.CtrlByte1.asByte = 0x40 | (FRAME_HEADER_LEN - 1 + len);
+        memcpy(packet.payload.packet.header.source, source, 3);
+        memcpy(packet.payload.packet.header.target, target, 3);
+        packet.payload.packet.header.cmd = cmd;
+        memcpy(packet.payload.buffer + FRAME_HEADER_LEN, data, len);
+        packet.buffer_length = FRAME_HEADER_LEN + len;
+        return packet;
+    }
+
+    // As the 0x3C handler computed it before, for one heater
+    void reference(uint8_t *answer, uint8_t request, const uint8_t *data, uint8_t len, const uint8_t *challenge) {
+        uint8_t iv[16];
+        iohcCrypto::challengeInitialValue(iv, request, data, len, challenge);
+        iohcCrypto::encryptBlock(iohcCrypto::KeyId::of(iohcCrypto::KeyKind::Transfer), transfert_key, iv, answer);
+    }
+}
+
+int main() {
+    constexpr uint8_t HEATERS = 8;
+    auto *sessions = iohcTransactions::getInstance();
+    auto *challenges = iohcChallenges::getInstance();
+    address heaters[HEATERS];
+    ChallengeContext contexts[HEATERS]{};
+    ChallengeContext *batch[HEATERS];
+    uint8_t setMode[HEATERS][5];
+    bool ok = true;
+
+    // setMode to every heater, each with its own mode, then their challenges in turn, one frame apart. The
+    // sessions are looked up at the time of the clock by the handler
+    uint32_t now = sessionTime();
+    uint32_t heard = challengeTime();
+    for (uint8_t h = 0; h < HEATERS; h++) {
+        heaters[h][0] = 0x48;
+        heaters[h][1] = 0x79;
+        heaters[h][2] = h;
+        const uint8_t data[5] = {0x0C, 0x61, 0x01, 0x00, h};
+        memcpy(setMode[h], data, sizeof(data));
+        sessions->sent(frame(gateway, heaters[h], 0x20, setMode[h], sizeof(setMode[h])), now);
+    }
+    for (uint8_t h = 0; h < HEATERS; h++) {
+        const uint8_t challenge[6] = {0x11, 0x22, 0x33, 0x44, 0x55, static_cast<uint8_t>(0x60 + h)};
+        iohcPacket asked = frame(heaters[h], gateway, 0x3C, challenge, sizeof(challenge));
+        sessions->received(asked, now);
+        heard += 20000;
+        // Answered at once, nothing left pending
+        ok &= challenges->challenged(asked, heard);
+        ok &= challenges->flush(heard) == 0;
+        // Missed our answer and asks again
+        if (h == 3) ok &= challenges->challenged(asked, heard);
+
+        ChallengeContext &c = contexts[h];
+        c.peer = sessionKey(heaters[h]);
+        c.request = 0x20;
+        memcpy(c.challenge, challenge, sizeof(challenge));
+        c.keyTransfer = h == HEATERS - 1;
+        if (c.keyTransfer) c.request = 0x31;
+        if (c.keyTransfer) iohcCrypto::challengePrefix(c.ivPrefix, c.request, nullptr, 0);
+        else iohcCrypto::challengePrefix(c.ivPrefix, c.request, setMode[h], sizeof(setMode[h]));
+        batch[h] = &c;
+    }
+    // Not challenged after a request
+    ok &= !challenges->challenged(frame(gateway, heaters[0], 0x3C, setMode[0], 6));
+
+    iohcChallenges::computeAnswers(batch, HEATERS);
+    for (uint8_t h = 0; h < HEATERS; h++) {
+        uint8_t expected[16];
+        const ChallengeContext &c = contexts[h];
+        if (c.keyTransfer) {
+            reference(expected, 0x31, nullptr, 0, c.challenge);
+            for (uint8_t b = 0; b < 16; b++) expected[b] ^= transfert_key[b];
+        } else {
+            reference(expected, c.request, setMode[h], sizeof(setMode[h]), c.challenge);
+        }
+        ok &= c.answered && !memcmp(c.answer, expected, 16);
+    }
+    const auto &stats = challenges->getStats();
+    ok &= stats.answered == HEATERS + 1 && stats.repeated == 1 && stats.noRequest == 1 && stats.batches == HEATERS + 1 &&
+          stats.largestBatch == 1 && stats.maxLatencyUs == 0;
+    challenges->print();
+    printf("Answers %s\n", ok ? "as expected" : "DIFFER");
+
+    constexpr uint32_t ROUNDS = 200000;
+    uint8_t answer[16];
+    uint32_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t r = 0; r < ROUNDS; r++) {
+        for (uint8_t h = 0; h < HEATERS; h++) {
+            reference(answer, contexts[h].request, setMode[h], sizeof(setMode[h]), contexts[h].challenge);
+            sink += answer[0];
+        }
+    }
+    std::chrono::duration<double, std::nano> single = std::chrono::steady_clock::now() - start;
+    start = std::chrono::steady_clock::now();
+    for (uint32_t r = 0; r < ROUNDS; r++) {
+        iohcChallenges::computeAnswers(batch, HEATERS);
+        sink += contexts[0].answer[0];
+    }
+    std::chrono::duration<double, std::nano> batched = std::chrono::steady_clock::now() - start;
+    printf("%u heaters: %.1f ns one by one from the requests, %.1f ns in one batch from the prefixes (%u)\n", HEATERS, single.count() / ROUNDS,
+           batched.count() / ROUNDS, sink & 1);
+    return ok ? 0 : 1;
+}
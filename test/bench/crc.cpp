@@ -0,0 +1,71 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+#include <iohcCrc.h>
+
+// The table and slice-by-4 CRC against the bitwise one on random blocks, then ns per frame of each
+
+int main() {
+    using namespace IOHC;
+    // CRC-16/KERMIT check value, then a 2W frame with its CRC as received
+    const uint8_t check[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+    uint8_t frame[] = {0x4e, 0x00, 0xba, 0x11, 0xad, 0x48, 0x79, 0x02, 0x3c, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0, 0};
+    uint16_t crc = crc16Bitwise(frame, sizeof(frame) - 2);
+    frame[sizeof(frame) - 2] = crc;
+    frame[sizeof(frame) - 1] = crc >> 8;
+    bool ok = crc16Bitwise(check, sizeof(check)) == 0x2189 && crc16(check, sizeof(check)) == 0x2189 &&
+              crc16Valid(frame, sizeof(frame));
+    frame[3] ^= 0x10;
+    ok &= !crc16Valid(frame, sizeof(frame));
+
+    std::mt19937 random(0x8408);
+    uint8_t block[300];
+    for (uint8_t &b: block) b = random();
+    uint32_t failures = 0;
+    for (uint32_t round = 0; round < 100000; round++) {
+        size_t offset = random() % 32, len = random() % 256;
+        uint16_t start = random();
+        uint16_t reference = crc16Bitwise(block + offset, len, start);
+        failures += crc16Table(block + offset, len, start) != reference;
+        failures += crc16Slice4(block + offset, len, start) != reference;
+        block[random() % sizeof(block)] = random();
+    }
+    printf("CRC check values %s, %u differences with the bitwise CRC\n", ok ? "ok" : "FAILED", failures);
+
+    constexpr uint32_t ROUNDS = 2000000;
+    auto run = [&](const char *name, uint16_t (*fn)(const uint8_t *, size_t, uint16_t), size_t len) {
+        uint16_t sink = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t r = 0; r < ROUNDS; r++) {
+            block[0] = r;
+            sink += fn(block, len, 0);
+        }
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        printf("%-9s %3zu bytes %7.1f ns %6.2f ns/byte (%04x)\n", name, len, elapsed.count() / ROUNDS,
+               elapsed.count() / ROUNDS / len, sink);
+    };
+    // Shortest and longest frames, and a sniffer record
+    for (size_t len: {11, 34, 56}) {
+        run("bitwise", crc16Bitwise, len);
+        run("table", crc16Table, len);
+        run("slice-4", crc16Slice4, len);
+    }
+    return ok && !failures ? 0 : 1;
+}
@@ -0,0 +1,38 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <cstdlib>
+#include <new>
+
+#include <iohcCryptoBench.h>
+
+// Every crypto operation on the host checked, then timed in the format of the console command
+
+void *operator new(size_t size) {
+    iohcCrypto::hostAllocations += 1;
+    if (void *p = malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+int main(int argc, char **argv) {
+    uint32_t rounds = argc > 1 ? strtoul(argv[1], nullptr, 10) : 200000;
+    bool ok = iohcCrypto::cryptoSelfTest();
+    iohcCrypto::cryptoBench(rounds ? rounds : 200000);
+    return ok ? 0 : 1;
+}
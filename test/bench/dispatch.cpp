@@ -0,0 +1,267 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+#include <iohcAuth1W.h>
+#include <iohcCozyDevice2W.h>
+#include <iohcCryptoHelpers.h>
+#include <iohcDispatch.h>
+#include <iohcOtherDevice2W.h>
+#include <iohcRemote1W.h>
+#include <interact.h>
+
+#include "../hostRadio.h"
+
+// Frames in capDump lines (sequence;us;Hz;dBm;afc;direction;hex) replayed through the handlers that main
+// registers, on the simulated radio. RX lines are received, TX lines are the frames the handlers sent, as the
+// msgRcvd switch answered them. Those starting with '>' were console commands, the bench sends them. A file
+// of capDump lines given as argument is received instead, without pairing or scan and without checks.
+// The 1W lines are those logged in iohcRemote1W.cpp. The 2W ones are written from the frame specs for a
+// heater 487902 and the gateway ba11ad, CtrlByte2 0: there is no 2W capture in the tree.
+
+namespace {
+    using namespace IOHC;
+
+    struct Recorded {
+        bool pairMode;
+        bool scanMode;
+        std::vector<const char *> lines;
+    };
+
+    const Recorded recorded[] = {
+        // Pairing of the heater, the gateway answering each step
+        {true, false, {
+            "0;1000;868950000;-62.0;-715;RX;c80000003f48790228",
+            "1;1030;868950000;0.0;0;TX;5100487902ba11ad29ffc0ba11ad0bcc0000",
+            "2;1300;868950000;-62.0;-715;RX;5100ba11ad48790229ffc04879020c1a0000",
+            "3;1330;868950000;0.0;0;TX;4800487902ba11ad2c",
+            "4;1600;868950000;-62.0;-715;RX;4800ba11ad4879022c",
+            "5;1630;868950000;0.0;0;TX;4800487902ba11ad2d",
+            "6;1900;868950000;-62.0;-715;RX;4800ba11ad4879022d",
+            "7;2200;868950000;-62.0;-715;RX;4e00ba11ad48790238112233445566",
+            "8;2230;868950000;0.0;0;TX;5800487902ba11ad324447068fd83a2a1879d89924bc4bcfab",
+        }},
+        // Then its use: a setMode challenged, names, 1W remotes and their key
+        {false, false, {
+            "9;5000;868950000;-62.0;-715;RX;c80000003f48790228",
+            "> 10;6000;868950000;0.0;0;TX;4d00487902ba11ad200c61010001",
+            "11;6300;868950000;-62.0;-715;RX;4e00ba11ad4879023ca1b2c3d4e5f6",
+            "12;6330;868950000;0.0;0;TX;4e00487902ba11ad3d4bdba40ebab2",
+            "13;6600;868950000;-62.0;-715;RX;4800ba11ad48790221",
+            "14;7000;868950000;-58.5;-400;RX;4800ba11ad12345650",
+            "15;7030;868950000;0.0;0;TX;5800123456ba11ad514d595f47415445574159000000000000",
+            "16;7300;868950000;-62.0;-715;RX;5800ba11ad4879025168656174657200000000000000000000",
+            "17;7600;868950000;-58.5;-400;RX;4800aaaaaa12345650",
+            "18;8000;868950000;-70.0;-1200;RX;f50000003fb60d1a0101430500112416406780a53021",
+            "19;8100;868950000;-70.0;-1200;RX;f60000003fb60d1a000143d200000024179f18402aa33d",
+            "20;8200;868950000;-70.0;-1200;RX;f70000003fb60d1a2002db000900000323e7ceefedf9ce81",
+            "21;8300;868950000;-70.0;-1200;RX;fc0000003fb60d1a306471a7cb4860b4a56750c04ba7f49c320201241a",
+            "22;8400;868950000;-62.0;-715;RX;4800ba11ad48790299",
+        }},
+        // Scan of the heater: each answer is kept against the command sent
+        {false, true, {
+            "> 23;9000;868950000;0.0;0;TX;4800487902ba11ad0a",
+            "24;9300;868950000;-62.0;-715;RX;4900ba11ad487902fe08",
+            "> 25;9600;868950000;0.0;0;TX;4800487902ba11ad0c",
+            "26;9900;868950000;-62.0;-715;RX;4800ba11ad4879020d",
+            "> 27;10200;868950000;0.0;0;TX;4d00487902ba11ad200c61010001",
+            "28;10500;868950000;-62.0;-715;RX;4e00ba11ad4879023ca1b2c3d4e5f6",
+        }},
+    };
+
+    // Key of remote B60D1A in clear, sent encrypted by its 0x30 above
+    const uint8_t remoteKey[16] = {0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+                                   0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff};
+
+    struct Expected {
+        uint8_t cmd;
+        uint32_t hits;
+    };
+    const Expected expected[] = {{0x28, 2}, {0x29, 1}, {0x2C, 1}, {0x2D, 1}, {0x38, 1}, {0x3C, 2}, {0x21, 1},
+                                 {0x50, 2}, {0x51, 1}, {0x01, 1}, {0x00, 1}, {0x20, 1}, {0x30, 1}, {0xFE, 1},
+                                 {0x0D, 1}};
+
+    // Handlers with neither print nor frame to send, pairing and scan off
+    const uint8_t quiet[] = {0x00, 0x01, 0x03, 0x19, 0x20, 0x21, 0x2D, 0x3D, 0xFE};
+
+    int nibble(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    // Frame after the last ';', refused unless its length is the one of its CtrlByte1
+    bool parse(const char *line, iohcPacket &packet, bool *sent = nullptr) {
+        const char *hex = strrchr(line, ';');
+        hex = hex ? hex + 1 : line;
+        size_t len = strcspn(hex, "\r\n");
+        if (len < 2 * FRAME_HEADER_LEN || len > 2 * MAX_FRAME_LEN || len % 2) return false;
+        packet = {};
+        packet.buffer_length = len / 2;
+        for (size_t i = 0; i < len; i += 2) {
+            int hi = nibble(hex[i]), lo = nibble(hex[i + 1]);
+            if (hi < 0 || lo < 0) return false;
+            packet.payload.buffer[i / 2] = hi << 4 | lo;
+        }
+        if (packet.payload.packet.header.CtrlByte1.asStruct.MsgLen + 1 != packet.buffer_length) return false;
+        if (sent) *sent = hex - line >= 3 && !strncmp(hex - 3, "TX;", 3);
+        return true;
+    }
+
+    std::deque<std::vector<uint8_t>> onAir;
+
+    // Every frame the radio has to send, each on air before the next
+    void sendAll(iohcRadio *radio) {
+        while (radio->txTicker().fire())
+            HostTest::run(radio, HostTest::airTimeNs(MAX_FRAME_LEN));
+    }
+
+    // The frame sent next has to be this one, sent by the handlers or by the console
+    void sent(iohcRadio *radio, const iohcPacket &frame, const char *line) {
+        if (line[0] == '>') {
+            CHECK(onAir.empty());
+            iohcPacket *packet = txSlot();
+            *packet = frame;
+            packet->tx.repeatTime = Frames::Answer.repeatTime;
+            std::vector<iohcPacket *> console{packet};
+            radio->send(console);
+            sendAll(radio);
+        }
+        if (!CHECK(!onAir.empty())) return;
+        const std::vector<uint8_t> &air = onAir.front();
+        if (!CHECK(air.size() == frame.buffer_length && !memcmp(air.data(), frame.payload.buffer, air.size())))
+            printf("  %s expected\n", line);
+        onAir.pop_front();
+    }
+
+    // A press of the remote signed with its key, as iohcRemote1W sends it
+    AuthVerdict press(const address remote, const uint8_t *key) {
+        iohcPacket packet;
+        address broadcast;
+        broadcast1W(broadcast, 0);
+        buildFrame(&packet, Frames::Remote0x00_14, remote, broadcast);
+        uint8_t *seq = packet.payload.packet.msg.p0x00_14.sequence;
+        seq[0] = 0x24;
+        seq[1] = 0x20;
+        uint8_t mac[16];
+        iohcCrypto::create_1W_hmac(mac, seq, key, &packet.payload.packet.header.cmd,
+                                   seq - &packet.payload.packet.header.cmd, remote);
+        memcpy(packet.payload.packet.msg.p0x00_14.hmac, mac, 6);
+        AuthResult result{};
+        result.verdict = AuthVerdict::Count;
+        iohcAuth1W::getInstance()->verify(packet.payload.buffer, packet.buffer_length, &result);
+        return result.verdict;
+    }
+}
+
+int main(int argc, char **argv) {
+    auto *dispatcher = iohcDispatcher::getInstance();
+    iohcAuth1W::getInstance()->begin();
+    auto *remote1W = iohcRemote1W::getInstance();
+    auto *cozy = iohcCozyDevice2W::getInstance();
+    auto *other = iohcOtherDevice2W::getInstance();
+    // As main does, but 0x2B whose system table needs the filesystem
+    remote1W->registerHandlers(dispatcher);
+    cozy->registerHandlers(dispatcher);
+    other->registerHandlers(dispatcher);
+    dispatcher->ignore({iohcDevice::RECEIVED_PRIVATE_ACK_0x21, iohcDevice::RECEIVED_CHALLENGE_ANSWER_0x3D, 0x48, 0x49, 0x4A, 0x05});
+
+    auto *radio = HostTest::startRadio([dispatcher](iohcPacket *iohc) { return dispatcher->dispatch(iohc); });
+    HostTest::chip().onTransmit([](const uint8_t *frame, uint8_t length, uint32_t) {
+        onAir.emplace_back(frame, frame + length);
+    });
+
+    std::vector<iohcPacket> frames;
+    iohcPacket packet;
+    bool tx;
+    if (argc > 1) {
+        FILE *file = fopen(argv[1], "r");
+        if (!file) {
+            perror(argv[1]);
+            return 1;
+        }
+        char line[256];
+        while (fgets(line, sizeof(line), file))
+            if (parse(line, packet, &tx) && !tx) {
+                frames.push_back(packet);
+                HostTest::inject(radio, packet);
+                sendAll(radio);
+            }
+        fclose(file);
+        onAir.clear();
+    } else {
+        for (const auto &session: recorded) {
+            Cmd::pairMode = session.pairMode;
+            Cmd::scanMode = session.scanMode;
+            for (const char *line: session.lines) {
+                if (!CHECK(parse(line, packet, &tx))) {
+                    printf("  %s\n", line);
+                    continue;
+                }
+                if (tx) {
+                    sent(radio, packet, line);
+                    continue;
+                }
+                // Whatever the handlers sent is recorded before the next frame received
+                CHECK(onAir.empty());
+                onAir.clear();
+                frames.push_back(packet);
+                CHECK(HostTest::inject(radio, packet));
+                sendAll(radio);
+            }
+        }
+        Cmd::pairMode = false;
+        Cmd::scanMode = false;
+        CHECK(onAir.empty());
+    }
+    printf("\n%zu frames replayed\n", frames.size());
+    dispatcher->printStats();
+
+    if (argc == 1) {
+        for (const auto &e: expected)
+            if (!CHECK(dispatcher->getStats(e.cmd).hits == e.hits))
+                printf("  command %2.2X: %u hits, %u expected\n", e.cmd, dispatcher->getStats(e.cmd).hits, e.hits);
+        CHECK(dispatcher->getUnknown() == 1);
+
+        // The key learnt from the 0x30, in clear, authenticates the next presses of the remote
+        const address remote = {0xb6, 0x0d, 0x1a};
+        CHECK(press(remote, remoteKey) == AuthVerdict::Authentic);
+
+        // The scan kept the answer to each command sent
+        CHECK(other->mapValid[0x0A] == 0x08);
+        CHECK(other->mapValid[0x0C] == 0x0D);
+        CHECK(other->mapValid[0x20] == iohcDevice::RECEIVED_CHALLENGE_REQUEST_0x3C);
+    }
+
+    // Dispatch alone, on the frames whose handlers neither print nor send
+    std::vector<iohcPacket> timed;
+    for (auto &frame: frames)
+        if (memchr(quiet, frame.payload.packet.header.cmd, sizeof(quiet))) timed.push_back(frame);
+    if (timed.empty()) return HostTest::result();
+    constexpr uint32_t ROUNDS = 2000000;
+    dispatcher->resetStats();
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t r = 0; r < ROUNDS; r++) dispatcher->dispatch(&timed[r % timed.size()]);
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    printf("%.1f ns/frame dispatched\n", elapsed.count() / ROUNDS);
+    return HostTest::result();
+}
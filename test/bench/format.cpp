@@ -0,0 +1,293 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <new>
+#include <random>
+#include <sstream>
+
+#include <iohcFormat.h>
+#include <iohcFrame.h>
+#include <iohcProtocol.h>
+
+// The decoded frame line and the hex against the stringstream helpers and the decode() switch they replace,
+// then the cost of both
+
+static size_t allocations = 0;
+
+void *operator new(size_t size) {
+    allocations++;
+    if (void *p = malloc(size)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+namespace {
+    using namespace IOHC;
+
+    std::string legacyHex(const uint8_t *bitrow, unsigned len, bool upper = false) {
+        std::stringstream ss;
+        ss << std::hex << std::setfill('0');
+        if (upper) ss << std::uppercase;
+        for (unsigned i = 0; i < len; ++i) ss << std::setw(2) << static_cast<unsigned>(bitrow[i]);
+        return ss.str();
+    }
+
+    struct Legacy {
+        char *out;
+        size_t size;
+        size_t n = 0;
+
+        template <typename... Args>
+        void printf(const char *format, Args... args) {
+            int written = snprintf(out + n, size - n, format, args...);
+            if (written > 0) n = n + written < size ? n + written : size - 1;
+        }
+    };
+
+    // decode() before the frame views, printf to the line, without the newline
+    size_t legacyDecode(char *out, size_t size, const iohcPacket &packet, bool verbosity, unsigned long elapsedUs) {
+        Legacy line{out, size};
+        const _packet &p = packet.payload.packet;
+        const _msg &msg = p.msg;
+        char _dir[3] = {};
+        if (p.header.CtrlByte1.asStruct.Protocol) _dir[0] = '>';
+        else if (p.header.CtrlByte1.asStruct.StartFrame && !p.header.CtrlByte1.asStruct.EndFrame) _dir[0] = '>';
+        else if (!p.header.CtrlByte1.asStruct.StartFrame && p.header.CtrlByte1.asStruct.EndFrame) _dir[0] = '<';
+        else _dir[0] = ' ';
+
+        line.printf("(%2.2u) %1xW S %s E %s ", p.header.CtrlByte1.asStruct.MsgLen, p.header.CtrlByte1.asStruct.Protocol ? 1 : 2,
+                    p.header.CtrlByte1.asStruct.StartFrame ? "1" : "0", p.header.CtrlByte1.asStruct.EndFrame ? "1" : "0");
+        if (p.header.CtrlByte2.asStruct.LPM) line.printf("[LPM]");
+        if (p.header.CtrlByte2.asStruct.Beacon) line.printf("[B]");
+        if (p.header.CtrlByte2.asStruct.Routed) line.printf("[R]");
+        if (p.header.CtrlByte2.asStruct.Prio) line.printf("[PRIO]");
+        if (p.header.CtrlByte2.asStruct.Unk2) line.printf("[U2]");
+        if (p.header.CtrlByte2.asStruct.Unk3) line.printf("[U3]");
+        if (p.header.CtrlByte2.asStruct.Version) line.printf("[V]%u", p.header.CtrlByte2.asStruct.Version);
+        line.printf("\tFROM %2.2X%2.2X%2.2X TO %2.2X%2.2X%2.2X CMD %2.2X", p.header.source[0], p.header.source[1],
+                    p.header.source[2], p.header.target[0], p.header.target[1], p.header.target[2], p.header.cmd);
+        if (verbosity) line.printf(" +%03.3f\t", static_cast<float>(elapsedUs) / 1000.0);
+        line.printf(" %s ", _dir);
+
+        uint8_t dataLen = packet.buffer_length - 9;
+        line.printf(" DATA(%2.2u) ", dataLen);
+
+        if (p.header.CtrlByte1.asStruct.Protocol) {
+            line.printf(" %s", legacyHex(packet.payload.buffer + 9, dataLen).c_str());
+            switch (p.header.cmd) {
+                case 0x30:
+                    line.printf("\tMANU %X DATA %X ", msg.p0x30.man_id, msg.p0x30.data);
+                    line.printf("\tKEY %s SEQ %s ", legacyHex(msg.p0x30.enc_key, 16).c_str(), legacyHex(msg.p0x30.sequence, 2).c_str());
+                    break;
+                case 0x2E:
+                case 0x39:
+                    line.printf("\tDATA %X ", msg.p0x2e.data);
+                    line.printf("\tSEQ %s MAC %s ", legacyHex(msg.p0x2e.sequence, 2).c_str(), legacyHex(msg.p0x2e.hmac, 6).c_str());
+                    break;
+                case 0x20:
+                    if (dataLen == 13) {
+                        line.printf("\tSEQ %s MAC %s ", legacyHex(msg.p0x20_13.sequence, 2).c_str(), legacyHex(msg.p0x20_13.hmac, 6).c_str());
+                        auto main = static_cast<unsigned>((msg.p0x20_13.main[0] << 8) | msg.p0x20_13.main[1]);
+                        line.printf(" Manuf %X Acei %X Main %X fp1 %X ", msg.p0x20_13.origin, msg.p0x20_13.acei.asByte, main, msg.p0x20_13.fp1);
+                    }
+                    if (dataLen == 15) {
+                        line.printf("\tSEQ %s MAC %s ", legacyHex(msg.p0x20_15.sequence, 2).c_str(), legacyHex(msg.p0x20_15.hmac, 6).c_str());
+                        auto main = static_cast<unsigned>((msg.p0x20_15.main[0] << 8) | msg.p0x20_15.main[1]);
+                        line.printf(" Manuf %X Acei %X Main %X fp1 %X fp2 %X fp3 %X ", msg.p0x20_15.origin, msg.p0x20_15.acei.asByte, main,
+                                    msg.p0x20_15.fp1, msg.p0x20_15.fp2, msg.p0x20_15.fp3);
+                    }
+                    if (dataLen == 16) {
+                        line.printf("\tSEQ %s MAC %s ", legacyHex(msg.p0x20_16.sequence, 2).c_str(), legacyHex(msg.p0x20_16.hmac, 6).c_str());
+                        auto main = static_cast<unsigned>((msg.p0x20_16.main[0] << 8) | msg.p0x20_16.main[1]);
+                        auto data = static_cast<unsigned>((msg.p0x20_16.data[0] << 8) | msg.p0x20_16.data[1]);
+                        line.printf(" Manu %X Acei %X Main %4X fp1 %X fp2 %X Data %4X", msg.p0x20_16.origin, msg.p0x20_16.acei.asByte, main,
+                                    msg.p0x20_16.fp1, msg.p0x20_16.fp2, data);
+                    }
+                    break;
+                case 0x28:
+                case 0x01:
+                case 0x00:
+                    if (dataLen == 13) {
+                        line.printf("\tSEQ %s MAC %s ", legacyHex(msg.p0x01_13.sequence, 2).c_str(), legacyHex(msg.p0x01_13.hmac, 6).c_str());
+                        line.printf(" Org %X Acei %X Main %X fp1 %X fp2 %X ", msg.p0x01_13.origin, msg.p0x01_13.acei.asByte,
+                                    static_cast<unsigned>(msg.p0x01_13.main), msg.p0x01_13.fp1, msg.p0x01_13.fp2);
+                        auto acei = msg.p0x01_13.acei;
+                        line.printf(" Acei %u %u %u %u ", acei.asStruct.level, acei.asStruct.service, acei.asStruct.extended, acei.asStruct.isvalid);
+                    }
+                    if (dataLen == 14) {
+                        line.printf("\tSEQ %s MAC %s ", legacyHex(msg.p0x00_14.sequence, 2).c_str(), legacyHex(msg.p0x00_14.hmac, 6).c_str());
+                        auto main = static_cast<unsigned>(msg.p0x00_14.main[0] << 8);
+                        line.printf(" Org %X Acei %X Main %X fp1 %X fp2 %X ", msg.p0x00_14.origin, msg.p0x00_14.acei.asByte, main,
+                                    msg.p0x00_14.fp1, msg.p0x00_14.fp2);
+                        auto acei = msg.p0x00_14.acei;
+                        line.printf(" Acei %u %u %u %u ", acei.asStruct.level, acei.asStruct.service, acei.asStruct.extended, acei.asStruct.isvalid);
+                    }
+                    if (dataLen == 16) {
+                        line.printf("\tSEQ %s MAC %s ", legacyHex(msg.p0x00_16.sequence, 2).c_str(), legacyHex(msg.p0x00_16.hmac, 6).c_str());
+                        auto main = static_cast<unsigned>((msg.p0x00_16.main[0] << 8) | msg.p0x00_16.main[1]);
+                        auto data = static_cast<unsigned>((msg.p0x00_16.data[0] << 8) | msg.p0x00_16.data[1]);
+                        line.printf(" Org %X Acei %X Main %4X fp1 %X fp2 %X Data %4X", msg.p0x00_16.origin, msg.p0x00_16.acei.asByte, main,
+                                    msg.p0x00_16.fp1, msg.p0x00_16.fp2, data);
+                        auto acei = msg.p0x00_16.acei;
+                        line.printf(" Acei %u %u %u %u ", acei.asStruct.level, acei.asStruct.service, acei.asStruct.extended, acei.asStruct.isvalid);
+                    }
+                    break;
+                default:
+                    break;
+            }
+            uint16_t broadcast = (p.header.target[1] << 2) | ((p.header.target[2] >> 6) & 0x03);
+            line.printf(" Type %s ", std::string(deviceTypeName(broadcast)).c_str());
+        } else if (dataLen != 0) {
+            line.printf(" %s", legacyHex(packet.payload.buffer + 9, dataLen).c_str());
+            if (p.header.cmd == 0x00 || p.header.cmd == 0x01) {
+                line.printf(" Org %X Acei %X Main %X fp1 %X fp2 %X ", msg.p0x01_13.origin, msg.p0x01_13.acei.asByte,
+                            static_cast<unsigned>(msg.p0x01_13.main), msg.p0x01_13.fp1, msg.p0x01_13.fp2);
+                auto acei = msg.p0x01_13.acei;
+                line.printf(" Acei %u %u %u %u ", acei.asStruct.level, acei.asStruct.service, acei.asStruct.extended, acei.asStruct.isvalid);
+            }
+        }
+        return line.n;
+    }
+
+    // One frame for each layout, with the length the switch knew it by: ctrl1 flags, cmd, data length
+    struct Shape {
+        uint8_t ctrl1;
+        uint8_t cmd;
+        uint8_t dataLen;
+    };
+    const Shape shapes[] = {
+        {0xE0, 0x00, 13}, {0xE0, 0x01, 13}, {0xE0, 0x28, 13},   // P0x01_13
+        {0xE0, 0x00, 14},                                       // P0x00_14
+        {0xE0, 0x00, 16}, {0xE0, 0x20, 16},                     // P0x00_16
+        {0xE0, 0x20, 13},                                       // P0x20_13
+        {0xE0, 0x20, 15},                                       // P0x20_15
+        {0xE0, 0x2E, 9}, {0xE0, 0x39, 9},                       // P0x2e
+        {0xE0, 0x30, 20},                                       // P0x30
+        {0xE0, 0x2B, 9}, {0x40, 0x29, 9},                       // P0x2b
+        {0x40, 0x00, 6}, {0x40, 0x01, 2}, {0x80, 0x00, 13},     // P2W_0x00
+        {0xE0, 0x00, 15}, {0xE0, 0x51, 0}, {0x40, 0x20, 5}, {0xC0, 0x2A, 0}, // Raw
+    };
+
+    // The decode() line of the vent press logged in iohcRemote1W.cpp, and of a key transfer and a 0x20
+    struct Pinned {
+        uint8_t frame[MAX_FRAME_LEN];
+        uint8_t length;
+        const char *line;
+    };
+    const Pinned pinned[] = {
+        {{0xF6, 0x00, 0x00, 0x00, 0x3F, 0xB6, 0x0D, 0x1A, 0x00,
+          0x01, 0x43, 0xD8, 0x03, 0x00, 0x00, 0x24, 0x17, 0x9F, 0x18, 0x40, 0x2A, 0xA3, 0x3D}, 23,
+         "(22) 1W S 1 E 1 \tFROM B60D1A TO 00003F CMD 00 >  DATA(14)  0143d803000024179f18402aa33d"
+         "\tSEQ 2417 MAC 9f18402aa33d  Org 1 Acei 43 Main D800 fp1 0 fp2 0  Acei 2 0 1 1  Type All "},
+        {{0xFC, 0x00, 0x00, 0x00, 0x3F, 0xB6, 0x0D, 0x1A, 0x30,
+          0x64, 0x71, 0xA7, 0xCB, 0x48, 0x60, 0xB4, 0xA5, 0x67, 0x50, 0xC0, 0x4B, 0xA7, 0xF4, 0x9C, 0x32,
+          0x02, 0x01, 0x24, 0x1A}, 29,
+         "(28) 1W S 1 E 1 \tFROM B60D1A TO 00003F CMD 30 >  DATA(20)  6471a7cb4860b4a56750c04ba7f49c320201241a"
+         "\tMANU 2 DATA 1 \tKEY 6471a7cb4860b4a56750c04ba7f49c32 SEQ 241a  Type All "},
+        {{0xF9, 0x00, 0x00, 0x00, 0x3F, 0xB6, 0x0D, 0x1A, 0x20,
+          0x02, 0xDB, 0x00, 0x09, 0x00, 0x00, 0x00, 0x5A, 0x23, 0xE7, 0xCE, 0xEF, 0xED, 0xF9, 0xCE, 0x81}, 25,
+         "(25) 1W S 1 E 1 \tFROM B60D1A TO 00003F CMD 20 >  DATA(16)  02db00090000005a23e7ceefedf9ce81"
+         "\tSEQ 23e7 MAC ceefedf9ce81  Manu 2 Acei DB Main    9 fp1 0 fp2 0 Data   5A Type All "},
+    };
+
+    constexpr uint32_t ROUNDS = 200000;
+}
+
+int main() {
+    std::mt19937 rng(0x10C);
+    bool ok = true;
+
+    // Hex of every length against the stringstream
+    uint8_t bytes[MAX_FRAME_LEN];
+    char hex[2 * MAX_FRAME_LEN + 1], text[2 * MAX_FRAME_LEN + 1];
+    uint32_t hexMismatches = 0;
+    for (uint32_t round = 0; round < 64; round++) {
+        for (auto &b: bytes) b = rng();
+        for (unsigned len = 0; len <= MAX_FRAME_LEN; len++) {
+            for (bool upper: {false, true}) {
+                hexEncode(hex, bytes, len, upper);
+                if (legacyHex(bytes, len, upper) == hex) continue;
+                if (!hexMismatches++) printf("hexEncode %u bytes: %s, stringstream %s\n", len, hex, legacyHex(bytes, len, upper).c_str());
+            }
+            TextWriter(text, sizeof(text)).hex(bytes, len);
+            if (legacyHex(bytes, len) != text && !hexMismatches++)
+                printf("TextWriter %u bytes: %s, stringstream %s\n", len, text, legacyHex(bytes, len).c_str());
+        }
+    }
+    printf("hex: %u mismatches\n", hexMismatches);
+    ok &= hexMismatches == 0;
+
+    // Lines of random frames of each layout against the decode() switch
+    char line[FRAME_LINE_LEN], legacy[FRAME_LINE_LEN];
+    bool seen[static_cast<uint8_t>(Layout::Count)]{};
+    uint32_t lineMismatches = 0;
+    iohcPacket packet;
+    for (const auto &shape: shapes) {
+        for (uint32_t round = 0; round < 256; round++) {
+            packet = {};
+            packet.buffer_length = FRAME_HEADER_LEN + shape.dataLen;
+            for (uint8_t i = 0; i < packet.buffer_length; i++) packet.payload.buffer[i] = rng();
+            packet.payload.buffer[0] = shape.ctrl1 | (packet.buffer_length - 1);
+            packet.payload.buffer[8] = shape.cmd;
+            seen[static_cast<uint8_t>(FrameView(packet).layout())] = true;
+            bool verbosity = round & 1;
+            unsigned long elapsedUs = rng() % 1000000;
+            formatFrame(line, sizeof(line), packet, verbosity, elapsedUs);
+            legacyDecode(legacy, sizeof(legacy), packet, verbosity, elapsedUs);
+            if (!strcmp(line, legacy)) continue;
+            if (!lineMismatches++) printf("%s\n%s\n", line, legacy);
+        }
+    }
+    for (uint8_t l = 0; l < static_cast<uint8_t>(Layout::Count); l++) {
+        if (seen[l]) continue;
+        printf("No frame of layout %s\n", layoutName(static_cast<Layout>(l)));
+        ok = false;
+    }
+    printf("lines: %u mismatches\n", lineMismatches);
+    ok &= lineMismatches == 0;
+
+    for (const auto &p: pinned) {
+        packet = {};
+        memcpy(packet.payload.buffer, p.frame, p.length);
+        packet.buffer_length = p.length;
+        formatFrame(line, sizeof(line), packet, false, 0);
+        if (!strcmp(line, p.line)) continue;
+        printf("%s\n%s expected\n", line, p.line);
+        ok = false;
+    }
+
+    memcpy(packet.payload.buffer, pinned[0].frame, pinned[0].length);
+    packet.buffer_length = pinned[0].length;
+    auto run = [&](auto &&fn) {
+        size_t before = allocations;
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t r = 0; r < ROUNDS; r++) fn();
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        printf("%.1f ns/frame %.2f allocations/frame\n", elapsed.count() / ROUNDS,
+               static_cast<double>(allocations - before) / ROUNDS);
+    };
+    printf("formatFrame  ");
+    run([&] { formatFrame(line, sizeof(line), packet, true, 12345); });
+    printf("stringstream ");
+    run([&] { legacyDecode(line, sizeof(line), packet, true, 12345); });
+    return ok ? 0 : 1;
+}
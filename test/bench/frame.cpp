@@ -0,0 +1,94 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include <iohcFrame.h>
+
+// Classification throughput of the layout tables against the cmd/dataLen switch they replace
+
+namespace {
+    using namespace IOHC;
+
+    Layout legacyClassify(const uint8_t *buffer, uint8_t length) {
+        const auto &packet = *reinterpret_cast<const _packet *>(buffer);
+        uint8_t dataLen = length - 9;
+        if (packet.header.CtrlByte1.asStruct.Protocol) {
+            switch (packet.header.cmd) {
+                case 0x30: return Layout::P0x30;
+                case 0x2E:
+                case 0x39: return Layout::P0x2e;
+                case 0x29:
+                case 0x2B: return Layout::P0x2b;
+                case 0x20:
+                    if (dataLen == 13) return Layout::P0x20_13;
+                    if (dataLen == 15) return Layout::P0x20_15;
+                    if (dataLen == 16) return Layout::P0x00_16;
+                    return Layout::Raw;
+                case 0x28:
+                case 0x01:
+                case 0x00:
+                    if (dataLen == 13) return Layout::P0x01_13;
+                    if (dataLen == 14) return Layout::P0x00_14;
+                    if (dataLen == 16) return Layout::P0x00_16;
+                    return Layout::Raw;
+                default: return Layout::Raw;
+            }
+        }
+        if (packet.header.cmd == 0x29 || packet.header.cmd == 0x2B) return Layout::P0x2b;
+        if (dataLen != 0 && (packet.header.cmd == 0x00 || packet.header.cmd == 0x01)) return Layout::P2W_0x00;
+        return Layout::Raw;
+    }
+
+    constexpr uint8_t cmds[] = {0x00, 0x01, 0x20, 0x28, 0x29, 0x2B, 0x2E, 0x30, 0x39, 0x3C, 0x3D, 0x04, 0x80};
+    constexpr uint32_t FRAMES = 4096;
+    constexpr uint32_t ROUNDS = 2000;
+}
+
+int main() {
+    static uint8_t frames[FRAMES][MAX_FRAME_LEN];
+    static uint8_t lengths[FRAMES];
+    srand(1);
+    for (uint32_t i = 0; i < FRAMES; i++) {
+        lengths[i] = FRAME_HEADER_LEN + rand() % (FRAME_MAX_DATA_LEN + 1);
+        for (auto &b: frames[i]) b = rand();
+        frames[i][0] = (frames[i][0] & 0xE0) | (lengths[i] - 1);
+        frames[i][8] = cmds[rand() % sizeof(cmds)];
+    }
+
+    uint32_t mismatches = 0;
+    for (uint32_t i = 0; i < FRAMES; i++)
+        if (classify(frames[i], lengths[i]).layout != legacyClassify(frames[i], lengths[i])) mismatches++;
+
+    auto run = [&](auto &&fn) {
+        volatile uint32_t sink = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t r = 0; r < ROUNDS; r++)
+            for (uint32_t i = 0; i < FRAMES; i++)
+                sink = sink + static_cast<uint8_t>(fn(frames[i], lengths[i]));
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count() / (static_cast<double>(ROUNDS) * FRAMES);
+    };
+    double table = run([](const uint8_t *b, uint8_t l) { return classify(b, l).layout; });
+    double legacy = run(legacyClassify);
+
+    printf("frames %u mismatches %u\n", FRAMES, mismatches);
+    printf("table  %.2f ns/frame %.1f Mframes/s\n", table, 1000.0 / table);
+    printf("switch %.2f ns/frame %.1f Mframes/s\n", legacy, 1000.0 / legacy);
+    return mismatches ? 1 : 0;
+}
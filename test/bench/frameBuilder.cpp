@@ -0,0 +1,110 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
+
+#include <iohcFrameBuilder.h>
+
+// Cost of a frame built into the pool, against the vector and forgePacket path it replaces
+
+static size_t allocations = 0;
+
+void *operator new(size_t size) {
+    allocations++;
+    if (void *p = malloc(size)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+namespace {
+    using namespace IOHC;
+
+    const address gateway = {0xba, 0x11, 0xad};
+    const address device = {0x48, 0x79, 0x02};
+
+    // The former Cozy forgePacket and its caller, packets deleted here instead of leaked
+    void legacySetTemp(std::vector<iohcPacket *> &packets2send, Memorize &memorize, uint8_t temp) {
+        std::vector<uint8_t> toSend = {0x0C, 0x61, 0x01, 0x03, 0xFF, 0x00};
+        toSend[4] = temp;
+        for (auto *p: packets2send) delete p;
+        packets2send.clear();
+        auto *packet = new iohcPacket;
+        packet->payload.packet.header.CtrlByte1.asStruct.MsgLen = sizeof(_header) - 1;
+        packet->payload.packet.header.CtrlByte1.asStruct.Protocol = 0;
+        packet->payload.packet.header.CtrlByte1.asStruct.StartFrame = 1;
+        packet->payload.packet.header.CtrlByte1.asStruct.EndFrame = 0;
+        packet->payload.packet.header.CtrlByte2.asByte = 0;
+        packet->payload.packet.header.CtrlByte1.asByte += toSend.size();
+        memcpy(packet->payload.buffer + 9, toSend.data(), toSend.size());
+        packet->buffer_length = toSend.size() + 9;
+        packet->frequency = CHANNEL2;
+        packet->tx.repeatTime = 25;
+        packet->tx.repeat = 0;
+        packet->tx.lock = false;
+        packet->payload.packet.header.cmd = 0x20;
+        memorize.memorizedData = toSend;
+        memorize.memorizedCmd = 0x20;
+        memcpy(packet->payload.packet.header.source, gateway, 3);
+        memcpy(packet->payload.packet.header.target, device, 3);
+        packet->tx.delayed = 50;
+        packets2send.push_back(packet);
+    }
+
+    void builderSetTemp(std::vector<iohcPacket *> &packets2send, Memorize &memorize, uint8_t temp) {
+        // Previous frame sent, the radio gives its packet back
+        for (auto *packet: packets2send) releaseFrame(packet);
+        packets2send.clear();
+        auto *packet = buildFrame(Frames::CozySetTemp, gateway, device);
+        frameData(packet)[4] = temp;
+        memorize.memorizedData.assign(frameData(packet), frameData(packet) + Frames::CozySetTemp.dataLen);
+        memorize.memorizedCmd = Frames::CozySetTemp.cmd;
+        packets2send.push_back(packet);
+    }
+
+    constexpr uint32_t ROUNDS = 1000000;
+}
+
+int main() {
+    std::vector<iohcPacket *> legacyBatch, builderBatch;
+    Memorize legacyMemorize, builderMemorize;
+    legacySetTemp(legacyBatch, legacyMemorize, 215);
+    builderSetTemp(builderBatch, builderMemorize, 215);
+    const iohcPacket &a = *legacyBatch[0], &b = *builderBatch[0];
+    bool same = a.buffer_length == b.buffer_length && !memcmp(a.payload.buffer, b.payload.buffer, a.buffer_length) &&
+                a.tx.repeatTime == b.tx.repeatTime && a.tx.repeat == b.tx.repeat && a.tx.delayed == b.tx.delayed &&
+                legacyMemorize.memorizedData == builderMemorize.memorizedData;
+    printf("Frames %s\n", same ? "identical" : "DIFFER");
+
+    auto run = [&](auto &&fn) {
+        size_t before = allocations;
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t r = 0; r < ROUNDS; r++) fn(static_cast<uint8_t>(r));
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        printf("%.1f ns/frame %.1f Mframes/s %.2f allocations/frame\n", elapsed.count() * 1e9 / ROUNDS,
+               ROUNDS / elapsed.count() / 1e6, static_cast<double>(allocations - before) / ROUNDS);
+    };
+    printf("buildFrame  ");
+    run([&](uint8_t t) { builderSetTemp(builderBatch, builderMemorize, t); });
+    printf("forgePacket ");
+    run([&](uint8_t t) { legacySetTemp(legacyBatch, legacyMemorize, t); });
+    return same ? 0 : 1;
+}
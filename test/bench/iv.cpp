@@ -0,0 +1,149 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <tuple>
+#include <vector>
+
+#include <iohcCryptoHelpers.h>
+
+// The IV builders against copies of the two constructInitialValue they replace, on random frames, then ns per IV
+
+namespace {
+    // iohcCryptoHelpers.cpp, 1W
+    std::tuple<uint8_t, uint8_t> legacyChecksum(uint8_t frame_byte, uint8_t chksum1, uint8_t chksum2) {
+        uint8_t tmpchksum = frame_byte ^ chksum2;
+        chksum2 = ((chksum1 & 0x7f) << 1) & 0xff;
+        if (tmpchksum >= 0x80)
+            chksum2 |= 1;
+        if ((chksum1 & 0x80) == 0)
+            return std::make_tuple(chksum2, (tmpchksum << 1) & 0xff);
+        return std::make_tuple(chksum2 ^ 0x55, ((tmpchksum << 1) ^ 0x5b) & 0xff);
+    }
+
+    std::vector<uint8_t> legacy1W(const std::vector<uint8_t> &frame_data, const uint8_t *sequence_number) {
+        std::vector<uint8_t> initial_value(16, 0);
+        size_t i = 0;
+        while (i < frame_data.size()) {
+            std::tie(initial_value[8], initial_value[9]) = legacyChecksum(frame_data[i], initial_value[8], initial_value[9]);
+            if (i < 8)
+                initial_value[i] = frame_data[i];
+            i++;
+        }
+        for (size_t j = i; j < 8; j++)
+            initial_value[j] = 0x55;
+        for (i = 12; i < 16; i++)
+            initial_value[i] = 0x55;
+        initial_value[10] = sequence_number[0];
+        initial_value[11] = sequence_number[1];
+        return initial_value;
+    }
+
+    // crypto2Wutils.h, 2W, with the request put together as the Cozy handler did
+    struct Checksum {
+        uint8_t chksum1;
+        uint8_t chksum2;
+    };
+
+    Checksum legacyChecksum2W(uint8_t frame_byte, uint8_t chksum1, uint8_t chksum2) {
+        Checksum result;
+        uint8_t tmpchksum = frame_byte ^ chksum2;
+        chksum2 = ((chksum1 & 0x7F) << 1) & 0xFF;
+        if (tmpchksum >= 128) chksum2 |= 1;
+        if ((chksum1 & 0x80) == 0) {
+            result.chksum1 = chksum2;
+            result.chksum2 = (tmpchksum << 1) & 0xFF;
+            return result;
+        }
+        result.chksum1 = chksum2 ^ 0x55;
+        result.chksum2 = ((tmpchksum << 1) ^ 0x5B) & 0xFF;
+        return result;
+    }
+
+    void legacy2W(std::vector<uint8_t> frame_data, uint8_t *initial_value, size_t frame_length, std::vector<uint8_t> challenge) {
+        initial_value[8] = 0;
+        initial_value[9] = 0;
+        size_t i = 0;
+        while (i < frame_length) {
+            Checksum checksum = legacyChecksum2W(frame_data[i], initial_value[8], initial_value[9]);
+            initial_value[8] = checksum.chksum1;
+            initial_value[9] = checksum.chksum2;
+            if (i < 8) initial_value[i] = frame_data[i];
+            i++;
+        }
+        for (size_t j = i; j < 8; j++) initial_value[j] = 0x55;
+        for (int k = 10; k < 16; k++) initial_value[k] = challenge[k - 10];
+    }
+
+    void legacyChallenge(uint8_t *iv, uint8_t cmd, const uint8_t *data, size_t len, const uint8_t *challenge) {
+        std::vector<uint8_t> IVdata(data, data + len);
+        IVdata.insert(IVdata.begin(), cmd);
+        std::vector<uint8_t> challengeAsked(challenge, challenge + 6);
+        legacy2W(IVdata, iv, IVdata.size(), challengeAsked);
+    }
+}
+
+int main() {
+    using namespace iohcCrypto;
+    std::mt19937 random(0x10c);
+    auto bytes = [&](uint8_t *out, size_t len) { for (size_t i = 0; i < len; i++) out[i] = random(); };
+    uint8_t frame[64], challenge[6], sequence[2], expected[16], iv[16];
+    uint32_t failures = 0;
+
+    for (uint32_t round = 0; round < 200000; round++) {
+        size_t len = random() % 40;
+        bytes(frame, len);
+        bytes(challenge, 6);
+        bytes(sequence, 2);
+
+        std::vector<uint8_t> legacy = legacy1W(std::vector<uint8_t>(frame, frame + len), sequence);
+        hmacInitialValue(iv, frame, len, sequence);
+        failures += memcmp(iv, legacy.data(), 16) != 0;
+
+        legacyChallenge(expected, frame[0], frame + 1, len, challenge);
+        challengeInitialValue(iv, frame[0], frame + 1, len, challenge);
+        failures += memcmp(iv, expected, 16) != 0;
+
+        // From any state, the table and the byte steps agree
+        uint16_t start = random();
+        uint8_t c1 = start >> 8, c2 = start;
+        for (size_t i = 0; i < len; i++) std::tie(c1, c2) = legacyChecksum(frame[i], c1, c2);
+        failures += ivChecksum(frame, len, start) != (c1 << 8 | c2);
+    }
+    printf("IV properties: %u failures\n", failures);
+
+    constexpr uint32_t ROUNDS = 2000000;
+    const uint8_t request[] = {0x0c, 0x61, 0x01, 0x03, 0xd7, 0x00};
+    const uint8_t command[] = {0x00, 0x01, 0x43, 0xd2, 0x00, 0x00, 0x00, 0x00, 0x00};
+    uint32_t sink = 0;
+    auto run = [&](const char *name, auto &&fn) {
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t r = 0; r < ROUNDS; r++) {
+            sequence[1] = r;
+            sink += fn(r);
+        }
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        printf("%-22s %6.1f ns/IV (%u)\n", name, elapsed.count() / ROUNDS, sink & 1);
+    };
+    run("2W challenge, vectors", [&](uint32_t r) { legacyChallenge(iv, 0x20, request, sizeof(request), challenge); challenge[0] = r; return iv[9]; });
+    run("2W challenge", [&](uint32_t r) { challengeInitialValue(iv, 0x20, request, sizeof(request), challenge); challenge[0] = r; return iv[9]; });
+    run("1W HMAC, vectors", [&](uint32_t) { return legacy1W(std::vector<uint8_t>(command, command + sizeof(command)), sequence)[9]; });
+    run("1W HMAC", [&](uint32_t) { hmacInitialValue(iv, command, sizeof(command), sequence); return iv[9]; });
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,54 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <cstdio>
+#include <cstring>
+
+#include <iohcCryptoHelpers.h>
+
+// Known answer, invalidation and eviction of the key cache, then a block with and without it
+
+int main() {
+    using namespace iohcCrypto;
+    // FIPS-197 appendix C.1
+    const uint8_t key[16] = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f};
+    const uint8_t plain[16] = {0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff};
+    const uint8_t cipher[16] = {0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30, 0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a};
+    uint8_t out[16];
+    encryptBlock(KeyId::of(KeyKind::System), key, plain, out);
+    bool ok = !memcmp(out, cipher, 16);
+
+    // A key changed under the same identity is expanded again
+    uint8_t changed[16];
+    memcpy(changed, key, 16);
+    changed[0] ^= 1;
+    encryptBlock(KeyId::of(KeyKind::System), changed, plain, out);
+    ok &= memcmp(out, cipher, 16) != 0;
+    encryptBlock(KeyId::of(KeyKind::System), key, plain, out);
+    ok &= !memcmp(out, cipher, 16) && keyCacheStats().expansions == 3;
+
+    // More remotes than entries, all still right
+    for (uint8_t n = 0; n < 2 * IOHC_KEY_CACHE_SIZE; n++) {
+        const uint8_t node[3] = {0x40, 0x00, n};
+        encryptBlock(KeyId::of(KeyKind::Remote, node), key, plain, out);
+        ok &= !memcmp(out, cipher, 16);
+    }
+    printf("Known answer and invalidation %s\n", ok ? "ok" : "FAILED");
+    invalidateKeys();
+
+    benchKeyCache(200000);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,67 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <cstdio>
+
+#include <iohcFrameBuilder.h>
+#include <iohcPacket.h>
+
+// Size of a packet and of the pools, against the former layout with every RX and TX field side by side
+
+namespace {
+    using namespace IOHC;
+
+    // As it was, unsigned long made 32 bits as on the ESP32
+    class LegacyPacket {
+    public:
+        Payload payload{};
+        uint8_t buffer_length = 0;
+        uint32_t frequency = CHANNEL2;
+        uint32_t repeatTime = 0L;
+        uint8_t repeat = 0;
+        bool lock = false;
+        uint32_t delayed = 0;
+        double afc{};
+        uint8_t snr{};
+        float rssi{};
+        uint8_t lna{};
+        uint8_t source_originator[3] = {0};
+    };
+
+    void pool(const char *name, size_t count) {
+        size_t before = count * sizeof(LegacyPacket), after = count * sizeof(iohcPacket);
+        printf("%-28s %3zu packets %6zu -> %6zu bytes, %zu saved, %zu packets in the same RAM\n", name, count, before,
+               after, before - after, before / sizeof(iohcPacket));
+    }
+}
+
+int main() {
+    printf("iohcPacket %zu bytes (payload %zu, RX %zu, TX %zu), was %zu\n", sizeof(iohcPacket), sizeof(Payload),
+           sizeof(RxInfo), sizeof(TxInfo), sizeof(LegacyPacket));
+    pool("TX pool", IOHC_TX_POOL_SIZE);
+    pool("Inbound (msgArchive)", IOHC_INBOUND_MAX_PACKETS);
+
+    // Fixed point RSSI as the transceivers report it, half dB steps
+    bool ok = true;
+    iohcPacket packet;
+    for (int raw = 0; raw < 256; raw++) {
+        float dBm = raw / -2.0f;
+        packet.setRssi(dBm);
+        ok &= packet.rssiDbm() == dBm;
+    }
+    printf("RSSI %s\n", ok ? "exact" : "DIFFER");
+    return ok && sizeof(iohcPacket) < sizeof(LegacyPacket) ? 0 : 1;
+}
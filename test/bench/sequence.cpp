@@ -0,0 +1,87 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+#include <iohcSequence.h>
+
+// Window verdicts on a scripted sequence, drift of a remote we send as, then ns per classification
+
+int main() {
+    using namespace IOHC;
+    using V = SequenceVerdict;
+
+    struct Step {
+        uint16_t sequence;
+        V expected;
+    };
+    // Repeats, a gap filled late, replays within and below the window, a jump, then a wrap through 0
+    const Step script[] = {
+        {0x2416, V::Fresh}, {0x2416, V::Repeat}, {0x2417, V::Fresh}, {0x241A, V::Fresh}, {0x2418, V::Late},
+        {0x2418, V::Replay}, {0x2419, V::Late}, {0x2416, V::Replay}, {0x241A - IOHC_SEQUENCE_WINDOW, V::Replay},
+        {0x241A + IOHC_SEQUENCE_JUMP, V::Jump}, {0x241A, V::Replay}, {0xFFFE, V::Replay},
+    };
+    SequenceWindow window{};
+    uint8_t wrong = 0;
+    for (const auto &step: script) wrong += window.observe(step.sequence) != step.expected;
+    SequenceWindow wrap{};
+    wrong += wrap.observe(0xFFFE) != V::Fresh;
+    wrong += wrap.observe(0x0001) != V::Fresh;
+    wrong += wrap.observe(0xFFFF) != V::Late;
+    wrong += wrap.observe(0xFFFE) != V::Replay;
+
+    // A real remote heard, then our copy of it sending with the counter of 1W.json
+    auto *sequences = iohcSequences::getInstance();
+    const address remote = {0xb6, 0x0d, 0x1a};
+    sequences->observe(remote, 0x2417, Direction::Rx);
+    sequences->observe(remote, 0x2418, Direction::Rx);
+    wrong += sequences->observe(remote, 0x2410, Direction::Tx) != V::Late;
+    wrong += sequences->observe(remote, 0x2419, Direction::Tx) != V::Fresh;
+    SequenceNode state{};
+    wrong += !sequences->find(remote, &state) || state.behind != 1 || state.txHighest != 0x2419 || state.rxHighest != 0x2418;
+    printf("Verdicts %s\n", wrong ? "WRONG" : "ok");
+    sequences->print();
+
+    // Remotes pressed in turn: frames repeated, presses lost, a few old frames replayed
+    constexpr uint32_t ROUNDS = 10000000;
+    std::mt19937 random(0x47);
+    struct Draw {
+        uint8_t step;
+        uint8_t back;
+    };
+    static Draw draws[4096];
+    for (auto &d: draws) {
+        uint32_t x = random() % 64;
+        d = x < 40 ? Draw{0, 0} : x < 58 ? Draw{1, 0} : x < 62 ? Draw{3, 0} : Draw{0, static_cast<uint8_t>(1 + random() % 100)};
+    }
+    SequenceWindow windows[8]{};
+    uint16_t next[8]{};
+    uint32_t counts[static_cast<uint8_t>(V::Count)]{};
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t r = 0; r < ROUNDS; r++) {
+        uint8_t w = r & 7;
+        const Draw &d = draws[(r >> 3) % 4096];
+        next[w] += d.step;
+        counts[static_cast<uint8_t>(windows[w].observe(next[w] - d.back))] += 1;
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    printf("%.2f ns per classification:", elapsed.count() / ROUNDS);
+    for (uint8_t v = 0; v < static_cast<uint8_t>(V::Count); v++) printf(" %u %s", counts[v], sequenceVerdictName(static_cast<V>(v)));
+    printf("\n");
+    return wrong ? 1 : 0;
+}
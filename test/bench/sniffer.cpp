@@ -0,0 +1,66 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include <iohcSniffer.h>
+
+// Cost on the radio task (encode) and on the receiver (decode), against the serial link budget
+
+int main() {
+    using namespace IOHC;
+    constexpr uint32_t FRAMES = 200000;
+    const uint8_t frame[MAX_FRAME_LEN] = {0xF6, 0x00, 0x00, 0x00, 0x3F, 0x12, 0x34, 0x56, 0x00, 0x01, 0x43, 0xD2, 0x00, 0x02,
+                                          0x00, 0x01, 0x23, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06};
+
+    std::vector<uint8_t> stream;
+    stream.reserve(FRAMES * SNIFFER_ENCODED_MAX);
+    uint8_t out[SNIFFER_ENCODED_MAX];
+    SnifferHeader header{SNIFFER_VERSION, Direction::Rx, 0, 0, 868950000, -1200, -715, MAX_FRAME_LEN, 0};
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < FRAMES; i++) {
+        header.sequence = static_cast<uint16_t>(i);
+        header.timestampUs = i;
+        size_t n = snifferEncode(out, header, frame);
+        stream.insert(stream.end(), out, out + n);
+    }
+    std::chrono::duration<double, std::nano> encode = std::chrono::steady_clock::now() - start;
+
+    // Every 1000th record loses a byte, as on a noisy line
+    for (size_t i = 500; i < stream.size(); i += 1000 * (SNIFFER_RECORD_MAX + 4)) stream[i] ^= 0x5A;
+
+    uint32_t received = 0;
+    SnifferDecoder decoder([&](const SnifferFrame &) { received++; });
+    start = std::chrono::steady_clock::now();
+    decoder.feed(stream.data(), stream.size());
+    std::chrono::duration<double, std::nano> decode = std::chrono::steady_clock::now() - start;
+
+    const auto &stats = decoder.getStats();
+    double recordBytes = static_cast<double>(stream.size()) / FRAMES;
+    double linkFps = SNIFFER_BAUD / 10.0 / recordBytes;
+    printf("%.1f bytes/record (longest frame), encode %.1f ns, decode %.1f ns\n", recordBytes,
+           encode.count() / FRAMES, decode.count() / FRAMES);
+    printf("%u received, %u CRC errors, %u framing errors, %u lost\n", stats.frames, stats.crcErrors,
+           stats.framingErrors, stats.lost);
+    printf("%u bauds: %.0f frames/s sustained, %.1f x worst case %u frames/s\n", SNIFFER_BAUD, linkFps,
+           linkFps / CAPTURE_WORST_FPS, CAPTURE_WORST_FPS);
+    printf("Added latency: %.0f us on the wire per record, %.1f ms with the ring full\n", 1e6 / linkFps,
+           SNIFFER_RING_SIZE * 10e3 / SNIFFER_BAUD);
+    return stats.frames + stats.lost == FRAMES ? 0 : 1;
+}
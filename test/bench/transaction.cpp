@@ -0,0 +1,105 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include <iohcTransaction.h>
+
+// Heaters driven side by side: a command to each, then their challenges, our answers and their
+// acknowledgements interleaved, as they come on air. One heater never answers and times out
+
+namespace {
+    using namespace IOHC;
+
+    const address gateway = {0xba, 0x11, 0xad};
+
+    iohcPacket frame(const address source, const address target, uint8_t cmd, const uint8_t *data, uint8_t len) {
+        iohcPacket packet{};
+        packet.payload.packet.header.CtrlByte1.asByte = 0x40 | (FRAME_HEADER_LEN - 1 + len);
+        memcpy(packet.payload.packet.header.source, source, 3);
+        memcpy(packet.payload.packet.header.target, target, 3);
+        packet.payload.packet.header.cmd = cmd;
+        memcpy(packet.payload.buffer + FRAME_HEADER_LEN, data, len);
+        packet.buffer_length = FRAME_HEADER_LEN + len;
+        return packet;
+    }
+}
+
+int main() {
+    constexpr uint8_t HEATERS = IOHC_MAX_SESSIONS;
+    auto *engine = iohcTransactions::getInstance();
+    const uint8_t setTemp[] = {0x0C, 0x61, 0x01, 0x03, 0xD7, 0x00};
+    const uint8_t challenge[] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x66};
+    address heaters[HEATERS];
+    for (uint8_t h = 0; h < HEATERS; h++) {
+        heaters[h][0] = 0x48;
+        heaters[h][1] = 0x79;
+        heaters[h][2] = h;
+    }
+
+    uint32_t now = 1000;
+    for (auto &heater: heaters) engine->sent(frame(gateway, heater, 0x20, setTemp, sizeof(setTemp)), now += 5);
+    bool ok = engine->activeCount() == HEATERS;
+    // The last heater stays silent
+    for (uint8_t h = 0; h + 1 < HEATERS; h++) {
+        engine->received(frame(heaters[h], gateway, 0x3C, challenge, sizeof(challenge)), now += 3);
+        Session session;
+        ok &= engine->find(heaters[h], &session, now) && session.state == SessionState::Challenged &&
+              session.request == 0x20 && session.dataLen == sizeof(setTemp) && !memcmp(session.data, setTemp, sizeof(setTemp));
+        engine->sent(frame(gateway, heaters[h], 0x3D, challenge, sizeof(challenge)), now += 1);
+    }
+    for (uint8_t h = 0; h + 1 < HEATERS; h++) engine->received(frame(heaters[h], gateway, 0x21, nullptr, 0), now += 3);
+    engine->expire(now += 1000);
+    engine->print(now);
+
+    const auto &stats = engine->getStats();
+    ok &= stats.done == HEATERS - 1 && stats.timedOut == 1 && stats.unexpected == 0 && !engine->activeCount();
+
+    // The same command sent again with other data before its answer is the request challenged
+    const uint8_t otherTemp[] = {0x0C, 0x61, 0x01, 0x03, 0xD9, 0x00};
+    Session first, second;
+    engine->sent(frame(gateway, heaters[0], 0x20, setTemp, sizeof(setTemp)), now += 1);
+    engine->find(heaters[0], &first, now);
+    engine->sent(frame(gateway, heaters[0], 0x20, otherTemp, sizeof(otherTemp)), now += 1);
+    engine->find(heaters[0], &second, now);
+    ok &= second.state == SessionState::AwaitAnswer && !memcmp(second.data, otherTemp, sizeof(otherTemp)) &&
+          memcmp(first.ivPrefix, second.ivPrefix, IV_PREFIX_LEN) != 0;
+    engine->received(frame(heaters[0], gateway, 0x21, nullptr, 0), now += 3);
+    printf("%s\n", ok ? "Sessions as expected" : "Sessions DIFFER");
+
+    // Cost of one exchange, four events, with the table full
+    constexpr uint32_t ROUNDS = 1000000;
+    iohcPacket request = frame(gateway, heaters[0], 0x20, setTemp, sizeof(setTemp));
+    iohcPacket asked = frame(heaters[0], gateway, 0x3C, challenge, sizeof(challenge));
+    iohcPacket answer = frame(gateway, heaters[0], 0x3D, challenge, sizeof(challenge));
+    iohcPacket ack = frame(heaters[0], gateway, 0x21, nullptr, 0);
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t r = 0; r < ROUNDS; r++) {
+        uint8_t h = r % HEATERS;
+        request.payload.packet.header.target[2] = asked.payload.packet.header.source[2] = h;
+        answer.payload.packet.header.target[2] = ack.payload.packet.header.source[2] = h;
+        engine->sent(request, now);
+        engine->received(asked, now);
+        engine->sent(answer, now);
+        engine->received(ack, now);
+        now += 1;
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    printf("%.1f ns/exchange, %u done\n", elapsed.count() / ROUNDS, engine->getStats().done);
+    return ok ? 0 : 1;
+}
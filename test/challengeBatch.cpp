@@ -0,0 +1,92 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <vector>
+
+#include <iohcChallenge.h>
+
+#include "hostRadio.h"
+
+// Each challenge received on air is answered at once, and the answers go on air. Given while a batch is
+// sent, they go before its next frame, ahead of another batch queued behind it
+int main() {
+    using namespace IOHC;
+    constexpr uint8_t HEATERS = 3;
+    auto *challenges = iohcChallenges::getInstance();
+    auto *sessions = iohcTransactions::getInstance();
+    auto *radio = HostTest::startRadio([&](iohcPacket *packet) {
+        if (packet->payload.packet.header.cmd == 0x3C) challenges->challenged(*packet);
+        return true;
+    });
+
+    std::vector<uint8_t> onAir;
+    HostTest::chip().onTransmit([&](const uint8_t *frame, uint8_t, uint32_t) {
+        onAir.push_back(frame[8]);
+    });
+    // Every frame of the batch being sent, each on air before the next
+    auto sendAll = [&]() {
+        while (radio->txTicker().fire())
+            HostTest::run(radio, HostTest::airTimeNs(MAX_FRAME_LEN));
+    };
+
+    const address gateway = {0xba, 0x11, 0xad};
+    address heaters[HEATERS];
+    for (uint8_t h = 0; h < HEATERS; h++) {
+        heaters[h][0] = 0x48;
+        heaters[h][1] = 0x79;
+        heaters[h][2] = h;
+    }
+    auto challengeAll = [&]() {
+        for (uint8_t h = 0; h < HEATERS; h++) {
+            iohcPacket setMode{};
+            buildFrame(&setMode, Frames::CozySetMode, gateway, heaters[h]);
+            sessions->sent(setMode);
+            iohcPacket challenge{};
+            buildFrame(&challenge, Frames::ChallengeAnswer, heaters[h], gateway);
+            challenge.payload.packet.header.cmd = 0x3C;
+            challenge.payload.buffer[FRAME_HEADER_LEN + 5] = h;
+            CHECK(HostTest::inject(radio, challenge));
+        }
+    };
+
+    // Answered on arrival, each before the next challenge
+    challengeAll();
+    CHECK(challenges->getStats().challenged == HEATERS);
+    CHECK(challenges->getStats().batches == HEATERS);
+    CHECK(challenges->getStats().largestBatch == 1);
+    CHECK(challenges->flush() == 0);
+    CHECK(radio->txTicker().active());
+    sendAll();
+    CHECK(onAir == std::vector<uint8_t>(HEATERS, Frames::ChallengeAnswer.cmd));
+
+    // During a batch: another batch is queued behind it, the answers go before its next frame
+    onAir.clear();
+    std::vector<iohcPacket *> batch{buildFrame(Frames::CozySetMode, gateway, heaters[0]),
+                                    buildFrame(Frames::CozySetMode, gateway, heaters[1])};
+    CHECK(radio->send(batch));
+    CHECK(radio->txTicker().fire());
+    std::vector<iohcPacket *> queued{buildFrame(Frames::OtherGetName, gateway, heaters[2])};
+    CHECK(radio->send(queued));
+    CHECK(queued.empty());
+    HostTest::run(radio, HostTest::airTimeNs(MAX_FRAME_LEN));
+    challengeAll();
+    CHECK(challenges->getStats().batches == 2 * HEATERS);
+    sendAll();
+    const uint8_t request = Frames::CozySetMode.cmd, answer = Frames::ChallengeAnswer.cmd;
+    CHECK(onAir == std::vector<uint8_t>({request, answer, answer, answer, request, Frames::OtherGetName.cmd}));
+
+    return HostTest::result();
+}
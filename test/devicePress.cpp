@@ -0,0 +1,59 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <vector>
+
+#include <iohcCozyDevice2W.h>
+
+#include "hostRadio.h"
+
+// The devices on the host, without their settings files: a console press of the Cozy gateway goes on
+// air, one setMode per heater with the mode asked, and the second one waits its delay
+int main() {
+    using namespace IOHC;
+    auto *radio = HostTest::startRadio([](iohcPacket *) { return true; });
+    auto *cozy = iohcCozyDevice2W::getInstance();
+
+    std::vector<std::vector<uint8_t>> onAir;
+    HostTest::chip().onTransmit([&](const uint8_t *frame, uint8_t length, uint32_t) {
+        onAir.emplace_back(frame, frame + length);
+    });
+
+    Tokens press{"setMode", "manual"};
+    cozy->cmd(DeviceButton::setMode, &press);
+    CHECK(radio->txTicker().period() == Frames::CozySetMode.tx.repeatTime);
+    bool waited = false;
+    while (true) {
+        if (radio->txTicker().period() == Frames::CozySetModeDelay) {
+            waited = true;
+            CHECK(onAir.size() == 1);
+        }
+        if (!radio->txTicker().fire()) break;
+        HostTest::run(radio, HostTest::airTimeNs(MAX_FRAME_LEN));
+    }
+    CHECK(waited);
+
+    CHECK(onAir.size() == cozy->addresses.size());
+    for (size_t h = 0; h < onAir.size() && h < cozy->addresses.size(); h++) {
+        const std::vector<uint8_t> &frame = onAir[h];
+        CHECK(frame.size() == FRAME_HEADER_LEN + Frames::CozySetMode.dataLen);
+        CHECK(!memcmp(frame.data() + 2, cozy->addresses[h].data(), sizeof(address)));
+        CHECK(!memcmp(frame.data() + 5, cozy->gateway, sizeof(address)));
+        CHECK(frame[FRAME_HEADER_LEN] == 0x0C && frame[FRAME_HEADER_LEN + 4] == 0x01);
+    }
+
+    return HostTest::result();
+}
@@ -0,0 +1,116 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <cstring>
+
+#include "hostRadio.h"
+
+/*
+    RX and TX latencies of a 32 bytes frame (and 29 for RX) at 38400 bps, as counted by the simulator:
+        RX  end of the frame on air to the FIFO emptied
+        TX  Standby to the first bit of preamble on air
+    The driver (FifoLevel on DIO1, drained by chunks while the frame arrives, Tx entered before the FIFO
+    is written) is measured against the former way, emulated on the same chip: the FIFO read a byte at a
+    time after PayloadReady, and written in full before Tx.
+*/
+int main() {
+    using namespace IOHC;
+    using namespace Radio;
+    auto &chip = HostTest::chip();
+    uint8_t frame[32];
+    for (uint8_t i = 0; i < sizeof(frame); i++) frame[i] = i;
+    frame[0] = 0x1f;
+
+    uint32_t received = 0;
+    uint8_t rxLength = 0;
+    auto *radio = HostTest::startRadio([&](iohcPacket *packet) {
+        received += 1;
+        rxLength = packet->buffer_length;
+        return true;
+    });
+
+    // DIO1 is FifoLevel, above the threshold the chunks are sized for
+    CHECK(((readByte(REG_DIOMAPPING1) >> 4) & 0x03) == 0b00);
+    CHECK((readByte(REG_FIFOTHRESH) & ~RF_FIFOTHRESH_FIFOTHRESHOLD_MASK) == RADIO_FIFO_THRESHOLD);
+
+    // Driver RX, the frame drained by chunks while on air and its tail read on PayloadReady. Back to back,
+    // a whole number of chunks then not, so that a frame drained to the last byte would show
+    uint32_t rxDriver[2];
+    const uint8_t lengths[2] = {sizeof(frame), sizeof(frame) - 3};
+    for (uint8_t i = 0; i < 2; i++) {
+        chip.clearCounters();
+        frame[0] = lengths[i] - 1;
+        CHECK(chip.inject(frame, lengths[i], CHANNEL2));
+        bool drainedEarly = false;
+        for (uint64_t t = 0; t < HostTest::airTimeNs(lengths[i]); t += 20000) {
+            chip.advance(20000);
+            uint32_t spiBefore = chip.counters().spiTransactions;
+            while (uint32_t notification = ulTaskNotifyTake(pdTRUE, 0))
+                radio->service(notification);
+            // FIFO read while the frame is still on air
+            drainedEarly |= !chip.counters().framesReceived && chip.counters().spiTransactions > spiBefore;
+        }
+        CHECK(received == i + 1u);
+        CHECK(rxLength == lengths[i]);
+        CHECK(drainedEarly);
+        rxDriver[i] = chip.counters().rxLatency;
+    }
+    frame[0] = 0x1f;
+
+    // Driver TX
+    chip.clearCounters();
+    iohcPacket *packet = txSlot();
+    memcpy(packet->payload.buffer, frame, sizeof(frame));
+    packet->buffer_length = sizeof(frame);
+    packet->frequency = CHANNEL2;
+    packet->tx = {25, 0, 0};
+    std::vector<iohcPacket *> batch{packet};
+    radio->send(batch);
+    radio->txTicker().fire();
+    HostTest::run(radio, HostTest::airTimeNs(sizeof(frame)));
+    CHECK(chip.counters().framesSent == 1);
+    CHECK(chip.counters().fifoUnderruns == 0);
+    uint32_t txDriver = chip.counters().txLatency;
+
+    // Former RX, byte by byte once PayloadReady
+    chip.clearCounters();
+    CHECK(chip.inject(frame, sizeof(frame), CHANNEL2));
+    while (!chip.dio(0)) chip.advance(1000);
+    uint8_t buffer[sizeof(frame) + 2];
+    uint8_t length = 0;
+    while (length < sizeof(buffer) && dataAvail()) buffer[length++] = readByte(REG_FIFO);
+    CHECK(length >= sizeof(frame));
+    uint32_t rxFormer = chip.counters().rxLatency;
+
+    // Former TX, FIFO written in Standby then Tx
+    chip.clearCounters();
+    Radio::setStandby();
+    Radio::clearFlags();
+    writeBytes(REG_FIFO, frame, sizeof(frame));
+    Radio::setTx();
+    chip.advance(HostTest::airTimeNs(sizeof(frame)));
+    CHECK(chip.counters().framesSent == 1);
+    uint32_t txFormer = chip.counters().txLatency;
+    ulTaskNotifyTake(pdTRUE, 0);
+
+    printf("fifo;rx;former;%.1f;driver;%.1f;%.1f us\n", rxFormer / 1000.0, rxDriver[0] / 1000.0, rxDriver[1] / 1000.0);
+    printf("fifo;tx;former;%.1f;driver;%.1f us\n", txFormer / 1000.0, txDriver / 1000.0);
+    CHECK(rxDriver[0] < rxFormer);
+    CHECK(rxDriver[1] < rxFormer);
+    CHECK(txDriver < txFormer);
+
+    return HostTest::result();
+}
@@ -0,0 +1,81 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef HOST_RADIO_H
+#define HOST_RADIO_H
+
+#include <cstdio>
+
+#include <SX1276Sim.h>
+#include <iohcFrameBuilder.h>
+#include <iohcRadio.h>
+
+/*
+    Host tests: iohcRadio on the simulated SX1276 (RADIO_SIM). There is no radio task and no esp_timer,
+    the test plays the air and runs the task on each notification of the interrupt, and fires the Tx
+    ticker itself. CHECK counts the failures, the test returns HostTest::result().
+*/
+#define CHECK(cond) HostTest::check((cond), #cond, __FILE__, __LINE__)
+
+namespace HostTest {
+    inline uint32_t failures = 0;
+    inline uint32_t frequencies[] = {CHANNEL2};
+
+    inline bool check(bool ok, const char *what, const char *file, int line) {
+        if (!ok) {
+            failures += 1;
+            printf("FAILED %s:%d %s\n", file, line, what);
+        }
+        return ok;
+    }
+
+    inline int result() {
+        printf(failures ? "%u check(s) failed\n" : "OK\n", failures);
+        return failures ? 1 : 0;
+    }
+
+    inline Radio::Sim::Chip &chip() { return Radio::Sim::chip(); }
+
+    // Radio started on CHANNEL2 alone, printing off
+    inline IOHC::iohcRadio *startRadio(IOHC::IohcPacketDelegate rx, IOHC::IohcPacketDelegate tx = nullptr) {
+        auto *radio = IOHC::iohcRadio::getInstance();
+        radio->printFrames = false;
+        radio->start(1, frequencies, 0, std::move(rx), std::move(tx));
+        return radio;
+    }
+
+    // Plays the air for ns, by steps, running the radio task each time the interrupt notified it
+    inline void run(IOHC::iohcRadio *radio, uint64_t ns, uint64_t step = 20000) {
+        for (uint64_t t = 0; t < ns; t += step) {
+            chip().advance(step);
+            while (uint32_t notification = ulTaskNotifyTake(pdTRUE, 0))
+                radio->service(notification);
+        }
+    }
+
+    // Frame on air long enough for the sim to receive it (preamble, sync, payload, CRC)
+    inline uint64_t airTimeNs(uint8_t length) {
+        return (PREAMBLE_LSB + 8 + length + 2 + 4) * chip().byteTimeNs();
+    }
+
+    inline bool inject(IOHC::iohcRadio *radio, const IOHC::iohcPacket &packet) {
+        bool started = chip().inject(packet.payload.buffer, packet.buffer_length, CHANNEL2);
+        run(radio, airTimeNs(packet.buffer_length));
+        return started;
+    }
+}
+
+#endif // HOST_RADIO_H
@@ -0,0 +1,82 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <cstring>
+
+#include "hostRadio.h"
+
+// A 1W press and a 2W command injected on air reach the rx callback as sent, then a frame sent goes on air
+int main() {
+    using namespace IOHC;
+    uint32_t received = 0;
+    iohcPacket last{};
+    uint32_t sentCB = 0;
+    auto *radio = HostTest::startRadio([&](iohcPacket *packet) {
+        received += 1;
+        last = *packet;
+        return true;
+    }, [&](iohcPacket *) {
+        sentCB += 1;
+        return true;
+    });
+
+    const address remote = {0xbe, 0x0c, 0x48};
+    const address gateway = {0xba, 0x11, 0xad};
+    const address heater = {0x12, 0x34, 0x56};
+
+    // 1W Close press to the broadcast address of the roller shutters
+    iohcPacket press{};
+    address broadcast;
+    broadcast1W(broadcast, 0);
+    buildFrame(&press, Frames::Remote0x00_14, remote, broadcast);
+    press.payload.packet.msg.p0x00_14.main[0] = 0xc8;
+    press.payload.packet.msg.p0x00_14.sequence[1] = 0x16;
+    CHECK(HostTest::inject(radio, press));
+    CHECK(received == 1);
+    CHECK(last.buffer_length == press.buffer_length);
+    CHECK(memcmp(last.payload.buffer, press.payload.buffer, press.buffer_length) == 0);
+    CHECK(last.payload.packet.header.CtrlByte1.asStruct.Protocol == 1);
+
+    // 2W setMode from the gateway to a heater
+    iohcPacket mode{};
+    buildFrame(&mode, Frames::CozySetMode, gateway, heater);
+    CHECK(HostTest::inject(radio, mode));
+    CHECK(received == 2);
+    CHECK(last.buffer_length == mode.buffer_length);
+    CHECK(memcmp(last.payload.buffer, mode.payload.buffer, mode.buffer_length) == 0);
+    CHECK(last.payload.packet.header.CtrlByte1.asStruct.Protocol == 0);
+
+    const auto &counters = HostTest::chip().counters();
+    CHECK(counters.framesReceived == 2);
+    CHECK(counters.framesDropped == 0);
+
+    // A frame given to send() goes on air when its ticker fires, then the receiver listens again
+    uint32_t onAir = 0;
+    HostTest::chip().onTransmit([&](const uint8_t *frame, uint8_t len, uint32_t) {
+        onAir += len == mode.buffer_length && memcmp(frame, mode.payload.buffer, len) == 0;
+    });
+    std::vector<iohcPacket *> batch{buildFrame(Frames::CozySetMode, gateway, heater)};
+    radio->send(batch);
+    CHECK(batch.empty());
+    radio->txTicker().fire();
+    HostTest::run(radio, HostTest::airTimeNs(mode.buffer_length));
+    CHECK(onAir == 1);
+    CHECK(sentCB == 1);
+    CHECK(HostTest::inject(radio, press));
+    CHECK(received == 3);
+
+    return HostTest::result();
+}
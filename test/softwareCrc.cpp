@@ -0,0 +1,55 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include "hostRadio.h"
+
+// CRC checked by the driver: a frame with its CRC bytes is passed on, a frame without is dropped before
+// any handler sees it
+int main() {
+    using namespace IOHC;
+    uint32_t received = 0;
+    auto *radio = HostTest::startRadio([&](iohcPacket *) {
+        received += 1;
+        return true;
+    });
+    radio->softwareCrc(true);
+
+    const address gateway = {0xba, 0x11, 0xad};
+    const address heater = {0x12, 0x34, 0x56};
+    iohcPacket mode{};
+    buildFrame(&mode, Frames::CozySetMode, gateway, heater);
+
+    CHECK(HostTest::inject(radio, mode));
+    CHECK(received == 1);
+    CHECK(radio->crcStats().checked == 1);
+
+    // Cut short on air, its length byte announces two more bytes: what comes in their place is the CRC,
+    // the real one never does
+    iohcPacket cut = mode;
+    cut.buffer_length -= 2;
+    CHECK(HostTest::inject(radio, cut));
+    CHECK(received == 1);
+    CHECK(radio->crcStats().unchecked == 1);
+    CHECK(radio->crcStats().failed == 0);
+
+    // Still listening
+    CHECK(HostTest::inject(radio, mode));
+    CHECK(received == 2);
+    CHECK(radio->crcStats().checked == 2);
+
+    radio->softwareCrc(false);
+    return HostTest::result();
+}
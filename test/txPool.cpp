@@ -0,0 +1,62 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <algorithm>
+
+#include "hostRadio.h"
+
+// A TX pool slot is never lent twice while taken: the pool wrapping onto a busy slot lends a heap
+// packet instead, and a frame given to send() is back in the pool once on air
+int main() {
+    using namespace IOHC;
+    auto *radio = HostTest::startRadio([](iohcPacket *) { return true; });
+    const address gateway = {0xba, 0x11, 0xad};
+    const address heater = {0x12, 0x34, 0x56};
+
+    iohcPacket *taken[IOHC_TX_POOL_SIZE];
+    for (auto &packet: taken) packet = txSlot();
+    std::sort(taken, taken + IOHC_TX_POOL_SIZE);
+    CHECK(std::adjacent_find(taken, taken + IOHC_TX_POOL_SIZE) == taken + IOHC_TX_POOL_SIZE);
+
+    // Pool all taken, the next packet is none of its slots
+    iohcPacket *spare = txSlot();
+    CHECK(!std::binary_search(taken, taken + IOHC_TX_POOL_SIZE, spare));
+    releaseFrame(spare);
+
+    // The one slot given back is the one lent
+    releaseFrame(taken[10]);
+    CHECK(txSlot() == taken[10]);
+    for (auto *packet: taken) releaseFrame(packet);
+
+    // A frame sent, repeated, is released after its last emission only
+    iohcPacket *frame = buildFrame(Frames::CozySetMode, gateway, heater);
+    frame->tx.repeat = 2;
+    std::vector<iohcPacket *> batch{frame};
+    radio->send(batch);
+    for (uint8_t emission = 0; emission < 2; emission++) {
+        radio->txTicker().fire();
+        HostTest::run(radio, HostTest::airTimeNs(frame->buffer_length));
+        bool lent = false;
+        for (auto &packet: taken) {
+            packet = txSlot();
+            lent |= packet == frame;
+        }
+        for (auto *packet: taken) releaseFrame(packet);
+        CHECK(lent == (emission == 1));
+    }
+
+    return HostTest::result();
+}
@@ -0,0 +1,69 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include "hostRadio.h"
+
+// Each fault of the simulator is recovered by the radio task idle checks, at its level, and RX resumes
+int main() {
+    using namespace IOHC;
+    using Radio::Sim::Fault;
+    uint32_t received = 0;
+    auto *radio = HostTest::startRadio([&](iohcPacket *) {
+        received += 1;
+        return true;
+    });
+
+    const address remote = {0xbe, 0x0c, 0x48};
+    address broadcast;
+    broadcast1W(broadcast, 0);
+    iohcPacket press{};
+    buildFrame(&press, Frames::Remote0x00_14, remote, broadcast);
+
+    const struct {
+        Fault fault;
+        const char *name;
+        Recovery level;
+    } cases[] = {
+        {Fault::StuckPreamble, "stuck preamble", Recovery::RestartRx},
+        {Fault::PllUnlock, "PLL unlock", Recovery::RestartRx},
+        {Fault::ConfigLost, "config lost", Recovery::Registers},
+        {Fault::Dead, "dead", Recovery::HardReset},
+    };
+
+    for (const auto &c: cases) {
+        HostTest::chip().fault(c.fault);
+        const WatchdogMetrics before = radio->watchdog.getMetrics();
+        Recovery highest = Recovery::None;
+        // Idle time outs of the radio task, each one a check
+        for (uint8_t check = 0; check < 8 && radio->watchdog.getMetrics().recovered == before.recovered; check++) {
+            HostTest::run(radio, 1000000);
+            radio->service(0);
+            const WatchdogMetrics &now = radio->watchdog.getMetrics();
+            for (uint8_t level = 0; level < WD_RECOVERY_LEVELS; level++)
+                if (now.recoveries[level] != before.recoveries[level]) highest = static_cast<Recovery>(level + 1);
+        }
+        printf("watchdog;%s;level %u\n", c.name, static_cast<uint8_t>(highest));
+        CHECK(radio->watchdog.getMetrics().recovered == before.recovered + 1);
+        CHECK(highest == c.level);
+        CHECK(HostTest::chip().fault() == Fault::None);
+
+        uint32_t expected = received + 1;
+        CHECK(HostTest::inject(radio, press));
+        CHECK(received == expected);
+    }
+
+    return HostTest::result();
+}
@@ -0,0 +1,223 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/*
+    Host converter for the frame captures, built from the firmware sources:
+    g++ -std=gnu++2a -O2 -DRADIO_SIM -Iinclude -o iohc2pcapng tools/iohc2pcapng.cpp src/iohcPcap.cpp src/iohcFrame.cpp src/iohcFormat.cpp
+
+    iohc2pcapng capture.bin out.pcapng      Ring file copied from LittleFS
+    iohc2pcapng console.log out.pcapng      Console log holding the output of capPcap
+    iohc2pcapng --lua iohc.lua              Wireshark dissector for the pcapng frames
+
+    The dissector is generated from the same tables as the firmware (iohcProtocol.h, iohcFrame.cpp), so
+    names and field offsets stay in step with the decoder. Copy it in the Wireshark plugins folder.
+*/
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <iohcCapture.h>
+#include <iohcFrame.h>
+#include <iohcPcap.h>
+#include <iohcProtocol.h>
+
+using namespace IOHC;
+
+namespace {
+    int fromHex(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    // Ring file: records sorted by sequence, free slots left out
+    bool convertRing(FILE *in, FILE *out) {
+        CaptureHeader header{};
+        if (fread(&header, sizeof(header), 1, in) != 1 || memcmp(header.magic, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC)) != 0)
+            return false;
+        if (header.version != CAPTURE_VERSION || header.recordSize != sizeof(CaptureRecord)) {
+            fprintf(stderr, "Capture version %u with %u bytes records is not supported\n", header.version, header.recordSize);
+            return false;
+        }
+
+        std::vector<CaptureRecord> records;
+        fseek(in, CAPTURE_DATA_OFFSET, SEEK_SET);
+        CaptureRecord rec;
+        for (uint32_t i = 0; i < header.capacity && fread(&rec, sizeof(rec), 1, in) == 1; i++)
+            if (rec.sequence) records.push_back(rec);
+        std::sort(records.begin(), records.end(),
+                  [](const CaptureRecord &a, const CaptureRecord &b) { return a.sequence < b.sequence; });
+
+        PcapWriter pcap(filePcapSink(out));
+        pcap.begin();
+        for (const auto &r: records) pcap.frame(r);
+        fprintf(stderr, "%zu frames\n", records.size());
+        return true;
+    }
+
+    // Console log: the blocks are already pcapng, only the hex is undone
+    bool convertLog(FILE *in, FILE *out) {
+        char line[2 * PCAP_BLOCK_MAX + 64];
+        uint8_t block[PCAP_BLOCK_MAX];
+        size_t blocks = 0;
+        const size_t prefix = strlen(PCAP_LINE_PREFIX);
+        while (fgets(line, sizeof(line), in)) {
+            const char *hex = strstr(line, PCAP_LINE_PREFIX);
+            if (!hex) continue;
+            hex += prefix;
+            size_t size = 0;
+            while (size < sizeof(block) && fromHex(hex[0]) >= 0 && fromHex(hex[1]) >= 0) {
+                block[size++] = static_cast<uint8_t>(fromHex(hex[0]) << 4 | fromHex(hex[1]));
+                hex += 2;
+            }
+            if (size < 12 || size % 4) {
+                fprintf(stderr, "Skipping a damaged block of %zu bytes\n", size);
+                continue;
+            }
+            fwrite(block, 1, size, out);
+            blocks++;
+        }
+        fprintf(stderr, "%zu blocks\n", blocks);
+        return blocks != 0;
+    }
+
+    template <size_t Size>
+    void luaTable(FILE *out, const char *name, const std::array<std::string_view, Size> &table) {
+        fprintf(out, "local %s = {\n", name);
+        for (size_t v = 0; v < Size; v++)
+            if (!table[v].empty()) fprintf(out, "    [0x%02zx] = \"%.*s\",\n", v, static_cast<int>(table[v].size()), table[v].data());
+        fprintf(out, "}\n\n");
+    }
+
+    void writeLua(FILE *out) {
+        fprintf(out, "-- io-homecontrol frames in pcapng (LINKTYPE_USER0), generated by iohc2pcapng --lua\n\n");
+        luaTable(out, "commands", Protocol::commands);
+        luaTable(out, "originators", Protocol::originators);
+
+        fprintf(out, "local layouts = {\n");
+        for (uint8_t l = 0; l < static_cast<uint8_t>(Layout::Count); l++)
+            fprintf(out, "    [%u] = \"%s\",\n", l, layoutName(static_cast<Layout>(l)));
+        fprintf(out, "}\n\n");
+
+        // Field spans of each layout, offsets from the first data byte
+        fprintf(out, "local layout_fields = {\n");
+        for (uint8_t l = 0; l < static_cast<uint8_t>(Layout::Count); l++) {
+            fprintf(out, "    [%u] = {", l);
+            for (uint8_t f = 0; f < static_cast<uint8_t>(Field::Count); f++) {
+                FieldSpan span = layoutField(static_cast<Layout>(l), static_cast<Field>(f));
+                if (span.length) fprintf(out, " {\"%s\", %u, %u},", fieldName(static_cast<Field>(f)), span.offset, span.length);
+            }
+            fprintf(out, " },\n");
+        }
+        fprintf(out, "}\n\n");
+
+        fprintf(out,
+            "local iohc = Proto(\"iohc\", \"io-homecontrol\")\n"
+            "local pf = {\n"
+            "    flags = ProtoField.uint16(\"iohc.flags\", \"Flags\", base.HEX),\n"
+            "    tx = ProtoField.bool(\"iohc.tx\", \"Sent\", 16, nil, 0x%04x),\n"
+            "    oneway = ProtoField.bool(\"iohc.oneway\", \"1W\", 16, nil, 0x%04x),\n"
+            "    frequency = ProtoField.uint32(\"iohc.frequency\", \"Frequency (Hz)\"),\n"
+            "    afc = ProtoField.int32(\"iohc.afc\", \"AFC (Hz)\"),\n"
+            "    rssi = ProtoField.int16(\"iohc.rssi\", \"RSSI (dBm x 10)\"),\n"
+            "    layout = ProtoField.uint8(\"iohc.layout\", \"Layout\", base.DEC, layouts),\n"
+            "    ctrl1 = ProtoField.uint8(\"iohc.ctrl1\", \"CtrlByte1\", base.HEX),\n"
+            "    ctrl2 = ProtoField.uint8(\"iohc.ctrl2\", \"CtrlByte2\", base.HEX),\n"
+            "    target = ProtoField.bytes(\"iohc.target\", \"Target\"),\n"
+            "    source = ProtoField.bytes(\"iohc.source\", \"Source\"),\n"
+            "    cmd = ProtoField.uint8(\"iohc.cmd\", \"Command\", base.HEX, commands),\n"
+            "    data = ProtoField.bytes(\"iohc.data\", \"Data\"),\n"
+            "}\n",
+            PCAP_FLAG_TX, PCAP_FLAG_1W);
+        for (uint8_t f = 0; f < static_cast<uint8_t>(Field::Count); f++) {
+            const char *name = fieldName(static_cast<Field>(f));
+            if (static_cast<Field>(f) == Field::Origin)
+                fprintf(out, "pf.f_%s = ProtoField.uint8(\"iohc.field.%s\", \"%s\", base.HEX, originators)\n", name, name, name);
+            else
+                fprintf(out, "pf.f_%s = ProtoField.bytes(\"iohc.field.%s\", \"%s\")\n", name, name, name);
+        }
+
+        fprintf(out,
+            "iohc.fields = {}\n"
+            "for _, f in pairs(pf) do table.insert(iohc.fields, f) end\n\n"
+            "function iohc.dissector(tvb, pinfo, tree)\n"
+            "    local hlen = tvb(1, 1):uint()\n"
+            "    local root = tree:add(iohc, tvb())\n"
+            "    local meta = root:add(iohc, tvb(0, hlen), \"Capture\")\n"
+            "    meta:add_le(pf.flags, tvb(2, 2))\n"
+            "    meta:add_le(pf.tx, tvb(2, 2))\n"
+            "    meta:add_le(pf.oneway, tvb(2, 2))\n"
+            "    meta:add_le(pf.frequency, tvb(4, 4))\n"
+            "    meta:add_le(pf.afc, tvb(8, 4))\n"
+            "    meta:add_le(pf.rssi, tvb(12, 2))\n"
+            "    meta:add(pf.layout, tvb(14, 1))\n"
+            "    pinfo.cols.protocol = \"IOHC\"\n"
+            "    local frame = tvb(hlen):tvb()\n"
+            "    if frame:len() < %u then return end\n"
+            "    root:add(pf.ctrl1, frame(0, 1))\n"
+            "    root:add(pf.ctrl2, frame(1, 1))\n"
+            "    root:add(pf.target, frame(2, 3))\n"
+            "    root:add(pf.source, frame(5, 3))\n"
+            "    root:add(pf.cmd, frame(8, 1))\n"
+            "    local cmd = frame(8, 1):uint()\n"
+            "    pinfo.cols.src = tostring(frame(5, 3):bytes())\n"
+            "    pinfo.cols.dst = tostring(frame(2, 3):bytes())\n"
+            "    pinfo.cols.info = commands[cmd] or string.format(\"CMD 0x%%02x\", cmd)\n"
+            "    if frame:len() == %u then return end\n"
+            "    local data = root:add(pf.data, frame(%u))\n"
+            "    for _, f in ipairs(layout_fields[tvb(14, 1):uint()] or {}) do\n"
+            "        if %u + f[2] + f[3] <= frame:len() then data:add(pf[\"f_\" .. f[1]], frame(%u + f[2], f[3])) end\n"
+            "    end\n"
+            "end\n\n"
+            "DissectorTable.get(\"wtap_encap\"):add(wtap.USER0, iohc)\n",
+            FRAME_HEADER_LEN, FRAME_HEADER_LEN, FRAME_HEADER_LEN, FRAME_HEADER_LEN, FRAME_HEADER_LEN);
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s capture.bin|console.log out.pcapng\n       %s --lua iohc.lua\n", argv[0], argv[0]);
+        return 2;
+    }
+    FILE *out = fopen(argv[2], "wb");
+    if (!out) {
+        perror(argv[2]);
+        return 1;
+    }
+    if (!strcmp(argv[1], "--lua")) {
+        writeLua(out);
+        fclose(out);
+        return 0;
+    }
+
+    FILE *in = fopen(argv[1], "rb");
+    if (!in) {
+        perror(argv[1]);
+        return 1;
+    }
+    bool done = convertRing(in, out);
+    if (!done) {
+        rewind(in);
+        done = convertLog(in, out);
+    }
+    fclose(in);
+    fclose(out);
+    if (!done) fprintf(stderr, "%s: neither a capture ring nor a capPcap log\n", argv[1]);
+    return done ? 0 : 1;
+}
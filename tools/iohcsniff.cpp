@@ -0,0 +1,159 @@
+/*
+   Copyright (c) 2024. CRIDP https://github.com/cridp
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+           http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/*
+    Host receiver for the sniffer stream ('sniffer on' on the console), built from the firmware sources:
+    g++ -std=gnu++2a -O2 -DRADIO_SIM -Iinclude -o iohcsniff tools/iohcsniff.cpp src/iohcSniffer.cpp src/iohcCrc.cpp src/iohcPcap.cpp src/iohcFrame.cpp src/iohcFormat.cpp
+
+    iohcsniff /dev/ttyUSB0                  Frames as text lines, as capDump
+    iohcsniff /dev/ttyUSB0 -w live.pcapng   Also to pcapng, see iohc2pcapng --lua for the dissector
+    iohcsniff stream.bin -b 0 -q            Recorded stream (or - for stdin), counters only
+
+    The decoder is the SnifferDecoder of the firmware. Counters and the sustained frame rate are printed on
+    Ctrl-C or at the end of the input.
+*/
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <iohcFormat.h>
+#include <iohcPcap.h>
+#include <iohcSniffer.h>
+
+using namespace IOHC;
+
+namespace {
+    volatile sig_atomic_t stopping = 0;
+
+    speed_t termiosSpeed(uint32_t baud) {
+        switch (baud) {
+            case 115200: return B115200;
+            case 230400: return B230400;
+            case 460800: return B460800;
+            case 921600: return B921600;
+            case 1000000: return B1000000;
+            case 2000000: return B2000000;
+            default: return 0;
+        }
+    }
+
+    // Raw mode, reads return what arrived within 100 ms
+    bool setupTty(int fd, uint32_t baud) {
+        termios tty{};
+        if (tcgetattr(fd, &tty) != 0) return false;
+        cfmakeraw(&tty);
+        speed_t speed = termiosSpeed(baud);
+        if (!speed) return false;
+        cfsetispeed(&tty, speed);
+        cfsetospeed(&tty, speed);
+        tty.c_cflag |= CLOCAL | CREAD;
+        tty.c_cc[VMIN] = 0;
+        tty.c_cc[VTIME] = 1;
+        return tcsetattr(fd, TCSANOW, &tty) == 0;
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <tty|file|-> [-b baud] [-w out.pcapng] [-q]\n", argv[0]);
+        return 2;
+    }
+    const char *input = argv[1];
+    uint32_t baud = SNIFFER_BAUD;
+    const char *pcapPath = nullptr;
+    bool quiet = false;
+    for (int i = 2; i < argc; i++) {
+        if (!strcmp(argv[i], "-b") && i + 1 < argc) baud = strtoul(argv[++i], nullptr, 10);
+        else if (!strcmp(argv[i], "-w") && i + 1 < argc) pcapPath = argv[++i];
+        else if (!strcmp(argv[i], "-q")) quiet = true;
+    }
+
+    int fd = strcmp(input, "-") ? open(input, O_RDONLY | O_NOCTTY) : STDIN_FILENO;
+    if (fd < 0) {
+        perror(input);
+        return 1;
+    }
+    if (isatty(fd) && !setupTty(fd, baud)) {
+        fprintf(stderr, "%s: can't set %u bauds\n", input, baud);
+        return 1;
+    }
+
+    FILE *pcapFile = pcapPath ? fopen(pcapPath, "wb") : nullptr;
+    if (pcapPath && !pcapFile) {
+        perror(pcapPath);
+        return 1;
+    }
+    PcapWriter pcap(pcapFile ? filePcapSink(pcapFile) : PcapWriter::Sink([](const uint8_t *, size_t) {}));
+    if (pcapFile) pcap.begin();
+
+    // The board sends the low 32 bits of its time, wraps are counted here
+    uint64_t epoch = 0;
+    uint32_t lastStamp = 0;
+    SnifferDecoder decoder([&](const SnifferFrame &f) {
+        if (f.header.timestampUs < lastStamp) epoch += 1ull << 32;
+        lastStamp = f.header.timestampUs;
+
+        if (pcapFile) {
+            CaptureRecord rec{};
+            rec.sequence = f.header.sequence;
+            rec.frequency = f.header.frequency;
+            rec.timestampUs = epoch + f.header.timestampUs;
+            rec.afc = f.header.afc;
+            rec.rssi = f.header.rssi;
+            rec.direction = f.header.direction;
+            rec.length = f.header.length;
+            memcpy(rec.frame, f.frame, f.header.length);
+            pcap.frame(rec);
+            fflush(pcapFile);
+        }
+        if (!quiet) {
+            char hex[2 * MAX_FRAME_LEN + 1];
+            hexEncode(hex, f.frame, f.header.length);
+            printf("%u;%llu;%u;%.1f;%d;%s;%s\n", f.header.sequence, static_cast<unsigned long long>(epoch + f.header.timestampUs),
+                   f.header.frequency, f.header.rssi / 10.0, f.header.afc, f.header.direction == Direction::Tx ? "TX" : "RX", hex);
+        }
+    });
+
+    signal(SIGINT, [](int) { stopping = 1; });
+    auto start = std::chrono::steady_clock::now();
+    uint8_t buffer[4096];
+    size_t bytes = 0;
+    while (!stopping) {
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        if (n < 0) break;
+        if (n == 0) {
+            if (isatty(fd)) continue;
+            break;
+        }
+        bytes += n;
+        decoder.feed(buffer, n);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    const auto &stats = decoder.getStats();
+    fprintf(stderr, "%u frames, %u lost, %u CRC errors, %u framing errors, %zu bytes in %.1f s: %.0f frames/s\n",
+            stats.frames, stats.lost, stats.crcErrors, stats.framingErrors, bytes, elapsed.count(),
+            elapsed.count() > 0 ? stats.frames / elapsed.count() : 0.0);
+    if (pcapFile) fclose(pcapFile);
+    return 0;
+}